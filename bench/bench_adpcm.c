@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "adpcm.h"
+
+/*
+ * Measures how fast ADPCM blocks are decoded on one core and how many
+ * streams of the given sample rate that is in real time. The blocks are
+ * random, which the decoders handle like any other data.
+*/
+
+#define SAMPLE_RATE (48000)
+#define BLOCK_ALIGN_PER_CHANNEL (256)
+#define BLOCK_COUNT (1024)
+#define MINIMUM_SECONDS (1.0)
+
+static const int16_t msCoefficients[][2] = {
+    { 256, 0 }, { 512, -256 }, { 0, 0 }, { 192, 64 },
+    { 240, 0 }, { 460, -208 }, { 392, -232 }
+};
+
+double now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+void benchDecode(enum AdpcmVariant variant, uint16_t channelAmount) {
+    AdpcmFormat format = {
+        .variant = variant,
+        .channelAmount = channelAmount,
+        .blockAlign = BLOCK_ALIGN_PER_CHANNEL * channelAmount,
+    };
+    if (variant == ADPCM_VARIANT_MS) {
+        format.coefficientCount = sizeof(msCoefficients) / sizeof(msCoefficients[0]);
+        memcpy(format.coefficients, msCoefficients, sizeof(msCoefficients));
+    }
+    format.framesPerBlock = adpcmGetBlockFrames(&format, format.blockAlign);
+
+    uint8_t *blocks = malloc((size_t)BLOCK_COUNT * format.blockAlign);
+    int16_t *frames = malloc((size_t)format.framesPerBlock * channelAmount * sizeof(int16_t));
+    if (blocks == NULL || frames == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    srand(1);
+    for (size_t i = 0; i < (size_t)BLOCK_COUNT * format.blockAlign; ++i) {
+        blocks[i] = rand();
+    }
+
+    // Decode all blocks until enough time has passed.
+    uint64_t decodedFrames = 0;
+    int64_t checksum = 0;
+    double start = now();
+    double seconds;
+    do {
+        for (int i = 0; i < BLOCK_COUNT; ++i) {
+            decodedFrames += adpcmDecodeBlock(
+                &format, blocks + (size_t)i * format.blockAlign,
+                format.blockAlign, frames
+            );
+            checksum += frames[0];
+        }
+        seconds = now() - start;
+    } while (seconds < MINIMUM_SECONDS);
+
+    double samplesPerSecond = decodedFrames * channelAmount / seconds;
+    double streams = decodedFrames / seconds / SAMPLE_RATE;
+    printf(
+        "%-10s %8u %14.1f %18.1f\n",
+        variant == ADPCM_VARIANT_IMA ? "ima" : "ms", channelAmount,
+        samplesPerSecond / 1e6, streams
+    );
+    if (checksum == 1) putchar('\0');
+
+    free(blocks);
+    free(frames);
+}
+
+int main() {
+    printf("%d Hz, %d bytes per channel and block\n\n", SAMPLE_RATE, BLOCK_ALIGN_PER_CHANNEL);
+    printf("%-10s %8s %14s %18s\n", "variant", "channels", "Msamples/s", "realtime streams");
+    uint16_t channelAmounts[] = { 1, 2, 6 };
+    for (size_t i = 0; i < sizeof(channelAmounts) / sizeof(channelAmounts[0]); ++i) {
+        benchDecode(ADPCM_VARIANT_IMA, channelAmounts[i]);
+    }
+    for (size_t i = 0; i < sizeof(channelAmounts) / sizeof(channelAmounts[0]); ++i) {
+        benchDecode(ADPCM_VARIANT_MS, channelAmounts[i]);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "flac.h"
+
+/*
+ * Measures the FLAC decoder on one or more files that are read into memory
+ * first. Every file is decoded once through a FLAC stream like an audio
+ * object would do. The CPU time of the decoding thread gives how many
+ * seconds of audio one core decodes per second. Afterwards the cost of
+ * finding the frame for random positions is measured, which is what a jump
+ * costs before decoding restarts.
+*/
+
+#define BLOCK_FRAMES (4096)
+#define QUEUE_DEPTH (8)
+#define FRAMES_PER_WRITE (1024)
+#define SEEK_COUNT (1000)
+
+double now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+uint8_t * readFile(const char *path, size_t *size) {
+    int fileDescriptor = open(path, O_RDONLY);
+    struct stat fileStats;
+    if (fileDescriptor == -1 || fstat(fileDescriptor, &fileStats) == -1) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    *size = fileStats.st_size;
+    uint8_t *data = malloc(*size);
+    if (data == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    size_t bytesRead = 0;
+    while (bytesRead < *size) {
+        ssize_t result = read(fileDescriptor, data + bytesRead, *size - bytesRead);
+        if (result <= 0) {
+            perror(path);
+            exit(EXIT_FAILURE);
+        }
+        bytesRead += result;
+    }
+    close(fileDescriptor);
+    return data;
+}
+
+void benchDecode(const FlacInfo *info) {
+    // Consume the stream like the audio thread, just without waiting for
+    // the sound device.
+    FlacStream *stream = flacStreamOpen(info, BLOCK_FRAMES, QUEUE_DEPTH);
+    if (stream == NULL) {
+        fprintf(stderr, "Could not open the stream\n");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t checksum = 0;
+    uint64_t frame = 0;
+    double start = now();
+    while (frame < info->totalSamples) {
+        flacStreamSetPlayhead(stream, frame, 0);
+        uint32_t frameCount = FRAMES_PER_WRITE;
+        const uint8_t *frames = flacStreamGetFrames(stream, frame, &frameCount);
+        if (frameCount == 0) {
+            sched_yield();
+            continue;
+        }
+        checksum += frames[0];
+        frame += frameCount;
+    }
+    double seconds = now() - start;
+
+    uint64_t nanoseconds, decodedFrames;
+    flacStreamGetDecodeTime(stream, &nanoseconds, &decodedFrames);
+    double audioSeconds = (double)decodedFrames / info->sampleRate;
+    printf(
+        "%10.1f s %12.1f x %12.1f x %10.3f%%",
+        (double)info->totalSamples / info->sampleRate,
+        audioSeconds / (nanoseconds / 1e9), audioSeconds / seconds,
+        100.0 * nanoseconds / 1e9 / audioSeconds
+    );
+    if (checksum == 1) putchar('\0');
+    flacStreamClose(stream);
+}
+
+void benchSeek(const FlacInfo *info) {
+    srand(1);
+    uint64_t checksum = 0;
+    double start = now();
+    for (int i = 0; i < SEEK_COUNT; ++i) {
+        uint64_t sample = ((uint64_t)rand() * RAND_MAX + rand()) % info->totalSamples;
+        checksum += flacFindFrame(info, sample);
+    }
+    double seconds = now() - start;
+    printf(" %10.1f us %8u\n", seconds / SEEK_COUNT * 1e6, info->seekPointCount);
+    if (checksum == 1) putchar('\0');
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s FLAC_FILE...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf(
+        "%-24s %12s %14s %14s %11s %13s %8s\n", "file", "duration",
+        "decode speed", "stream speed", "CPU load", "seek", "points"
+    );
+    for (int i = 1; i < argc; ++i) {
+        size_t size;
+        uint8_t *data = readFile(argv[i], &size);
+        FlacInfo info;
+        if (!flacReadInfo(data, size, size, &info)) {
+            fprintf(stderr, "%s: not a supported FLAC file\n", argv[i]);
+            free(data);
+            continue;
+        }
+        printf("%-24.24s ", argv[i]);
+        benchDecode(&info);
+        benchSeek(&info);
+        flacFreeInfo(&info);
+        free(data);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,449 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audio.h"
+
+/*
+ * Measures the library against a sound device that needs no hardware,
+ * ALSA's null PCM by default, and writes the results as JSON so releases
+ * can be compared.
+ *
+ * - Every format of the test matrix is probed and initialized from memory,
+ *   once opening the device and once taking a pcm of the pcm pool.
+ * - 1, 4 and 16 streams play at once. The CPU time per second of audio
+ *   written is what one stream costs in real time, independent of how fast
+ *   the device consumes frames. The null PCM consumes them as fast as they
+ *   are written, a real device in real time.
+ * - Play, pause and jump are timed until the audio thread applied them.
+ *
+ * Allocations are counted by replacing malloc() for the whole process,
+ * syscalls with the raw_syscalls:sys_enter tracepoint if perf may read it.
+*/
+
+#define TIME_RESOLUTION (10)
+#define PROBE_REPETITIONS (200)
+#define INIT_REPETITIONS (5)
+#define POOL_IDLE_MILLISECONDS (10000)
+#define STREAM_SECONDS (60)
+#define STREAM_SAMPLE_RATE (44100)
+#define MEASURE_SECONDS (2.0)
+#define SETTLE_SECONDS (0.2)
+#define COMMAND_REPETITIONS (100)
+
+static const uint32_t sampleRates[] = { 8000, 44100 };
+static const uint16_t channelAmounts[] = { 1, 2, 3, 5 };
+static const uint16_t bitDepths[] = { 8, 16, 24, 32 };
+static const uint32_t streamAmounts[] = { 1, 4, 16 };
+
+static _Atomic uint64_t allocationCount;
+
+extern void * __libc_malloc(size_t size);
+extern void * __libc_calloc(size_t count, size_t size);
+extern void * __libc_realloc(void *pointer, size_t size);
+extern void * __libc_memalign(size_t alignment, size_t size);
+
+void * malloc(size_t size) {
+    atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void * calloc(size_t count, size_t size) {
+    atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void * realloc(void *pointer, size_t size) {
+    atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+void * aligned_alloc(size_t alignment, size_t size) {
+    atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **pointer, size_t alignment, size_t size) {
+    atomic_fetch_add_explicit(&allocationCount, 1, memory_order_relaxed);
+    *pointer = __libc_memalign(alignment, size);
+    return *pointer == NULL ? ENOMEM : 0;
+}
+
+uint64_t getAllocationCount() {
+    return atomic_load_explicit(&allocationCount, memory_order_relaxed);
+}
+
+double now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+double cpuNow() {
+    struct timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+void sleepSeconds(double seconds) {
+    struct timespec time = {
+        .tv_sec = (time_t)seconds,
+        .tv_nsec = (long)((seconds - (time_t)seconds) * 1e9)
+    };
+    while (nanosleep(&time, &time) == -1 && errno == EINTR);
+}
+
+int openSyscallCounter() {
+    // The counter is inherited by the threads created afterwards, reading
+    // it sums them up.
+    static const char *paths[] = {
+        "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+        "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"
+    };
+    unsigned long long id;
+    bool found = false;
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]) && !found; ++i) {
+        FILE *file = fopen(paths[i], "r");
+        if (file == NULL) continue;
+        found = fscanf(file, "%llu", &id) == 1;
+        fclose(file);
+    }
+    if (!found) return -1;
+    struct perf_event_attr attributes = {
+        .type = PERF_TYPE_TRACEPOINT,
+        .size = sizeof(attributes),
+        .config = id,
+        .inherit = 1
+    };
+    return syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+}
+
+int64_t readSyscallCounter(int fileDescriptor) {
+    uint64_t value;
+    if (fileDescriptor == -1 || read(fileDescriptor, &value, sizeof(value)) != sizeof(value)) {
+        return -1;
+    }
+    return value;
+}
+
+uint64_t getContextSwitches() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+uint8_t * makeWav(
+    uint32_t sampleRate, uint16_t channelAmount, uint16_t bitDepth,
+    uint32_t seconds, size_t *size
+) {
+    // A 440 Hz sine at half scale on every channel.
+    uint32_t bytesPerSample = bitDepth / 8;
+    uint32_t frameCount = sampleRate * seconds;
+    uint32_t dataSize = frameCount * channelAmount * bytesPerSample;
+    *size = 44 + (size_t)dataSize;
+    uint8_t *wav = malloc(*size);
+    if (wav == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    uint32_t riffSize = 36 + dataSize;
+    uint32_t byteRate = sampleRate * channelAmount * bytesPerSample;
+    uint16_t blockAlign = channelAmount * bytesPerSample;
+    uint32_t fmtSize = 16;
+    uint16_t formatTag = 1;
+    memcpy(wav, "RIFF", 4);
+    memcpy(wav + 4, &riffSize, 4);
+    memcpy(wav + 8, "WAVEfmt ", 8);
+    memcpy(wav + 16, &fmtSize, 4);
+    memcpy(wav + 20, &formatTag, 2);
+    memcpy(wav + 22, &channelAmount, 2);
+    memcpy(wav + 24, &sampleRate, 4);
+    memcpy(wav + 28, &byteRate, 4);
+    memcpy(wav + 32, &blockAlign, 2);
+    memcpy(wav + 34, &bitDepth, 2);
+    memcpy(wav + 36, "data", 4);
+    memcpy(wav + 40, &dataSize, 4);
+
+    uint8_t *sample = wav + 44;
+    for (uint32_t frame = 0; frame < frameCount; ++frame) {
+        double value = 0.5 * sin(2.0 * M_PI * 440.0 * frame / sampleRate);
+        int32_t scaled = (int32_t)(value * 2147483647.0);
+        if (bitDepth == 8) scaled = (scaled >> 24) + 128;
+        else scaled >>= 32 - bitDepth;
+        for (uint16_t channel = 0; channel < channelAmount; ++channel) {
+            memcpy(sample, &scaled, bytesPerSample);
+            sample += bytesPerSample;
+        }
+    }
+    return wav;
+}
+
+AudioObject initFromMemory(const char *device, uint8_t *wav, size_t size) {
+    AudioConfiguration configuration = {
+        .rawData = wav,
+        .rawDataSize = size,
+        .soundDeviceName = (char*)device,
+        .soundDeviceNameSize = strlen(device),
+        .timeResolution = TIME_RESOLUTION
+    };
+    AudioObject audio = audioInit(&configuration);
+    if (audio == NULL) {
+        fprintf(stderr, "Could not allocate the audio object.\n");
+        exit(EXIT_FAILURE);
+    }
+    AudioError *error = audioGetError(audio);
+    if (error->level == AUDIO_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "Could not open %s: %s\n", device, audioGetErrorString(error));
+        exit(EXIT_FAILURE);
+    }
+    return audio;
+}
+
+void benchFormat(
+    FILE *json, const char *device, uint32_t sampleRate,
+    uint16_t channelAmount, uint16_t bitDepth, bool isFirst
+) {
+    size_t size;
+    uint8_t *wav = makeWav(sampleRate, channelAmount, bitDepth, 1, &size);
+
+    // Probing reads the header from a file like an indexer would.
+    char path[] = "/tmp/bench_playback_XXXXXX";
+    int fileDescriptor = mkstemp(path);
+    if (fileDescriptor == -1 || write(fileDescriptor, wav, size) != (ssize_t)size) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    close(fileDescriptor);
+    AudioProbe probe;
+    double start = now();
+    for (int i = 0; i < PROBE_REPETITIONS; ++i) {
+        if (!audioProbe(path, &probe)) {
+            fprintf(stderr, "Could not probe: %s\n", audioGetErrorString(&probe.error));
+            exit(EXIT_FAILURE);
+        }
+    }
+    double parseMicroseconds = (now() - start) / PROBE_REPETITIONS * 1e6;
+    unlink(path);
+
+    // Initializing opens the device and starts the audio thread.
+    double initSeconds = 0.0;
+    uint64_t initAllocations = 0;
+    for (int i = 0; i < INIT_REPETITIONS; ++i) {
+        uint64_t allocations = getAllocationCount();
+        start = now();
+        AudioObject audio = initFromMemory(device, wav, size);
+        initSeconds += now() - start;
+        initAllocations = getAllocationCount() - allocations;
+        audioDestroy(audio);
+    }
+    double initMicroseconds = initSeconds / INIT_REPETITIONS * 1e6;
+
+    // With the pcm pool every object after the first takes over the pcm.
+    audioSetPcmPool(1, POOL_IDLE_MILLISECONDS);
+    audioDestroy(initFromMemory(device, wav, size));
+    initSeconds = 0.0;
+    for (int i = 0; i < INIT_REPETITIONS; ++i) {
+        start = now();
+        AudioObject audio = initFromMemory(device, wav, size);
+        initSeconds += now() - start;
+        audioDestroy(audio);
+    }
+    audioSetPcmPool(0, 0);
+    double warmInitMicroseconds = initSeconds / INIT_REPETITIONS * 1e6;
+    free(wav);
+
+    printf(
+        "%8u %8u %5u %10.1f %10.1f %10.1f %12lu\n", sampleRate, channelAmount,
+        bitDepth, parseMicroseconds, initMicroseconds, warmInitMicroseconds,
+        initAllocations
+    );
+    fprintf(
+        json,
+        "%s\n    {\"sample_rate\": %u, \"channels\": %u, \"bits\": %u, "
+        "\"parse_us\": %.1f, \"init_us\": %.1f, \"warm_init_us\": %.1f, "
+        "\"init_allocations\": %lu}",
+        isFirst ? "" : ",", sampleRate, channelAmount, bitDepth,
+        parseMicroseconds, initMicroseconds, warmInitMicroseconds, initAllocations
+    );
+}
+
+void benchStreams(
+    FILE *json, const char *device, uint8_t *wav, size_t size,
+    uint32_t streamAmount, int syscallCounter, bool isFirst
+) {
+    AudioObject audios[streamAmount];
+    for (uint32_t i = 0; i < streamAmount; ++i) {
+        audios[i] = initFromMemory(device, wav, size);
+        audioPlay(audios[i], NULL);
+    }
+    sleepSeconds(SETTLE_SECONDS);
+
+    // Everything but the sleeping main thread is the audio threads.
+    AudioStats stats;
+    uint64_t framesWritten = 0, wakeups = 0, xruns = 0;
+    for (uint32_t i = 0; i < streamAmount; ++i) {
+        audioGetStats(audios[i], &stats);
+        framesWritten -= stats.framesWritten;
+        wakeups -= stats.wakeups;
+        xruns -= stats.xruns;
+    }
+    uint64_t allocations = getAllocationCount();
+    int64_t syscalls = readSyscallCounter(syscallCounter);
+    uint64_t contextSwitches = getContextSwitches();
+    double cpuStart = cpuNow();
+    double start = now();
+
+    sleepSeconds(MEASURE_SECONDS);
+
+    double seconds = now() - start;
+    double cpuSeconds = cpuNow() - cpuStart;
+    contextSwitches = getContextSwitches() - contextSwitches;
+    if (syscalls != -1) syscalls = readSyscallCounter(syscallCounter) - syscalls;
+    allocations = getAllocationCount() - allocations;
+    for (uint32_t i = 0; i < streamAmount; ++i) {
+        audioGetStats(audios[i], &stats);
+        framesWritten += stats.framesWritten;
+        wakeups += stats.wakeups;
+        xruns += stats.xruns;
+    }
+    for (uint32_t i = 0; i < streamAmount; ++i) audioDestroy(audios[i]);
+
+    double audioSeconds = (double)framesWritten / STREAM_SAMPLE_RATE;
+    double cpuPerStream = audioSeconds > 0.0 ? cpuSeconds / audioSeconds * 100.0 : 0.0;
+    double wakeupsPerSecond = wakeups / seconds / streamAmount;
+    printf(
+        "%8u %12.3f %10.1f %14.1f %14.1f %16.1f %6lu\n", streamAmount,
+        cpuPerStream, cpuSeconds / seconds * 100.0, wakeupsPerSecond,
+        allocations / seconds, contextSwitches / seconds, xruns
+    );
+    fprintf(
+        json,
+        "%s\n    {\"streams\": %u, \"cpu_percent_per_stream\": %.4f, "
+        "\"cpu_percent\": %.3f, \"audio_seconds\": %.3f, "
+        "\"wakeups_per_second_per_stream\": %.2f, \"allocations_per_second\": %.2f, "
+        "\"context_switches_per_second\": %.2f, \"xruns\": %lu, \"syscalls_per_second\": ",
+        isFirst ? "" : ",", streamAmount, cpuPerStream, cpuSeconds / seconds * 100.0,
+        audioSeconds, wakeupsPerSecond, allocations / seconds,
+        contextSwitches / seconds, xruns
+    );
+    if (syscalls == -1) fprintf(json, "null}");
+    else fprintf(json, "%.2f}", syscalls / seconds);
+}
+
+int compareDoubles(const void *a, const void *b) {
+    double difference = *(const double*)a - *(const double*)b;
+    return (difference > 0) - (difference < 0);
+}
+
+void writeLatencies(FILE *json, const char *name, double *latencies, bool isFirst) {
+    qsort(latencies, COMMAND_REPETITIONS, sizeof(double), compareDoubles);
+    double p50 = latencies[COMMAND_REPETITIONS / 2] * 1e6;
+    double p99 = latencies[COMMAND_REPETITIONS * 99 / 100] * 1e6;
+    double max = latencies[COMMAND_REPETITIONS - 1] * 1e6;
+    printf("%-8s %10.1f %10.1f %10.1f\n", name, p50, p99, max);
+    fprintf(
+        json, "%s\n    \"%s\": {\"p50_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f}",
+        isFirst ? "" : ",", name, p50, p99, max
+    );
+}
+
+void benchCommands(FILE *json, const char *device, uint8_t *wav, size_t size) {
+    // Every command blocks until the audio thread applied it, which takes
+    // up to one time resolution.
+    AudioObject audio = initFromMemory(device, wav, size);
+    double playLatencies[COMMAND_REPETITIONS];
+    double pauseLatencies[COMMAND_REPETITIONS];
+    double jumpLatencies[COMMAND_REPETITIONS];
+    audioPlay(audio, NULL);
+    for (int i = 0; i < COMMAND_REPETITIONS; ++i) {
+        double start = now();
+        bool success = audioJump(audio, NULL, (i * 997) % (STREAM_SECONDS * 1000 / 2));
+        jumpLatencies[i] = now() - start;
+        start = now();
+        success = audioPause(audio, NULL) && success;
+        pauseLatencies[i] = now() - start;
+        start = now();
+        success = audioPlay(audio, NULL) && success;
+        playLatencies[i] = now() - start;
+        if (!success) {
+            fprintf(stderr, "Command failed: %s\n", audioGetErrorString(audioGetError(audio)));
+            exit(EXIT_FAILURE);
+        }
+    }
+    audioDestroy(audio);
+
+    printf("%-8s %10s %10s %10s\n", "command", "p50 us", "p99 us", "max us");
+    writeLatencies(json, "play", playLatencies, true);
+    writeLatencies(json, "pause", pauseLatencies, false);
+    writeLatencies(json, "jump", jumpLatencies, false);
+}
+
+int main(int argc, char **argv) {
+    const char *device = argc > 1 ? argv[1] : "null";
+    const char *outputPath = argc > 2 ? argv[2] : "bench.json";
+    FILE *json = fopen(outputPath, "w");
+    if (json == NULL) {
+        perror(outputPath);
+        return EXIT_FAILURE;
+    }
+    int syscallCounter = openSyscallCounter();
+
+    printf("Device %s, time resolution %d ms\n\n", device, TIME_RESOLUTION);
+    fprintf(
+        json, "{\n  \"device\": \"%s\",\n  \"time_resolution_ms\": %d,\n"
+        "  \"timestamp\": %ld,\n  \"formats\": [",
+        device, TIME_RESOLUTION, (long)time(NULL)
+    );
+    printf(
+        "%8s %8s %5s %10s %10s %10s %12s\n", "rate", "channels", "bits",
+        "parse us", "init us", "warm us", "allocations"
+    );
+    bool isFirst = true;
+    for (size_t i = 0; i < sizeof(sampleRates) / sizeof(sampleRates[0]); ++i) {
+        for (size_t j = 0; j < sizeof(channelAmounts) / sizeof(channelAmounts[0]); ++j) {
+            for (size_t k = 0; k < sizeof(bitDepths) / sizeof(bitDepths[0]); ++k) {
+                benchFormat(
+                    json, device, sampleRates[i], channelAmounts[j],
+                    bitDepths[k], isFirst
+                );
+                isFirst = false;
+            }
+        }
+    }
+
+    size_t size;
+    uint8_t *wav = makeWav(STREAM_SAMPLE_RATE, 2, 16, STREAM_SECONDS, &size);
+    printf(
+        "\n%8s %12s %10s %14s %14s %16s %6s\n", "streams", "cpu%/stream",
+        "cpu%", "wakeups/s", "allocs/s", "ctx switches/s", "xruns"
+    );
+    fprintf(json, "\n  ],\n  \"streams\": [");
+    for (size_t i = 0; i < sizeof(streamAmounts) / sizeof(streamAmounts[0]); ++i) {
+        benchStreams(json, device, wav, size, streamAmounts[i], syscallCounter, i == 0);
+    }
+    if (syscallCounter == -1) printf("Syscalls are not counted, perf cannot read raw_syscalls:sys_enter.\n");
+
+    putchar('\n');
+    fprintf(json, "\n  ],\n  \"commands\": {");
+    benchCommands(json, device, wav, size);
+    fprintf(json, "\n  }\n}\n");
+    free(wav);
+
+    if (syscallCounter != -1) close(syscallCounter);
+    if (fclose(json) != 0) {
+        perror(outputPath);
+        return EXIT_FAILURE;
+    }
+    printf("\nWrote %s\n", outputPath);
+    return EXIT_SUCCESS;
+}
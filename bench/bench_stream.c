@@ -0,0 +1,213 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "stream.h"
+
+/*
+ * Compares how fast the audio data of one or more files gets into memory:
+ * reading the whole file and mapping it like main.c does, and the stream
+ * reader with io_uring and with its pread fallback. All streams are consumed
+ * concurrently like several playing audio objects would do. The page cache
+ * of the files is dropped before every run so the storage is measured.
+*/
+
+#define BLOCK_SIZE (64 * 1024)
+#define QUEUE_DEPTH (8)
+#define FRAME_SIZE (4)
+#define FRAMES_PER_WRITE (1024)
+#define BYTES_PER_MEGABYTE (1024.0 * 1024.0)
+
+typedef struct {
+    const char *path;
+    int fileDescriptor;
+    size_t fileSize;
+} BenchFile;
+
+double now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+void dropPageCache(BenchFile *files, int fileCount) {
+    for (int i = 0; i < fileCount; ++i) {
+        posix_fadvise(files[i].fileDescriptor, 0, 0, POSIX_FADV_DONTNEED);
+    }
+}
+
+void printResult(
+    const char *method, double seconds, size_t bytes,
+    uint64_t starvations, double maxWait
+) {
+    printf(
+        "%-16s %10.1f ms %10.1f MiB/s %12lu %12.3f ms\n",
+        method, seconds * 1000.0, bytes / BYTES_PER_MEGABYTE / seconds,
+        (unsigned long)starvations, maxWait * 1000.0
+    );
+}
+
+void benchRead(BenchFile *files, int fileCount, size_t totalSize) {
+    dropPageCache(files, fileCount);
+    double start = now();
+    uint64_t checksum = 0;
+    for (int i = 0; i < fileCount; ++i) {
+        uint8_t *rawData = malloc(files[i].fileSize);
+        if (rawData == NULL) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        if (pread(
+            files[i].fileDescriptor, rawData, files[i].fileSize, 0
+        ) != (ssize_t)files[i].fileSize) {
+            perror("pread");
+            exit(EXIT_FAILURE);
+        }
+        checksum += rawData[files[i].fileSize - 1];
+        free(rawData);
+    }
+    printResult("read", now() - start, totalSize, 0, 0.0);
+    if (checksum == 1) putchar('\0');
+}
+
+void benchMap(BenchFile *files, int fileCount, size_t totalSize) {
+    dropPageCache(files, fileCount);
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    double start = now();
+    uint64_t checksum = 0;
+    for (int i = 0; i < fileCount; ++i) {
+        uint8_t *rawData = mmap(
+            NULL, files[i].fileSize, PROT_READ, MAP_PRIVATE,
+            files[i].fileDescriptor, 0
+        );
+        if (rawData == MAP_FAILED) {
+            perror("mmap");
+            exit(EXIT_FAILURE);
+        }
+        // Touch every page like the audio thread would.
+        for (size_t offset = 0; offset < files[i].fileSize; offset += pageSize) {
+            checksum += rawData[offset];
+        }
+        munmap(rawData, files[i].fileSize);
+    }
+    printResult("mmap", now() - start, totalSize, 0, 0.0);
+    if (checksum == 1) putchar('\0');
+}
+
+void benchStream(
+    BenchFile *files, int fileCount, size_t totalSize, bool useIoUring
+) {
+    dropPageCache(files, fileCount);
+    streamSetIoUringEnabled(useIoUring);
+
+    AudioStream **streams = calloc(fileCount, sizeof(AudioStream*));
+    uint64_t *positions = calloc(fileCount, sizeof(uint64_t));
+    uint64_t *frameCounts = calloc(fileCount, sizeof(uint64_t));
+    double *waitingSince = calloc(fileCount, sizeof(double));
+    if (!streams || !positions || !frameCounts || !waitingSince) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    double start = now();
+    for (int i = 0; i < fileCount; ++i) {
+        streams[i] = streamOpen(
+            files[i].fileDescriptor, 0, files[i].fileSize,
+            FRAME_SIZE, BLOCK_SIZE, QUEUE_DEPTH
+        );
+        if (streams[i] == NULL) {
+            fprintf(stderr, "Could not open stream\n");
+            exit(EXIT_FAILURE);
+        }
+        frameCounts[i] = files[i].fileSize / FRAME_SIZE;
+    }
+    const char *method = streamGetUsesIoUring() ? "stream io_uring" : "stream thread";
+
+    // Consume all streams round robin as fast as the data arrives.
+    int finished = 0;
+    double maxWait = 0.0;
+    uint64_t checksum = 0;
+    while (finished < fileCount) {
+        for (int i = 0; i < fileCount; ++i) {
+            if (positions[i] >= frameCounts[i]) continue;
+            uint32_t frameCount = FRAMES_PER_WRITE;
+            const uint8_t *frames = streamGetFrames(
+                streams[i], positions[i], &frameCount
+            );
+            if (frameCount == 0) {
+                if (waitingSince[i] == 0.0) waitingSince[i] = now();
+                continue;
+            }
+            if (waitingSince[i] != 0.0) {
+                double wait = now() - waitingSince[i];
+                if (wait > maxWait) maxWait = wait;
+                waitingSince[i] = 0.0;
+            }
+            checksum += frames[0];
+            positions[i] += frameCount;
+            streamSetPlayhead(streams[i], positions[i], 0);
+            if (positions[i] >= frameCounts[i]) finished++;
+        }
+    }
+    double seconds = now() - start;
+
+    uint64_t starvations = 0;
+    for (int i = 0; i < fileCount; ++i) {
+        starvations += streamGetStarvationCount(streams[i]);
+        streamClose(streams[i]);
+    }
+    printResult(method, seconds, totalSize, starvations, maxWait);
+    if (checksum == 1) putchar('\0');
+
+    free(streams);
+    free(positions);
+    free(frameCounts);
+    free(waitingSince);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <file> [<file> ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int fileCount = argc - 1;
+    BenchFile *files = calloc(fileCount, sizeof(BenchFile));
+    size_t totalSize = 0;
+    for (int i = 0; i < fileCount; ++i) {
+        files[i].path = argv[i + 1];
+        files[i].fileDescriptor = open(files[i].path, O_RDONLY);
+        struct stat fileStats;
+        if (files[i].fileDescriptor == -1
+            || fstat(files[i].fileDescriptor, &fileStats) == -1) {
+            perror(files[i].path);
+            return EXIT_FAILURE;
+        }
+        files[i].fileSize = fileStats.st_size;
+        totalSize += files[i].fileSize;
+    }
+
+    printf(
+        "%d files, %.1f MiB, page cache dropped before every run\n\n",
+        fileCount, totalSize / BYTES_PER_MEGABYTE
+    );
+    printf(
+        "%-16s %13s %16s %12s %15s\n",
+        "method", "time", "throughput", "starvations", "max wait"
+    );
+    benchRead(files, fileCount, totalSize);
+    benchMap(files, fileCount, totalSize);
+    benchStream(files, fileCount, totalSize, true);
+    benchStream(files, fileCount, totalSize, false);
+
+    for (int i = 0; i < fileCount; ++i) close(files[i].fileDescriptor);
+    free(files);
+    return EXIT_SUCCESS;
+}
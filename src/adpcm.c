@@ -0,0 +1,279 @@
+#include "adpcm.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#define IMA_STEP_COUNT (89)
+#define IMA_MAX_STEP_INDEX (IMA_STEP_COUNT - 1)
+#define IMA_CHANNEL_HEADER_SIZE (4)
+#define IMA_GROUP_SIZE (4)  // bytes per channel and group of 8 samples
+#define IMA_FRAMES_PER_GROUP (8)
+#define MS_CHANNEL_HEADER_SIZE (7)
+#define MS_HEADER_FRAMES (2)
+#define MS_MIN_DELTA (16)
+#define MS_MAX_DELTA (INT32_MAX / 768)  // keeps corrupt blocks from overflowing
+#define NIBBLE_COUNT (16)
+
+static const int16_t imaSteps[IMA_STEP_COUNT] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37,
+    41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173,
+    190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+    724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
+    7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818,
+    18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t imaIndexAdjustments[NIBBLE_COUNT] = {
+    -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int16_t msAdaptations[NIBBLE_COUNT] = {
+    230, 230, 230, 230, 307, 409, 512, 614,
+    768, 614, 512, 409, 307, 230, 230, 230
+};
+
+/*
+ * The IMA decoder is serial per channel, every sample depends on the
+ * previous one. Instead of computing the difference from the step and the
+ * nibble bits per sample it is looked up, which leaves one add, one clamp
+ * and two loads per sample and no branches.
+*/
+static int32_t imaDifferences[IMA_STEP_COUNT][NIBBLE_COUNT];
+static uint8_t imaNextIndices[IMA_STEP_COUNT][NIBBLE_COUNT];
+static pthread_once_t imaTablesOnce = PTHREAD_ONCE_INIT;
+
+void _initImaTables() {
+    for (int index = 0; index < IMA_STEP_COUNT; ++index) {
+        int32_t step = imaSteps[index];
+        for (int nibble = 0; nibble < NIBBLE_COUNT; ++nibble) {
+            int32_t difference = step >> 3;
+            if (nibble & 1) difference += step >> 2;
+            if (nibble & 2) difference += step >> 1;
+            if (nibble & 4) difference += step;
+            imaDifferences[index][nibble] = nibble & 8 ? -difference : difference;
+
+            int nextIndex = index + imaIndexAdjustments[nibble];
+            if (nextIndex < 0) nextIndex = 0;
+            if (nextIndex > IMA_MAX_STEP_INDEX) nextIndex = IMA_MAX_STEP_INDEX;
+            imaNextIndices[index][nibble] = nextIndex;
+        }
+    }
+}
+
+static inline int32_t _clampSample(int32_t sample) {
+    if (sample < INT16_MIN) return INT16_MIN;
+    if (sample > INT16_MAX) return INT16_MAX;
+    return sample;
+}
+
+static inline int16_t _readInt16(const uint8_t *bytes) {
+    return (int16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+uint32_t _decodeImaBlock(
+    const AdpcmFormat *format, const uint8_t *block, uint32_t frameCount,
+    int16_t *frames
+) {
+    // After the headers the block consists of groups of 4 bytes per
+    // channel, each holding 8 samples low nibble first.
+    uint16_t channelAmount = format->channelAmount;
+    uint32_t groupCount = (frameCount - 1) / IMA_FRAMES_PER_GROUP;
+    const uint8_t *groups = block + IMA_CHANNEL_HEADER_SIZE * channelAmount;
+    size_t groupStride = (size_t)IMA_GROUP_SIZE * channelAmount;
+
+    for (uint16_t channel = 0; channel < channelAmount; ++channel) {
+        const uint8_t *header = block + IMA_CHANNEL_HEADER_SIZE * channel;
+        int32_t sample = _readInt16(header);
+        uint8_t index = header[2] > IMA_MAX_STEP_INDEX
+            ? IMA_MAX_STEP_INDEX
+            : header[2];
+        int16_t *output = frames + channel;
+        *output = sample;
+        output += channelAmount;
+
+        const uint8_t *group = groups + IMA_GROUP_SIZE * channel;
+        for (uint32_t i = 0; i < groupCount; ++i, group += groupStride) {
+            for (int byte = 0; byte < IMA_GROUP_SIZE; ++byte) {
+                uint8_t nibble = group[byte] & 0x0F;
+                sample = _clampSample(sample + imaDifferences[index][nibble]);
+                index = imaNextIndices[index][nibble];
+                *output = sample;
+                output += channelAmount;
+
+                nibble = group[byte] >> 4;
+                sample = _clampSample(sample + imaDifferences[index][nibble]);
+                index = imaNextIndices[index][nibble];
+                *output = sample;
+                output += channelAmount;
+            }
+        }
+    }
+    return frameCount;
+}
+
+uint32_t _decodeMsBlock(
+    const AdpcmFormat *format, const uint8_t *block, uint32_t frameCount,
+    int16_t *frames
+) {
+    // The headers hold the predictor indices, the deltas and the two first
+    // samples in reverse order. The nibbles that follow alternate between
+    // the channels, high nibble first.
+    uint16_t channelAmount = format->channelAmount;
+    const uint8_t *predictors = block;
+    const uint8_t *deltas = predictors + channelAmount;
+    const uint8_t *firstSamples = deltas + 2 * channelAmount;
+    const uint8_t *secondSamples = firstSamples + 2 * channelAmount;
+    const uint8_t *nibbles = block + MS_CHANNEL_HEADER_SIZE * channelAmount;
+
+    for (uint16_t channel = 0; channel < channelAmount; ++channel) {
+        // Invalid predictors fall back to the first coefficient pair.
+        uint8_t predictor = predictors[channel] < format->coefficientCount
+            ? predictors[channel]
+            : 0;
+        int32_t coefficient1 = format->coefficients[predictor][0];
+        int32_t coefficient2 = format->coefficients[predictor][1];
+        int32_t delta = _readInt16(deltas + 2 * channel);
+        int32_t sample1 = _readInt16(firstSamples + 2 * channel);
+        int32_t sample2 = _readInt16(secondSamples + 2 * channel);
+
+        int16_t *output = frames + channel;
+        output[0] = sample2;
+        output[channelAmount] = sample1;
+        output += MS_HEADER_FRAMES * channelAmount;
+
+        size_t position = channel;
+        for (uint32_t frame = MS_HEADER_FRAMES; frame < frameCount; ++frame) {
+            uint8_t byte = nibbles[position >> 1];
+            uint8_t nibble = position & 1 ? byte & 0x0F : byte >> 4;
+            position += channelAmount;
+
+            int32_t prediction = (sample1 * coefficient1 + sample2 * coefficient2) >> 8;
+            int32_t signedNibble = nibble & 8 ? nibble - NIBBLE_COUNT : nibble;
+            sample2 = sample1;
+            sample1 = _clampSample(prediction + signedNibble * delta);
+            *output = sample1;
+            output += channelAmount;
+
+            delta = (msAdaptations[nibble] * delta) >> 8;
+            if (delta < MS_MIN_DELTA) delta = MS_MIN_DELTA;
+            if (delta > MS_MAX_DELTA) delta = MS_MAX_DELTA;
+        }
+    }
+    return frameCount;
+}
+
+void _encodeImaChannel(
+    const int16_t *frames, uint32_t frameCount, uint16_t channelAmount,
+    uint8_t *index, uint8_t *header, uint8_t *groups, uint32_t groupCount
+) {
+    // Every nibble is chosen by trying all magnitudes with the sign of the
+    // difference and running the decoder on the best one, so the encoder
+    // never drifts from what is played. Missing samples of the last group
+    // repeat the last sample.
+    int32_t sample = frames[0];
+    header[0] = sample & 0xFF;
+    header[1] = (sample >> 8) & 0xFF;
+    header[2] = *index;
+    header[3] = 0;
+
+    size_t groupStride = (size_t)IMA_GROUP_SIZE * channelAmount;
+    for (uint32_t i = 0; i < groupCount * IMA_FRAMES_PER_GROUP; ++i) {
+        uint32_t frame = 1 + i < frameCount ? 1 + i : frameCount - 1;
+        int32_t target = frames[(size_t)frame * channelAmount];
+        uint8_t sign = target < sample ? 8 : 0;
+        uint8_t bestNibble = sign;
+        int32_t bestError = INT32_MAX;
+        for (uint8_t magnitude = 0; magnitude < 8; ++magnitude) {
+            int32_t decoded = _clampSample(
+                sample + imaDifferences[*index][sign | magnitude]
+            );
+            int32_t error = abs(decoded - target);
+            if (error < bestError) {
+                bestError = error;
+                bestNibble = sign | magnitude;
+            }
+        }
+        sample = _clampSample(sample + imaDifferences[*index][bestNibble]);
+        *index = imaNextIndices[*index][bestNibble];
+
+        uint8_t *byte = groups + (i / IMA_FRAMES_PER_GROUP) * groupStride
+            + (i % IMA_FRAMES_PER_GROUP) / 2;
+        if (i % 2 == 0) {
+            *byte = bestNibble;
+        } else {
+            *byte |= bestNibble << 4;
+        }
+    }
+}
+
+size_t adpcmEncodeBlock(
+    const AdpcmFormat *format, const int16_t *frames, uint32_t frameCount,
+    uint8_t *stepIndices, uint8_t *block
+) {
+    if (
+        format->variant != ADPCM_VARIANT_IMA
+        || frameCount == 0
+        || frameCount > format->framesPerBlock
+    ) {
+        return 0;
+    }
+    pthread_once(&imaTablesOnce, _initImaTables);
+
+    uint16_t channelAmount = format->channelAmount;
+    uint32_t groupCount = (frameCount - 1 + IMA_FRAMES_PER_GROUP - 1)
+        / IMA_FRAMES_PER_GROUP;
+    uint8_t *groups = block + IMA_CHANNEL_HEADER_SIZE * channelAmount;
+    for (uint16_t channel = 0; channel < channelAmount; ++channel) {
+        _encodeImaChannel(
+            frames + channel, frameCount, channelAmount, stepIndices + channel,
+            block + IMA_CHANNEL_HEADER_SIZE * channel,
+            groups + IMA_GROUP_SIZE * channel, groupCount
+        );
+    }
+    return IMA_CHANNEL_HEADER_SIZE * channelAmount
+        + (size_t)groupCount * IMA_GROUP_SIZE * channelAmount;
+}
+
+uint32_t adpcmGetBlockFrames(const AdpcmFormat *format, size_t blockSize) {
+    uint16_t channelAmount = format->channelAmount;
+    if (channelAmount == 0) return 0;
+    if (blockSize > format->blockAlign) blockSize = format->blockAlign;
+
+    switch (format->variant) {
+        case ADPCM_VARIANT_IMA:
+            if (blockSize < (size_t)IMA_CHANNEL_HEADER_SIZE * channelAmount) {
+                return 0;
+            }
+            return 1 + (blockSize - IMA_CHANNEL_HEADER_SIZE * channelAmount)
+                / (IMA_GROUP_SIZE * channelAmount) * IMA_FRAMES_PER_GROUP;
+
+        case ADPCM_VARIANT_MS:
+            if (blockSize < (size_t)MS_CHANNEL_HEADER_SIZE * channelAmount) {
+                return 0;
+            }
+            return MS_HEADER_FRAMES
+                + (blockSize - MS_CHANNEL_HEADER_SIZE * channelAmount) * 2
+                / channelAmount;
+    }
+    return 0;
+}
+
+uint32_t adpcmDecodeBlock(
+    const AdpcmFormat *format, const uint8_t *block, size_t blockSize,
+    int16_t *frames
+) {
+    uint32_t frameCount = adpcmGetBlockFrames(format, blockSize);
+    if (frameCount > format->framesPerBlock) frameCount = format->framesPerBlock;
+    if (frameCount == 0) return 0;
+
+    switch (format->variant) {
+        case ADPCM_VARIANT_IMA:
+            pthread_once(&imaTablesOnce, _initImaTables);
+            return _decodeImaBlock(format, block, frameCount, frames);
+
+        case ADPCM_VARIANT_MS:
+            return _decodeMsBlock(format, block, frameCount, frames);
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+#ifndef __ADPCM_H__
+#define __ADPCM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ADPCM_MAX_COEFFICIENTS (32)
+
+/**
+ * @brief The supported ADPCM variants.
+*/
+enum AdpcmVariant {
+    ADPCM_VARIANT_MS,  /* Microsoft ADPCM, WAV format 0x0002. */
+    ADPCM_VARIANT_IMA  /* IMA/DVI ADPCM, WAV format 0x0011. */
+};
+
+/**
+ * @brief This describes the blocks of an ADPCM WAV file.
+ *
+ * Every block starts with a header per channel and can be decoded without
+ * any other block. All blocks except the last one have blockAlign bytes.
+*/
+typedef struct {
+    enum AdpcmVariant variant;  /* The ADPCM variant */
+    uint16_t channelAmount;  /* The amount of channels */
+    uint16_t blockAlign;  /* The size of one block in bytes */
+    uint16_t framesPerBlock;  /* The amount of frames in one block */
+    uint16_t coefficientCount;  /* The amount of MS ADPCM predictor coefficients */
+    int16_t coefficients[ADPCM_MAX_COEFFICIENTS][2];  /* The MS ADPCM predictor coefficients */
+} AdpcmFormat;
+
+/**
+ * Returns how many frames a block of the given size decodes to.
+ *
+ * @param format The format.
+ * @param blockSize The size of the block in bytes, at most blockAlign.
+ * @return The amount of frames. 0 if the block is too small for its header.
+*/
+uint32_t adpcmGetBlockFrames(const AdpcmFormat *format, size_t blockSize);
+/**
+ * Decodes one block to interleaved signed 16 bit samples.
+ *
+ * frames must have room for framesPerBlock frames.
+ *
+ * @param format The format.
+ * @param block The encoded block.
+ * @param blockSize The size of the block in bytes, at most blockAlign.
+ * @param frames The decoded frames.
+ * @return The amount of decoded frames.
+*/
+uint32_t adpcmDecodeBlock(
+    const AdpcmFormat *format, const uint8_t *block, size_t blockSize,
+    int16_t *frames
+);
+
+/**
+ * Encodes interleaved signed 16 bit samples to one IMA ADPCM block.
+ *
+ * The step index of every channel is carried from one block to the next,
+ * so the first block should start with 0 and every following block with
+ * what the previous one left behind. A block with fewer than framesPerBlock
+ * frames is shorter, its last group is padded.
+ *
+ * @param format The format. Only ADPCM_VARIANT_IMA is supported.
+ * @param frames The frames.
+ * @param frameCount The amount of frames, at most framesPerBlock.
+ * @param stepIndices The step index of each channel, updated on return.
+ * @param block Room for blockAlign bytes.
+ * @return The size of the block in bytes, 0 if it could not be encoded.
+*/
+size_t adpcmEncodeBlock(
+    const AdpcmFormat *format, const int16_t *frames, uint32_t frameCount,
+    uint8_t *stepIndices, uint8_t *block
+);
+
+#endif // __ADPCM_H__
@@ -1,7 +1,31 @@
-#include "audio.h"
+#define _GNU_SOURCE
 
+#include "audio.h"
+#include "adpcm.h"
+#include "backend.h"
+#include "bank.h"
+#include "flac.h"
+#include "loudness.h"
+#include "peaks.h"
+#include "pipe.h"
+#include "pool.h"
+#include "stats.h"
+#include "sink.h"
+#include "stream.h"
+#include "trace.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <time.h>
 
 #include <errno.h>
 
@@ -14,6 +38,11 @@ typedef uint8_t Bool8;
 #define FMT_MAGIC  (uint8_t[4]){'f', 'm', 't', ' '}
 #define FACT_MAGIC (uint8_t[4]){'f', 'a', 'c', 't'}
 #define DATA_MAGIC (uint8_t[4]){'d', 'a', 't', 'a'}
+#define CUE_MAGIC  (uint8_t[4]){'c', 'u', 'e', ' '}
+#define LIST_MAGIC (uint8_t[4]){'L', 'I', 'S', 'T'}
+#define ADTL_MAGIC (uint8_t[4]){'a', 'd', 't', 'l'}
+#define LABL_MAGIC (uint8_t[4]){'l', 'a', 'b', 'l'}
+#define SMPL_MAGIC (uint8_t[4]){'s', 'm', 'p', 'l'}
 #define MAGIC_SIZE (4)
 
 #define FMT_CHUNK_SIZE_PCM (sizeof(AudioFmtChunk))
@@ -32,10 +61,14 @@ typedef uint8_t Bool8;
 #define EXTENSIBLE_GUID_SIZE (14)
 
 #define WAVE_FORMAT_PCM (0x0001)
+#define WAVE_FORMAT_ADPCM (0x0002)
 #define WAVE_FORMAT_IEEE_FLOAT (0x0003)
 #define WAVE_FORMAT_ALAW (0x0006)
 #define WAVE_FORMAT_MULAW (0x0007)
+#define WAVE_FORMAT_IMA_ADPCM (0x0011)
 #define WAVE_FORMAT_EXTENSIBLE (0xFFFE)
+// Not a WAV format. Marks native FLAC files.
+#define AUDIO_FORMAT_FLAC (0xF1AC)
 
 #define CHANNEL_POSITION_COUNT (18)
 #define CHANNEL_MASK_18 (0b111111111111111111)
@@ -60,12 +93,11 @@ const static enum snd_pcm_chmap_position all_channel_positions[CHANNEL_POSITION_
     SND_CHMAP_TRR,
 };
 
-#define PCM_BLOCK_MODE (0)
-#define PCM_SEARCH_DIRECTION_NEAR (0)
 
 #define MAX_VOLUME (100)
 
 #define MAX_VOLUME (100)
+#define NORMALIZED_TRUE_PEAK (-1.0f)
 
 #define DEFAULT_SOUND_DEVICE_NAME ("default")
 
@@ -76,6 +108,47 @@ const static enum snd_pcm_chmap_position all_channel_positions[CHANNEL_POSITION_
 #define BUFFER_SIZE_FACTOR (8)
 #define INTERNAL_BARRIER_COUNT (2)
 
+#define SECONDS_PER_MINUTE (60)
+
+#define DEFAULT_READAHEAD_MILLISECONDS (4000)
+#define DEFAULT_KEEP_BEHIND_MILLISECONDS (1000)
+#define DEFAULT_POPULATE_THRESHOLD (8 * 1024 * 1024)
+#define LOADER_STEPS_PER_WINDOW (4)
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define DEFAULT_STREAM_BLOCK_SIZE (64 * 1024)
+#define DEFAULT_STREAM_QUEUE_DEPTH (8)
+#define STREAM_HEADER_SIZE (64 * 1024)
+#define PROBE_MAX_HEADER_SIZE (16 * 1024 * 1024)
+#define PROBE_HEADER_PADDING (256)
+#define MIN_LOCKED_PAGES (3)
+#define ADPCM_BITS_PER_SAMPLE (4)
+#define IMA_ADPCM_EXTRA_SIZE (2)
+#define MS_ADPCM_EXTRA_SIZE (4)
+#define MS_ADPCM_COEFFICIENT_SIZE (4)
+#define NO_DECODED_BLOCK (UINT64_MAX)
+#define FLAC_BLOCK_FRAMES (4096)
+#define FLAC_MIN_QUEUE_DEPTH (8)
+#define COMPACT_BLOCK_FRAMES (1024)
+#define COMPACT_ADPCM_CHANNEL_BLOCK_SIZE (512)
+#define BUFFER_HASH_OFFSET (0xCBF29CE484222325ull)
+#define BUFFER_HASH_PRIME (0x100000001B3ull)
+#define NANOSECONDS_PER_SECOND (1000000000ull)
+#define NO_CUE (UINT32_MAX)
+#define SMPL_LOOP_FORWARD (0)
+#define CLOCK_LOOP_SHIFT (32)
+#define PEAKS_SUFFIX (".peaks")
+#define LOUDNESS_SUFFIX (".loudness")
+#define TEMPORARY_SUFFIX (".XXXXXX")
+#define MICROSECONDS_PER_SECOND (1000000.0)
+#define PARTS_PER_MILLION (1000000.0)
+#define DRIFT_MIN_SECONDS (1.0)
+#define OFFSET_SMOOTHING_SECONDS (1.0)
+#define DRIFT_CORRECTION_SECONDS (5.0)
+#define MAX_CORRECTION_PPM (1000.0)
+#define EVENT_QUEUE_SIZE (64)
+#define NANOSECONDS_PER_MICROSECOND (1000)
+#define NANOSECONDS_PER_MILLISECOND (1000000ull)
+
 // The following 6 structs define the structure of a WAV file.
 
 /**
@@ -119,6 +192,17 @@ typedef struct __attribute__((packed)) {
     uint8_t guid[14];
 } AudioExtensibleFmtChunkExtension;
 
+/**
+ * @brief The Fmt Chunk extension of an ADPCM WAV file
+ * 
+ * For MS ADPCM this is followed by the amount of coefficient pairs and the
+ * pairs themselves.
+*/
+typedef struct __attribute__((packed)) {
+    uint16_t extraSize;
+    uint16_t samplesPerBlock;
+} AudioAdpcmFmtChunkExtension;
+
 /**
  * @brief The Fact Chunk of a WAV file
 */
@@ -138,6 +222,59 @@ typedef struct __attribute__((packed)) {
     uint32_t dataSize;
 } AudioDataChunk;
 
+/**
+ * @brief The header of any chunk of a WAV file
+*/
+typedef struct __attribute__((packed)) {
+    uint8_t magic[4];
+    uint32_t size;
+} AudioChunkHeader;
+
+/**
+ * @brief A cue point in the cue chunk of a WAV file
+ * 
+ * The cue chunk holds the amount of cue points followed by the points.
+*/
+typedef struct __attribute__((packed)) {
+    uint32_t id;
+    uint32_t position;
+    uint8_t chunkMagic[4];
+    uint32_t chunkStart;
+    uint32_t blockStart;
+    uint32_t sampleOffset;
+} AudioCuePoint;
+
+/**
+ * @brief The smpl chunk of a WAV file
+ * 
+ * The chunk is followed by loopCount loops and samplerDataSize bytes.
+*/
+typedef struct __attribute__((packed)) {
+    uint32_t manufacturer;
+    uint32_t product;
+    uint32_t samplePeriod;
+    uint32_t midiUnityNote;
+    uint32_t midiPitchFraction;
+    uint32_t smpteFormat;
+    uint32_t smpteOffset;
+    uint32_t loopCount;
+    uint32_t samplerDataSize;
+} AudioSmplChunk;
+
+/**
+ * @brief A loop in the smpl chunk of a WAV file
+ * 
+ * start and end are frames, both of them are played.
+*/
+typedef struct __attribute__((packed)) {
+    uint32_t id;
+    uint32_t type;
+    uint32_t start;
+    uint32_t end;
+    uint32_t fraction;
+    uint32_t playCount;
+} AudioSmplLoop;
+
 /**
  * @brief This represents the data necessary to play the audio.
 */
@@ -149,30 +286,286 @@ typedef struct {
     uint32_t channelMap;  /* The mapping from channel to speaker */
     uint32_t samplesPerChannel;  /* The amount of samples per channel */
     uint16_t channelAmount;  /* The amount of channels, 1 is mono, 2 is stereo */
-    uint16_t blockAlign;  /* Amount of bytes per sample */
+    uint16_t blockAlign;  /* Amount of bytes per block, a frame unless compressed */
     uint16_t bitsPerSample;  /* The amount of bits per sample */
     uint16_t format;  /* The format of the audio data */
+    uint16_t framesPerBlock;  /* Amount of frames per block, 1 unless compressed */
     uint8_t *data;  /* A pointer to the audio data */
     uint8_t __align[3];
 } AudioRiffData;
 
+/**
+ * @brief This keeps the audio data of an audio object resident.
+ * 
+ * If the file was loaded by the library and isWindowed is set the file is
+ * mapped and the loader thread keeps a window ahead of the playhead
+ * resident. If useStream is set only the header is in memory and the audio
+ * data is read in blocks by a stream. Otherwise the whole file was loaded
+ * at init time or the data was given by the user.
+ * 
+ * If lockEnabled is set the loader thread additionally keeps a window
+ * around the playhead locked. The loader thread only runs if one of the
+ * windows has to be maintained.
+*/
+typedef struct {
+    uint8_t *mapping;  /* The mapped file content or the header if streamed */
+    AudioStream *stream;  /* The stream reading the audio data if streamed */
+    size_t mappingSize;  /* The size of the mapping in bytes */
+    size_t fileSize;  /* The size of the file in bytes */
+    size_t availableSize;  /* How many bytes of the file are in the mapping */
+    size_t readaheadBytes;  /* The size of the window ahead of the playhead */
+    size_t keepBehindBytes;  /* The size of the window behind the playhead */
+    size_t prefetchedUntil;  /* The file offset up to which readahead was requested */
+    size_t droppedUntil;  /* The file offset up to which pages were released */
+    size_t lockAheadBytes;  /* The size of the locked window ahead of the playhead */
+    size_t lockBehindBytes;  /* The size of the locked window behind the playhead */
+    size_t lockBudget;  /* The maximum amount of locked bytes */
+    size_t lockedBytes;  /* The amount of currently locked bytes */
+    uint8_t *lockedBegin;  /* The first locked page */
+    uint8_t *lockedEnd;  /* The end of the last locked page */
+    uint32_t stepFrames;  /* Every how many played frames the loader thread is woken up */
+    uint32_t signaledFrame;  /* The frame at which the loader thread was woken up last */
+    uint32_t streamBlockSize;  /* The size of one stream block in bytes */
+    uint32_t streamQueueDepth;  /* The amount of stream blocks read ahead */
+    pthread_t *thread;  /* The thread that moves the window */
+    sem_t wakeup;  /* Posted by the audio thread when the window should move */
+    pthread_mutex_t windowLock;  /* Serializes moving the windows between the user and the loader thread */
+    int fileDescriptor;  /* The file descriptor of the file */
+    Bool8 isWindowed;  /* Whether the window is maintained by the loader thread */
+    Bool8 isAnonymous;  /* Whether the mapping is anonymous memory instead of the file */
+    Bool8 dropBehind;  /* Whether pages behind the playhead are released */
+    Bool8 haltFlag;  /* Whether the loader thread should be stopped */
+    Bool8 jumpFlag;  /* Whether the playhead jumped since the last wakeup */
+    Bool8 useStream;  /* Whether the audio data is read by a stream */
+    Bool8 lockEnabled;  /* Whether the locked window is maintained */
+    uint8_t __align[1];
+} AudioLoader;
+
+/**
+ * @brief This decodes compressed audio data block by block.
+ * 
+ * ADPCM blocks have a fixed size, so the block containing the next frame to
+ * write is decoded into a scratch buffer right before it is written and a
+ * jump only changes which block is decoded next.
+ * 
+ * FLAC frames vary in size and are expensive to decode. A FLAC stream
+ * decodes them on its own thread into a window around the playhead, so the
+ * audio thread only copies decoded frames. Only the short FLAC frames of
+ * audioInitCompact() are decoded like ADPCM blocks, their offsets are the
+ * seek points.
+*/
+typedef struct {
+    AdpcmFormat format;  /* The format of the blocks */
+    FlacInfo flacInfo;  /* The metadata if the file is native FLAC */
+    FlacStream *flacStream;  /* Decodes FLAC frames ahead of the playhead, else NULL */
+    uint8_t *frames;  /* The decoded frames of one block */
+    int32_t *samples;  /* The samples of one compact FLAC frame per channel, else NULL */
+    uint64_t decodedBlock;  /* The block in frames or NO_DECODED_BLOCK */
+    uint64_t decodeNanoseconds;  /* The CPU time the audio thread spent decoding */
+    uint64_t decodedFrameCount;  /* The amount of frames the audio thread decoded */
+    uint32_t decodedFrames;  /* The amount of frames in frames */
+    uint32_t frameSize;  /* The size of one decoded frame in bytes */
+} AudioDecoder;
+
+/**
+ * @brief This holds the frames behind every cue point as they are written to the sound device.
+ * 
+ * The frames of the cue point with index i start at i * frameCount frames.
+*/
+typedef struct {
+    uint8_t *frames;  /* The mapping holding the frames, else NULL */
+    size_t size;  /* The size of the mapping in bytes */
+    uint32_t frameCount;  /* How many frames behind each cue point are held */
+    Bool8 isLocked;  /* Whether the mapping is locked in memory */
+    uint8_t __align[3];
+} AudioCuePreload;
+
+/**
+ * @brief This tracks how many frames a sound device played over CLOCK_MONOTONIC.
+ * 
+ * The frames a running device played are the frames written to it minus
+ * its delay. The rate is measured from the first measurement after the
+ * device was started, so noise in the delay averages out over time.
+*/
+typedef struct {
+    struct timespec firstTime;  /* When the device was first measured running */
+    struct timespec time;  /* When the device was measured last */
+    uint64_t writtenFrames;  /* The frames written since the device was prepared */
+    uint64_t firstPlayedFrames;  /* The frames played at firstTime */
+    double delay;  /* The frames written but not played at time */
+    float driftPpm;  /* How much faster the device played than its nominal rate */
+    Bool8 isRunning;  /* Whether firstTime and firstPlayedFrames are valid */
+    uint8_t __align[3];
+} AudioDeviceClock;
+
+/**
+ * @brief This is a sound device fed the frames written to the first one.
+ * 
+ * The frames are resampled by linear interpolation. For every written
+ * frame the resampler reads step frames, so a step above 1 lets the device
+ * catch up with the first one and a step below 1 holds it back. A PI
+ * controller steers the step from the smoothed offset between the frames
+ * both devices play. Its integral settles at the drift between both clocks.
+*/
+typedef struct {
+    Backend *output;  /* The output that plays the frames */
+    char *soundDeviceName;  /* The name of the sound device */
+    uint8_t *frames;  /* Room for the resampled frames of an ALSA buffer */
+    uint8_t *history;  /* The last frame read, the first one interpolated from */
+    AudioDeviceClock clock;  /* The clock of the device */
+    double step;  /* The frames read per written frame */
+    double phase;  /* Where the next written frame lies behind history in frames */
+    double offset;  /* How far the device plays ahead of the first one in frames */
+    double integral;  /* The integrated offset in seconds squared */
+    Bool8 hasHistory;  /* Whether history holds a frame */
+    Bool8 hasOffset;  /* Whether offset was measured since the device was started */
+    Bool8 isLinked;  /* Whether the device is linked to the first one */
+    uint8_t __align[5];
+} AudioDevice;
+
+/**
+ * @brief The events of an audio object on their way to the user.
+ * 
+ * The audio thread is the only writer and one user thread the only
+ * reader, so the ring needs no lock. head and tail run freely and are
+ * taken modulo EVENT_QUEUE_SIZE.
+*/
+typedef struct {
+    AudioEvent events[EVENT_QUEUE_SIZE];  /* The ring of events */
+    _Atomic uint32_t head;  /* The next event to read, advanced by the reader */
+    _Atomic uint32_t tail;  /* The next event to write, advanced by the audio thread */
+    uint32_t droppedEvents;  /* The events dropped since the ring was full */
+    int fileDescriptor;  /* The eventfd written for every queued event, else -1 */
+} AudioEventQueue;
+
+/**
+ * @brief A loop the audio thread plays.
+ * 
+ * frames holds the crossfaded frames in front of endFrame. The frames on
+ * both sides of the end are gathered into gatherFrames of the audio object.
+*/
+typedef struct {
+    uint8_t *frames;  /* The crossfaded frames, else NULL */
+    uint32_t startFrame;  /* The first frame of the loop */
+    uint32_t endFrame;  /* The frame behind the loop, 0 if there is no loop */
+    uint32_t count;  /* How often the loop is played, 0 for endlessly */
+    uint32_t seamFrameCount;  /* The amount of crossfaded frames */
+} AudioLoopRegion;
+
+typedef struct _AudioBuffer _AudioBuffer;
+
+/**
+ * @brief A part of a buffer played behind the audio data.
+*/
+typedef struct {
+    _AudioBuffer *buffer;  /* The buffer holding the frames, referenced by the segment */
+    const uint8_t *frames;  /* The first frame of the segment */
+    uint32_t startFrame;  /* Where the segment starts on the timeline */
+    uint32_t frameCount;  /* The amount of frames */
+} AudioSegment;
+
+/**
+ * @brief A frame that queues an event when it is played.
+*/
+typedef struct {
+    uint32_t id;  /* The identifier given by the user */
+    uint32_t frame;  /* The frame of the marker */
+} AudioMarker;
+
+/**
+ * @brief The statistics the audio thread records for audioGetStats().
+ * 
+ * The buffer level is sampled at every wakeup while the first device runs.
+*/
+typedef struct {
+    _Atomic uint64_t wakeups;  /* How often the audio thread woke up */
+    _Atomic uint64_t refills;  /* How often frames were written */
+    _Atomic uint64_t framesWritten;  /* The frames written to the first device */
+    _Atomic uint64_t xruns;  /* How often a device ran out of frames */
+    _Atomic uint64_t minorFaults;  /* The minor page faults taken while writing */
+    _Atomic uint64_t majorFaults;  /* The major page faults taken while writing */
+    _Atomic uint64_t levelSamples;  /* How often the buffer level was sampled */
+    _Atomic uint64_t availFrames;  /* The sum of the sampled room in the buffer */
+    _Atomic uint64_t maxAvailFrames;  /* The most room sampled */
+    _Atomic uint64_t delayFrames;  /* The sum of the sampled delays */
+    _Atomic uint64_t minDelayFrames;  /* The smallest delay sampled */
+    StatsRecorder refill;  /* The microseconds a refill took */
+    StatsRecorder command;  /* The microseconds from handing over an action until it was applied */
+    StatsRecorder headroom;  /* The sampled delays in microseconds */
+} AudioCounters;
+
 /**
  * @brief This is the entire audio object given to the user as an opaque pointer.
 */
 typedef struct {
     AudioRiffData riffData;  /* The data necessary to play the audio */
-    snd_pcm_t *pcmHandle;  /* The ALSA pcm handle */
+    Backend *output;  /* The output of the first sound device */
     pthread_t *thread;  /* The thread that plays the audio */
     pthread_barrier_t *externalBarrier;  /* A barrier to synchronize with potential other threads created by the user */
     pthread_barrier_t *internalBarrier;  /* A barrier to synchronize the user thread with the audio thread */
     pthread_mutex_t *actionLock;  /* A lock to prevent multiple actions at the same time */
     AudioError *error;  /* An error object to communicate errors to the user */
     char *soundDeviceName;  /* The name of the sound device */
-    uint32_t jumpTarget;  /* The target time to jump to in milliseconds */
+    AudioLoader *loader;  /* The loader keeping the audio data resident */
+    AudioDecoder *decoder;  /* The decoder if the audio data is compressed, else NULL */
+    uint8_t *compactData;  /* The audio data transcoded by audioInitCompact(), else NULL */
+    _AudioBuffer *buffer;  /* The shared buffer holding the audio data, else NULL */
+    AudioCue *cues;  /* The cue points sorted by frame with their labels behind them, else NULL */
+    size_t cuesSize;  /* The size of cues including the labels in bytes */
+    AudioCuePreload cuePreload;  /* The preloaded frames the audio thread plays */
+    AudioCuePreload pendingCuePreload;  /* The preloaded frames handed to the audio thread */
+    uint64_t playedFrames;  /* The amount of frames written while playing */
+    uint64_t majorFaults;  /* The major page faults of the audio thread while playing */
+    long lastMajorFaultCount;  /* The major page fault count of the audio thread at the last refill */
+    long lastMinorFaultCount;  /* The minor page fault count of the audio thread at the last refill */
+    AudioCounters counters;  /* The statistics of the audio thread */
+    struct timespec actionTime;  /* When the action being processed was handed over */
+    TraceRing *trace;  /* The events the audio thread records, else NULL */
+    TraceRing *pendingTrace;  /* The ring handed to the audio thread */
+    uint32_t jumpTarget;  /* The target frame to jump to */
+    uint32_t jumpCue;  /* The index of the cue point jumped to or NO_CUE */
+    uint32_t activeCue;  /* The cue point whose preloaded frames are played or NO_CUE */
+    uint32_t cueCount;  /* The amount of cue points */
     uint32_t currentFrame;  /* The current frame being played */
     uint32_t lastFrame;  /* The last frame that can be played */
+    uint32_t dataFrameCount;  /* The frames of the audio data, where the segments start */
     uint32_t timeResolution;  /* The time resolution in milliseconds */
     uint32_t alsaBufferSize;  /* The size of the ALSA buffer in frames */
+    snd_pcm_format_t format;  /* The sample format the frames are written in */
+    uint8_t *gainFrames;  /* Room for the frames of the ALSA buffer with the gain applied, else NULL */
+    float gain;  /* The linear gain applied to the written frames */
+    float pendingGain;  /* The linear gain handed to the audio thread */
+    AudioDeviceClock clock;  /* The clock of the sound device */
+    AudioDevice devices[AUDIO_MAX_DEVICES - 1];  /* The sound devices fed the same frames */
+    uint32_t deviceCount;  /* The amount of devices in devices */
+    AudioEventQueue events;  /* The events for the user */
+    pthread_mutex_t *markerLock;  /* A lock to prevent multiple changes of the markers at the same time */
+    AudioMarker *markers;  /* The markers sorted by frame, else NULL */
+    AudioMarker *pendingMarkers;  /* The markers handed to the audio thread */
+    uint32_t markerCount;  /* The amount of markers */
+    uint32_t pendingMarkerCount;  /* The amount of pending markers */
+    uint32_t markerFrame;  /* The frame up to which markers were reported */
+    AudioLoop fileLoop;  /* The first forward loop of the smpl chunk */
+    AudioLoopRegion loop;  /* The loop the audio thread plays */
+    AudioLoopRegion pendingLoop;  /* The loop handed to the audio thread */
+    uint32_t loopsWritten;  /* How often the written frames went back to the start of the loop */
+    uint32_t loopsHeard;  /* How often the frames up to markerFrame went back to the start of the loop */
+    _Atomic uint64_t clockPosition;  /* The heard loop count above CLOCK_LOOP_SHIFT and the heard frame below */
+    uint8_t *gatherFrames;  /* Room for the frames of the ALSA buffer gathered across a loop or segment end, else NULL */
+    pthread_mutex_t *segmentLock;  /* A lock to prevent multiple changes of the segments at the same time */
+    AudioSegment *segments;  /* The segments behind the audio data sorted by startFrame, else NULL */
+    AudioSegment *pendingSegments;  /* The segments handed to the audio thread */
+    uint32_t segmentCount;  /* The amount of segments */
+    uint32_t pendingSegmentCount;  /* The amount of pending segments */
+    AudioSegment replacement;  /* The buffer played instead of the audio data, else its buffer is NULL */
+    AudioSegment pendingReplacement;  /* The replacement handed to the audio thread */
+    uint8_t *fadeFrames;  /* The frames fading from the replaced into the new audio data, else NULL */
+    uint8_t *pendingFadeFrames;  /* Room for the fade handed to the audio thread */
+    uint32_t fadeFrame;  /* The first frame of the fade */
+    uint32_t fadeFrameCount;  /* The amount of frames of the fade, 0 if there is none */
+    uint32_t pendingFadeFrameCount;  /* The room in pendingFadeFrames in frames */
+    enum AudioState state;  /* The playback state last reported */
+    float compressionRatio;  /* The size of the given audio data divided by the size in memory */
     Bool8 soundDeviceNameSetByUser;  /* Whether the sound device name was set by the user */
     Bool8 useExternalBarrier;  /* Whether an external barrier is used */
     Bool8 isPlaying;  /* Whether the audio is playing */
@@ -182,707 +575,4814 @@ typedef struct {
     Bool8 stopFlag;  /* Whether the audio should be stopped */
     Bool8 haltFlag;  /* Whether the audio thread should be stopped */
     Bool8 jumpFlag;  /* Whether the audio should jump to a specific time */
-    uint8_t __align[7];
+    Bool8 cuePreloadFlag;  /* Whether the audio thread should take the pending preloaded frames */
+    Bool8 gainFlag;  /* Whether the audio thread should take the pending gain */
+    Bool8 addDeviceFlag;  /* Whether the audio thread should take the device behind devices */
+    Bool8 markerFlag;  /* Whether the audio thread should take the pending markers */
+    Bool8 traceFlag;  /* Whether the audio thread should take the pending trace ring */
+    Bool8 loopFlag;  /* Whether the audio thread should take the pending loop */
+    Bool8 hasFileLoop;  /* Whether fileLoop was read from the smpl chunk */
+    Bool8 segmentFlag;  /* Whether the audio thread should take the pending segments */
+    Bool8 replaceFlag;  /* Whether the audio thread should take the pending replacement */
+    Bool8 isOutputConfigured;  /* Whether the first output is configured, so it may go back to the pool */
+    uint8_t __align[5];
 } _AudioObject;
 
+/**
+ * @brief This is the shared audio data given to the user as an opaque pointer.
+ * 
+ * The data is parsed once into an audio object that is never played. Audio
+ * objects created from the buffer copy its riffData and decoder settings
+ * and hold a reference until they are destroyed.
+ * 
+ * Owned buffers that were created with AUDIO_BUFFER_DEDUPLICATE are listed
+ * in the registry, so loading the same file or bytes again returns them.
+*/
+struct _AudioBuffer {
+    _AudioObject *parsed;  /* The parsed audio data and the error object */
+    uint8_t *data;  /* The bytes of the WAV or FLAC file */
+    _AudioBuffer *next;  /* The next buffer in the registry */
+    size_t size;  /* The size of data in bytes */
+    uint64_t hash;  /* The hash of data if it is deduplicated */
+    dev_t device;  /* The device of the file if it was loaded from a path */
+    ino_t inode;  /* The inode of the file if it was loaded from a path */
+    struct timespec modificationTime;  /* The modification time of the file */
+    uint32_t references;  /* Held by the user and every audio object, under the registry lock */
+    Bool8 isCopied;  /* Whether data was allocated by the library */
+    Bool8 isMapped;  /* Whether data is a mapping of the file */
+    Bool8 isRegistered;  /* Whether the buffer is in the registry */
+    Bool8 hasFile;  /* Whether device, inode and modificationTime are valid */
+};
+
+/**
+ * @brief The deduplicated buffers of the process.
+*/
+typedef struct {
+    pthread_mutex_t lock;  /* Protects the list and the references of listed buffers */
+    _AudioBuffer *buffers;  /* The listed buffers */
+} AudioBufferRegistry;
+
+static AudioBufferRegistry bufferRegistry = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/**
+ * @brief This is the sound bank given to the user as an opaque pointer.
+ * 
+ * The mapping of the bank is a buffer without parsed audio data, so the
+ * audio objects of its clips keep it mapped after audioBankClose().
+*/
+typedef struct {
+    _AudioBuffer *buffer;  /* The mapped bank and the error object */
+    BankIndex index;  /* The index inside the mapping */
+} _AudioBank;
+
+/**
+ * @brief These are the waveform peaks given to the user as an opaque pointer.
+ * 
+ * The peaks are either a mapped sidecar file or were computed into memory.
+*/
+typedef struct {
+    AudioError *error;  /* The error object */
+    Peaks peaks;  /* The peaks, data is NULL if there are none */
+    Bool8 isMapped;  /* Whether the peaks are a mapped sidecar file */
+    uint8_t __align[7];
+} _AudioPeaks;
+
+/**
+ * @brief This is the range of frames one thread computes the peaks of.
+*/
+typedef struct {
+    const _AudioObject *parsed;  /* The read audio data */
+    Peaks *peaks;  /* The peaks that are filled */
+    uint64_t firstFrame;  /* The first frame, a multiple of PEAKS_TOP_BUCKET_FRAMES */
+    uint64_t frameCount;  /* The amount of frames */
+    Bool8 isComputed;  /* Whether the scratch memory could be allocated */
+    uint8_t __align[7];
+} AudioPeaksSegment;
+
+/**
+ * @brief This is the range of frames one thread measures the loudness of.
+*/
+typedef struct {
+    const _AudioObject *parsed;  /* The read audio data */
+    double *segmentEnergies;  /* The energies of all segments of the file */
+    const double *weights;  /* The weight of every channel */
+    uint64_t firstFrame;  /* The first frame, a multiple of the segment frames */
+    uint64_t frameCount;  /* The amount of frames */
+    float truePeak;  /* The largest absolute oversampled sample of the range */
+    Bool8 isComputed;  /* Whether the scratch memory could be allocated */
+    uint8_t __align[3];
+} AudioLoudnessSegment;
+
+/**
+ * @brief This is one of the threads probing a list of files.
+ * 
+ * The threads take the next file from a shared counter, so a slow file
+ * does not hold up the files behind it.
+*/
+typedef struct {
+    const char **paths;  /* The paths of all files */
+    AudioProbe *probes;  /* The probes of all files */
+    _Atomic uint32_t *nextPath;  /* The next file no thread has taken */
+    uint32_t pathCount;  /* The amount of files */
+    uint8_t __align[4];
+} AudioProbeSegment;
+
+/**
+ * @brief This is the batch of audio objects given to the user as an opaque pointer.
+ * 
+ * The worker threads take the next configuration from a shared counter
+ * and hand the ready objects to one reader through the list of ready
+ * indices and the eventfd, like the event queue of an audio object.
+*/
+typedef struct {
+    AudioConfiguration *configurations;  /* The configurations of all objects */
+    AudioObject *objects;  /* The objects, set when they are ready */
+    Bool8 *isReady;  /* Whether the objects are ready */
+    uint32_t *readyIndices;  /* The indices of the ready objects in the order they became ready */
+    pthread_t *threads;  /* The started worker threads */
+    AudioBatchCallback callback;  /* Called for every ready object or NULL */
+    void *userData;  /* The first argument of the callback */
+    pthread_mutex_t lock;  /* Protects the objects and the ready indices */
+    pthread_cond_t readyCondition;  /* Signalled when the last object is ready */
+    _Atomic uint32_t nextConfiguration;  /* The next configuration no thread has taken */
+    uint32_t configurationCount;  /* The amount of configurations */
+    uint32_t readyCount;  /* The amount of ready objects */
+    uint32_t readCount;  /* The ready indices taken by the reader */
+    uint32_t threadCount;  /* The amount of started worker threads */
+    int fileDescriptor;  /* The eventfd written for every ready object, else -1 */
+} _AudioBatch;
+
 void _resetError(_AudioObject *_self) {
     _self->error->type = AUDIO_ERROR_NO_ERROR;
     _self->error->level = AUDIO_ERROR_LEVEL_INFO;
     _self->error->alsaErrorNumber = 0;
 }
 
-void _waitForBarriers(_AudioObject *_self) {
+uint64_t _getMicrosecondsSince(_AudioObject *_self, const struct timespec *start) {
+    struct timespec now;
+    backendGetTime(_self->output, &now);
+    return ((now.tv_sec - start->tv_sec) * NANOSECONDS_PER_SECOND 
+        + now.tv_nsec - start->tv_nsec) / NANOSECONDS_PER_MICROSECOND;
+}
+
+void _trace(_AudioObject *_self, uint16_t type, uint16_t device, int64_t value) {
+    if (_self->trace == NULL) return;
+    struct timespec now;
+    backendGetTime(_self->output, &now);
+    traceRecordAt(_self->trace, &now, type, device, value);
+}
+
+void _waitForBarriers(_AudioObject *_self, enum TraceAction action) {
+    // The action is applied, the user thread is still waiting.
+    statsRecord(
+        &_self->counters.command, _getMicrosecondsSince(_self, &_self->actionTime)
+    );
+    if (_self->trace != NULL) {
+        traceRecordAt(
+            _self->trace, &_self->actionTime, TRACE_ACTION_SUBMITTED, 0, action
+        );
+        _trace(_self, TRACE_ACTION_APPLIED, 0, action);
+    }
     pthread_barrier_wait(_self->internalBarrier);
     if (_self->externalBarrier != NULL) {
         pthread_barrier_wait(_self->externalBarrier);
         _self->externalBarrier = NULL;
     }
+    _trace(_self, TRACE_BARRIER_RELEASED, 0, action);
 }
 
-void _play(_AudioObject *_self) {
-    _self->playFlag = false;
-    _self->isPlaying = true;
-    _self->isPaused = false;
+size_t _getFrameOffset(_AudioObject *_self, uint32_t frame) {
+    // Compressed frames can only be found by their block. FLAC frames vary
+    // in size, so the offset is estimated from the average bitrate.
+    if (_self->riffData.format == AUDIO_FORMAT_FLAC) {
+        return (uint64_t)frame * _self->riffData.dataSize 
+            / _self->riffData.samplesPerChannel;
+    }
+    return (size_t)(frame / _self->riffData.framesPerBlock) 
+        * _self->riffData.blockAlign;
 }
 
-void _pause(_AudioObject *_self) {
-    _self->pauseFlag = false;
-    _self->isPlaying = false;
-    _self->isPaused = true;
-    
-    // How much not played frames are in the buffer?
-    snd_pcm_sframes_t delay; 
-    snd_pcm_delay(_self->pcmHandle, &delay);
-
-    // Remove them from the buffer
-    _self->currentFrame -= delay;
-    if (_self->currentFrame < 0) _self->currentFrame = 0;
-    snd_pcm_drop(_self->pcmHandle);
-    snd_pcm_prepare(_self->pcmHandle);
+uint32_t _getDataPlayhead(_AudioObject *_self) {
+    // The frame of the audio data that is played. While the segments
+    // behind it play it stays at its end.
+    return _self->currentFrame < _self->dataFrameCount 
+        ? _self->currentFrame 
+        : _self->dataFrameCount;
 }
 
-void _stop(_AudioObject *_self) {
-    _self->stopFlag = false;
-    _self->isPlaying = false;
-    _self->isPaused = true;
+void _signalLoader(_AudioObject *_self, bool jumped) {
+    // Wake the loader thread up if the window has to be moved. This is
+    // called by the audio thread so it must not block.
+    uint32_t playhead = _getDataPlayhead(_self);
+    if (_self->decoder != NULL && _self->decoder->flacStream != NULL) {
+        flacStreamSetPlayhead(
+            _self->decoder->flacStream, playhead, 
+            _self->alsaBufferSize
+        );
+    }
+    AudioLoader *loader = _self->loader;
+    if (loader == NULL) return;
+    if (loader->stream != NULL) {
+        // Keep what a pause might rewind to. The stream counts blocks.
+        uint32_t framesPerBlock = _self->riffData.framesPerBlock;
+        streamSetPlayhead(
+            loader->stream, playhead / framesPerBlock, 
+            (_self->alsaBufferSize + framesPerBlock - 1) / framesPerBlock
+        );
+        return;
+    }
+    if (!loader->isWindowed && !loader->lockEnabled) return;
+    if (jumped) {
+        loader->jumpFlag = true;
+    } else if (
+        playhead - loader->signaledFrame < loader->stepFrames
+    ) {
+        return;
+    }
+    loader->signaledFrame = playhead;
+    sem_post(&loader->wakeup);
+}
 
-    // Clear buffer
-    _self->currentFrame = 0;
-    snd_pcm_drop(_self->pcmHandle);
-    snd_pcm_prepare(_self->pcmHandle);
+void _adviseRange(AudioLoader *loader, size_t begin, size_t end, int advice) {
+    // madvise needs page aligned addresses.
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    begin -= begin % pageSize;
+    if (end > loader->mappingSize) end = loader->mappingSize;
+    if (begin >= end) return;
+    madvise(loader->mapping + begin, end - begin, advice);
 }
 
-void _jump(_AudioObject *_self) {
-    _self->jumpFlag = false;
+void _moveLoaderWindow(_AudioObject *_self) {
+    AudioLoader *loader = _self->loader;
+    size_t playhead = (_self->riffData.data - loader->mapping)
+        + _getFrameOffset(_self, _getDataPlayhead(_self));
 
-    // Calculate new current frame and check for overrun
-    _self->currentFrame = (_self->jumpTarget * _self->riffData.sampleRate) 
-        / MILLISECONDS_PER_SECOND;
-    if (_self->currentFrame > _self->lastFrame) {
-        _self->currentFrame = _self->lastFrame;
+    // After a jump the old window is meaningless.
+    if (loader->jumpFlag) {
+        loader->jumpFlag = false;
+        loader->prefetchedUntil = playhead;
+        if (loader->droppedUntil > playhead) loader->droppedUntil = playhead;
     }
 
-    // Clear buffer
-    snd_pcm_drop(_self->pcmHandle);
-    snd_pcm_prepare(_self->pcmHandle);
-}
+    // Request readahead for the part of the window that is not requested yet.
+    size_t windowEnd = playhead + loader->readaheadBytes;
+    if (windowEnd > loader->fileSize) windowEnd = loader->fileSize;
+    if (loader->prefetchedUntil < playhead) loader->prefetchedUntil = playhead;
+    if (windowEnd > loader->prefetchedUntil) {
+        _adviseRange(
+            loader, loader->prefetchedUntil, windowEnd, MADV_WILLNEED
+        );
+        loader->prefetchedUntil = windowEnd;
+    }
 
-snd_pcm_uframes_t _getFramesAvailable(_AudioObject *_self) {
-    // Get the amount of frames that can be written to the buffer
-    snd_pcm_status_t *status;
-    snd_pcm_status_malloc(&status);
-    snd_pcm_status(_self->pcmHandle, status);
-    snd_pcm_uframes_t framesAvailable = snd_pcm_status_get_avail(status);
-    snd_pcm_status_free(status);
-    return framesAvailable;
+    // Release everything that is too far behind the playhead.
+    if (!loader->dropBehind || playhead < loader->keepBehindBytes) return;
+    size_t dropEnd = playhead - loader->keepBehindBytes;
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    dropEnd -= dropEnd % pageSize;
+    if (loader->lockedBytes > 0 && loader->mapping + dropEnd > loader->lockedBegin) {
+        // Locked pages cannot be released.
+        dropEnd = loader->lockedBegin - loader->mapping;
+    }
+    if (dropEnd <= loader->droppedUntil) return;
+    madvise(
+        loader->mapping + loader->droppedUntil, 
+        dropEnd - loader->droppedUntil, 
+        MADV_DONTNEED
+    );
+    posix_fadvise(
+        loader->fileDescriptor, loader->droppedUntil, 
+        dropEnd - loader->droppedUntil, POSIX_FADV_DONTNEED
+    );
+    loader->droppedUntil = dropEnd;
 }
 
-snd_pcm_uframes_t _getFramesToWrite(
-    _AudioObject *_self, snd_pcm_uframes_t framesAvailable, bool *endReached
-) {
-    // Compute the actual amount of frames to be written considering 
-    // possible overrun.
-    snd_pcm_uframes_t framesToWrite = framesAvailable;
-    *endReached = false;
-    if (_self->currentFrame + framesToWrite > _self->lastFrame) {
-        framesToWrite = _self->lastFrame - _self->currentFrame;
-        *endReached = true;
+bool _lockRange(AudioLoader *loader, uint8_t *begin, uint8_t *end) {
+    // Lock the pages in [begin, end) and unlock all other locked pages.
+    // Pages locked already are neither unlocked nor locked again. On
+    // failure nothing is locked afterwards.
+    uint8_t *lockedBegin = loader->lockedBegin;
+    uint8_t *lockedEnd = loader->lockedEnd;
+    if (loader->lockedBytes == 0 || end <= lockedBegin || begin >= lockedEnd) {
+        if (loader->lockedBytes > 0) munlock(lockedBegin, lockedEnd - lockedBegin);
+        lockedBegin = lockedEnd = begin;
+    } else {
+        if (lockedBegin < begin) munlock(lockedBegin, begin - lockedBegin);
+        if (end < lockedEnd) munlock(end, lockedEnd - end);
+        if (lockedBegin < begin) lockedBegin = begin;
+        if (end < lockedEnd) lockedEnd = end;
     }
-    return framesToWrite;
-}
 
-void * _mainloop(void *self) {
-    _AudioObject *_self = (_AudioObject*)self;
-    _self->isPaused = true;
+    bool locked = true;
+    if (begin < lockedBegin && mlock(begin, lockedBegin - begin) == -1) {
+        locked = false;
+    } else if (lockedEnd < end && mlock(lockedEnd, end - lockedEnd) == -1) {
+        locked = false;
+    }
+    if (!locked) {
+        munlock(begin, end - begin);
+        begin = end = NULL;
+    }
 
-    while (!_self->haltFlag) {
-        // Handle set command flags.
-        if (_self->playFlag) {
-            _play(_self);
-            _waitForBarriers(_self);
-        } else if (_self->pauseFlag) {
-            _pause(_self);
-            _waitForBarriers(_self);
-        } else if (_self->stopFlag) {
-            _stop(_self);
-            _waitForBarriers(_self);
-        } else if (_self->jumpFlag) {
-            _jump(_self);
-            _waitForBarriers(_self);
-        }
+    loader->lockedBegin = begin;
+    loader->lockedEnd = end;
+    loader->lockedBytes = end - begin;
+    return locked;
+}
 
-        // Wait a bit and if paused don't do anything.
-        usleep(_self->timeResolution * MICROSECONDS_PER_MILLISECOND);
-        if (_self->isPaused) continue;
+void _getLockedWindow(_AudioObject *_self, uint8_t **begin, uint8_t **end) {
+    // Fit the window into the budget. Two pages are reserved for the page
+    // alignment. The part behind the playhead is shrunk first.
+    AudioLoader *loader = _self->loader;
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t budget = loader->lockBudget - 2 * pageSize;
+    size_t aheadBytes = loader->lockAheadBytes;
+    if (aheadBytes > budget) aheadBytes = budget;
+    size_t behindBytes = loader->lockBehindBytes;
+    if (behindBytes > budget - aheadBytes) behindBytes = budget - aheadBytes;
+
+    size_t playhead = _getFrameOffset(_self, _getDataPlayhead(_self));
+    size_t windowBegin = playhead > behindBytes ? playhead - behindBytes : 0;
+    size_t windowEnd = playhead + aheadBytes;
+    if (windowEnd > _self->riffData.dataSize) windowEnd = _self->riffData.dataSize;
+    if (windowBegin > windowEnd) windowBegin = windowEnd;
+
+    // mlock works on whole pages.
+    uintptr_t alignedBegin = (uintptr_t)(_self->riffData.data + windowBegin);
+    uintptr_t alignedEnd = (uintptr_t)(_self->riffData.data + windowEnd);
+    alignedBegin -= alignedBegin % pageSize;
+    alignedEnd += (pageSize - alignedEnd % pageSize) % pageSize;
+    *begin = (uint8_t*)alignedBegin;
+    *end = (uint8_t*)alignedEnd;
+}
 
-        // Determine how many frames could be written.
-        snd_pcm_uframes_t framesAvailable = _getFramesAvailable(_self);
+void _moveLockedWindow(_AudioObject *_self) {
+    AudioLoader *loader = _self->loader;
 
-        // If buffer is half empty write frames
-        if (framesAvailable > HALF(_self->alsaBufferSize)) {
-            // Determine the amount of frames to write and check if
-            // the end is reached afterwards.
-            bool endReached = false;
-            snd_pcm_uframes_t framesToWrite = _getFramesToWrite(
-                _self, framesAvailable, &endReached
-            );
+    // Streamed audio only ever has its blocks in memory.
+    if (loader->stream != NULL) {
+        if (loader->lockEnabled && loader->lockedBytes == 0) {
+            loader->lockedBytes = streamLockBuffers(loader->stream, true);
+            if (loader->lockedBytes == 0) loader->lockEnabled = false;
+        } else if (!loader->lockEnabled && loader->lockedBytes > 0) {
+            loader->lockedBytes = streamLockBuffers(loader->stream, false);
+        }
+        return;
+    }
 
-            // Calculate the offset in the pcm data.
-            size_t pcm_offset = _self->currentFrame 
-                * _self->riffData.blockAlign;
-
-            // Write the frames
-            if (snd_pcm_writei(
-                _self->pcmHandle, 
-                (void*)(_self->riffData.data + pcm_offset), 
-                framesToWrite
-            ) == -EPIPE) {
-                snd_pcm_prepare(_self->pcmHandle);
-            }
+    if (!loader->lockEnabled) {
+        _lockRange(loader, NULL, NULL);
+        return;
+    }
 
-            // Stop if end is reached.
-            if (endReached) {
-                _stop(_self);
-            } else {
-                _self->currentFrame += framesToWrite;
-            }
+    // Locking fails if RLIMIT_MEMLOCK is exhausted, e.g. by other audio
+    // objects. Retry with half the budget until only the readahead of a
+    // windowed loader is left.
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    uint8_t *begin, *end;
+    _getLockedWindow(_self, &begin, &end);
+    while (!_lockRange(loader, begin, end)) {
+        loader->lockBudget /= 2;
+        if (loader->lockBudget < MIN_LOCKED_PAGES * pageSize) {
+            loader->lockEnabled = false;
+            return;
         }
+        _getLockedWindow(_self, &begin, &end);
+    }
+}
+
+void * _loaderLoop(void *self) {
+    _AudioObject *_self = (_AudioObject*)self;
+    AudioLoader *loader = _self->loader;
+
+    while (true) {
+        // Sleep until the audio thread or audioDestroy() wakes us up.
+        if (sem_wait(&loader->wakeup) == -1) continue;
+        if (loader->haltFlag) break;
+        pthread_mutex_lock(&loader->windowLock);
+        if (loader->isWindowed) _moveLoaderWindow(_self);
+        _moveLockedWindow(_self);
+        pthread_mutex_unlock(&loader->windowLock);
     }
 
     pthread_exit(NULL);
     return NULL;
 }
 
-bool _readFactCunk(_AudioObject *_self, AudioFactChunk *factChunk) {
-    if (memcmp(factChunk->factMagic, FACT_MAGIC, MAGIC_SIZE)) {
-        _self->error->type = AUDIO_ERROR_INVALID_FACT_MAGIC_NUMBER;
-        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+void _accountPageFaults(_AudioObject *_self, snd_pcm_uframes_t framesWritten) {
+    // Count the page faults the audio thread took since the last refill.
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) == -1) return;
+    _self->majorFaults += usage.ru_majflt - _self->lastMajorFaultCount;
+    statsAdd(
+        &_self->counters.majorFaults, usage.ru_majflt - _self->lastMajorFaultCount
+    );
+    statsAdd(
+        &_self->counters.minorFaults, usage.ru_minflt - _self->lastMinorFaultCount
+    );
+    _self->lastMajorFaultCount = usage.ru_majflt;
+    _self->lastMinorFaultCount = usage.ru_minflt;
+    _self->playedFrames += framesWritten;
+}
+
+double _getSecondsBetween(
+    const struct timespec *start, const struct timespec *end
+) {
+    return (double)(end->tv_sec - start->tv_sec) 
+        + (double)(end->tv_nsec - start->tv_nsec) / NANOSECONDS_PER_SECOND;
+}
+
+void _resetClock(AudioDeviceClock *clock) {
+    // The drift measured so far is kept until it is measured again.
+    clock->writtenFrames = 0;
+    clock->isRunning = false;
+}
+
+bool _measureClock(
+    AudioDeviceClock *clock, Backend *output, uint32_t sampleRate
+) {
+    snd_pcm_sframes_t delay;
+    if (
+        backendState(output) != SND_PCM_STATE_RUNNING 
+        || backendDelay(output, &delay) < 0 
+        || delay < 0 || (uint64_t)delay > clock->writtenFrames
+    ) {
         return false;
     }
-    if (factChunk->factSize != 4) {
-        _self->error->type = AUDIO_ERROR_INVALID_FACT_SIZE;
-        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return false;
+    backendGetTime(output, &clock->time);
+    clock->delay = delay;
+    uint64_t playedFrames = clock->writtenFrames - delay;
+    if (!clock->isRunning) {
+        clock->firstTime = clock->time;
+        clock->firstPlayedFrames = playedFrames;
+        clock->isRunning = true;
+        return true;
+    }
+    double seconds = _getSecondsBetween(&clock->firstTime, &clock->time);
+    if (seconds >= DRIFT_MIN_SECONDS) {
+        double rate = (playedFrames - clock->firstPlayedFrames) / seconds;
+        clock->driftPpm = (rate / sampleRate - 1.0) * PARTS_PER_MILLION;
     }
-    // The fact chunk contains the amount of samples per channel
-    _self->riffData.samplesPerChannel = factChunk->samplesPerChannel;
     return true;
 }
 
-bool _readNonPcmFmtChunkExtension(
-    _AudioObject *_self, AudioNonPcmFmtChunkExtension *nonPcmExtension
-) {
-    // non-PCM extensions that are not extensible have size 0
-    if (nonPcmExtension->extraSize != 0) {
-        _self->error->type = AUDIO_ERROR_INVALID_NON_PCM_EXTENSION_SIZE;
-        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return false;
+void _steerDevice(_AudioObject *_self, AudioDevice *device, double seconds) {
+    // Both devices are compared at the time this one was measured. The
+    // resampler reads its next frame at phase behind history, which is one
+    // frame before the next frame of the first device.
+    uint32_t sampleRate = _self->riffData.sampleRate;
+    double firstDelay = _self->clock.delay - _getSecondsBetween(
+        &_self->clock.time, &device->clock.time
+    ) * sampleRate;
+    double readPosition = device->isLinked ? 0.0 : device->phase - 1.0;
+    double offset = firstDelay - device->clock.delay * device->step + readPosition;
+    if (!device->hasOffset) {
+        device->offset = offset;
+        device->hasOffset = true;
+    } else {
+        device->offset += (offset - device->offset) 
+            * seconds / (seconds + OFFSET_SMOOTHING_SECONDS);
     }
-    // every non-PCM extension must have a fact chunk
+    // Linked devices share the clock of the first one.
+    if (device->isLinked) return;
+
+    // The controller is critically damped with a time constant of
+    // DRIFT_CORRECTION_SECONDS. The integral is held while the correction
+    // is limited.
+    double error = device->offset / sampleRate;
+    double correction = error / DRIFT_CORRECTION_SECONDS 
+        + device->integral / (4.0 * DRIFT_CORRECTION_SECONDS * DRIFT_CORRECTION_SECONDS);
+    double limit = MAX_CORRECTION_PPM / PARTS_PER_MILLION;
+    if (fabs(correction) < limit) {
+        device->integral += error * seconds;
+    } else {
+        correction = correction > 0.0 ? limit : -limit;
+    }
+    device->step = 1.0 - correction;
+}
+
+void _measureDevices(_AudioObject *_self) {
+    // The added devices are steered towards the first one.
+    uint32_t sampleRate = _self->riffData.sampleRate;
+    if (!_measureClock(&_self->clock, _self->output, sampleRate)) return;
+    for (uint32_t i = 0; i < _self->deviceCount; ++i) {
+        AudioDevice *device = &_self->devices[i];
+        struct timespec lastTime = device->clock.time;
+        bool wasRunning = device->clock.isRunning;
+        if (!_measureClock(&device->clock, device->output, sampleRate)) {
+            continue;
+        }
+        _steerDevice(
+            _self, device, 
+            wasRunning ? _getSecondsBetween(&lastTime, &device->clock.time) : 0.0
+        );
+    }
+}
+
+bool _isLoopPending(_AudioObject *_self, uint32_t frame) {
+    // Whether the playback at frame goes back to the start of the loop
+    // when it reaches its end.
+    const AudioLoopRegion *loop = &_self->loop;
+    return frame < loop->endFrame 
+        && (loop->count == 0 || _self->loopsWritten + 1 < loop->count);
+}
+
+uint32_t _rewindFrame(
+    _AudioObject *_self, uint32_t frame, uint32_t *loops, snd_pcm_uframes_t frameCount
+) {
+    // Go back frameCount frames from frame, which went back to the start of
+    // the loop loops times, through the passes of the loop in between.
+    const AudioLoopRegion *loop = &_self->loop;
+    if (*loops == 0 || frame < loop->startFrame || frameCount <= frame - loop->startFrame) {
+        return frameCount > frame ? 0 : frame - frameCount;
+    }
+    frameCount -= frame - loop->startFrame;
+    uint32_t loopFrameCount = loop->endFrame - loop->startFrame;
+    uint64_t passes = (frameCount - 1) / loopFrameCount;
+    if (passes > *loops - 1) passes = *loops - 1;
+    frameCount -= passes * loopFrameCount;
+    *loops -= passes + 1;
+    return frameCount > loop->endFrame ? 0 : loop->endFrame - frameCount;
+}
+
+void _dropFrames(_AudioObject *_self) {
+    // Clear the buffers of all devices. Linked devices are cleared with the
+    // first one. The resamplers start over, the controllers keep the drift.
+    _trace(_self, TRACE_DROP, 0, 0);
+    backendDrop(_self->output);
+    backendPrepare(_self->output);
+    _resetClock(&_self->clock);
+    for (uint32_t i = 0; i < _self->deviceCount; ++i) {
+        AudioDevice *device = &_self->devices[i];
+        if (!device->isLinked) {
+            _trace(_self, TRACE_DROP, i + 1, 0);
+            backendDrop(device->output);
+            backendPrepare(device->output);
+        }
+        _resetClock(&device->clock);
+        device->hasHistory = false;
+        device->hasOffset = false;
+    }
+}
+
+void _restartDevices(_AudioObject *_self) {
+    // Continue with the frame the first device plays, so all devices start
+    // from it together.
+    snd_pcm_sframes_t delay = 0;
+    if (backendDelay(_self->output, &delay) < 0 || delay < 0) delay = 0;
+    _self->currentFrame = _rewindFrame(
+        _self, _self->currentFrame, &_self->loopsWritten, delay
+    );
+    _dropFrames(_self);
+    _signalLoader(_self, true);
+}
+
+void _startDevices(_AudioObject *_self) {
+    // The devices of a fan-out wait until every one of them holds frames.
+    // Linked devices start with the first one.
+    if (backendState(_self->output) == SND_PCM_STATE_PREPARED) {
+        _trace(_self, TRACE_START, 0, 0);
+        backendStart(_self->output);
+    }
+    for (uint32_t i = 0; i < _self->deviceCount; ++i) {
+        Backend *output = _self->devices[i].output;
+        if (backendState(output) == SND_PCM_STATE_PREPARED) {
+            _trace(_self, TRACE_START, i + 1, 0);
+            backendStart(output);
+        }
+    }
+}
+
+void _addDevice(_AudioObject *_self) {
+    // All devices start again from the frame that is heard, so the new
+    // device is linked while none of them runs. If the first device cannot
+    // wait for the others it starts a little early, which the controllers
+    // take out.
+    _self->addDeviceFlag = false;
+    AudioDevice *device = &_self->devices[_self->deviceCount];
+    if (_self->isPlaying) _restartDevices(_self);
+    int card = backendGetCard(_self->output);
+    device->isLinked = card >= 0 
+        && backendGetCard(device->output) == card 
+        && backendLink(_self->output, device->output) == 0;
+    if (_self->deviceCount == 0) backendSetManualStart(_self->output);
+    ++_self->deviceCount;
+}
+
+void _closeDevice(AudioDevice *device) {
+    if (device->output) backendClose(device->output);
+    free(device->soundDeviceName);
+    free(device->frames);
+    free(device->history);
+    *device = (AudioDevice){ 0 };
+}
+
+void _postEvent(_AudioObject *_self, AudioEvent event) {
+    // Events that do not fit are counted in the next one that does.
+    AudioEventQueue *queue = &_self->events;
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head >= EVENT_QUEUE_SIZE) {
+        ++queue->droppedEvents;
+        return;
+    }
+    struct timespec now;
+    backendGetTime(_self->output, &now);
+    event.state = _self->state;
+    event.droppedEvents = queue->droppedEvents;
+    event.nanoseconds = now.tv_sec * NANOSECONDS_PER_SECOND + now.tv_nsec;
+    queue->events[tail % EVENT_QUEUE_SIZE] = event;
+    queue->droppedEvents = 0;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    if (queue->fileDescriptor != -1) {
+        uint64_t value = 1;
+        ssize_t result = write(queue->fileDescriptor, &value, sizeof(value));
+        (void)result;
+    }
+}
+
+void _postAlsaError(_AudioObject *_self, int alsaErrorNumber) {
+    _postEvent(_self, (AudioEvent){
+        .type = AUDIO_EVENT_ERROR,
+        .frame = _self->currentFrame,
+        .error = {
+            .type = AUDIO_ERROR_ALSA_ERROR,
+            .level = AUDIO_ERROR_LEVEL_ERROR,
+            .alsaErrorNumber = alsaErrorNumber
+        }
+    });
+}
+
+bool _checkStream(_AudioObject *_self) {
+    // A stream that cannot read its file anymore ends the playback instead
+    // of starving it forever.
+    if (_self->loader == NULL || _self->loader->stream == NULL) return true;
+    int error = streamGetError(_self->loader->stream);
+    if (error == 0) return true;
+    _postEvent(_self, (AudioEvent){
+        .type = AUDIO_EVENT_ERROR,
+        .frame = _self->currentFrame,
+        .error = {
+            .type = AUDIO_ERROR_FILE_READ_FAILED,
+            .level = AUDIO_ERROR_LEVEL_ERROR,
+            .alsaErrorNumber = error
+        }
+    });
+    return false;
+}
+
+void _postXrun(_AudioObject *_self) {
+    // The trace of the last xrun is kept until the next one.
+    statsAdd(&_self->counters.xruns, 1);
+    if (_self->trace != NULL) {
+        _trace(_self, TRACE_XRUN, 0, _self->currentFrame);
+        traceTakeSnapshot(_self->trace);
+    }
+    _postEvent(_self, (AudioEvent){
+        .type = AUDIO_EVENT_XRUN, .frame = _self->currentFrame
+    });
+}
+
+void _setState(_AudioObject *_self, enum AudioState state) {
+    if (_self->state == state) return;
+    _self->state = state;
+    _postEvent(_self, (AudioEvent){
+        .type = AUDIO_EVENT_STATE_CHANGED, .frame = _self->currentFrame
+    });
+}
+
+uint32_t _getAudibleFrame(_AudioObject *_self, uint32_t *loops) {
+    // The frames in the buffer of the first device are not heard yet.
+    snd_pcm_sframes_t delay = 0;
+    if (backendDelay(_self->output, &delay) < 0 || delay < 0) delay = 0;
+    *loops = _self->loopsWritten;
+    return _rewindFrame(_self, _self->currentFrame, loops, delay);
+}
+
+void _publishClock(_AudioObject *_self, uint32_t frame, uint32_t loops) {
+    // One store, so audioGetClock() never sees a frame of another pass.
+    atomic_store(
+        &_self->clockPosition, ((uint64_t)loops << CLOCK_LOOP_SHIFT) | frame
+    );
+}
+
+void _postMarkers(_AudioObject *_self, uint64_t endFrame) {
+    // Report the markers from markerFrame up to but excluding endFrame.
+    if (endFrame <= _self->markerFrame) return;
+    uint32_t low = 0;
+    uint32_t high = _self->markerCount;
+    while (low < high) {
+        uint32_t middle = low + HALF(high - low);
+        if (_self->markers[middle].frame < _self->markerFrame) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    for (uint32_t i = low; i < _self->markerCount; ++i) {
+        const AudioMarker *marker = &_self->markers[i];
+        if (marker->frame >= endFrame) break;
+        _postEvent(_self, (AudioEvent){
+            .type = AUDIO_EVENT_MARKER, .frame = marker->frame, .markerId = marker->id
+        });
+    }
+    _self->markerFrame = endFrame > _self->lastFrame ? _self->lastFrame : endFrame;
+}
+
+void _postHeardMarkers(_AudioObject *_self, uint64_t endFrame, uint32_t loops) {
+    // The markers inside the loop are reported on every pass.
+    while (_self->loopsHeard < loops) {
+        _postMarkers(_self, _self->loop.endFrame);
+        _self->markerFrame = _self->loop.startFrame;
+        ++_self->loopsHeard;
+    }
+    _postMarkers(_self, endFrame);
+    _publishClock(
+        _self, endFrame > _self->lastFrame ? _self->lastFrame : endFrame, loops
+    );
+}
+
+void _swapMarkers(_AudioObject *_self) {
+    // The user thread frees the markers handed back.
+    _self->markerFlag = false;
+    AudioMarker *markers = _self->markers;
+    uint32_t markerCount = _self->markerCount;
+    _self->markers = _self->pendingMarkers;
+    _self->markerCount = _self->pendingMarkerCount;
+    _self->pendingMarkers = markers;
+    _self->pendingMarkerCount = markerCount;
+}
+
+void _swapTrace(_AudioObject *_self) {
+    // The user thread frees the ring handed back.
+    _self->traceFlag = false;
+    TraceRing *trace = _self->trace;
+    _self->trace = _self->pendingTrace;
+    _self->pendingTrace = trace;
+}
+
+void _play(_AudioObject *_self) {
+    _self->playFlag = false;
+    _self->isPlaying = true;
+    _self->isPaused = false;
+    _setState(_self, AUDIO_STATE_PLAYING);
+}
+
+void _pause(_AudioObject *_self) {
+    _self->pauseFlag = false;
+    _self->isPlaying = false;
+    _self->isPaused = true;
+    
+    // How much not played frames are in the buffer?
+    snd_pcm_sframes_t delay = 0; 
+    backendDelay(_self->output, &delay);
+
+    // Remove them from the buffer
+    if (delay < 0) delay = 0;
+    _self->currentFrame = _rewindFrame(
+        _self, _self->currentFrame, &_self->loopsWritten, delay
+    );
+    _dropFrames(_self);
+
+    _signalLoader(_self, true);
+    _postHeardMarkers(_self, _self->currentFrame, _self->loopsWritten);
+    _setState(_self, AUDIO_STATE_PAUSED);
+}
+
+void _stop(_AudioObject *_self) {
+    _self->stopFlag = false;
+    _self->isPlaying = false;
+    _self->isPaused = true;
+
+    // Clear buffer
+    _self->currentFrame = 0;
+    _self->markerFrame = 0;
+    _self->loopsWritten = 0;
+    _self->loopsHeard = 0;
+    _self->fadeFrameCount = 0;
+    _publishClock(_self, 0, 0);
+    _dropFrames(_self);
+
+    _signalLoader(_self, true);
+    _setState(_self, AUDIO_STATE_STOPPED);
+}
+
+void _swapCuePreload(_AudioObject *_self) {
+    // The user thread frees the preloaded frames handed back.
+    _self->cuePreloadFlag = false;
+    AudioCuePreload cuePreload = _self->cuePreload;
+    _self->cuePreload = _self->pendingCuePreload;
+    _self->pendingCuePreload = cuePreload;
+    _self->activeCue = NO_CUE;
+}
+
+void _swapLoop(_AudioObject *_self) {
+    // The user thread frees the loop handed back. The frames in the buffer
+    // count as frames of the new loop.
+    _self->loopFlag = false;
+    AudioLoopRegion loop = _self->loop;
+    _self->loop = _self->pendingLoop;
+    _self->pendingLoop = loop;
+    _self->loopsWritten = 0;
+    _self->loopsHeard = 0;
+}
+
+void _swapSegments(_AudioObject *_self) {
+    // The user thread releases the segments handed back. The timeline ends
+    // behind the last segment.
+    _self->segmentFlag = false;
+    AudioSegment *segments = _self->segments;
+    uint32_t segmentCount = _self->segmentCount;
+    _self->segments = _self->pendingSegments;
+    _self->segmentCount = _self->pendingSegmentCount;
+    _self->pendingSegments = segments;
+    _self->pendingSegmentCount = segmentCount;
+    const AudioSegment *last = &_self->segments[_self->segmentCount - 1];
+    _self->lastFrame = last->startFrame + last->frameCount;
+}
+
+void _jump(_AudioObject *_self) {
+    _self->jumpFlag = false;
+    if (_self->isPlaying) {
+        uint32_t loops;
+        uint32_t frame = _getAudibleFrame(_self, &loops);
+        _postHeardMarkers(_self, frame, loops);
+    }
+
+    // Check the new current frame for overrun
+    _self->currentFrame = _self->jumpTarget;
+    if (_self->currentFrame > _self->lastFrame) {
+        _self->currentFrame = _self->lastFrame;
+    }
+    _self->activeCue = _self->jumpCue;
+    _self->markerFrame = _self->currentFrame;
+    _self->loopsWritten = 0;
+    _self->loopsHeard = 0;
+    _self->fadeFrameCount = 0;
+    _publishClock(_self, _self->currentFrame, 0);
+
+    // Clear buffer
+    _dropFrames(_self);
+
+    _signalLoader(_self, true);
+}
+
+snd_pcm_uframes_t _getFramesAvailable(_AudioObject *_self) {
+    // Get the amount of frames that can be written to the buffer
+    BackendStatus status;
+    backendStatus(_self->output, &status);
+    snd_pcm_uframes_t framesAvailable = status.avail;
+
+    // Sample the buffer level for the statistics while the device plays.
+    snd_pcm_sframes_t delay = status.delay;
+    _trace(_self, TRACE_AVAIL, 0, framesAvailable);
+    _trace(_self, TRACE_DELAY, 0, delay);
+    if (status.state == SND_PCM_STATE_RUNNING && delay >= 0) {
+        AudioCounters *counters = &_self->counters;
+        statsAdd(&counters->levelSamples, 1);
+        statsAdd(&counters->availFrames, framesAvailable);
+        statsRaise(&counters->maxAvailFrames, framesAvailable);
+        statsAdd(&counters->delayFrames, delay);
+        statsLower(&counters->minDelayFrames, delay);
+        statsRecord(
+            &counters->headroom, 
+            (uint64_t)delay * MICROSECONDS_PER_SECOND / _self->riffData.sampleRate
+        );
+    }
+    return framesAvailable;
+}
+
+const uint8_t * _getEncodedBlock(
+    _AudioObject *_self, uint64_t block, size_t *blockSize
+) {
+    // Returns NULL if a streamed block was not read yet.
+    *blockSize = _self->riffData.blockAlign;
+    if (_self->loader->stream != NULL) {
+        uint32_t blockCount = 1;
+        const uint8_t *encodedBlock = streamGetFrames(
+            _self->loader->stream, block, &blockCount
+        );
+        return blockCount == 0 ? NULL : encodedBlock;
+    }
+    // The last block may be shorter.
+    size_t offset = block * *blockSize;
+    if (_self->riffData.dataSize - offset < *blockSize) {
+        *blockSize = _self->riffData.dataSize - offset;
+    }
+    return _self->riffData.data + offset;
+}
+
+const uint8_t * _decodeFrames(
+    _AudioObject *_self, uint32_t frame, snd_pcm_uframes_t *frameCount
+) {
+    // FLAC frames are decoded by the stream already.
+    AudioDecoder *decoder = _self->decoder;
+    if (decoder->flacStream != NULL) {
+        uint32_t flacFrameCount = *frameCount;
+        const uint8_t *frames = flacStreamGetFrames(
+            decoder->flacStream, frame, &flacFrameCount
+        );
+        *frameCount = flacFrameCount;
+        return frames;
+    }
+
+    // Decode the block containing the frame unless it is decoded already.
+    uint32_t framesPerBlock = _self->riffData.framesPerBlock;
+    uint64_t block = frame / framesPerBlock;
+    if (decoder->decodedBlock != block) {
+        const uint8_t *encodedBlock = NULL;
+        size_t blockSize = 0;
+        if (decoder->samples == NULL) {
+            encodedBlock = _getEncodedBlock(_self, block, &blockSize);
+            if (encodedBlock == NULL) {
+                *frameCount = 0;
+                return NULL;
+            }
+        }
+        struct timespec start, end;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+        if (decoder->samples != NULL) {
+            decoder->decodedFrames = flacDecodeFrame(
+                &decoder->flacInfo, decoder->flacInfo.seekPoints[block].offset, 
+                decoder->samples, decoder->frames
+            );
+        } else {
+            decoder->decodedFrames = adpcmDecodeBlock(
+                &decoder->format, encodedBlock, blockSize, 
+                (int16_t*)decoder->frames
+            );
+        }
+        decoder->decodedBlock = block;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+        decoder->decodeNanoseconds += (end.tv_sec - start.tv_sec) 
+            * NANOSECONDS_PER_SECOND + end.tv_nsec - start.tv_nsec;
+        decoder->decodedFrameCount += decoder->decodedFrames;
+    }
+
+    uint32_t frameInBlock = frame % framesPerBlock;
+    if (frameInBlock >= decoder->decodedFrames) {
+        *frameCount = 0;
+        return NULL;
+    }
+    if (*frameCount > decoder->decodedFrames - frameInBlock) {
+        *frameCount = decoder->decodedFrames - frameInBlock;
+    }
+    return decoder->frames + (size_t)frameInBlock * decoder->frameSize;
+}
+
+const uint8_t * _getPreloadedFrames(
+    _AudioObject *_self, uint32_t frame, snd_pcm_uframes_t *frameCount
+) {
+    // Play the frames behind the cue point jumped to until the playhead
+    // leaves them.
+    AudioCuePreload *cuePreload = &_self->cuePreload;
+    uint32_t cueFrame = _self->cues[_self->activeCue].frame;
+    if (
+        cuePreload->frames == NULL || frame < cueFrame 
+        || frame - cueFrame >= cuePreload->frameCount
+    ) {
+        _self->activeCue = NO_CUE;
+        return NULL;
+    }
+    uint32_t frameInCue = frame - cueFrame;
+    if (*frameCount > cuePreload->frameCount - frameInCue) {
+        *frameCount = cuePreload->frameCount - frameInCue;
+    }
+    size_t frameSize = _self->decoder != NULL 
+        ? _self->decoder->frameSize 
+        : _self->riffData.blockAlign;
+    return cuePreload->frames + (
+        (size_t)_self->activeCue * cuePreload->frameCount + frameInCue
+    ) * frameSize;
+}
+
+uint32_t _findSegment(_AudioObject *_self, uint32_t frame) {
+    // Returns the index of the segment holding a frame behind the audio
+    // data.
+    uint32_t low = 0;
+    uint32_t high = _self->segmentCount;
+    while (high - low > 1) {
+        uint32_t middle = low + HALF(high - low);
+        if (_self->segments[middle].startFrame <= frame) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+const uint8_t * _getSegmentFrames(
+    _AudioObject *_self, uint32_t frame, snd_pcm_uframes_t *frameCount
+) {
+    // The frames of a segment are in memory like those of a buffer.
+    const AudioSegment *segment = &_self->segments[_findSegment(_self, frame)];
+    uint32_t frameInSegment = frame - segment->startFrame;
+    if (frameInSegment >= segment->frameCount) {
+        *frameCount = 0;
+        return NULL;
+    }
+    if (*frameCount > segment->frameCount - frameInSegment) {
+        *frameCount = segment->frameCount - frameInSegment;
+    }
+    return segment->frames 
+        + (size_t)frameInSegment * segment->buffer->parsed->riffData.blockAlign;
+}
+
+uint32_t _getRunEnd(_AudioObject *_self, uint32_t frame) {
+    // Returns the frame at which the frames behind frame continue
+    // elsewhere in memory, which is the end of a loop that is played
+    // again, of the audio data or of a segment. Returns lastFrame if
+    // there is no such frame.
+    if (_isLoopPending(_self, frame)) return _self->loop.endFrame;
+    if (_self->segmentCount == 0) return _self->lastFrame;
+    if (frame < _self->dataFrameCount) return _self->dataFrameCount;
+    const AudioSegment *segment = &_self->segments[_findSegment(_self, frame)];
+    return segment->startFrame + segment->frameCount;
+}
+
+const uint8_t * _getFrameData(
+    _AudioObject *_self, uint32_t frame, snd_pcm_uframes_t *frameCount
+) {
+    // Return a pointer to the frame and reduce frameCount to the amount of
+    // consecutive frames behind it. Data in memory is always complete.
+    const AudioLoopRegion *loop = &_self->loop;
+    if (loop->seamFrameCount > 0 && _isLoopPending(_self, frame)) {
+        // The end of a loop that is played again is crossfaded.
+        uint32_t seamFrame = loop->endFrame - loop->seamFrameCount;
+        if (frame >= seamFrame) {
+            if (*frameCount > loop->endFrame - frame) {
+                *frameCount = loop->endFrame - frame;
+            }
+            size_t frameSize = _self->decoder != NULL 
+                ? _self->decoder->frameSize 
+                : _self->riffData.blockAlign;
+            return loop->frames + (size_t)(frame - seamFrame) * frameSize;
+        }
+        if (*frameCount > seamFrame - frame) *frameCount = seamFrame - frame;
+    }
+    if (_self->fadeFrameCount > 0) {
+        // The frames behind the switch to new audio data are faded.
+        if (frame >= _self->fadeFrame && frame - _self->fadeFrame < _self->fadeFrameCount) {
+            uint32_t frameInFade = frame - _self->fadeFrame;
+            if (*frameCount > _self->fadeFrameCount - frameInFade) {
+                *frameCount = _self->fadeFrameCount - frameInFade;
+            }
+            return _self->fadeFrames 
+                + (size_t)frameInFade * _self->riffData.blockAlign;
+        }
+        if (frame < _self->fadeFrame && *frameCount > _self->fadeFrame - frame) {
+            *frameCount = _self->fadeFrame - frame;
+        }
+    }
+    if (_self->activeCue != NO_CUE) {
+        const uint8_t *frames = _getPreloadedFrames(_self, frame, frameCount);
+        if (frames != NULL) return frames;
+    }
+    if (frame >= _self->dataFrameCount && _self->segmentCount > 0) {
+        return _getSegmentFrames(_self, frame, frameCount);
+    }
+    if (_self->replacement.buffer != NULL) {
+        return _self->replacement.frames + (size_t)frame * _self->riffData.blockAlign;
+    }
+    if (_self->decoder != NULL) {
+        return _decodeFrames(_self, frame, frameCount);
+    }
+    if (_self->loader == NULL || _self->loader->stream == NULL) {
+        return _self->riffData.data + (size_t)frame * _self->riffData.blockAlign;
+    }
+    uint32_t streamFrameCount = *frameCount;
+    const uint8_t *frames = streamGetFrames(
+        _self->loader->stream, frame, &streamFrameCount
+    );
+    *frameCount = streamFrameCount;
+    return frames;
+}
+
+const uint8_t * _getNextFrames(
+    _AudioObject *_self, uint32_t *frame, snd_pcm_uframes_t *frameCount
+) {
+    // Like _getFrameData() but moves frame behind the frames. At the end of
+    // a loop that is played again it goes back to the start of the loop.
+    const AudioLoopRegion *loop = &_self->loop;
+    bool isLoopPending = _isLoopPending(_self, *frame);
+    uint32_t runEnd = _getRunEnd(_self, *frame);
+    if (*frameCount > runEnd - *frame) *frameCount = runEnd - *frame;
+    const uint8_t *frames = _getFrameData(_self, *frame, frameCount);
+    *frame += *frameCount;
+    if (isLoopPending && *frame == loop->endFrame) {
+        *frame = loop->startFrame;
+        ++_self->loopsWritten;
+    }
+    return frames;
+}
+
+const uint8_t * _gatherFrames(
+    _AudioObject *_self, uint32_t *frame, snd_pcm_uframes_t *frameCount
+) {
+    // The frames on both sides of the end of a loop or a segment are
+    // copied behind each other, so crossing it costs no extra write.
+    size_t frameSize = _self->decoder != NULL 
+        ? _self->decoder->frameSize 
+        : _self->riffData.blockAlign;
+    uint8_t *gatheredFrames = _self->gatherFrames;
+    if (*frameCount > _self->alsaBufferSize) *frameCount = _self->alsaBufferSize;
+    snd_pcm_uframes_t gatheredFrameCount = 0;
+    while (gatheredFrameCount < *frameCount) {
+        snd_pcm_uframes_t count = *frameCount - gatheredFrameCount;
+        const uint8_t *frames = _getNextFrames(_self, frame, &count);
+        if (count == 0) break;
+        memcpy(
+            gatheredFrames + (size_t)gatheredFrameCount * frameSize, frames, 
+            (size_t)count * frameSize
+        );
+        gatheredFrameCount += count;
+    }
+    *frameCount = gatheredFrameCount;
+    return gatheredFrames;
+}
+
+bool _isStableFrames(
+    _AudioObject *_self, const uint8_t *frames, snd_pcm_uframes_t frameCount
+) {
+    // Frames in a read-only mapping of the library never change, so an
+    // output may reference them instead of copying them.
+    const uint8_t *mapping = NULL;
+    size_t mappingSize = 0;
+    if (
+        _self->loader != NULL && _self->loader->stream == NULL 
+        && _self->loader->mapping != NULL
+    ) {
+        mapping = _self->loader->mapping;
+        mappingSize = _self->loader->mappingSize;
+    } else if (_self->buffer != NULL && _self->buffer->isMapped) {
+        mapping = _self->buffer->data;
+        mappingSize = _self->buffer->size;
+    }
+    return mapping != NULL && frames >= mapping 
+        && frames + (size_t)frameCount * _self->riffData.blockAlign <= mapping + mappingSize;
+}
+
+const uint8_t * _applyGain(
+    _AudioObject *_self, const uint8_t *frames, snd_pcm_uframes_t *frameCount
+) {
+    // The frames are scaled into gainFrames, which holds an ALSA buffer,
+    // so the caller fetches no more frames than that.
+    size_t sampleCount = (size_t)*frameCount * _self->riffData.channelAmount;
+    float gain = _self->gain;
+    uint8_t *gainFrames = _self->gainFrames;
+    switch (_self->format) {
+        case SND_PCM_FORMAT_U8:
+            for (size_t i = 0; i < sampleCount; ++i) {
+                float sample = ((float)frames[i] - 128.0f) * gain;
+                sample = sample > INT8_MAX ? INT8_MAX : sample < INT8_MIN ? INT8_MIN : sample;
+                gainFrames[i] = (uint8_t)(lrintf(sample) + 128);
+            }
+            break;
+
+        case SND_PCM_FORMAT_S16_LE:
+            for (size_t i = 0; i < sampleCount; ++i) {
+                float sample = ((const int16_t*)frames)[i] * gain;
+                sample = sample > INT16_MAX ? INT16_MAX : sample < INT16_MIN ? INT16_MIN : sample;
+                ((int16_t*)gainFrames)[i] = (int16_t)lrintf(sample);
+            }
+            break;
+
+        case SND_PCM_FORMAT_S24_3LE:
+            for (size_t i = 0; i < sampleCount; ++i) {
+                const uint8_t *bytes = frames + i * 3;
+                int32_t unscaled = (int32_t)(
+                    ((uint32_t)bytes[0] << 8) 
+                    | ((uint32_t)bytes[1] << 16) 
+                    | ((uint32_t)bytes[2] << 24)
+                ) >> 8;
+                float sample = unscaled * gain;
+                int32_t scaled = (int32_t)lrintf(
+                    sample > 0x7FFFFF ? 0x7FFFFF : sample < -0x800000 ? -0x800000 : sample
+                );
+                gainFrames[i * 3] = scaled & 0xFF;
+                gainFrames[i * 3 + 1] = (scaled >> 8) & 0xFF;
+                gainFrames[i * 3 + 2] = (scaled >> 16) & 0xFF;
+            }
+            break;
+
+        case SND_PCM_FORMAT_S32_LE:
+            for (size_t i = 0; i < sampleCount; ++i) {
+                double sample = ((const int32_t*)frames)[i] * (double)gain;
+                sample = sample > INT32_MAX ? INT32_MAX : sample < INT32_MIN ? INT32_MIN : sample;
+                ((int32_t*)gainFrames)[i] = (int32_t)llrint(sample);
+            }
+            break;
+
+        case SND_PCM_FORMAT_FLOAT_LE:
+            for (size_t i = 0; i < sampleCount; ++i) {
+                ((float*)gainFrames)[i] = ((const float*)frames)[i] * gain;
+            }
+            break;
+
+        case SND_PCM_FORMAT_FLOAT64_LE:
+            for (size_t i = 0; i < sampleCount; ++i) {
+                ((double*)gainFrames)[i] = ((const double*)frames)[i] * gain;
+            }
+            break;
+
+        default:
+            // Companded samples are written as they are.
+            return frames;
+    }
+    return gainFrames;
+}
+
+double _loadSample(snd_pcm_format_t format, const uint8_t *bytes) {
+    // The samples of decoded or gained frames may not be aligned.
+    switch (format) {
+        case SND_PCM_FORMAT_U8:
+            return (double)bytes[0] - 128.0;
+
+        case SND_PCM_FORMAT_S16_LE: {
+            int16_t sample;
+            memcpy(&sample, bytes, sizeof(sample));
+            return sample;
+        }
+
+        case SND_PCM_FORMAT_S24_3LE:
+            return (int32_t)(
+                ((uint32_t)bytes[0] << 8) 
+                | ((uint32_t)bytes[1] << 16) 
+                | ((uint32_t)bytes[2] << 24)
+            ) >> 8;
+
+        case SND_PCM_FORMAT_S32_LE: {
+            int32_t sample;
+            memcpy(&sample, bytes, sizeof(sample));
+            return sample;
+        }
+
+        case SND_PCM_FORMAT_FLOAT_LE: {
+            float sample;
+            memcpy(&sample, bytes, sizeof(sample));
+            return sample;
+        }
+
+        default: {
+            double sample;
+            memcpy(&sample, bytes, sizeof(sample));
+            return sample;
+        }
+    }
+}
+
+void _storeSample(snd_pcm_format_t format, uint8_t *bytes, double sample) {
+    // Interpolated samples lie between two valid samples, so they are only
+    // rounded.
+    switch (format) {
+        case SND_PCM_FORMAT_U8:
+            bytes[0] = (uint8_t)(lrint(sample) + 128);
+            break;
+
+        case SND_PCM_FORMAT_S16_LE: {
+            int16_t rounded = (int16_t)lrint(sample);
+            memcpy(bytes, &rounded, sizeof(rounded));
+            break;
+        }
+
+        case SND_PCM_FORMAT_S24_3LE: {
+            int32_t rounded = (int32_t)lrint(sample);
+            bytes[0] = rounded & 0xFF;
+            bytes[1] = (rounded >> 8) & 0xFF;
+            bytes[2] = (rounded >> 16) & 0xFF;
+            break;
+        }
+
+        case SND_PCM_FORMAT_S32_LE: {
+            int32_t rounded = (int32_t)llrint(sample);
+            memcpy(bytes, &rounded, sizeof(rounded));
+            break;
+        }
+
+        case SND_PCM_FORMAT_FLOAT_LE: {
+            float narrowed = (float)sample;
+            memcpy(bytes, &narrowed, sizeof(narrowed));
+            break;
+        }
+
+        default:
+            memcpy(bytes, &sample, sizeof(sample));
+            break;
+    }
+}
+
+void _fadeIntoReplacement(_AudioObject *_self, const AudioSegment *replacement) {
+    // The frames of the replaced audio data fade linearly into the new
+    // ones, starting at the next frame that is written.
+    uint32_t frame = _self->currentFrame;
+    uint32_t frameCount = _self->pendingFadeFrameCount;
+    if (frame >= _self->dataFrameCount || frame >= replacement->frameCount) return;
+    if (frameCount > _self->dataFrameCount - frame) {
+        frameCount = _self->dataFrameCount - frame;
+    }
+    if (frameCount > replacement->frameCount - frame) {
+        frameCount = replacement->frameCount - frame;
+    }
+    size_t frameSize = _self->riffData.blockAlign;
+    size_t sampleSize = snd_pcm_format_physical_width(_self->format) / BITS_PER_BYTE;
+    uint16_t channelAmount = _self->riffData.channelAmount;
+    const uint8_t *newFrames = replacement->frames + (size_t)frame * frameSize;
+    uint32_t fadedFrameCount = 0;
+    while (fadedFrameCount < frameCount) {
+        // Streamed frames may come in several parts or run out.
+        snd_pcm_uframes_t count = frameCount - fadedFrameCount;
+        const uint8_t *oldFrames = _getFrameData(_self, frame + fadedFrameCount, &count);
+        if (count == 0) break;
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t fadeIndex = fadedFrameCount + i;
+            double weight = (fadeIndex + 1.0) / (frameCount + 1.0);
+            for (uint16_t channel = 0; channel < channelAmount; ++channel) {
+                size_t offset = (size_t)fadeIndex * frameSize + channel * sampleSize;
+                double sample = _loadSample(_self->format, oldFrames + i * frameSize + channel * sampleSize) 
+                    * (1.0 - weight) 
+                    + _loadSample(_self->format, newFrames + offset) * weight;
+                _storeSample(_self->format, _self->pendingFadeFrames + offset, sample);
+            }
+        }
+        fadedFrameCount += count;
+    }
+    _self->fadeFrame = frame;
+    _self->fadeFrameCount = fadedFrameCount;
+}
+
+void _swapData(_AudioObject *_self) {
+    // The user thread releases the replacement and frees the fade handed
+    // back. The playback stays at the current frame, the frames already
+    // in the buffer of the sound device are played first.
+    _self->replaceFlag = false;
+    _self->fadeFrameCount = 0;
+    if (_self->pendingFadeFrames != NULL) {
+        _fadeIntoReplacement(_self, &_self->pendingReplacement);
+    }
+    uint8_t *fadeFrames = _self->fadeFrames;
+    _self->fadeFrames = _self->pendingFadeFrames;
+    _self->pendingFadeFrames = fadeFrames;
+    AudioSegment replacement = _self->replacement;
+    _self->replacement = _self->pendingReplacement;
+    _self->pendingReplacement = replacement;
+
+    // The segments move with the end of the audio data. A loop is only
+    // kept within the new data and without the crossfade computed from the
+    // replaced data.
+    uint32_t dataFrameCount = _self->replacement.frameCount;
+    for (uint32_t i = 0; i < _self->segmentCount; ++i) {
+        _self->segments[i].startFrame = _self->segments[i].startFrame 
+            - _self->dataFrameCount + dataFrameCount;
+    }
+    _self->lastFrame = _self->lastFrame - _self->dataFrameCount + dataFrameCount;
+    _self->dataFrameCount = dataFrameCount;
+    _self->loop.seamFrameCount = 0;
+    if (_self->loop.endFrame > dataFrameCount) _self->loop.endFrame = 0;
+
+    // The preloaded frames belong to the replaced data. Their mapping is
+    // kept for the user thread to unmap.
+    _self->activeCue = NO_CUE;
+    _self->cuePreload.frameCount = 0;
+    if (_self->currentFrame > _self->lastFrame) _self->currentFrame = _self->lastFrame;
+}
+
+snd_pcm_uframes_t _resampleFrames(
+    _AudioObject *_self, AudioDevice *device, const uint8_t *frames, 
+    snd_pcm_uframes_t frameCount
+) {
+    // Frame i of frames follows history at position i + 1. Every written
+    // frame is interpolated between the frames around its position.
+    // Companded samples take the nearer frame instead.
+    uint16_t channelAmount = _self->riffData.channelAmount;
+    size_t sampleSize = snd_pcm_format_physical_width(_self->format) 
+        / BITS_PER_BYTE;
+    size_t frameSize = sampleSize * channelAmount;
+    bool isCompanded = _self->format == SND_PCM_FORMAT_A_LAW 
+        || _self->format == SND_PCM_FORMAT_MU_LAW;
+    if (!device->hasHistory) {
+        // The first frame is written as it is.
+        memcpy(device->history, frames, frameSize);
+        device->hasHistory = true;
+        device->phase = 1.0;
+    }
+
+    double position = device->phase;
+    snd_pcm_uframes_t framesWritten = 0;
+    while (position < frameCount) {
+        size_t index = (size_t)position;
+        double fraction = position - index;
+        const uint8_t *before = index == 0 
+            ? device->history 
+            : frames + (index - 1) * frameSize;
+        const uint8_t *after = frames + index * frameSize;
+        uint8_t *frame = device->frames + framesWritten * frameSize;
+        if (isCompanded) {
+            memcpy(frame, fraction < 0.5 ? before : after, frameSize);
+        } else {
+            for (size_t offset = 0; offset < frameSize; offset += sampleSize) {
+                double first = _loadSample(_self->format, before + offset);
+                double second = _loadSample(_self->format, after + offset);
+                _storeSample(
+                    _self->format, frame + offset, 
+                    first + (second - first) * fraction
+                );
+            }
+        }
+        ++framesWritten;
+        position += device->step;
+    }
+    device->phase = position - frameCount;
+    memcpy(device->history, frames + (frameCount - 1) * frameSize, frameSize);
+    return framesWritten;
+}
+
+bool _limitFramesToDevices(
+    _AudioObject *_self, snd_pcm_uframes_t *framesAvailable
+) {
+    // Every device has to take its frames without blocking, as a device
+    // that waits for snd_pcm_start() never frees room. Returns false if a
+    // device ran out of frames.
+    for (uint32_t i = 0; i < _self->deviceCount; ++i) {
+        AudioDevice *device = &_self->devices[i];
+        snd_pcm_sframes_t deviceFramesAvailable = backendAvail(device->output);
+        if (deviceFramesAvailable < 0) return false;
+        // The resampler writes at most one frame more than frames / step.
+        double frames = floor(deviceFramesAvailable * device->step) - 1.0;
+        if (frames < *framesAvailable) {
+            *framesAvailable = frames > 0.0 ? (snd_pcm_uframes_t)frames : 0;
+        }
+    }
+    return true;
+}
+
+bool _writeToDevices(
+    _AudioObject *_self, const uint8_t *frames, snd_pcm_uframes_t frameCount
+) {
+    // Returns false if a device ran out of frames.
+    bool isAligned = true;
+    for (uint32_t i = 0; i < _self->deviceCount; ++i) {
+        AudioDevice *device = &_self->devices[i];
+        const uint8_t *deviceFrames = frames;
+        snd_pcm_uframes_t deviceFrameCount = frameCount;
+        if (!device->isLinked) {
+            deviceFrameCount = _resampleFrames(_self, device, frames, frameCount);
+            deviceFrames = device->frames;
+        }
+        _trace(_self, TRACE_WRITE_BEGIN, i + 1, deviceFrameCount);
+        snd_pcm_sframes_t framesWritten = backendWrite(
+            device->output, deviceFrames, deviceFrameCount
+        );
+        _trace(_self, TRACE_WRITE_END, i + 1, framesWritten);
+        if (framesWritten < 0) {
+            if (framesWritten != -EPIPE) _postAlsaError(_self, framesWritten);
+            isAligned = false;
+        } else {
+            device->clock.writtenFrames += framesWritten;
+        }
+    }
+    return isAligned;
+}
+
+snd_pcm_uframes_t _getFramesToWrite(
+    _AudioObject *_self, snd_pcm_uframes_t framesAvailable, bool *endReached
+) {
+    // Compute the actual amount of frames to be written considering 
+    // possible overrun. The passes of the loop that are still played lie
+    // in front of the end.
+    *endReached = false;
+    uint64_t framesLeft = _self->lastFrame - _self->currentFrame;
+    const AudioLoopRegion *loop = &_self->loop;
+    if (_isLoopPending(_self, _self->currentFrame)) {
+        if (loop->count == 0) return framesAvailable;
+        framesLeft += (uint64_t)(loop->count - 1 - _self->loopsWritten) 
+            * (loop->endFrame - loop->startFrame);
+    }
+    if (framesAvailable > framesLeft) {
+        *endReached = true;
+        return framesLeft;
+    }
+    return framesAvailable;
+}
+
+void * _mainloop(void *self) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _self->isPaused = true;
+
+    // Remember the page faults taken before playback started.
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+        _self->lastMajorFaultCount = usage.ru_majflt;
+        _self->lastMinorFaultCount = usage.ru_minflt;
+    }
+
+    while (!_self->haltFlag) {
+        // Handle set command flags.
+        if (_self->playFlag) {
+            _play(_self);
+            _waitForBarriers(_self, TRACE_ACTION_PLAY);
+        } else if (_self->pauseFlag) {
+            _pause(_self);
+            _waitForBarriers(_self, TRACE_ACTION_PAUSE);
+        } else if (_self->stopFlag) {
+            _stop(_self);
+            _waitForBarriers(_self, TRACE_ACTION_STOP);
+        } else if (_self->jumpFlag) {
+            _jump(_self);
+            _waitForBarriers(_self, TRACE_ACTION_JUMP);
+        } else if (_self->cuePreloadFlag) {
+            _swapCuePreload(_self);
+            _waitForBarriers(_self, TRACE_ACTION_CUE_PRELOAD);
+        } else if (_self->gainFlag) {
+            _self->gain = _self->pendingGain;
+            _self->gainFlag = false;
+            _waitForBarriers(_self, TRACE_ACTION_GAIN);
+        } else if (_self->addDeviceFlag) {
+            _addDevice(_self);
+            _waitForBarriers(_self, TRACE_ACTION_ADD_DEVICE);
+        } else if (_self->markerFlag) {
+            _swapMarkers(_self);
+            _waitForBarriers(_self, TRACE_ACTION_MARKERS);
+        } else if (_self->traceFlag) {
+            _swapTrace(_self);
+            _waitForBarriers(_self, TRACE_ACTION_TRACING);
+        } else if (_self->loopFlag) {
+            _swapLoop(_self);
+            _waitForBarriers(_self, TRACE_ACTION_LOOP);
+        } else if (_self->segmentFlag) {
+            _swapSegments(_self);
+            _waitForBarriers(_self, TRACE_ACTION_SEGMENTS);
+        } else if (_self->replaceFlag) {
+            _swapData(_self);
+            _waitForBarriers(_self, TRACE_ACTION_REPLACE);
+        }
+
+        // Wait a bit and if paused don't do anything.
+        backendSleep(_self->output, _self->timeResolution * MICROSECONDS_PER_MILLISECOND);
+        statsAdd(&_self->counters.wakeups, 1);
+        _trace(_self, TRACE_WAKEUP, 0, 0);
+        if (_self->isPaused) continue;
+
+        // Determine how many frames could be written. All devices start
+        // over if one of them ran out of frames.
+        snd_pcm_uframes_t framesAvailable = _getFramesAvailable(_self);
+        if (!_limitFramesToDevices(_self, &framesAvailable)) {
+            _postXrun(_self);
+            _restartDevices(_self);
+            continue;
+        }
+
+        // If buffer is half empty write frames
+        if (framesAvailable > HALF(_self->alsaBufferSize)) {
+            struct timespec refillStart;
+            backendGetTime(_self->output, &refillStart);
+
+            // Determine the amount of frames to write and check if
+            // the end is reached afterwards.
+            bool endReached = false;
+            snd_pcm_uframes_t framesToWrite = _getFramesToWrite(
+                _self, framesAvailable, &endReached
+            );
+
+            // Write the frames. Streamed data might be split into blocks
+            // or not be read yet.
+            bool isAligned = true;
+            bool isXrun = false;
+            bool isFailed = false;
+            snd_pcm_uframes_t framesWritten = 0;
+            uint32_t frame = _self->currentFrame;
+            uint32_t loopsWritten = _self->loopsWritten;
+            while (framesWritten < framesToWrite) {
+                snd_pcm_uframes_t frameCount = framesToWrite - framesWritten;
+                if (_self->gain != 1.0f && frameCount > _self->alsaBufferSize) {
+                    frameCount = _self->alsaBufferSize;
+                }
+                const uint8_t *frames = frameCount > _getRunEnd(_self, frame) - frame
+                    ? _gatherFrames(_self, &frame, &frameCount)
+                    : _getNextFrames(_self, &frame, &frameCount);
+                if (frameCount == 0) break;
+                if (_self->gain != 1.0f) {
+                    frames = _applyGain(_self, frames, &frameCount);
+                }
+                _trace(_self, TRACE_WRITE_BEGIN, 0, frameCount);
+                snd_pcm_sframes_t result = _isStableFrames(_self, frames, frameCount)
+                    ? backendWriteStable(_self->output, frames, frameCount)
+                    : backendWrite(_self->output, frames, frameCount);
+                _trace(_self, TRACE_WRITE_END, 0, result);
+                snd_pcm_uframes_t writtenCount = frameCount;
+                if (result == -EPIPE) {
+                    _trace(_self, TRACE_PREPARE, 0, 0);
+                    backendPrepare(_self->output);
+                    _resetClock(&_self->clock);
+                    isAligned = _self->deviceCount == 0;
+                    isXrun = true;
+                } else if (result < 0) {
+                    // Interrupted writes are tried again with the next
+                    // refill, other errors pause the playback.
+                    writtenCount = 0;
+                    if (result != -EINTR && result != -EAGAIN) {
+                        _postAlsaError(_self, result);
+                        isFailed = true;
+                    }
+                } else {
+                    writtenCount = result;
+                    _self->clock.writtenFrames += writtenCount;
+                }
+
+                // The playhead only moves by the frames that were written.
+                if (writtenCount < frameCount) {
+                    frame = _rewindFrame(
+                        _self, frame, &_self->loopsWritten, frameCount - writtenCount
+                    );
+                }
+                if (writtenCount > 0 && !_writeToDevices(_self, frames, writtenCount)) {
+                    isAligned = false;
+                    isXrun = true;
+                }
+                framesWritten += writtenCount;
+                if (writtenCount < frameCount) break;
+            }
+            _accountPageFaults(_self, framesWritten);
+            statsAdd(&_self->counters.refills, 1);
+            statsAdd(&_self->counters.framesWritten, framesWritten);
+            statsRecord(&_self->counters.refill, _getMicrosecondsSince(_self, &refillStart));
+            if (isXrun) _postXrun(_self);
+            if (framesWritten < framesToWrite && !_checkStream(_self)) {
+                _stop(_self);
+                continue;
+            }
+            if (isFailed) {
+                _self->currentFrame = frame;
+                _pause(_self);
+                continue;
+            }
+
+            // Stop if end is reached.
+            if (endReached && framesWritten == framesToWrite) {
+                _postHeardMarkers(
+                    _self, (uint64_t)_self->lastFrame + 1, _self->loopsWritten
+                );
+                _postEvent(_self, (AudioEvent){
+                    .type = AUDIO_EVENT_END_REACHED, .frame = _self->lastFrame
+                });
+                _stop(_self);
+            } else if (!isAligned) {
+                _self->currentFrame = frame;
+                _restartDevices(_self);
+            } else {
+                _self->currentFrame = frame;
+                if (frame - _self->fadeFrame >= _self->fadeFrameCount) {
+                    // The fade is written.
+                    _self->fadeFrameCount = 0;
+                }
+                _signalLoader(_self, _self->loopsWritten != loopsWritten);
+                if (_self->deviceCount > 0) _startDevices(_self);
+            }
+        }
+        if (_self->isPlaying) {
+            _measureDevices(_self);
+            uint32_t loops;
+            uint32_t frame = _getAudibleFrame(_self, &loops);
+            _postHeardMarkers(_self, frame, loops);
+        }
+    }
+
+    pthread_exit(NULL);
+    return NULL;
+}
+
+bool _readFactCunk(_AudioObject *_self, AudioFactChunk *factChunk) {
+    if (memcmp(factChunk->factMagic, FACT_MAGIC, MAGIC_SIZE)) {
+        _self->error->type = AUDIO_ERROR_INVALID_FACT_MAGIC_NUMBER;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    if (factChunk->factSize != 4) {
+        _self->error->type = AUDIO_ERROR_INVALID_FACT_SIZE;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    // The fact chunk contains the amount of samples per channel
+    _self->riffData.samplesPerChannel = factChunk->samplesPerChannel;
+    return true;
+}
+
+bool _readNonPcmFmtChunkExtension(
+    _AudioObject *_self, AudioNonPcmFmtChunkExtension *nonPcmExtension
+) {
+    // non-PCM extensions that are not extensible have size 0
+    if (nonPcmExtension->extraSize != 0) {
+        _self->error->type = AUDIO_ERROR_INVALID_NON_PCM_EXTENSION_SIZE;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    // every non-PCM extension must have a fact chunk
+    AudioFactChunk *factChunk = (AudioFactChunk*)(
+        (uint8_t*)nonPcmExtension + sizeof(AudioNonPcmFmtChunkExtension)
+    );
+    if (!_readFactCunk(_self, factChunk)) {
+        return false;
+    }
+    return true;
+}
+
+bool _readExtensibleFmtChunkExtension(
+    _AudioObject *_self, AudioExtensibleFmtChunkExtension *extensibleExtension
+) {
+    // extensible fmt extensions have a fixed size
+    if (
+        extensibleExtension->extraSize 
+        != EXTENSIBLE_FMT_CHUNK_EXTRA_SIZE
+    ) {
+        _self->error->type = AUDIO_ERROR_INVALID_EXTENSIBLE_EXTENSION_SIZE;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    // the extension conatains the actual audio format
+    switch (extensibleExtension->audioFormat) {
+        case WAVE_FORMAT_PCM:
+        case WAVE_FORMAT_IEEE_FLOAT:
+        case WAVE_FORMAT_ALAW:
+        case WAVE_FORMAT_MULAW:
+            _self->riffData.format = extensibleExtension->audioFormat;
+            break;
+        default:
+            _self->error->type = AUDIO_ERROR_INVALID_EXTENSIBLE_AUDIO_FORMAT;
+            _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return false;
+    }
+    // There is a fixed guid in the extension
+    if (memcmp(
+        extensibleExtension->guid, EXTENSIBLE_GUID, EXTENSIBLE_GUID_SIZE
+    )) {
+        _self->error->type = AUDIO_ERROR_INVALID_EXTENSIBLE_GUID;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    // The channel mask is used to map channels to speakers
+    _self->riffData.channelMap = extensibleExtension->channelMask;
+    // Every extensible fmt chunk must have a fact chunk
+    AudioFactChunk *factChunk = (AudioFactChunk*)(
+        (uint8_t*)extensibleExtension 
+        + sizeof(AudioExtensibleFmtChunkExtension)
+    );
+    if (!_readFactCunk(_self, factChunk)) {
+        return false;
+    }
+    return true;
+}
+
+bool _readAdpcmFmtChunkExtension(
+    _AudioObject *_self, AudioFmtChunk *fmtChunk
+) {
+    AudioAdpcmFmtChunkExtension *adpcmExtension = 
+    (AudioAdpcmFmtChunkExtension*)(
+        (uint8_t*)fmtChunk + sizeof(AudioFmtChunk)
+    );
+    if (fmtChunk->bitsPerSample != ADPCM_BITS_PER_SAMPLE) {
+        _self->error->type = AUDIO_UNSUPPORTED_BITS_PER_SAMPLE;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+
+    // The extension and the fmt chunk must cover each other before
+    // anything behind extraSize is read.
+    if (
+        fmtChunk->fmtSize 
+        != FMT_CHUNK_SIZE_NON_PCM - FMT_CHUNK_SIZE_OFFSET + adpcmExtension->extraSize
+    ) {
+        _self->error->type = AUDIO_ERROR_INVALID_FMT_SIZE;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    if (adpcmExtension->extraSize < IMA_ADPCM_EXTRA_SIZE) {
+        _self->error->type = AUDIO_ERROR_INVALID_NON_PCM_EXTENSION_SIZE;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+
+    AdpcmFormat format = {
+        .variant = fmtChunk->audioFormat == WAVE_FORMAT_IMA_ADPCM
+            ? ADPCM_VARIANT_IMA
+            : ADPCM_VARIANT_MS,
+        .channelAmount = fmtChunk->numChannels,
+        .blockAlign = fmtChunk->blockAlign,
+        .framesPerBlock = adpcmExtension->samplesPerBlock
+    };
+
+    // IMA ADPCM only stores the samples per block, MS ADPCM additionally
+    // the predictor coefficients. Their count is only read once the
+    // extension covers it and the table once the extension covers that.
+    size_t expectedExtraSize = IMA_ADPCM_EXTRA_SIZE;
+    const int16_t *coefficients = NULL;
+    if (format.variant == ADPCM_VARIANT_MS) {
+        uint16_t *coefficientCount = (uint16_t*)(adpcmExtension + 1);
+        coefficients = (int16_t*)(coefficientCount + 1);
+        if (
+            adpcmExtension->extraSize < MS_ADPCM_EXTRA_SIZE
+            || *coefficientCount == 0 
+            || *coefficientCount > ADPCM_MAX_COEFFICIENTS
+        ) {
+            _self->error->type = AUDIO_ERROR_INVALID_NON_PCM_EXTENSION_SIZE;
+            _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return false;
+        }
+        format.coefficientCount = *coefficientCount;
+        expectedExtraSize = MS_ADPCM_EXTRA_SIZE 
+            + format.coefficientCount * MS_ADPCM_COEFFICIENT_SIZE;
+    }
+    if (adpcmExtension->extraSize != expectedExtraSize) {
+        _self->error->type = AUDIO_ERROR_INVALID_NON_PCM_EXTENSION_SIZE;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    if (coefficients != NULL) {
+        memcpy(
+            format.coefficients, coefficients, 
+            format.coefficientCount * MS_ADPCM_COEFFICIENT_SIZE
+        );
+    }
+
+    // Every block must decode to the same amount of frames.
+    if (
+        format.framesPerBlock == 0 
+        || format.framesPerBlock != adpcmGetBlockFrames(&format, format.blockAlign)
+    ) {
+        _self->error->type = AUDIO_ERROR_INVALID_BLOCK_ALIGN;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+
+    _self->decoder = (AudioDecoder*)calloc(1, sizeof(AudioDecoder));
+    if (_self->decoder == NULL) {
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    _self->decoder->format = format;
+    _self->decoder->decodedBlock = NO_DECODED_BLOCK;
+    _self->decoder->frameSize = format.channelAmount * sizeof(int16_t);
+    _self->decoder->frames = (uint8_t*)calloc(
+        format.framesPerBlock, _self->decoder->frameSize
+    );
+    if (_self->decoder->frames == NULL) {
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+
+    // every ADPCM file must have a fact chunk behind the fmt chunk
     AudioFactChunk *factChunk = (AudioFactChunk*)(
-        (uint8_t*)nonPcmExtension + sizeof(AudioNonPcmFmtChunkExtension)
+        (uint8_t*)fmtChunk + FMT_CHUNK_SIZE_OFFSET + fmtChunk->fmtSize
+    );
+    if (!_readFactCunk(_self, factChunk)) {
+        return false;
+    }
+    return true;
+}
+
+bool _readFmtChunk(_AudioObject *_self, AudioFmtChunk *fmtChunk) {
+    if (memcmp(fmtChunk->fmtMagic, FMT_MAGIC, MAGIC_SIZE)) {
+        _self->error->type = AUDIO_ERROR_IMVALID_FMT_MAGIC_NUMBER;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+
+    // Check if the fmt chunk has the right size
+    _self->riffData.format = fmtChunk->audioFormat;
+    size_t expectedFmtSize = 0;
+    switch (_self->riffData.format) {
+        case WAVE_FORMAT_PCM:
+            expectedFmtSize = FMT_CHUNK_SIZE_PCM - FMT_CHUNK_SIZE_OFFSET;
+            break;
+
+        case WAVE_FORMAT_IEEE_FLOAT:
+        case WAVE_FORMAT_ALAW:
+        case WAVE_FORMAT_MULAW:
+            expectedFmtSize = FMT_CHUNK_SIZE_NON_PCM - FMT_CHUNK_SIZE_OFFSET;
+            break;
+
+        case WAVE_FORMAT_EXTENSIBLE:
+            expectedFmtSize = FMT_CHUNK_SIZE_EXTENSIBLE - FMT_CHUNK_SIZE_OFFSET;
+            break;
+
+        case WAVE_FORMAT_ADPCM:
+        case WAVE_FORMAT_IMA_ADPCM:
+            // The size depends on the extension and is checked there.
+            expectedFmtSize = fmtChunk->fmtSize;
+            break;
+
+        default:
+            _self->error->type = AUDIO_ERROR_NO_PCM_FORMAT;
+            _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return false;
+    }
+    if (fmtChunk->fmtSize != expectedFmtSize) {
+        _self->error->type = AUDIO_ERROR_INVALID_FMT_SIZE;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+
+    // Read the fmt chunk extension based on the format
+    switch (_self->riffData.format) {
+        case WAVE_FORMAT_IEEE_FLOAT:
+        case WAVE_FORMAT_ALAW:
+        case WAVE_FORMAT_MULAW:
+            AudioNonPcmFmtChunkExtension *nonPcmExtension = 
+            (AudioNonPcmFmtChunkExtension*)(
+                (uint8_t*)fmtChunk + sizeof(AudioFmtChunk)
+            );
+            if (!_readNonPcmFmtChunkExtension(_self, nonPcmExtension)) {
+                return false;
+            }
+            break;
+
+        case WAVE_FORMAT_EXTENSIBLE:
+            AudioExtensibleFmtChunkExtension *extensibleExtension = 
+            (AudioExtensibleFmtChunkExtension*)(
+                (uint8_t*)fmtChunk + sizeof(AudioFmtChunk)
+            );
+            if (!_readExtensibleFmtChunkExtension(_self, extensibleExtension)) {
+                return false;
+            }
+            break;
+
+        case WAVE_FORMAT_ADPCM:
+        case WAVE_FORMAT_IMA_ADPCM:
+            if (!_readAdpcmFmtChunkExtension(_self, fmtChunk)) {
+                return false;
+            }
+            break;
+
+        case WAVE_FORMAT_PCM:
+            // PCM has no extension
+            break;
+    }
+
+    // Read the rest of the fmt chunk and check if all invariants hold true.
+    _self->riffData.channelAmount = fmtChunk->numChannels;
+    _self->riffData.channelAmount = fmtChunk->numChannels;
+    _self->riffData.sampleRate = fmtChunk->sampleRate;
+    _self->riffData.byteRate = fmtChunk->byteRate;
+    _self->riffData.blockAlign = fmtChunk->blockAlign;
+    _self->riffData.bitsPerSample = fmtChunk->bitsPerSample;
+    _self->riffData.framesPerBlock = 1;
+
+    // Compressed blocks were checked by the extension. Their byte rate is
+    // only an average.
+    if (_self->decoder != NULL) {
+        _self->riffData.framesPerBlock = _self->decoder->format.framesPerBlock;
+        return true;
+    }
+    if (
+        _self->riffData.byteRate 
+        != _self->riffData.sampleRate 
+            * _self->riffData.channelAmount 
+            * _self->riffData.bitsPerSample / BITS_PER_BYTE
+    ) {
+        _self->error->type = AUDIO_ERROR_INVALID_BYTE_RATE;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    if (
+        _self->riffData.blockAlign 
+        != _self->riffData.channelAmount 
+            * _self->riffData.bitsPerSample / BITS_PER_BYTE
+    ) {
+        _self->error->type = AUDIO_ERROR_INVALID_BLOCK_ALIGN;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    return true;
+}
+
+int _compareCues(const void *a, const void *b) {
+    const AudioCue *cueA = (const AudioCue*)a;
+    const AudioCue *cueB = (const AudioCue*)b;
+    if (cueA->frame != cueB->frame) return cueA->frame < cueB->frame ? -1 : 1;
+    return cueA->id < cueB->id ? -1 : cueA->id > cueB->id;
+}
+
+void _readCueLabels(
+    _AudioObject *_self, const uint8_t *list, size_t listSize, char *labels
+) {
+    // The labels are copied behind the cue points. labels[0] stays empty
+    // for cue points without a label.
+    size_t labelsSize = 1;
+    size_t offset = 0;
+    while (offset + sizeof(AudioChunkHeader) <= listSize) {
+        const AudioChunkHeader *header = (const AudioChunkHeader*)(list + offset);
+        size_t bodyOffset = offset + sizeof(AudioChunkHeader);
+        if (header->size > listSize - bodyOffset) break;
+        if (
+            !memcmp(header->magic, LABL_MAGIC, MAGIC_SIZE) 
+            && header->size >= sizeof(uint32_t)
+        ) {
+            uint32_t id;
+            memcpy(&id, list + bodyOffset, sizeof(uint32_t));
+            const char *text = (const char*)list + bodyOffset + sizeof(uint32_t);
+            size_t textSize = strnlen(text, header->size - sizeof(uint32_t));
+            for (uint32_t i = 0; i < _self->cueCount; ++i) {
+                if (_self->cues[i].id != id || _self->cues[i].label[0]) continue;
+                memcpy(labels + labelsSize, text, textSize);
+                labels[labelsSize + textSize] = '\0';
+                _self->cues[i].label = labels + labelsSize;
+                labelsSize += textSize + 1;
+                break;
+            }
+        }
+        offset = bodyOffset + header->size + (header->size & 1);
+    }
+}
+
+void _readSmplChunk(
+    _AudioObject *_self, const uint8_t *smplChunk, size_t smplChunkSize, 
+    uint64_t frameCount
+) {
+    // Only the first forward loop within the audio data is kept.
+    if (smplChunkSize < sizeof(AudioSmplChunk)) return;
+    uint32_t loopCount = ((const AudioSmplChunk*)smplChunk)->loopCount;
+    size_t maxLoopCount = (smplChunkSize - sizeof(AudioSmplChunk)) / sizeof(AudioSmplLoop);
+    if (loopCount > maxLoopCount) loopCount = maxLoopCount;
+    const AudioSmplLoop *loops = (const AudioSmplLoop*)(smplChunk + sizeof(AudioSmplChunk));
+    for (uint32_t i = 0; i < loopCount; ++i) {
+        if (
+            loops[i].type != SMPL_LOOP_FORWARD || loops[i].end < loops[i].start 
+            || loops[i].end >= frameCount
+        ) {
+            continue;
+        }
+        _self->fileLoop = (AudioLoop){
+            .startFrame = loops[i].start,
+            .endFrame = loops[i].end,
+            .count = loops[i].playCount
+        };
+        _self->hasFileLoop = true;
+        return;
+    }
+}
+
+bool _readCueChunks(
+    _AudioObject *_self, const uint8_t *rawData, size_t rawDataSize, 
+    size_t availableSize
+) {
+    // Walk the chunks for the cue chunk, the associated data list and the
+    // smpl chunk. Only chunks among the first availableSize bytes are
+    // found. Malformed chunks end the search, they never fail reading the
+    // file.
+    size_t size = rawDataSize < availableSize ? rawDataSize : availableSize;
+    const uint8_t *cueChunk = NULL;
+    const uint8_t *list = NULL;
+    const uint8_t *smplChunk = NULL;
+    size_t cueChunkSize = 0;
+    size_t listSize = 0;
+    size_t smplChunkSize = 0;
+    size_t offset = sizeof(AudioRiffHeader);
+    while (offset + sizeof(AudioChunkHeader) <= size) {
+        const AudioChunkHeader *header = (const AudioChunkHeader*)(rawData + offset);
+        size_t bodyOffset = offset + sizeof(AudioChunkHeader);
+        if (header->size > size - bodyOffset) break;
+        if (!memcmp(header->magic, CUE_MAGIC, MAGIC_SIZE)) {
+            cueChunk = rawData + bodyOffset;
+            cueChunkSize = header->size;
+        } else if (
+            !memcmp(header->magic, LIST_MAGIC, MAGIC_SIZE) 
+            && header->size >= MAGIC_SIZE 
+            && !memcmp(rawData + bodyOffset, ADTL_MAGIC, MAGIC_SIZE)
+        ) {
+            list = rawData + bodyOffset + MAGIC_SIZE;
+            listSize = header->size - MAGIC_SIZE;
+        } else if (!memcmp(header->magic, SMPL_MAGIC, MAGIC_SIZE)) {
+            smplChunk = rawData + bodyOffset;
+            smplChunkSize = header->size;
+        }
+        offset = bodyOffset + header->size + (header->size & 1);
+    }
+    uint64_t frameCount = _self->decoder != NULL 
+        ? _self->riffData.samplesPerChannel 
+        : _self->riffData.dataSize / _self->riffData.blockAlign;
+    if (smplChunk != NULL) _readSmplChunk(_self, smplChunk, smplChunkSize, frameCount);
+    if (cueChunk == NULL || cueChunkSize < sizeof(uint32_t)) return true;
+
+    uint32_t pointCount;
+    memcpy(&pointCount, cueChunk, sizeof(uint32_t));
+    if (pointCount > (cueChunkSize - sizeof(uint32_t)) / sizeof(AudioCuePoint)) {
+        pointCount = (cueChunkSize - sizeof(uint32_t)) / sizeof(AudioCuePoint);
+    }
+    if (pointCount == 0) return true;
+
+    // One allocation holds the cue points and their labels.
+    _self->cuesSize = pointCount * sizeof(AudioCue) + 1 + listSize;
+    _self->cues = (AudioCue*)malloc(_self->cuesSize);
+    if (_self->cues == NULL) {
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    char *labels = (char*)(_self->cues + pointCount);
+    labels[0] = '\0';
+    const AudioCuePoint *points = (const AudioCuePoint*)(cueChunk + sizeof(uint32_t));
+    for (uint32_t i = 0; i < pointCount; ++i) {
+        // Cue points outside of the audio data are dropped.
+        if (points[i].sampleOffset >= frameCount) continue;
+        AudioCue *cue = &_self->cues[_self->cueCount++];
+        cue->id = points[i].id;
+        cue->frame = points[i].sampleOffset;
+        cue->milliseconds = (uint64_t)cue->frame * MILLISECONDS_PER_SECOND 
+            / _self->riffData.sampleRate;
+        cue->label = labels;
+    }
+    if (list != NULL) _readCueLabels(_self, list, listSize, labels);
+    qsort(_self->cues, _self->cueCount, sizeof(AudioCue), _compareCues);
+    return true;
+}
+
+bool _readRiffFile(
+    _AudioObject *_self, void *rawData, size_t rawDataSize, size_t availableSize
+) {
+    // Read entire WAV file and check if all invariants hold true. Only the
+    // first availableSize bytes of rawData are in memory. The data chunk
+    // header must be among them.
+
+    // check RIFF header
+    AudioRiffHeader *riffHeader = (AudioRiffHeader*)rawData;
+    if (memcmp(riffHeader->riffMagic, RIFF_MAGIC, MAGIC_SIZE)) {
+        _self->error->type = AUDIO_ERROR_INVALID_RIFF_MAGIC_NUMBER;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    if (memcmp(riffHeader->waveMagic, WAVE_MAGIC, MAGIC_SIZE)) {
+        _self->error->type = AUDIO_ERROR_INVALID_WAVE_MAGIC_NUMBER;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    if (
+        riffHeader->fileSize 
+        != rawDataSize - (riffHeader->waveMagic - (uint8_t*)riffHeader)
+    ) {
+        _self->error->type = AUDIO_ERROR_INVALID_FILE_SIZE;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+
+    // check and read fmt chunk
+    AudioFmtChunk *fmtChunk = (AudioFmtChunk*)(
+        (uint8_t*)rawData + sizeof(AudioRiffHeader)
+    );
+    if (!_readFmtChunk(_self, fmtChunk)) {
+        return false;
+    }
+
+    // look for begin of data chunk
+    size_t dataChunkOffset = sizeof(AudioRiffHeader) + sizeof(AudioFmtChunk);
+    while (memcmp(
+        (uint8_t*)rawData + dataChunkOffset, DATA_MAGIC, MAGIC_SIZE
+    )) {
+        dataChunkOffset++;
+        if (dataChunkOffset + sizeof(AudioDataChunk) > availableSize) {
+            _self->error->type = AUDIO_ERROR_DATA_CHUNK_NOT_FOUND;
+            _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return false;
+        }
+    }
+
+    // check and read data chunk
+    AudioDataChunk *dataChunk = (AudioDataChunk*)(
+        (uint8_t*)rawData + dataChunkOffset
+    );
+    if (memcmp(dataChunk->dataMagic, DATA_MAGIC, MAGIC_SIZE)) {
+        _self->error->type = AUDIO_ERROR_INVALID_DATA_MAGIC_NUMBER;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    _self->riffData.dataSize = dataChunk->dataSize;
+
+    // This fails if the data chunk is not the last chunk in the file.
+    // TODO: provide a proper check
+
+    // if (
+    //     _self->riffData.dataSize 
+    //     != rawDataSize 
+    //         - dataChunkOffset
+    //         - sizeof(AudioDataChunk)
+    //     ) {
+    //     _self->error->type = AUDIO_ERROR_INVALID_DATA_SIZE;
+    //     _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+    //     return false;
+    // }
+
+    // This is the pointer to the audio data itself. dataChunkOffset is
+    // already relative to the begin of the file.
+    _self->riffData.data = (uint8_t*)rawData 
+        + dataChunkOffset
+        + sizeof(AudioDataChunk);
+
+    if (!_readCueChunks(_self, rawData, rawDataSize, availableSize)) {
+        return false;
+    }
+
+    // Compute the length of the entire audio in milliseconds. For
+    // compressed data only the fact chunk knows it.
+    if (_self->decoder != NULL) {
+        _self->riffData.audioLength = _self->riffData.samplesPerChannel
+            * (uint64_t)MILLISECONDS_PER_SECOND
+            / _self->riffData.sampleRate;
+        return true;
+    }
+    _self->riffData.audioLength = _self->riffData.dataSize
+        * (uint64_t)MILLISECONDS_PER_SECOND 
+        / _self->riffData.byteRate;
+
+    // Check if the amount of samples per channel is correct
+    if (
+        _self->riffData.samplesPerChannel 
+        != (_self->riffData.sampleRate 
+            * (uint64_t)_self->riffData.audioLength) / MILLISECONDS_PER_SECOND
+        && _self->riffData.format != WAVE_FORMAT_PCM
+    ) {
+        _self->error->type = AUDIO_ERROR_INVALID_SAMPLES_PER_CHANNEL;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+
+    return true;
+}
+
+bool _readFlacFile(
+    _AudioObject *_self, void *rawData, size_t rawDataSize, size_t availableSize
+) {
+    // Read the metadata of a native FLAC file. The frames are decoded by a
+    // FLAC stream that is opened once the ALSA buffer size is known.
+    _self->decoder = (AudioDecoder*)calloc(1, sizeof(AudioDecoder));
+    if (_self->decoder == NULL) {
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    FlacInfo *info = &_self->decoder->flacInfo;
+    if (!flacReadInfo(rawData, rawDataSize, availableSize, info)) {
+        _self->error->type = AUDIO_ERROR_INVALID_FLAC_STREAM;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    // Frames are counted in 32 bits.
+    if (info->totalSamples > UINT32_MAX) {
+        _self->error->type = AUDIO_ERROR_INVALID_SAMPLES_PER_CHANNEL;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+
+    // The decoded frames are played like PCM. The data size and the byte
+    // rate describe the encoded frames, they only size the loader windows.
+    uint32_t sampleSize = flacGetSampleSize(info);
+    size_t dataSize = rawDataSize - info->firstFrameOffset;
+    _self->riffData.format = AUDIO_FORMAT_FLAC;
+    _self->riffData.channelAmount = info->channelAmount;
+    _self->riffData.sampleRate = info->sampleRate;
+    _self->riffData.bitsPerSample = sampleSize * BITS_PER_BYTE;
+    _self->riffData.blockAlign = info->channelAmount * sampleSize;
+    _self->riffData.framesPerBlock = 1;
+    _self->riffData.channelMap = 0;
+    _self->riffData.samplesPerChannel = info->totalSamples;
+    _self->riffData.dataSize = dataSize > UINT32_MAX ? UINT32_MAX : dataSize;
+    _self->riffData.byteRate = (uint64_t)_self->riffData.dataSize 
+        * info->sampleRate / info->totalSamples;
+    if (_self->riffData.byteRate == 0) _self->riffData.byteRate = 1;
+    _self->riffData.data = (uint8_t*)rawData + info->firstFrameOffset;
+    _self->riffData.audioLength = info->totalSamples 
+        * MILLISECONDS_PER_SECOND / info->sampleRate;
+    return true;
+}
+
+int32_t _readPcmSample(const uint8_t *bytes, uint16_t bytesPerSample) {
+    // Right justified and signed, 8 bit samples are unsigned in WAV files.
+    switch (bytesPerSample) {
+        case 1: return (int32_t)bytes[0] - 128;
+        case 2: return (int16_t)(bytes[0] | (bytes[1] << 8));
+        case 3:
+            return (int32_t)(
+                ((uint32_t)bytes[0] << 8) 
+                | ((uint32_t)bytes[1] << 16) 
+                | ((uint32_t)bytes[2] << 24)
+            ) >> 8;
+        default:
+            int32_t sample;
+            memcpy(&sample, bytes, sizeof(int32_t));
+            return sample;
+    }
+}
+
+int16_t _roundTo16Bit(int32_t sample, uint16_t bitsPerSample) {
+    if (bitsPerSample <= 16) {
+        return (int16_t)((uint32_t)sample << (16 - bitsPerSample));
+    }
+    uint32_t shift = bitsPerSample - 16;
+    int64_t rounded = ((int64_t)sample + (1 << (shift - 1))) >> shift;
+    return rounded > INT16_MAX ? INT16_MAX : (int16_t)rounded;
+}
+
+bool _compactLossless(_AudioObject *_self, uint32_t frameCount) {
+    // The frames are encoded into FLAC frames of COMPACT_BLOCK_FRAMES
+    // frames. Their offsets are kept as seek points, so every block is
+    // found and decoded on its own like an ADPCM block.
+    AudioRiffData *riffData = &_self->riffData;
+    uint16_t channelAmount = riffData->channelAmount;
+    uint16_t bytesPerSample = riffData->bitsPerSample / BITS_PER_BYTE;
+    uint64_t blockCount = (frameCount + COMPACT_BLOCK_FRAMES - 1) 
+        / COMPACT_BLOCK_FRAMES;
+
+    _self->decoder = (AudioDecoder*)calloc(1, sizeof(AudioDecoder));
+    if (_self->decoder == NULL) {
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    FlacInfo *info = &_self->decoder->flacInfo;
+    info->totalSamples = frameCount;
+    info->sampleRate = riffData->sampleRate;
+    info->channelAmount = channelAmount;
+    info->bitsPerSample = riffData->bitsPerSample;
+    info->minBlockSize = COMPACT_BLOCK_FRAMES;
+    info->maxBlockSize = COMPACT_BLOCK_FRAMES;
+    info->seekPoints = (FlacSeekPoint*)malloc(
+        blockCount * sizeof(FlacSeekPoint)
+    );
+    size_t maxFrameSize = flacGetMaxEncodedSize(info, COMPACT_BLOCK_FRAMES);
+    size_t capacity = riffData->dataSize / 2 + maxFrameSize;
+    uint8_t *data = (uint8_t*)malloc(capacity);
+    int32_t *samples = (int32_t*)malloc(
+        (size_t)COMPACT_BLOCK_FRAMES * channelAmount * sizeof(int32_t)
+    );
+    int32_t *scratch = (int32_t*)malloc(
+        (size_t)COMPACT_BLOCK_FRAMES * (channelAmount + 4) * sizeof(int32_t)
+    );
+    _self->compactData = data;
+    bool isAllocated = info->seekPoints != NULL 
+        && data != NULL 
+        && samples != NULL 
+        && scratch != NULL;
+
+    size_t size = 0;
+    for (uint64_t block = 0; isAllocated && block < blockCount; ++block) {
+        if (size + maxFrameSize > capacity) {
+            capacity *= 2;
+            data = (uint8_t*)realloc(_self->compactData, capacity);
+            if (data == NULL) {
+                isAllocated = false;
+                break;
+            }
+            _self->compactData = data;
+        }
+        uint32_t firstFrame = block * COMPACT_BLOCK_FRAMES;
+        uint32_t blockFrames = frameCount - firstFrame < COMPACT_BLOCK_FRAMES 
+            ? frameCount - firstFrame 
+            : COMPACT_BLOCK_FRAMES;
+        const uint8_t *frames = riffData->data 
+            + (size_t)firstFrame * riffData->blockAlign;
+        for (size_t i = 0; i < (size_t)blockFrames * channelAmount; ++i) {
+            samples[i] = _readPcmSample(frames + i * bytesPerSample, bytesPerSample);
+        }
+        info->seekPoints[block].sample = firstFrame;
+        info->seekPoints[block].offset = size;
+        size_t frameSize = flacEncodeFrame(
+            info, samples, blockFrames, block, scratch, data + size
+        );
+        if (frameSize > info->maxFrameSize) info->maxFrameSize = frameSize;
+        size += frameSize;
+    }
+    free(samples);
+    free(scratch);
+    if (!isAllocated) {
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+
+    // Give back what the estimate reserved too much.
+    data = (uint8_t*)realloc(_self->compactData, size);
+    if (data != NULL) _self->compactData = data;
+    info->data = _self->compactData;
+    info->size = size;
+    info->seekPointCount = blockCount;
+
+    // The audio thread decodes one FLAC frame at a time.
+    uint32_t sampleSize = flacGetSampleSize(info);
+    AudioDecoder *decoder = _self->decoder;
+    decoder->decodedBlock = NO_DECODED_BLOCK;
+    decoder->frameSize = channelAmount * sampleSize;
+    decoder->frames = (uint8_t*)calloc(COMPACT_BLOCK_FRAMES, decoder->frameSize);
+    decoder->samples = (int32_t*)calloc(
+        (size_t)COMPACT_BLOCK_FRAMES * channelAmount, sizeof(int32_t)
+    );
+    if (decoder->frames == NULL || decoder->samples == NULL) {
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+
+    riffData->format = AUDIO_FORMAT_FLAC;
+    riffData->bitsPerSample = sampleSize * BITS_PER_BYTE;
+    riffData->blockAlign = decoder->frameSize;
+    riffData->framesPerBlock = COMPACT_BLOCK_FRAMES;
+    riffData->samplesPerChannel = frameCount;
+    riffData->dataSize = size;
+    riffData->byteRate = (uint64_t)size * riffData->sampleRate / frameCount;
+    if (riffData->byteRate == 0) riffData->byteRate = 1;
+    riffData->data = _self->compactData;
+    return true;
+}
+
+bool _compact16Bit(_AudioObject *_self, uint32_t frameCount) {
+    // Narrower samples would only grow.
+    AudioRiffData *riffData = &_self->riffData;
+    if (riffData->bitsPerSample <= 16) return true;
+    uint16_t bytesPerSample = riffData->bitsPerSample / BITS_PER_BYTE;
+    size_t sampleCount = (size_t)frameCount * riffData->channelAmount;
+    int16_t *samples = (int16_t*)malloc(sampleCount * sizeof(int16_t));
+    if (samples == NULL) {
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    for (size_t i = 0; i < sampleCount; ++i) {
+        samples[i] = _roundTo16Bit(
+            _readPcmSample(riffData->data + i * bytesPerSample, bytesPerSample), 
+            riffData->bitsPerSample
+        );
+    }
+    _self->compactData = (uint8_t*)samples;
+
+    riffData->bitsPerSample = 16;
+    riffData->blockAlign = riffData->channelAmount * sizeof(int16_t);
+    riffData->byteRate = riffData->sampleRate * riffData->blockAlign;
+    riffData->dataSize = sampleCount * sizeof(int16_t);
+    riffData->data = _self->compactData;
+    return true;
+}
+
+bool _compactAdpcm(_AudioObject *_self, uint32_t frameCount) {
+    // The frames are rounded to 16 bits and encoded like an IMA ADPCM file,
+    // which is then played block by block like one.
+    AudioRiffData *riffData = &_self->riffData;
+    uint16_t channelAmount = riffData->channelAmount;
+    uint16_t bytesPerSample = riffData->bitsPerSample / BITS_PER_BYTE;
+    AdpcmFormat format = {
+        .variant = ADPCM_VARIANT_IMA,
+        .channelAmount = channelAmount,
+        .blockAlign = COMPACT_ADPCM_CHANNEL_BLOCK_SIZE * channelAmount
+    };
+    format.framesPerBlock = adpcmGetBlockFrames(&format, format.blockAlign);
+    uint64_t blockCount = (frameCount + format.framesPerBlock - 1) 
+        / format.framesPerBlock;
+
+    _self->decoder = (AudioDecoder*)calloc(1, sizeof(AudioDecoder));
+    if (_self->decoder == NULL) {
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    _self->decoder->format = format;
+    _self->decoder->decodedBlock = NO_DECODED_BLOCK;
+    _self->decoder->frameSize = channelAmount * sizeof(int16_t);
+    _self->decoder->frames = (uint8_t*)calloc(
+        format.framesPerBlock, _self->decoder->frameSize
+    );
+    _self->compactData = (uint8_t*)malloc(blockCount * format.blockAlign);
+    uint8_t *stepIndices = (uint8_t*)calloc(channelAmount, sizeof(uint8_t));
+    if (
+        _self->decoder->frames == NULL 
+        || _self->compactData == NULL 
+        || stepIndices == NULL
+    ) {
+        free(stepIndices);
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+
+    // The decoder's scratch buffer holds the 16 bit frames of each block.
+    int16_t *frames = (int16_t*)_self->decoder->frames;
+    size_t size = 0;
+    for (uint64_t block = 0; block < blockCount; ++block) {
+        uint32_t firstFrame = block * format.framesPerBlock;
+        uint32_t blockFrames = frameCount - firstFrame < format.framesPerBlock 
+            ? frameCount - firstFrame 
+            : format.framesPerBlock;
+        const uint8_t *samples = riffData->data 
+            + (size_t)firstFrame * riffData->blockAlign;
+        for (size_t i = 0; i < (size_t)blockFrames * channelAmount; ++i) {
+            frames[i] = _roundTo16Bit(
+                _readPcmSample(samples + i * bytesPerSample, bytesPerSample), 
+                riffData->bitsPerSample
+            );
+        }
+        size += adpcmEncodeBlock(
+            &format, frames, blockFrames, stepIndices, _self->compactData + size
+        );
+    }
+    free(stepIndices);
+
+    riffData->format = WAVE_FORMAT_IMA_ADPCM;
+    riffData->bitsPerSample = ADPCM_BITS_PER_SAMPLE;
+    riffData->blockAlign = format.blockAlign;
+    riffData->framesPerBlock = format.framesPerBlock;
+    riffData->samplesPerChannel = frameCount;
+    riffData->dataSize = size;
+    riffData->byteRate = (uint64_t)size * riffData->sampleRate / frameCount;
+    if (riffData->byteRate == 0) riffData->byteRate = 1;
+    riffData->data = _self->compactData;
+    return true;
+}
+
+bool _compactData(_AudioObject *_self, enum AudioResidency residency) {
+    // Only integer PCM is transcoded. Everything else, including files
+    // that are compressed already, is played as given.
+    if (residency == AUDIO_RESIDENCY_RAW) return true;
+    AudioRiffData *riffData = &_self->riffData;
+    uint32_t frameCount = riffData->dataSize / riffData->blockAlign;
+    bool isSupported = riffData->format == WAVE_FORMAT_PCM 
+        && riffData->bitsPerSample % BITS_PER_BYTE == 0 
+        && riffData->bitsPerSample >= 8 
+        && riffData->bitsPerSample <= 32 
+        && riffData->blockAlign 
+            == riffData->channelAmount * riffData->bitsPerSample / BITS_PER_BYTE 
+        && frameCount > 0;
+    if (residency == AUDIO_RESIDENCY_LOSSLESS) {
+        isSupported = isSupported && riffData->channelAmount <= FLAC_MAX_CHANNELS;
+    } else if (residency == AUDIO_RESIDENCY_ADPCM) {
+        isSupported = isSupported 
+            && riffData->channelAmount <= UINT16_MAX / COMPACT_ADPCM_CHANNEL_BLOCK_SIZE;
+    }
+    if (!isSupported) {
+        _self->error->type = AUDIO_WARNING_RESIDENCY_UNSUPPORTED;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return true;
+    }
+
+    uint32_t rawDataSize = riffData->dataSize;
+    bool success = false;
+    switch (residency) {
+        case AUDIO_RESIDENCY_LOSSLESS:
+            success = _compactLossless(_self, frameCount);
+            break;
+        case AUDIO_RESIDENCY_16_BIT:
+            success = _compact16Bit(_self, frameCount);
+            break;
+        case AUDIO_RESIDENCY_ADPCM:
+            success = _compactAdpcm(_self, frameCount);
+            break;
+        default:
+            return true;
+    }
+    if (success && riffData->dataSize > 0) {
+        _self->compressionRatio = (float)rawDataSize / riffData->dataSize;
+    }
+    return success;
+}
+
+bool _readAudioData(
+    _AudioObject *_self, void *rawData, size_t rawDataSize, size_t availableSize
+) {
+    if (flacIsFlac(rawData, availableSize)) {
+        return _readFlacFile(_self, rawData, rawDataSize, availableSize);
+    }
+    return _readRiffFile(_self, rawData, rawDataSize, availableSize);
+}
+
+bool _copyParsedData(_AudioObject *_self, const _AudioObject *parsed) {
+    // Take over what reading the data produced. Every audio object needs
+    // its own decoding state.
+    if (parsed->error->level == AUDIO_ERROR_LEVEL_ERROR) {
+        *_self->error = *parsed->error;
+        return false;
+    }
+    _self->riffData = parsed->riffData;
+    _self->fileLoop = parsed->fileLoop;
+    _self->hasFileLoop = parsed->hasFileLoop;
+    if (parsed->cues != NULL) {
+        _self->cues = (AudioCue*)malloc(parsed->cuesSize);
+        if (_self->cues == NULL) {
+            _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+            _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return false;
+        }
+        memcpy(_self->cues, parsed->cues, parsed->cuesSize);
+        _self->cuesSize = parsed->cuesSize;
+        _self->cueCount = parsed->cueCount;
+        // The labels have to point into the copy.
+        for (uint32_t i = 0; i < _self->cueCount; ++i) {
+            _self->cues[i].label = (const char*)_self->cues 
+                + (parsed->cues[i].label - (const char*)parsed->cues);
+        }
+    }
+    if (parsed->decoder == NULL) return true;
+
+    _self->decoder = (AudioDecoder*)calloc(1, sizeof(AudioDecoder));
+    if (_self->decoder == NULL) {
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    AudioDecoder *decoder = _self->decoder;
+    decoder->format = parsed->decoder->format;
+    decoder->flacInfo = parsed->decoder->flacInfo;
+    decoder->frameSize = parsed->decoder->frameSize;
+    decoder->decodedBlock = NO_DECODED_BLOCK;
+    decoder->flacInfo.seekPoints = NULL;
+    if (decoder->flacInfo.seekPointCount > 0) {
+        size_t seekTableSize = decoder->flacInfo.seekPointCount 
+            * sizeof(FlacSeekPoint);
+        decoder->flacInfo.seekPoints = (FlacSeekPoint*)malloc(seekTableSize);
+        if (decoder->flacInfo.seekPoints == NULL) {
+            decoder->flacInfo.seekPointCount = 0;
+            _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+            _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return false;
+        }
+        memcpy(
+            decoder->flacInfo.seekPoints, parsed->decoder->flacInfo.seekPoints, 
+            seekTableSize
+        );
+    }
+    if (parsed->decoder->frames != NULL) {
+        decoder->frames = (uint8_t*)calloc(
+            decoder->format.framesPerBlock, decoder->frameSize
+        );
+        if (decoder->frames == NULL) {
+            _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+            _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool _setSoundDeviceName(
+    _AudioObject *audioObject, AudioConfiguration *configuration
+) {
+    /* This function determines the name of the audio device used
+    * to play the audio. It can be specifed by the user. If the user
+    * passes NULL it is set to the default device. */
+    if (configuration->soundDeviceName == NULL) {
+        // Use the default name and remember that it was not set by the user.
+        audioObject->soundDeviceName = DEFAULT_SOUND_DEVICE_NAME;
+        audioObject->soundDeviceNameSetByUser = false;
+    } else {
+        // Allocate memory for the device name
+        audioObject->soundDeviceName = (char*)calloc(
+            configuration->soundDeviceNameSize + 1, sizeof(char)
+        );
+        // Fail if allocation failed
+        if (audioObject->soundDeviceName == NULL) {
+            audioObject->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+            audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return false;
+        }
+        // Copy the name to the allocatec memory
+        memcpy(
+            audioObject->soundDeviceName, 
+            configuration->soundDeviceName, 
+            configuration->soundDeviceNameSize
+        );
+        // Remember that it was set to free the allocated memory later.
+        audioObject->soundDeviceNameSetByUser = true;
+    }
+    return true;
+}
+
+snd_pcm_chmap_t * _getChannelMap(_AudioObject *audioObject) {
+    // Create a new channel map instance and set the amount of channels.
+    snd_pcm_chmap_t *channelMap = (snd_pcm_chmap_t*)calloc(
+        1, 
+        sizeof(snd_pcm_chmap_t) 
+            + audioObject->riffData.channelAmount 
+            * sizeof(unsigned int)
+    );
+    if (channelMap == NULL) {
+        audioObject->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return NULL;
+    }
+    channelMap->channels = audioObject->riffData.channelAmount;
+
+    // Set the channel positions based on the channel map.
+    if ((audioObject->riffData.channelMap & CHANNEL_MASK_18) == 0) {
+        // If the channel map is 0, use the default channel positions.
+        for (int i = 0; i < audioObject->riffData.channelAmount; ++i) {
+            channelMap->pos[i] = all_channel_positions[i];
+        }
+    } else {
+        for (int i = 0, j = 0; i < CHANNEL_POSITION_COUNT; ++i) {
+            if (audioObject->riffData.channelMap & (1 << i)) {
+                channelMap->pos[j++] = all_channel_positions[i];
+                if (j >= audioObject->riffData.channelAmount) break;
+            }
+        }
+    }
+    return channelMap;
+}
+
+_AudioObject * _allocAudioObject() {
+    _AudioObject *audioObject = (_AudioObject*)calloc(1, sizeof(_AudioObject));
+    if (audioObject == NULL) { return NULL; }
+
+    // Initialize the error object
+    audioObject->error = (AudioError*)calloc(1, sizeof(AudioError));
+    if (audioObject->error == NULL) { 
+        free(audioObject);
+        return NULL; 
+    }
+    _resetError(audioObject);
+    audioObject->events.fileDescriptor = -1;
+    atomic_init(&audioObject->counters.minDelayFrames, UINT64_MAX);
+    audioObject->compressionRatio = 1.0f;
+    audioObject->gain = 1.0f;
+    return audioObject;
+}
+
+AudioLoader * _allocLoader() {
+    AudioLoader *loader = (AudioLoader*)calloc(1, sizeof(AudioLoader));
+    if (loader == NULL) { return NULL; }
+    loader->fileDescriptor = -1;
+    sem_init(&loader->wakeup, 0, 0);
+    pthread_mutex_init(&loader->windowLock, NULL);
+    return loader;
+}
+
+bool _startLoaderThread(_AudioObject *_self) {
+    AudioLoader *loader = _self->loader;
+    if (loader->thread) return true;
+    // The handle is only kept for a running thread, so _freeLoader()
+    // never joins one that was not created.
+    loader->thread = (pthread_t*)calloc(1, sizeof(pthread_t));
+    if (
+        loader->thread == NULL 
+        || pthread_create(loader->thread, NULL, _loaderLoop, (void*)_self)
+    ) {
+        free(loader->thread);
+        loader->thread = NULL;
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    return true;
+}
+
+uint64_t _hashBytes(const uint8_t *data, size_t size) {
+    // FNV-1a over whole words. Matches are compared byte by byte anyway.
+    uint64_t hash = BUFFER_HASH_OFFSET ^ size;
+    size_t index = 0;
+    for (; index + sizeof(uint64_t) <= size; index += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + index, sizeof(uint64_t));
+        hash = (hash ^ word) * BUFFER_HASH_PRIME;
+    }
+    for (; index < size; ++index) {
+        hash = (hash ^ data[index]) * BUFFER_HASH_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Looks up a listed buffer with the same bytes and takes a reference.
+ * 
+ * The registry lock has to be held.
+*/
+_AudioBuffer * _findBufferByData(
+    const uint8_t *data, size_t size, uint64_t hash
+) {
+    for (
+        _AudioBuffer *buffer = bufferRegistry.buffers; 
+        buffer != NULL; 
+        buffer = buffer->next
+    ) {
+        if (
+            buffer->hash == hash && buffer->size == size 
+            && !memcmp(buffer->data, data, size)
+        ) {
+            ++buffer->references;
+            return buffer;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Looks up a listed buffer of the same unchanged file and takes a reference.
+ * 
+ * The registry lock has to be held.
+*/
+_AudioBuffer * _findBufferByFile(const struct stat *fileStats) {
+    for (
+        _AudioBuffer *buffer = bufferRegistry.buffers; 
+        buffer != NULL; 
+        buffer = buffer->next
+    ) {
+        if (
+            buffer->hasFile 
+            && buffer->device == fileStats->st_dev 
+            && buffer->inode == fileStats->st_ino 
+            && buffer->size == (size_t)fileStats->st_size 
+            && buffer->modificationTime.tv_sec == fileStats->st_mtim.tv_sec 
+            && buffer->modificationTime.tv_nsec == fileStats->st_mtim.tv_nsec
+        ) {
+            ++buffer->references;
+            return buffer;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Frees an audio object that only holds read data and was never initialized further.
+*/
+void _freeParsedData(_AudioObject *parsed) {
+    if (parsed->decoder) {
+        flacFreeInfo(&parsed->decoder->flacInfo);
+        free(parsed->decoder->frames);
+        free(parsed->decoder);
+    }
+    free(parsed->cues);
+    free(parsed->error);
+    free(parsed);
+}
+
+void _retainBuffer(_AudioBuffer *buffer) {
+    pthread_mutex_lock(&bufferRegistry.lock);
+    ++buffer->references;
+    pthread_mutex_unlock(&bufferRegistry.lock);
+}
+
+void _releaseBuffer(_AudioBuffer *buffer) {
+    // The registry lock keeps a lookup from reviving a buffer that is
+    // being freed.
+    pthread_mutex_lock(&bufferRegistry.lock);
+    bool isLast = --buffer->references == 0;
+    if (isLast && buffer->isRegistered) {
+        _AudioBuffer **link = &bufferRegistry.buffers;
+        while (*link != buffer) link = &(*link)->next;
+        *link = buffer->next;
+    }
+    pthread_mutex_unlock(&bufferRegistry.lock);
+    if (!isLast) return;
+
+    if (buffer->parsed) _freeParsedData(buffer->parsed);
+    if (buffer->isMapped) {
+        munmap(buffer->data, buffer->size);
+    } else if (buffer->isCopied) {
+        free(buffer->data);
+    }
+    free(buffer);
+}
+
+/**
+ * @brief Parses the data of a new buffer and lists it if it should be shared.
+ * 
+ * On a parsing error the buffer is kept unlisted to report the error.
+*/
+_AudioBuffer * _finishBuffer(_AudioBuffer *buffer, uint32_t flags) {
+    buffer->references = 1;
+    buffer->parsed = _allocAudioObject();
+    if (buffer->parsed == NULL) {
+        _releaseBuffer(buffer);
+        return NULL;
+    }
+    if (!_readAudioData(buffer->parsed, buffer->data, buffer->size, buffer->size)) {
+        return buffer;
+    }
+
+    // Borrowed bytes can go away with the user, so only owned ones are shared.
+    if ((flags & AUDIO_BUFFER_DEDUPLICATE) && (buffer->isCopied || buffer->isMapped)) {
+        pthread_mutex_lock(&bufferRegistry.lock);
+        buffer->next = bufferRegistry.buffers;
+        bufferRegistry.buffers = buffer;
+        buffer->isRegistered = true;
+        pthread_mutex_unlock(&bufferRegistry.lock);
+    }
+    return buffer;
+}
+
+bool _getPcmFormat(_AudioObject *audioObject, snd_pcm_format_t *format) {
+    // Compressed formats are played in the format they are decoded to.
+    switch (audioObject->riffData.format) {
+        case WAVE_FORMAT_PCM:
+            switch (audioObject->riffData.bitsPerSample) {
+                case 8:  *format = SND_PCM_FORMAT_U8;         break;
+                case 16: *format = SND_PCM_FORMAT_S16_LE;     break;
+                case 24: *format = SND_PCM_FORMAT_S24_3LE;    break;
+                case 32: *format = SND_PCM_FORMAT_S32_LE;     break;
+                default:
+                    audioObject->error->type = AUDIO_UNSUPPORTED_BITS_PER_SAMPLE;
+                    audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
+                    return false;
+            }
+            break;
+
+        case WAVE_FORMAT_IEEE_FLOAT:
+            switch (audioObject->riffData.bitsPerSample) {
+                case 32: *format = SND_PCM_FORMAT_FLOAT_LE; break;
+                case 64: *format = SND_PCM_FORMAT_FLOAT64_LE; break;
+                default:
+                    audioObject->error->type = AUDIO_UNSUPPORTED_BITS_PER_SAMPLE;
+                    audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
+                    return false;
+            }
+            break;
+
+        case WAVE_FORMAT_ALAW:
+            switch (audioObject->riffData.bitsPerSample) {
+                case 8: *format = SND_PCM_FORMAT_A_LAW; break;
+                default:
+                    audioObject->error->type = AUDIO_UNSUPPORTED_BITS_PER_SAMPLE;
+                    audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
+                    return false;
+            }
+            break;
+
+        case WAVE_FORMAT_MULAW:
+            switch (audioObject->riffData.bitsPerSample) {
+                case 8: *format = SND_PCM_FORMAT_MU_LAW; break;
+                default:
+                    audioObject->error->type = AUDIO_UNSUPPORTED_BITS_PER_SAMPLE;
+                    audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
+                    return false;
+            }
+            break;
+
+        case WAVE_FORMAT_ADPCM:
+        case WAVE_FORMAT_IMA_ADPCM:
+            // ADPCM is decoded to 16 bit samples
+            *format = SND_PCM_FORMAT_S16_LE;
+            break;
+
+        case AUDIO_FORMAT_FLAC:
+            // FLAC is decoded to left justified 16 or 32 bit samples
+            *format = audioObject->riffData.bitsPerSample == 16 
+                ? SND_PCM_FORMAT_S16_LE 
+                : SND_PCM_FORMAT_S32_LE;
+            break;
+
+        default:
+            audioObject->error->type = AUDIO_UNSUPPORTED_FORMAT;
+            audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return false;
+    }
+    return true;
+}
+
+void _getBackendParameters(
+    _AudioObject *audioObject, snd_pcm_chmap_t *channelMap, 
+    BackendParameters *parameters
+) {
+    *parameters = (BackendParameters){
+        .format = audioObject->format,
+        .sampleRate = audioObject->riffData.sampleRate,
+        .bufferSize = audioObject->alsaBufferSize,
+        .channelMap = channelMap,
+        .channelAmount = audioObject->riffData.channelAmount
+    };
+}
+
+bool _openOutput(
+    _AudioObject *audioObject, const char *soundDeviceName, Backend **output
+) {
+    // Set the channel map, the sample format, the amount of channels
+    // (1 in mono, 2 is stereo, ...), the sample rate and the ring buffer size.
+    snd_pcm_chmap_t *channelMap = _getChannelMap(audioObject);
+    if (channelMap == NULL) {
+        return false;
+    }
+    BackendParameters parameters;
+    _getBackendParameters(audioObject, channelMap, &parameters);
+
+    // The first output may be a warm one of the pool, which is configured
+    // already. Added devices are linked to it and never pooled.
+    if (output == &audioObject->output) {
+        *output = poolCheckOut(soundDeviceName, &parameters);
+        if (*output != NULL) {
+            free(channelMap);
+            audioObject->isOutputConfigured = true;
+            return true;
+        }
+    }
+
+    // Open the output. It is kept even if setting it up fails, so the
+    // caller closes it. Memory sinks of added devices share the clock of
+    // the first one.
+    if ((audioObject->error->alsaErrorNumber = backendOpen(
+        output, soundDeviceName, audioObject->output
+    )) < 0) {
+        free(channelMap);
+        audioObject->error->type = AUDIO_ERROR_ALSA_ERROR;
+        audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    audioObject->error->alsaErrorNumber = backendConfigure(*output, &parameters);
+    free(channelMap);
+    if (audioObject->error->alsaErrorNumber < 0) {
+        audioObject->error->type = AUDIO_ERROR_ALSA_ERROR;
+        audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    audioObject->isOutputConfigured = output == &audioObject->output;
+    return true;
+}
+
+AudioObject * _initAudioObject(
+    AudioConfiguration *configuration, AudioLoader *loader, 
+    _AudioBuffer *buffer, const _AudioObject *parsed, 
+    enum AudioResidency residency
+) {
+    _AudioObject *audioObject = _allocAudioObject();
+    if (audioObject == NULL) { return NULL; }
+
+    // Data given by the user gets a loader as well so it can be locked.
+    if (loader == NULL) {
+        loader = _allocLoader();
+        if (loader == NULL) {
+            audioObject->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+            audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return (AudioObject*)audioObject;
+        }
+        loader->fileSize = configuration->rawDataSize;
+        loader->availableSize = configuration->rawDataSize;
+    }
+    audioObject->loader = loader;
+
+    // Read the input file. From here on in case of an error an incomplete
+    // audioObject is returned containing a error object describing
+    // what went wrong.
+    // Data of a buffer or a bank was read before.
+    if (buffer != NULL) {
+        _retainBuffer(buffer);
+        audioObject->buffer = buffer;
+    }
+    if (parsed != NULL) {
+        if (!_copyParsedData(audioObject, parsed)) {
+            return (AudioObject*)audioObject;
+        }
+    } else if (!_readAudioData(
+        audioObject, configuration->rawData, configuration->rawDataSize, 
+        loader->availableSize
+    )) {
+        return (AudioObject*)audioObject;
+    }
+    if (!_compactData(audioObject, residency)) {
+        return (AudioObject*)audioObject;
+    }
+
+    if (!_setSoundDeviceName(audioObject, configuration)) {
+        return (AudioObject*)audioObject;
+    }
+
+    // Determine the pcm format from the WAV format and the bits per sample
+    if (!_getPcmFormat(audioObject, &audioObject->format)) {
+        return (AudioObject*)audioObject;
+    }
+
+    // The ALSA ring buffer holds BUFFER_SIZE_FACTOR time resolutions.
+    audioObject->alsaBufferSize = audioObject->riffData.sampleRate 
+        * BUFFER_SIZE_FACTOR
+        * configuration->timeResolution
+        / MILLISECONDS_PER_SECOND;
+    if (!_openOutput(
+        audioObject, audioObject->soundDeviceName, &audioObject->output
+    )) {
+        return (AudioObject*)audioObject;
+    }
+
+    // Set the remaining members of the audioObject. For explanation see
+    // the type definition.
+
+    audioObject->timeResolution = configuration->timeResolution;
+    audioObject->currentFrame = 0;
+    audioObject->lastFrame = audioObject->riffData.dataSize 
+        / audioObject->riffData.blockAlign
+        * audioObject->riffData.framesPerBlock;
+    if (audioObject->riffData.format == AUDIO_FORMAT_FLAC) {
+        audioObject->lastFrame = audioObject->riffData.samplesPerChannel;
+    } else if (audioObject->decoder != NULL) {
+        // A shorter last block is played as well unless it is streamed.
+        // Padding at the end of the last block is not played.
+        size_t lastBlockSize = audioObject->riffData.dataSize 
+            % audioObject->riffData.blockAlign;
+        if (!loader->useStream) {
+            audioObject->lastFrame += adpcmGetBlockFrames(
+                &audioObject->decoder->format, lastBlockSize
+            );
+        }
+        if (audioObject->riffData.samplesPerChannel < audioObject->lastFrame) {
+            audioObject->lastFrame = audioObject->riffData.samplesPerChannel;
+        }
+    }
+    audioObject->dataFrameCount = audioObject->lastFrame;
+
+    audioObject->externalBarrier = NULL;
+    audioObject->internalBarrier = (pthread_barrier_t*)calloc(
+        1, sizeof(pthread_barrier_t)
     );
-    if (!_readFactCunk(_self, factChunk)) {
+    audioObject->actionLock = (pthread_mutex_t*)calloc(
+        1, sizeof(pthread_mutex_t)
+    );
+    pthread_mutex_init(audioObject->actionLock, NULL);
+    audioObject->markerLock = (pthread_mutex_t*)calloc(
+        1, sizeof(pthread_mutex_t)
+    );
+    pthread_mutex_init(audioObject->markerLock, NULL);
+    audioObject->segmentLock = (pthread_mutex_t*)calloc(
+        1, sizeof(pthread_mutex_t)
+    );
+    pthread_mutex_init(audioObject->segmentLock, NULL);
+    audioObject->events.fileDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    audioObject->isPlaying = false;
+    audioObject->isPaused = false;
+
+    // Streamed audio data is read from the file behind the header. The
+    // window must cover the ALSA buffer twice, once behind the playhead for
+    // rewinds after pausing and once ahead of it.
+    if (loader->useStream) {
+        // The stream reads whole blocks. For uncompressed data these are
+        // frames.
+        uint32_t framesPerBlock = audioObject->riffData.framesPerBlock;
+        if (loader->streamBlockSize < audioObject->riffData.blockAlign) {
+            loader->streamBlockSize = audioObject->riffData.blockAlign;
+        }
+        uint32_t blockFrames = loader->streamBlockSize 
+            / audioObject->riffData.blockAlign * framesPerBlock;
+        uint32_t bufferBlocks = (audioObject->alsaBufferSize + blockFrames - 1) 
+            / blockFrames;
+        if (loader->streamQueueDepth < 2 * bufferBlocks + 2) {
+            loader->streamQueueDepth = 2 * bufferBlocks + 2;
+        }
+        size_t dataOffset = audioObject->riffData.data - loader->mapping;
+        audioObject->riffData.data = NULL;
+        loader->stream = streamOpen(
+            loader->fileDescriptor, dataOffset, audioObject->riffData.dataSize, 
+            audioObject->riffData.blockAlign, 
+            loader->streamBlockSize, loader->streamQueueDepth
+        );
+        if (loader->stream == NULL) {
+            audioObject->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+            audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return (AudioObject*)audioObject;
+        }
+    }
+
+    // FLAC frames are decoded ahead of the playhead. Like a stream the
+    // window covers the ALSA buffer twice. Compact FLAC frames are short
+    // enough for the audio thread.
+    if (
+        audioObject->riffData.format == AUDIO_FORMAT_FLAC 
+        && audioObject->compactData == NULL
+    ) {
+        uint32_t bufferBlocks = (audioObject->alsaBufferSize 
+            + FLAC_BLOCK_FRAMES - 1) / FLAC_BLOCK_FRAMES;
+        uint32_t queueDepth = 2 * bufferBlocks + 2;
+        if (queueDepth < FLAC_MIN_QUEUE_DEPTH) queueDepth = FLAC_MIN_QUEUE_DEPTH;
+        audioObject->decoder->flacStream = flacStreamOpen(
+            &audioObject->decoder->flacInfo, FLAC_BLOCK_FRAMES, queueDepth
+        );
+        if (audioObject->decoder->flacStream == NULL) {
+            audioObject->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+            audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return (AudioObject*)audioObject;
+        }
+    }
+
+    audioObject->playFlag = false;
+    audioObject->pauseFlag = false;
+    audioObject->stopFlag = false;
+    audioObject->haltFlag = false;
+    audioObject->jumpFlag = false;
+    audioObject->jumpTarget = 0;
+    audioObject->jumpCue = NO_CUE;
+    audioObject->activeCue = NO_CUE;
+
+    // Start the loader thread if the window has to be maintained.
+    if (loader->isWindowed && !_startLoaderThread(audioObject)) {
+        return (AudioObject*)audioObject;
+    }
+
+    // Start the audio thread and return the assembled object. The thread
+    // is allocated last, so audioDestroy() only joins a running one.
+    audioObject->thread = (pthread_t*)calloc(1, sizeof(pthread_t));
+    if (
+        audioObject->thread == NULL 
+        || pthread_create(audioObject->thread, NULL, _mainloop, (void*)audioObject)
+    ) {
+        free(audioObject->thread);
+        audioObject->thread = NULL;
+        audioObject->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
+    }
+    return (AudioObject)audioObject;
+}
+
+void audioSetPcmPool(uint32_t maxPcms, uint32_t idleMilliseconds) {
+    poolSetLimits(maxPcms, idleMilliseconds);
+}
+
+uint32_t audioGetPcmPoolSize(void) {
+    return poolGetIdleCount();
+}
+
+AudioObject * audioInit(AudioConfiguration *configuration) {
+    return _initAudioObject(configuration, NULL, NULL, NULL, AUDIO_RESIDENCY_RAW);
+}
+
+AudioObject * audioInitCompact(
+    AudioConfiguration *configuration, enum AudioResidency residency
+) {
+    return _initAudioObject(configuration, NULL, NULL, NULL, residency);
+}
+
+void _freeLoader(AudioLoader *loader) {
+    if (loader->thread) {
+        loader->haltFlag = true;
+        sem_post(&loader->wakeup);
+        pthread_join(*(loader->thread), NULL);
+        free(loader->thread);
+    }
+    // Unmapping unlocks as well but data given by the user stays mapped.
+    if (loader->stream == NULL) _lockRange(loader, NULL, NULL);
+    sem_destroy(&loader->wakeup);
+    pthread_mutex_destroy(&loader->windowLock);
+    if (loader->stream) streamClose(loader->stream);
+    if (loader->mapping) munmap(loader->mapping, loader->mappingSize);
+    if (loader->fileDescriptor >= 0) close(loader->fileDescriptor);
+    free(loader);
+}
+
+bool _loadWholeFile(
+    AudioLoader *loader, AudioLoaderConfiguration *loaderConfiguration
+) {
+    if (!loaderConfiguration->useHugePages) {
+        // Let the kernel fault in every page right away.
+        loader->mappingSize = loader->fileSize;
+        loader->mapping = mmap(
+            NULL, loader->mappingSize, PROT_READ, 
+            MAP_PRIVATE | MAP_POPULATE, loader->fileDescriptor, 0
+        );
+        if (loader->mapping == MAP_FAILED) {
+            loader->mapping = NULL;
+            return false;
+        }
+        return true;
+    }
+
+    // Copy the file into anonymous memory backed by transparent huge pages.
+    // The mapping is rounded up to whole huge pages.
+    loader->isAnonymous = true;
+    loader->mappingSize = (loader->fileSize + HUGE_PAGE_SIZE - 1) 
+        / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    loader->mapping = mmap(
+        NULL, loader->mappingSize, PROT_READ | PROT_WRITE, 
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    if (loader->mapping == MAP_FAILED) {
+        loader->mapping = NULL;
+        return false;
+    }
+    madvise(loader->mapping, loader->mappingSize, MADV_HUGEPAGE);
+    size_t bytesRead = 0;
+    while (bytesRead < loader->fileSize) {
+        ssize_t result = pread(
+            loader->fileDescriptor, loader->mapping + bytesRead, 
+            loader->fileSize - bytesRead, bytesRead
+        );
+        if (result == -1 && errno == EINTR) continue;
+        if (result <= 0) return false;
+        bytesRead += result;
+    }
+    mprotect(loader->mapping, loader->mappingSize, PROT_READ);
+    return true;
+}
+
+bool _readHeader(AudioLoader *loader) {
+    // Only read the beginning of the file. The stream reads the rest.
+    loader->mappingSize = loader->fileSize < STREAM_HEADER_SIZE 
+        ? loader->fileSize 
+        : STREAM_HEADER_SIZE;
+    loader->mapping = mmap(
+        NULL, loader->mappingSize, PROT_READ | PROT_WRITE, 
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    if (loader->mapping == MAP_FAILED) {
+        loader->mapping = NULL;
+        return false;
+    }
+    size_t bytesRead = 0;
+    while (bytesRead < loader->mappingSize) {
+        ssize_t result = pread(
+            loader->fileDescriptor, loader->mapping + bytesRead, 
+            loader->mappingSize - bytesRead, bytesRead
+        );
+        if (result == -1 && errno == EINTR) continue;
+        if (result <= 0) return false;
+        bytesRead += result;
+    }
+    return true;
+}
+
+bool _mapFile(AudioLoader *loader) {
+    loader->isWindowed = true;
+    loader->mappingSize = loader->fileSize;
+    loader->mapping = mmap(
+        NULL, loader->mappingSize, PROT_READ, MAP_PRIVATE, 
+        loader->fileDescriptor, 0
+    );
+    if (loader->mapping == MAP_FAILED) {
+        loader->mapping = NULL;
         return false;
     }
+    // The data is read front to back so aggressive kernel readahead helps.
+    madvise(loader->mapping, loader->mappingSize, MADV_SEQUENTIAL);
     return true;
 }
 
-bool _readExtensibleFmtChunkExtension(
-    _AudioObject *_self, AudioExtensibleFmtChunkExtension *extensibleExtension
+AudioObject * audioInitFromPath(
+    AudioConfiguration *configuration, 
+    const char *path, 
+    AudioLoaderConfiguration *loaderConfiguration
+) {
+    AudioLoaderConfiguration defaultLoaderConfiguration = { 0 };
+    if (loaderConfiguration == NULL) {
+        loaderConfiguration = &defaultLoaderConfiguration;
+    }
+
+    AudioLoader *loader = _allocLoader();
+    if (loader == NULL) { return NULL; }
+    loader->dropBehind = loaderConfiguration->dropBehind;
+
+    // Loading errors are reported through the error object of an otherwise
+    // empty audio object.
+    enum AudioErrorType loadError = AUDIO_ERROR_NO_ERROR;
+    loader->fileDescriptor = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat fileStats;
+    if (loader->fileDescriptor == -1) {
+        loadError = AUDIO_ERROR_FILE_OPEN_FAILED;
+    } else if (fstat(loader->fileDescriptor, &fileStats) == -1) {
+        loadError = AUDIO_ERROR_FILE_OPEN_FAILED;
+    } else {
+        loader->fileSize = fileStats.st_size;
+        size_t populateThreshold = loaderConfiguration->populateThreshold 
+            ? loaderConfiguration->populateThreshold 
+            : DEFAULT_POPULATE_THRESHOLD;
+        if (loaderConfiguration->useStreaming) {
+            loader->useStream = true;
+            loader->streamBlockSize = loaderConfiguration->streamBlockSize 
+                ? loaderConfiguration->streamBlockSize 
+                : DEFAULT_STREAM_BLOCK_SIZE;
+            loader->streamQueueDepth = loaderConfiguration->streamQueueDepth 
+                ? loaderConfiguration->streamQueueDepth 
+                : DEFAULT_STREAM_QUEUE_DEPTH;
+            if (!_readHeader(loader)) {
+                loadError = AUDIO_ERROR_FILE_MAP_FAILED;
+            } else if (flacIsFlac(loader->mapping, loader->mappingSize)) {
+                // FLAC frames vary in size and cannot be read in fixed
+                // blocks. The file is mapped and its decoder thread takes
+                // the page faults instead.
+                munmap(loader->mapping, loader->mappingSize);
+                loader->mapping = NULL;
+                loader->useStream = false;
+                if (!_mapFile(loader)) {
+                    loadError = AUDIO_ERROR_FILE_MAP_FAILED;
+                }
+            }
+        } else if (loader->fileSize <= populateThreshold) {
+            if (!_loadWholeFile(loader, loaderConfiguration)) {
+                loadError = AUDIO_ERROR_FILE_MAP_FAILED;
+            }
+        } else if (!_mapFile(loader)) {
+            loadError = AUDIO_ERROR_FILE_MAP_FAILED;
+        }
+        loader->availableSize = loader->useStream 
+            ? loader->mappingSize 
+            : loader->fileSize;
+    }
+
+    if (loadError != AUDIO_ERROR_NO_ERROR) {
+        _AudioObject *audioObject = _allocAudioObject();
+        _freeLoader(loader);
+        if (audioObject == NULL) { return NULL; }
+        audioObject->error->type = loadError;
+        audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return (AudioObject*)audioObject;
+    }
+
+    AudioConfiguration loaderAudioConfiguration = *configuration;
+    loaderAudioConfiguration.rawData = loader->mapping;
+    loaderAudioConfiguration.rawDataSize = loader->fileSize;
+    _AudioObject *audioObject = (_AudioObject*)_initAudioObject(
+        &loaderAudioConfiguration, loader, NULL, NULL, AUDIO_RESIDENCY_RAW
+    );
+    if (audioObject == NULL) {
+        _freeLoader(loader);
+        return NULL;
+    }
+    if (audioObject->error->level == AUDIO_ERROR_LEVEL_ERROR) {
+        // The audio object still owns the loader.
+        return (AudioObject*)audioObject;
+    }
+
+    // Convert the window sizes from milliseconds to bytes.
+    uint32_t readaheadMilliseconds = loaderConfiguration->readaheadMilliseconds
+        ? loaderConfiguration->readaheadMilliseconds
+        : DEFAULT_READAHEAD_MILLISECONDS;
+    uint32_t keepBehindMilliseconds = loaderConfiguration->keepBehindMilliseconds
+        ? loaderConfiguration->keepBehindMilliseconds
+        : DEFAULT_KEEP_BEHIND_MILLISECONDS;
+    loader->readaheadBytes = (uint64_t)audioObject->riffData.byteRate 
+        * readaheadMilliseconds / MILLISECONDS_PER_SECOND;
+    loader->keepBehindBytes = (uint64_t)audioObject->riffData.byteRate 
+        * keepBehindMilliseconds / MILLISECONDS_PER_SECOND;
+    loader->stepFrames = (uint64_t)audioObject->riffData.sampleRate 
+        * readaheadMilliseconds / MILLISECONDS_PER_SECOND 
+        / LOADER_STEPS_PER_WINDOW;
+
+    // Prefetch the first window before playback starts.
+    loader->jumpFlag = true;
+    sem_post(&loader->wakeup);
+
+    return (AudioObject*)audioObject;
+}
+
+AudioBuffer * audioBufferInit(
+    const void *rawData, size_t rawDataSize, uint32_t flags
+) {
+    uint64_t hash = 0;
+    if (flags & AUDIO_BUFFER_DEDUPLICATE) {
+        hash = _hashBytes(rawData, rawDataSize);
+        pthread_mutex_lock(&bufferRegistry.lock);
+        _AudioBuffer *buffer = _findBufferByData(rawData, rawDataSize, hash);
+        pthread_mutex_unlock(&bufferRegistry.lock);
+        if (buffer != NULL) return (AudioBuffer*)buffer;
+    }
+
+    _AudioBuffer *buffer = (_AudioBuffer*)calloc(1, sizeof(_AudioBuffer));
+    if (buffer == NULL) { return NULL; }
+    buffer->size = rawDataSize;
+    buffer->hash = hash;
+    if (flags & AUDIO_BUFFER_COPY) {
+        buffer->data = (uint8_t*)malloc(rawDataSize);
+        if (buffer->data == NULL) {
+            free(buffer);
+            return NULL;
+        }
+        memcpy(buffer->data, rawData, rawDataSize);
+        buffer->isCopied = true;
+    } else {
+        buffer->data = (uint8_t*)rawData;
+    }
+    return (AudioBuffer*)_finishBuffer(buffer, flags);
+}
+
+/**
+ * @brief Maps the file at path into a new buffer.
+ * 
+ * Buffers that are returned with parsed data are done: either loading
+ * failed and the error is set, or a listed buffer of the same file was
+ * found. Otherwise the mapping still has to be parsed and has no
+ * references yet.
+*/
+_AudioBuffer * _mapBuffer(const char *path, uint32_t flags, bool populate) {
+    _AudioBuffer *buffer = (_AudioBuffer*)calloc(1, sizeof(_AudioBuffer));
+    if (buffer == NULL) { return NULL; }
+
+    // Loading errors are reported through the error object of a buffer
+    // without data.
+    enum AudioErrorType loadError = AUDIO_ERROR_NO_ERROR;
+    int fileDescriptor = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat fileStats;
+    if (fileDescriptor == -1 || fstat(fileDescriptor, &fileStats) == -1) {
+        loadError = AUDIO_ERROR_FILE_OPEN_FAILED;
+    } else if (flags & AUDIO_BUFFER_DEDUPLICATE) {
+        // The same unchanged file needs neither mapping nor hashing.
+        pthread_mutex_lock(&bufferRegistry.lock);
+        _AudioBuffer *found = _findBufferByFile(&fileStats);
+        pthread_mutex_unlock(&bufferRegistry.lock);
+        if (found != NULL) {
+            close(fileDescriptor);
+            free(buffer);
+            return found;
+        }
+    }
+
+    if (loadError == AUDIO_ERROR_NO_ERROR) {
+        buffer->size = fileStats.st_size;
+        buffer->data = mmap(
+            NULL, buffer->size, PROT_READ, 
+            MAP_PRIVATE | (populate ? MAP_POPULATE : 0), fileDescriptor, 0
+        );
+        if (buffer->data == MAP_FAILED) {
+            buffer->data = NULL;
+            loadError = AUDIO_ERROR_FILE_MAP_FAILED;
+        } else {
+            buffer->isMapped = true;
+            buffer->hasFile = true;
+            buffer->device = fileStats.st_dev;
+            buffer->inode = fileStats.st_ino;
+            buffer->modificationTime = fileStats.st_mtim;
+        }
+    }
+    if (fileDescriptor != -1) close(fileDescriptor);
+
+    if (loadError != AUDIO_ERROR_NO_ERROR) {
+        buffer->references = 1;
+        buffer->parsed = _allocAudioObject();
+        if (buffer->parsed == NULL) {
+            free(buffer);
+            return NULL;
+        }
+        buffer->parsed->error->type = loadError;
+        buffer->parsed->error->level = AUDIO_ERROR_LEVEL_ERROR;
+    }
+    return buffer;
+}
+
+AudioBuffer * audioBufferInitFromPath(const char *path, uint32_t flags) {
+    _AudioBuffer *buffer = _mapBuffer(path, flags, true);
+    if (buffer == NULL || buffer->parsed != NULL) {
+        return (AudioBuffer*)buffer;
+    }
+
+    if (flags & AUDIO_BUFFER_DEDUPLICATE) {
+        // Another path or a copy might hold the same bytes.
+        buffer->hash = _hashBytes(buffer->data, buffer->size);
+        pthread_mutex_lock(&bufferRegistry.lock);
+        _AudioBuffer *found = _findBufferByData(
+            buffer->data, buffer->size, buffer->hash
+        );
+        pthread_mutex_unlock(&bufferRegistry.lock);
+        if (found != NULL) {
+            munmap(buffer->data, buffer->size);
+            free(buffer);
+            return (AudioBuffer*)found;
+        }
+    }
+    return (AudioBuffer*)_finishBuffer(buffer, flags);
+}
+
+void audioBufferRetain(AudioBuffer self) {
+    _retainBuffer((_AudioBuffer*)self);
+}
+
+void audioBufferRelease(AudioBuffer self) {
+    _releaseBuffer((_AudioBuffer*)self);
+}
+
+AudioError * audioBufferGetError(AudioBuffer self) {
+    return ((_AudioBuffer*)self)->parsed->error;
+}
+
+AudioObject * audioInitFromBuffer(
+    AudioConfiguration *configuration, AudioBuffer buffer
+) {
+    _AudioBuffer *_buffer = (_AudioBuffer*)buffer;
+    AudioConfiguration bufferAudioConfiguration = *configuration;
+    bufferAudioConfiguration.rawData = _buffer->data;
+    bufferAudioConfiguration.rawDataSize = _buffer->size;
+    return _initAudioObject(
+        &bufferAudioConfiguration, NULL, _buffer, _buffer->parsed, 
+        AUDIO_RESIDENCY_RAW
+    );
+}
+
+void _describeBankClip(BankEntry *entry, const _AudioBuffer *buffer) {
+    const _AudioObject *parsed = buffer->parsed;
+    const AudioRiffData *riffData = &parsed->riffData;
+    entry->clipSize = buffer->size;
+    // Compressed clips need decoder state and cue points are not indexed,
+    // both are read at runtime.
+    entry->flags = parsed->decoder != NULL || parsed->cueCount > 0 
+        ? BANK_CLIP_NEEDS_PARSING 
+        : 0;
+    entry->dataOffset = riffData->data != NULL ? riffData->data - buffer->data : 0;
+    entry->dataSize = riffData->dataSize;
+    entry->audioLength = riffData->audioLength;
+    entry->sampleRate = riffData->sampleRate;
+    entry->byteRate = riffData->byteRate;
+    entry->channelMap = riffData->channelMap;
+    entry->samplesPerChannel = riffData->samplesPerChannel;
+    entry->channelAmount = riffData->channelAmount;
+    entry->blockAlign = riffData->blockAlign;
+    entry->bitsPerSample = riffData->bitsPerSample;
+    entry->format = riffData->format;
+    entry->framesPerBlock = riffData->framesPerBlock;
+}
+
+bool audioBankPack(
+    const char *path, const char **clipPaths, const char **clipNames, 
+    uint32_t clipCount, AudioError *error
 ) {
-    // extensible fmt extensions have a fixed size
-    if (
-        extensibleExtension->extraSize 
-        != EXTENSIBLE_FMT_CHUNK_EXTRA_SIZE
-    ) {
-        _self->error->type = AUDIO_ERROR_INVALID_EXTENSIBLE_EXTENSION_SIZE;
-        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return false;
+    *error = (AudioError){ AUDIO_ERROR_NO_ERROR, AUDIO_ERROR_LEVEL_INFO, 0 };
+    size_t count = clipCount ? clipCount : 1;
+    _AudioBuffer **buffers = (_AudioBuffer**)calloc(count, sizeof(_AudioBuffer*));
+    BankEntry *entries = (BankEntry*)calloc(count, sizeof(BankEntry));
+    const char **names = (const char**)calloc(count, sizeof(char*));
+    const uint8_t **clips = (const uint8_t**)calloc(count, sizeof(uint8_t*));
+    if (buffers == NULL || entries == NULL || names == NULL || clips == NULL) {
+        error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
     }
-    // the extension conatains the actual audio format
-    switch (extensibleExtension->audioFormat) {
-        case WAVE_FORMAT_PCM:
-        case WAVE_FORMAT_IEEE_FLOAT:
-        case WAVE_FORMAT_ALAW:
-        case WAVE_FORMAT_MULAW:
-            _self->riffData.format = extensibleExtension->audioFormat;
-            break;
-        default:
-            _self->error->type = AUDIO_ERROR_INVALID_EXTENSIBLE_AUDIO_FORMAT;
-            _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-            return false;
+
+    // Every clip is validated once here instead of at every startup.
+    for (uint32_t i = 0; error->type == AUDIO_ERROR_NO_ERROR && i < clipCount; ++i) {
+        buffers[i] = (_AudioBuffer*)audioBufferInitFromPath(clipPaths[i], 0);
+        if (buffers[i] == NULL) {
+            error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        } else if (buffers[i]->parsed->error->level == AUDIO_ERROR_LEVEL_ERROR) {
+            *error = *buffers[i]->parsed->error;
+        } else {
+            _describeBankClip(&entries[i], buffers[i]);
+            names[i] = clipNames[i];
+            clips[i] = buffers[i]->data;
+        }
     }
-    // There is a fixed guid in the extension
-    if (memcmp(
-        extensibleExtension->guid, EXTENSIBLE_GUID, EXTENSIBLE_GUID_SIZE
-    )) {
-        _self->error->type = AUDIO_ERROR_INVALID_EXTENSIBLE_GUID;
-        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return false;
+
+    if (error->type == AUDIO_ERROR_NO_ERROR) {
+        int fileDescriptor = open(
+            path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644
+        );
+        if (fileDescriptor == -1) {
+            error->type = AUDIO_ERROR_FILE_OPEN_FAILED;
+        } else {
+            if (!bankWrite(fileDescriptor, entries, names, clips, clipCount)) {
+                error->type = errno == EEXIST 
+                    ? AUDIO_ERROR_DUPLICATE_CLIP_NAME 
+                    : AUDIO_ERROR_FILE_WRITE_FAILED;
+            }
+            if (close(fileDescriptor) == -1 && error->type == AUDIO_ERROR_NO_ERROR) {
+                error->type = AUDIO_ERROR_FILE_WRITE_FAILED;
+            }
+            // Leave no incomplete bank behind.
+            if (error->type != AUDIO_ERROR_NO_ERROR) unlink(path);
+        }
     }
-    // The channel mask is used to map channels to speakers
-    _self->riffData.channelMap = extensibleExtension->channelMask;
-    // Every extensible fmt chunk must have a fact chunk
-    AudioFactChunk *factChunk = (AudioFactChunk*)(
-        (uint8_t*)extensibleExtension 
-        + sizeof(AudioExtensibleFmtChunkExtension)
-    );
-    if (!_readFactCunk(_self, factChunk)) {
-        return false;
+    if (error->type != AUDIO_ERROR_NO_ERROR) {
+        error->level = AUDIO_ERROR_LEVEL_ERROR;
+    }
+
+    for (uint32_t i = 0; buffers != NULL && i < clipCount; ++i) {
+        if (buffers[i]) _releaseBuffer(buffers[i]);
+    }
+    free(buffers);
+    free(entries);
+    free(names);
+    free(clips);
+    return error->type == AUDIO_ERROR_NO_ERROR;
+}
+
+AudioBank * audioBankOpen(const char *path) {
+    _AudioBank *bank = (_AudioBank*)calloc(1, sizeof(_AudioBank));
+    if (bank == NULL) { return NULL; }
+
+    // The clips are faulted in when they are played, not at startup.
+    bank->buffer = _mapBuffer(path, 0, false);
+    if (bank->buffer == NULL) {
+        free(bank);
+        return NULL;
+    }
+    if (bank->buffer->parsed != NULL) return (AudioBank*)bank;
+
+    bank->buffer->references = 1;
+    bank->buffer->parsed = _allocAudioObject();
+    if (bank->buffer->parsed == NULL) {
+        _releaseBuffer(bank->buffer);
+        free(bank);
+        return NULL;
+    }
+    if (!bankReadIndex(bank->buffer->data, bank->buffer->size, &bank->index)) {
+        bank->index.clipCount = 0;
+        bank->buffer->parsed->error->type = AUDIO_ERROR_INVALID_BANK;
+        bank->buffer->parsed->error->level = AUDIO_ERROR_LEVEL_ERROR;
+    }
+    return (AudioBank*)bank;
+}
+
+void audioBankClose(AudioBank self) {
+    _AudioBank *_self = (_AudioBank*)self;
+    _releaseBuffer(_self->buffer);
+    free(_self);
+}
+
+AudioError * audioBankGetError(AudioBank self) {
+    return ((_AudioBank*)self)->buffer->parsed->error;
+}
+
+uint32_t audioBankGetClipCount(AudioBank self) {
+    return ((_AudioBank*)self)->index.clipCount;
+}
+
+bool audioBankFindClip(AudioBank self, const char *name, uint32_t *clip) {
+    return bankFindClip(&((_AudioBank*)self)->index, name, clip);
+}
+
+uint32_t audioBankGetClipDuration(AudioBank self, uint32_t clip) {
+    _AudioBank *_self = (_AudioBank*)self;
+    if (clip >= _self->index.clipCount) return 0;
+    return _self->index.entries[clip].audioLength;
+}
+
+bool _readBankClip(_AudioObject *_self, const BankIndex *index, uint32_t clip) {
+    const BankEntry *entry = &index->entries[clip];
+    uint8_t *clipData = (uint8_t*)index->data + entry->clipOffset;
+    if (entry->flags & BANK_CLIP_NEEDS_PARSING) {
+        return _readAudioData(_self, clipData, entry->clipSize, entry->clipSize);
     }
+
+    // Everything else was validated when the bank was packed.
+    AudioRiffData *riffData = &_self->riffData;
+    riffData->audioLength = entry->audioLength;
+    riffData->sampleRate = entry->sampleRate;
+    riffData->byteRate = entry->byteRate;
+    riffData->dataSize = entry->dataSize;
+    riffData->channelMap = entry->channelMap;
+    riffData->samplesPerChannel = entry->samplesPerChannel;
+    riffData->channelAmount = entry->channelAmount;
+    riffData->blockAlign = entry->blockAlign;
+    riffData->bitsPerSample = entry->bitsPerSample;
+    riffData->format = entry->format;
+    riffData->framesPerBlock = entry->framesPerBlock;
+    riffData->data = clipData + entry->dataOffset;
     return true;
 }
 
-bool _readFmtChunk(_AudioObject *_self, AudioFmtChunk *fmtChunk) {
-    if (memcmp(fmtChunk->fmtMagic, FMT_MAGIC, MAGIC_SIZE)) {
-        _self->error->type = AUDIO_ERROR_IMVALID_FMT_MAGIC_NUMBER;
-        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return false;
+AudioObject * audioInitFromBank(
+    AudioConfiguration *configuration, AudioBank bank, uint32_t clip
+) {
+    _AudioBank *_bank = (_AudioBank*)bank;
+    _AudioObject *parsed = _allocAudioObject();
+    if (parsed == NULL) { return NULL; }
+
+    AudioConfiguration clipAudioConfiguration = *configuration;
+    clipAudioConfiguration.rawData = _bank->buffer->data;
+    clipAudioConfiguration.rawDataSize = 0;
+    if (_bank->buffer->parsed->error->level == AUDIO_ERROR_LEVEL_ERROR) {
+        *parsed->error = *_bank->buffer->parsed->error;
+    } else if (clip >= _bank->index.clipCount) {
+        parsed->error->type = AUDIO_ERROR_CLIP_NOT_FOUND;
+        parsed->error->level = AUDIO_ERROR_LEVEL_ERROR;
+    } else if (_readBankClip(parsed, &_bank->index, clip)) {
+        const BankEntry *entry = &_bank->index.entries[clip];
+        clipAudioConfiguration.rawData = _bank->buffer->data + entry->clipOffset;
+        clipAudioConfiguration.rawDataSize = entry->clipSize;
     }
 
-    // Check if the fmt chunk has the right size
-    _self->riffData.format = fmtChunk->audioFormat;
-    size_t expectedFmtSize = 0;
-    switch (_self->riffData.format) {
+    AudioObject *audioObject = _initAudioObject(
+        &clipAudioConfiguration, NULL, _bank->buffer, parsed, 
+        AUDIO_RESIDENCY_RAW
+    );
+    _freeParsedData(parsed);
+    return audioObject;
+}
+
+uint64_t _getPeakFrameCount(const _AudioBuffer *buffer) {
+    // Only count frames whose bytes are inside the file.
+    const _AudioObject *parsed = buffer->parsed;
+    const AudioRiffData *riffData = &parsed->riffData;
+    if (riffData->format == AUDIO_FORMAT_FLAC) {
+        return parsed->decoder->flacInfo.totalSamples;
+    }
+    size_t dataSize = buffer->size - (riffData->data - buffer->data);
+    if (riffData->dataSize < dataSize) dataSize = riffData->dataSize;
+    if (parsed->decoder == NULL) return dataSize / riffData->blockAlign;
+    // Only the last block of complete data may be short.
+    uint64_t blockCount = dataSize == riffData->dataSize 
+        ? (dataSize + riffData->blockAlign - 1) / riffData->blockAlign 
+        : dataSize / riffData->blockAlign;
+    uint64_t frameCount = blockCount * riffData->framesPerBlock;
+    return riffData->samplesPerChannel < frameCount 
+        ? riffData->samplesPerChannel 
+        : frameCount;
+}
+
+int16_t _decodeAlaw(uint8_t value) {
+    // G.711 A-law
+    value ^= 0x55;
+    int16_t segment = (value & 0x70) >> 4;
+    int16_t sample = (value & 0x0F) << 4;
+    sample += segment == 0 ? 8 : 0x108;
+    if (segment > 1) sample <<= segment - 1;
+    return (value & 0x80) ? sample : -sample;
+}
+
+int16_t _decodeMulaw(uint8_t value) {
+    // G.711 µ-law
+    value = ~value;
+    int16_t sample = (((value & 0x0F) << 3) + 0x84) << ((value & 0x70) >> 4);
+    return (value & 0x80) ? 0x84 - sample : sample - 0x84;
+}
+
+int16_t _scaleFloatSample(double sample) {
+    sample *= -(double)INT16_MIN;
+    if (sample >= INT16_MAX) return INT16_MAX;
+    if (sample <= INT16_MIN) return INT16_MIN;
+    return (int16_t)sample;
+}
+
+void _readShortFrames(
+    const _AudioObject *parsed, uint64_t firstFrame, uint32_t frameCount, 
+    int16_t *samples, uint8_t *scratch, int32_t *flacSamples
+) {
+    // Convert the frames to 16 bit samples. ADPCM blocks and FLAC frames
+    // are decoded into scratch first.
+    const AudioRiffData *riffData = &parsed->riffData;
+    uint16_t channelAmount = riffData->channelAmount;
+    size_t sampleCount = (size_t)frameCount * channelAmount;
+    uint16_t bytesPerSample = riffData->blockAlign / channelAmount;
+    const uint8_t *data = riffData->data 
+        + (riffData->format == AUDIO_FORMAT_FLAC || parsed->decoder != NULL 
+            ? 0 
+            : firstFrame * riffData->blockAlign);
+    switch (riffData->format) {
         case WAVE_FORMAT_PCM:
-            expectedFmtSize = FMT_CHUNK_SIZE_PCM - FMT_CHUNK_SIZE_OFFSET;
+            for (size_t i = 0; i < sampleCount; ++i) {
+                samples[i] = _roundTo16Bit(
+                    _readPcmSample(data + i * bytesPerSample, bytesPerSample), 
+                    bytesPerSample * BITS_PER_BYTE
+                );
+            }
             break;
 
         case WAVE_FORMAT_IEEE_FLOAT:
+            for (size_t i = 0; i < sampleCount; ++i) {
+                if (bytesPerSample == sizeof(double)) {
+                    double sample;
+                    memcpy(&sample, data + i * sizeof(double), sizeof(double));
+                    samples[i] = _scaleFloatSample(sample);
+                } else {
+                    float sample;
+                    memcpy(&sample, data + i * sizeof(float), sizeof(float));
+                    samples[i] = _scaleFloatSample(sample);
+                }
+            }
+            break;
+
         case WAVE_FORMAT_ALAW:
+            for (size_t i = 0; i < sampleCount; ++i) samples[i] = _decodeAlaw(data[i]);
+            break;
+
         case WAVE_FORMAT_MULAW:
-            expectedFmtSize = FMT_CHUNK_SIZE_NON_PCM - FMT_CHUNK_SIZE_OFFSET;
+            for (size_t i = 0; i < sampleCount; ++i) samples[i] = _decodeMulaw(data[i]);
             break;
 
-        case WAVE_FORMAT_EXTENSIBLE:
-            expectedFmtSize = FMT_CHUNK_SIZE_EXTENSIBLE - FMT_CHUNK_SIZE_OFFSET;
+        case WAVE_FORMAT_ADPCM:
+        case WAVE_FORMAT_IMA_ADPCM:
+            uint32_t framesPerBlock = riffData->framesPerBlock;
+            uint32_t filled = 0;
+            while (filled < frameCount) {
+                uint64_t block = (firstFrame + filled) / framesPerBlock;
+                uint64_t blockOffset = block * riffData->blockAlign;
+                size_t blockSize = riffData->blockAlign;
+                if (riffData->dataSize - blockOffset < blockSize) {
+                    blockSize = riffData->dataSize - blockOffset;
+                }
+                uint32_t decodedFrames = adpcmDecodeBlock(
+                    &parsed->decoder->format, data + blockOffset, blockSize, 
+                    (int16_t*)scratch
+                );
+                uint32_t frameInBlock = (firstFrame + filled) % framesPerBlock;
+                uint32_t count = decodedFrames > frameInBlock 
+                    ? decodedFrames - frameInBlock 
+                    : 0;
+                if (count > frameCount - filled) count = frameCount - filled;
+                memcpy(
+                    samples + (size_t)filled * channelAmount, 
+                    (int16_t*)scratch + (size_t)frameInBlock * channelAmount, 
+                    (size_t)count * channelAmount * sizeof(int16_t)
+                );
+                // Frames missing from a short last block are silent.
+                if (count == 0) {
+                    memset(
+                        samples + (size_t)filled * channelAmount, 0, 
+                        (size_t)(frameCount - filled) * channelAmount * sizeof(int16_t)
+                    );
+                    count = frameCount - filled;
+                }
+                filled += count;
+            }
             break;
 
-        default:
-            _self->error->type = AUDIO_ERROR_NO_PCM_FORMAT;
-            _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-            return false;
-    }
-    if (fmtChunk->fmtSize != expectedFmtSize) {
-        _self->error->type = AUDIO_ERROR_INVALID_FMT_SIZE;
-        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return false;
+        case AUDIO_FORMAT_FLAC:
+            // The decoded samples are left justified.
+            const FlacInfo *info = &parsed->decoder->flacInfo;
+            flacDecodeFrames(info, firstFrame, frameCount, flacSamples, scratch);
+            if (flacGetSampleSize(info) == sizeof(int16_t)) {
+                memcpy(samples, scratch, sampleCount * sizeof(int16_t));
+            } else {
+                for (size_t i = 0; i < sampleCount; ++i) {
+                    samples[i] = ((int32_t*)scratch)[i] >> 16;
+                }
+            }
+            break;
     }
+}
+
+void _readFloatFrames(
+    const _AudioObject *parsed, uint64_t firstFrame, uint32_t frameCount, 
+    float *samples, int16_t *shortSamples, uint8_t *scratch, int32_t *flacSamples
+) {
+    // Convert the frames to samples with a full scale of 1. Formats that
+    // decode to 16 bit are read into shortSamples first.
+    const AudioRiffData *riffData = &parsed->riffData;
+    uint16_t channelAmount = riffData->channelAmount;
+    size_t sampleCount = (size_t)frameCount * channelAmount;
+    uint16_t bytesPerSample = riffData->blockAlign / channelAmount;
+    const uint8_t *data = riffData->data 
+        + (parsed->decoder != NULL ? 0 : firstFrame * riffData->blockAlign);
+    switch (riffData->format) {
+        case WAVE_FORMAT_PCM:
+            float scale = 1.0f / (float)(1u << (bytesPerSample * BITS_PER_BYTE - 1));
+            for (size_t i = 0; i < sampleCount; ++i) {
+                samples[i] = _readPcmSample(data + i * bytesPerSample, bytesPerSample) 
+                    * scale;
+            }
+            break;
 
-    // Read the fmt chunk extension based on the format
-    switch (_self->riffData.format) {
         case WAVE_FORMAT_IEEE_FLOAT:
-        case WAVE_FORMAT_ALAW:
-        case WAVE_FORMAT_MULAW:
-            AudioNonPcmFmtChunkExtension *nonPcmExtension = 
-            (AudioNonPcmFmtChunkExtension*)(
-                (uint8_t*)fmtChunk + sizeof(AudioFmtChunk)
-            );
-            if (!_readNonPcmFmtChunkExtension(_self, nonPcmExtension)) {
-                return false;
+            for (size_t i = 0; i < sampleCount; ++i) {
+                if (bytesPerSample == sizeof(double)) {
+                    double sample;
+                    memcpy(&sample, data + i * sizeof(double), sizeof(double));
+                    samples[i] = (float)sample;
+                } else {
+                    memcpy(&samples[i], data + i * sizeof(float), sizeof(float));
+                }
             }
             break;
 
-        case WAVE_FORMAT_EXTENSIBLE:
-            AudioExtensibleFmtChunkExtension *extensibleExtension = 
-            (AudioExtensibleFmtChunkExtension*)(
-                (uint8_t*)fmtChunk + sizeof(AudioFmtChunk)
-            );
-            if (!_readExtensibleFmtChunkExtension(_self, extensibleExtension)) {
-                return false;
+        case AUDIO_FORMAT_FLAC:
+            // The decoded samples are left justified.
+            const FlacInfo *info = &parsed->decoder->flacInfo;
+            flacDecodeFrames(info, firstFrame, frameCount, flacSamples, scratch);
+            if (flacGetSampleSize(info) == sizeof(int16_t)) {
+                for (size_t i = 0; i < sampleCount; ++i) {
+                    samples[i] = ((int16_t*)scratch)[i] / -(float)INT16_MIN;
+                }
+            } else {
+                for (size_t i = 0; i < sampleCount; ++i) {
+                    samples[i] = ((int32_t*)scratch)[i] / -(float)INT32_MIN;
+                }
             }
             break;
 
-        case WAVE_FORMAT_PCM:
-            // PCM has no extension
+        default:
+            _readShortFrames(
+                parsed, firstFrame, frameCount, shortSamples, scratch, flacSamples
+            );
+            for (size_t i = 0; i < sampleCount; ++i) {
+                samples[i] = shortSamples[i] / -(float)INT16_MIN;
+            }
             break;
     }
+}
 
-    // Read the rest of the fmt chunk and check if all invariants hold true.
-    _self->riffData.channelAmount = fmtChunk->numChannels;
-    _self->riffData.channelAmount = fmtChunk->numChannels;
-    _self->riffData.sampleRate = fmtChunk->sampleRate;
-    _self->riffData.byteRate = fmtChunk->byteRate;
-    _self->riffData.blockAlign = fmtChunk->blockAlign;
-    _self->riffData.bitsPerSample = fmtChunk->bitsPerSample;
-    if (
-        _self->riffData.byteRate 
-        != _self->riffData.sampleRate 
-            * _self->riffData.channelAmount 
-            * _self->riffData.bitsPerSample / BITS_PER_BYTE
-    ) {
-        _self->error->type = AUDIO_ERROR_INVALID_BYTE_RATE;
-        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return false;
-    }
-    if (
-        _self->riffData.blockAlign 
-        != _self->riffData.channelAmount 
-            * _self->riffData.bitsPerSample / BITS_PER_BYTE
-    ) {
-        _self->error->type = AUDIO_ERROR_INVALID_BLOCK_ALIGN;
-        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return false;
+size_t _getScratchSize(const _AudioObject *parsed, uint32_t frameCount) {
+    // The scratch holds decoded FLAC frames or one decoded ADPCM block.
+    const AudioRiffData *riffData = &parsed->riffData;
+    size_t scratchSize = (size_t)frameCount * riffData->channelAmount 
+        * sizeof(int32_t);
+    if (parsed->decoder != NULL && riffData->format != AUDIO_FORMAT_FLAC) {
+        size_t blockSize = (size_t)riffData->framesPerBlock 
+            * riffData->channelAmount * sizeof(int16_t);
+        if (blockSize > scratchSize) scratchSize = blockSize;
     }
-    return true;
+    return scratchSize;
 }
 
-bool _readRiffFile(_AudioObject *_self, void *rawData, size_t rawDataSize) {
-    // Read entire WAV file and check if all invariants hold true.
+int32_t * _allocFlacSamples(const _AudioObject *parsed) {
+    return (int32_t*)malloc(
+        (size_t)parsed->decoder->flacInfo.maxBlockSize 
+            * parsed->riffData.channelAmount * sizeof(int32_t)
+    );
+}
 
-    // check RIFF header
-    AudioRiffHeader *riffHeader = (AudioRiffHeader*)rawData;
-    if (memcmp(riffHeader->riffMagic, RIFF_MAGIC, MAGIC_SIZE)) {
-        _self->error->type = AUDIO_ERROR_INVALID_RIFF_MAGIC_NUMBER;
-        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return false;
-    }
-    if (memcmp(riffHeader->waveMagic, WAVE_MAGIC, MAGIC_SIZE)) {
-        _self->error->type = AUDIO_ERROR_INVALID_WAVE_MAGIC_NUMBER;
-        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return false;
+void _runOnThreads(
+    void *segments, size_t segmentSize, uint32_t segmentCount, 
+    void * (*loop)(void*)
+) {
+    // Every segment but the last gets a thread. The last one and those
+    // without a thread run on this thread.
+    pthread_t *threads = (pthread_t*)calloc(segmentCount, sizeof(pthread_t));
+    bool *isStarted = (bool*)calloc(segmentCount, sizeof(bool));
+    for (uint32_t i = 0; i < segmentCount; ++i) {
+        void *segment = (uint8_t*)segments + i * segmentSize;
+        bool started = threads != NULL && isStarted != NULL && i + 1 < segmentCount 
+            && !pthread_create(&threads[i], NULL, loop, segment);
+        if (started) {
+            isStarted[i] = true;
+        } else {
+            loop(segment);
+        }
     }
-    if (
-        riffHeader->fileSize 
-        != rawDataSize - (riffHeader->waveMagic - (uint8_t*)riffHeader)
-    ) {
-        _self->error->type = AUDIO_ERROR_INVALID_FILE_SIZE;
-        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return false;
+    for (uint32_t i = 0; isStarted != NULL && i < segmentCount; ++i) {
+        if (isStarted[i]) pthread_join(threads[i], NULL);
     }
+    free(threads);
+    free(isStarted);
+}
 
-    // check and read fmt chunk
-    AudioFmtChunk *fmtChunk = (AudioFmtChunk*)(
-        (uint8_t*)rawData + sizeof(AudioRiffHeader)
-    );
-    if (!_readFmtChunk(_self, fmtChunk)) {
-        return false;
-    }
+uint32_t _getThreadCount(uint32_t threadCount, uint64_t maxThreadCount) {
+    if (threadCount == 0) threadCount = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+    return threadCount > maxThreadCount ? (uint32_t)maxThreadCount : threadCount;
+}
 
-    // look for begin of data chunk
-    size_t dataChunkOffset = sizeof(AudioRiffHeader) + sizeof(AudioFmtChunk);
-    while (memcmp(
-        (uint8_t*)rawData + dataChunkOffset, DATA_MAGIC, MAGIC_SIZE
-    )) {
-        dataChunkOffset++;
-        if (dataChunkOffset >= rawDataSize) {
-            _self->error->type = AUDIO_ERROR_DATA_CHUNK_NOT_FOUND;
-            _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-            return false;
-        }
-    }
+void * _peaksLoop(void *segment) {
+    AudioPeaksSegment *_segment = (AudioPeaksSegment*)segment;
+    const _AudioObject *parsed = _segment->parsed;
+    const AudioRiffData *riffData = &parsed->riffData;
+    uint16_t channelAmount = riffData->channelAmount;
 
-    // check and read data chunk
-    AudioDataChunk *dataChunk = (AudioDataChunk*)(
-        (uint8_t*)rawData + dataChunkOffset
+    int16_t *samples = (int16_t*)malloc(
+        (size_t)PEAKS_TOP_BUCKET_FRAMES * channelAmount * sizeof(int16_t)
     );
-    if (memcmp(dataChunk->dataMagic, DATA_MAGIC, MAGIC_SIZE)) {
-        _self->error->type = AUDIO_ERROR_INVALID_DATA_MAGIC_NUMBER;
-        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return false;
+    uint8_t *scratch = (uint8_t*)malloc(
+        _getScratchSize(parsed, PEAKS_TOP_BUCKET_FRAMES)
+    );
+    int32_t *flacSamples = riffData->format == AUDIO_FORMAT_FLAC 
+        ? _allocFlacSamples(parsed) 
+        : NULL;
+    _segment->isComputed = samples != NULL && scratch != NULL 
+        && (riffData->format != AUDIO_FORMAT_FLAC || flacSamples != NULL);
+
+    for (
+        uint64_t frame = 0; 
+        _segment->isComputed && frame < _segment->frameCount; 
+        frame += PEAKS_TOP_BUCKET_FRAMES
+    ) {
+        uint32_t frameCount = _segment->frameCount - frame < PEAKS_TOP_BUCKET_FRAMES 
+            ? _segment->frameCount - frame 
+            : PEAKS_TOP_BUCKET_FRAMES;
+        _readShortFrames(
+            parsed, _segment->firstFrame + frame, frameCount, samples, scratch, 
+            flacSamples
+        );
+        peaksAddFrames(
+            _segment->peaks, samples, _segment->firstFrame + frame, frameCount
+        );
     }
-    _self->riffData.dataSize = dataChunk->dataSize;
-
-    // This fails if the data chunk is not the last chunk in the file.
-    // TODO: provide a proper check
-
-    // if (
-    //     _self->riffData.dataSize 
-    //     != rawDataSize 
-    //         - dataChunkOffset
-    //         - sizeof(AudioDataChunk)
-    //     ) {
-    //     _self->error->type = AUDIO_ERROR_INVALID_DATA_SIZE;
-    //     _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
-    //     return false;
-    // }
+    free(samples);
+    free(scratch);
+    free(flacSamples);
+    return NULL;
+}
 
-    // This is the pointer to the audio data itself.
-    _self->riffData.data = (uint8_t*)rawData 
-        + sizeof(AudioRiffHeader) 
-        + sizeof(AudioFmtChunk) 
-        + dataChunkOffset
-        + sizeof(AudioDataChunk);
+bool _computePeaks(
+    _AudioPeaks *_self, const _AudioBuffer *buffer, uint32_t threadCount
+) {
+    const AudioRiffData *riffData = &buffer->parsed->riffData;
+    PeaksHeader header = {
+        .sampleRate = riffData->sampleRate,
+        .frameCount = _getPeakFrameCount(buffer),
+        .fileSize = buffer->size,
+        .modificationSeconds = buffer->modificationTime.tv_sec,
+        .modificationNanoseconds = buffer->modificationTime.tv_nsec,
+        .channelAmount = riffData->channelAmount
+    };
+    uint8_t *data = (uint8_t*)malloc(
+        peaksGetSize(header.frameCount, header.channelAmount)
+    );
+    if (data == NULL) return false;
+    peaksInit(&_self->peaks, data, &header);
+
+    // Every thread scans a contiguous range of the coarsest buckets, so
+    // no bucket is shared.
+    uint64_t topBucketCount = (header.frameCount + PEAKS_TOP_BUCKET_FRAMES - 1) 
+        / PEAKS_TOP_BUCKET_FRAMES;
+    threadCount = _getThreadCount(threadCount, topBucketCount);
+    if (threadCount == 0) return true;
+    AudioPeaksSegment *segments = (AudioPeaksSegment*)calloc(
+        threadCount, sizeof(AudioPeaksSegment)
+    );
+    if (segments == NULL) return false;
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        uint64_t firstFrame = topBucketCount * i / threadCount 
+            * PEAKS_TOP_BUCKET_FRAMES;
+        uint64_t endFrame = topBucketCount * (i + 1) / threadCount 
+            * PEAKS_TOP_BUCKET_FRAMES;
+        if (endFrame > header.frameCount) endFrame = header.frameCount;
+        segments[i] = (AudioPeaksSegment){
+            .parsed = buffer->parsed,
+            .peaks = &_self->peaks,
+            .firstFrame = firstFrame,
+            .frameCount = endFrame - firstFrame
+        };
+    }
+    _runOnThreads(segments, sizeof(AudioPeaksSegment), threadCount, _peaksLoop);
+    bool isComputed = true;
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        isComputed = isComputed && segments[i].isComputed;
+    }
+    free(segments);
+    return isComputed;
+}
 
-    // Compute the length of the entire audio in milliseconds
-    _self->riffData.audioLength = _self->riffData.dataSize
-        * MILLISECONDS_PER_SECOND 
-        / (uint64_t)(_self->riffData.byteRate);
+bool _readPeaksFile(
+    _AudioPeaks *_self, const char *sidecarPath, const struct stat *fileStats
+) {
+    int fileDescriptor = open(sidecarPath, O_RDONLY | O_CLOEXEC);
+    if (fileDescriptor == -1) return false;
+    struct stat sidecarStats;
+    uint8_t *data = MAP_FAILED;
+    if (fstat(fileDescriptor, &sidecarStats) == 0 && sidecarStats.st_size > 0) {
+        data = mmap(
+            NULL, sidecarStats.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0
+        );
+    }
+    close(fileDescriptor);
+    if (data == MAP_FAILED) return false;
 
-    // Check if the amount of samples per channel is correct
+    // Peaks of an older version of the audio file are computed again.
+    Peaks *peaks = &_self->peaks;
     if (
-        _self->riffData.samplesPerChannel 
-        != (_self->riffData.sampleRate 
-            * _self->riffData.audioLength) / MILLISECONDS_PER_SECOND
-        && _self->riffData.format != WAVE_FORMAT_PCM
+        !peaksRead(peaks, data, sidecarStats.st_size) 
+        || peaks->header->fileSize != (uint64_t)fileStats->st_size 
+        || peaks->header->modificationSeconds != fileStats->st_mtim.tv_sec 
+        || peaks->header->modificationNanoseconds != fileStats->st_mtim.tv_nsec
     ) {
-        _self->error->type = AUDIO_ERROR_INVALID_SAMPLES_PER_CHANNEL;
-        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        munmap(data, sidecarStats.st_size);
+        *peaks = (Peaks){ 0 };
         return false;
     }
-
+    _self->isMapped = true;
     return true;
 }
 
-bool _setSoundDeviceName(
-    _AudioObject *audioObject, AudioConfiguration *configuration
-) {
-    /* This function determines the name of the audio device used
-    * to play the audio. It can be specifed by the user. If the user
-    * passes NULL it is set to the default device. */
-    if (configuration->soundDeviceName == NULL) {
-        // Use the default name and remember that it was not set by the user.
-        audioObject->soundDeviceName = DEFAULT_SOUND_DEVICE_NAME;
-        audioObject->soundDeviceNameSetByUser = false;
-    } else {
-        // Allocate memory for the device name
-        audioObject->soundDeviceName = (char*)calloc(
-            configuration->soundDeviceNameSize + 1, sizeof(char)
-        );
-        // Fail if allocation failed
-        if (audioObject->soundDeviceName == NULL) {
-            audioObject->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
-            audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-            return false;
+char * _getSidecarPath(const char *path, const char *suffix) {
+    size_t pathSize = strlen(path);
+    size_t suffixSize = strlen(suffix) + 1;
+    char *sidecarPath = (char*)malloc(pathSize + suffixSize);
+    if (sidecarPath == NULL) return NULL;
+    memcpy(sidecarPath, path, pathSize);
+    memcpy(sidecarPath + pathSize, suffix, suffixSize);
+    return sidecarPath;
+}
+
+bool _writeSidecarFile(const char *sidecarPath, const uint8_t *data, size_t size) {
+    // Readers never see a partly written file.
+    char *temporaryPath = _getSidecarPath(sidecarPath, TEMPORARY_SUFFIX);
+    if (temporaryPath == NULL) return false;
+    int fileDescriptor = mkostemp(temporaryPath, O_CLOEXEC);
+    bool success = fileDescriptor != -1;
+    if (success) {
+        // mkostemp() leaves the file to its owner but other programs read it.
+        success = fchmod(fileDescriptor, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == 0;
+        size_t bytesWritten = 0;
+        while (success && bytesWritten < size) {
+            ssize_t result = pwrite(
+                fileDescriptor, data + bytesWritten, size - bytesWritten, 
+                bytesWritten
+            );
+            if (result == -1 && errno == EINTR) continue;
+            success = result > 0;
+            if (success) bytesWritten += result;
         }
-        // Copy the name to the allocatec memory
-        memcpy(
-            audioObject->soundDeviceName, 
-            configuration->soundDeviceName, 
-            configuration->soundDeviceNameSize
-        );
-        // Remember that it was set to free the allocated memory later.
-        audioObject->soundDeviceNameSetByUser = true;
+        success = close(fileDescriptor) == 0 && success;
+        success = success && rename(temporaryPath, sidecarPath) == 0;
+        if (!success) unlink(temporaryPath);
     }
-    return true;
+    free(temporaryPath);
+    return success;
 }
 
-bool _setChannelMap(_AudioObject *audioObject) {
-    // Create a new channel map instance and set the amount of channels.
-    snd_pcm_chmap_t *channelMap = (snd_pcm_chmap_t*)calloc(
-        1, 
-        sizeof(snd_pcm_chmap_t) 
-            + audioObject->riffData.channelAmount 
-            * sizeof(unsigned int)
-    );
-    if (channelMap == NULL) {
-        audioObject->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
-        audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return false;
+AudioPeaks * audioPeaksInit(const char *path, uint32_t threadCount) {
+    _AudioPeaks *peaks = (_AudioPeaks*)calloc(1, sizeof(_AudioPeaks));
+    if (peaks == NULL) { return NULL; }
+    peaks->error = (AudioError*)calloc(1, sizeof(AudioError));
+    char *sidecarPath = _getSidecarPath(path, PEAKS_SUFFIX);
+    if (peaks->error == NULL || sidecarPath == NULL) {
+        free(sidecarPath);
+        audioPeaksDestroy((AudioPeaks*)peaks);
+        return NULL;
     }
-    channelMap->channels = audioObject->riffData.channelAmount;
 
-    // Set the channel positions based on the channel map.
-    if ((audioObject->riffData.channelMap & CHANNEL_MASK_18) == 0) {
-        // If the channel map is 0, use the default channel positions.
-        for (int i = 0; i < audioObject->riffData.channelAmount; ++i) {
-            channelMap->pos[i] = all_channel_positions[i];
-        }
-    } else {
-        for (int i = 0, j = 0; i < CHANNEL_POSITION_COUNT; ++i) {
-            if (audioObject->riffData.channelMap & (1 << i)) {
-                channelMap->pos[j++] = all_channel_positions[i];
-                if (j >= audioObject->riffData.channelAmount) break;
-            }
-        }
+    // A valid sidecar file spares reading the audio file.
+    struct stat fileStats;
+    if (stat(path, &fileStats) == -1) {
+        peaks->error->type = AUDIO_ERROR_FILE_OPEN_FAILED;
+        peaks->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        free(sidecarPath);
+        return (AudioPeaks*)peaks;
     }
-    int error = snd_pcm_set_chmap(audioObject->pcmHandle, channelMap);
-    free(channelMap);
-    // ENXIO means that the device does not support channel mapping.
-    // We don't want to fail in this case.
-    if (error && error != -ENXIO) {  
-        audioObject->error->type = AUDIO_ERROR_ALSA_ERROR;
-        audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        audioObject->error->alsaErrorNumber = error;
-        return false;
+    if (_readPeaksFile(peaks, sidecarPath, &fileStats)) {
+        free(sidecarPath);
+        return (AudioPeaks*)peaks;
     }
-    return true;
+
+    _AudioBuffer *buffer = _mapBuffer(path, 0, true);
+    if (buffer != NULL && buffer->parsed == NULL) {
+        buffer = _finishBuffer(buffer, 0);
+    }
+    bool isAllocated = buffer != NULL;
+    if (buffer != NULL && buffer->parsed->error->level == AUDIO_ERROR_LEVEL_ERROR) {
+        *peaks->error = *buffer->parsed->error;
+    } else if (buffer != NULL && !_computePeaks(peaks, buffer, threadCount)) {
+        isAllocated = false;
+    } else if (buffer != NULL && !_writeSidecarFile(
+        sidecarPath, peaks->peaks.data, peaks->peaks.size
+    )) {
+        peaks->error->type = AUDIO_WARNING_PEAKS_NOT_CACHED;
+        peaks->error->level = AUDIO_ERROR_LEVEL_WARNING;
+    }
+    if (buffer != NULL) _releaseBuffer(buffer);
+    free(sidecarPath);
+    if (!isAllocated) {
+        audioPeaksDestroy((AudioPeaks*)peaks);
+        return NULL;
+    }
+    return (AudioPeaks*)peaks;
 }
 
-AudioObject * audioInit(AudioConfiguration *configuration) {
-    _AudioObject *audioObject = (_AudioObject*)calloc(1, sizeof(_AudioObject));
-    if (audioObject == NULL) { return NULL; }
+void audioPeaksDestroy(AudioPeaks self) {
+    _AudioPeaks *_self = (_AudioPeaks*)self;
+    if (_self->isMapped) {
+        munmap(_self->peaks.data, _self->peaks.size);
+    } else {
+        free(_self->peaks.data);
+    }
+    free(_self->error);
+    free(_self);
+}
 
-    // Initialize the error object
-    audioObject->error = (AudioError*)calloc(1, sizeof(AudioError));
-    if (audioObject->error == NULL) { 
-        free(audioObject);
-        return NULL; 
+AudioError * audioPeaksGetError(AudioPeaks self) {
+    return ((_AudioPeaks*)self)->error;
+}
+
+uint16_t audioPeaksGetChannelAmount(AudioPeaks self) {
+    _AudioPeaks *_self = (_AudioPeaks*)self;
+    return _self->peaks.header != NULL ? _self->peaks.header->channelAmount : 0;
+}
+
+uint32_t audioPeaksGet(
+    AudioPeaks self, enum AudioPeakLevel level, uint32_t startMilliseconds, 
+    uint32_t endMilliseconds, AudioPeak *peaks, uint32_t bucketCapacity
+) {
+    _AudioPeaks *_self = (_AudioPeaks*)self;
+    const Peaks *_peaks = &_self->peaks;
+    if (_peaks->header == NULL || level >= PEAKS_LEVEL_COUNT) return 0;
+
+    // Find the buckets overlapping the range.
+    uint32_t bucketFrames = peaksGetBucketFrames(level);
+    uint32_t sampleRate = _peaks->header->sampleRate;
+    uint64_t firstBucket = (uint64_t)startMilliseconds * sampleRate 
+        / MILLISECONDS_PER_SECOND / bucketFrames;
+    uint64_t endFrame = ((uint64_t)endMilliseconds * sampleRate 
+        + MILLISECONDS_PER_SECOND - 1) / MILLISECONDS_PER_SECOND;
+    uint64_t endBucket = (endFrame + bucketFrames - 1) / bucketFrames;
+    if (endBucket > _peaks->bucketCounts[level]) {
+        endBucket = _peaks->bucketCounts[level];
     }
-    _resetError(audioObject);
+    if (firstBucket >= endBucket) return 0;
+    uint32_t bucketCount = endBucket - firstBucket;
+    if (peaks == NULL) return bucketCount;
+
+    if (bucketCount > bucketCapacity) bucketCount = bucketCapacity;
+    uint16_t channelAmount = _peaks->header->channelAmount;
+    const PeaksBucket *buckets = _peaks->levels[level] + firstBucket * channelAmount;
+    for (size_t i = 0; i < (size_t)bucketCount * channelAmount; ++i) {
+        peaks[i].min = buckets[i].min;
+        peaks[i].max = buckets[i].max;
+        peaks[i].rms = buckets[i].rms;
+    }
+    return bucketCount;
+}
 
-    // Read the input file. From here on in case of an error an incomplete
-    // audioObject is returned containing a error object describing
-    // what went wrong.
-    if (!_readRiffFile(
-        audioObject, configuration->rawData, configuration->rawDataSize
-    )) {
-        return (AudioObject*)audioObject;
+double * _getLoudnessWeights(const AudioRiffData *riffData) {
+    // The channels are placed like _setChannelMap() does. Surround
+    // channels count more and the LFE channel is left out.
+    uint16_t channelAmount = riffData->channelAmount;
+    double *weights = (double*)malloc(channelAmount * sizeof(double));
+    if (weights == NULL) return NULL;
+    for (uint16_t i = 0; i < channelAmount; ++i) weights[i] = 1.0;
+    uint32_t channelMask = riffData->channelMap & CHANNEL_MASK_18;
+    for (int i = 0, j = 0; i < CHANNEL_POSITION_COUNT && j < channelAmount; ++i) {
+        if (channelMask != 0 && !(channelMask & (1 << i))) continue;
+        switch (all_channel_positions[i]) {
+            case SND_CHMAP_LFE: weights[j] = 0.0; break;
+            case SND_CHMAP_RL:
+            case SND_CHMAP_RR:
+            case SND_CHMAP_SL:
+            case SND_CHMAP_SR: weights[j] = 1.41; break;
+            default: break;
+        }
+        ++j;
     }
+    return weights;
+}
 
-    if (!_setSoundDeviceName(audioObject, configuration)) {
-        return (AudioObject*)audioObject;
+void * _loudnessLoop(void *segment) {
+    AudioLoudnessSegment *_segment = (AudioLoudnessSegment*)segment;
+    const _AudioObject *parsed = _segment->parsed;
+    const AudioRiffData *riffData = &parsed->riffData;
+    uint16_t channelAmount = riffData->channelAmount;
+
+    LoudnessMeter meter;
+    bool isInitialized = loudnessInit(
+        &meter, riffData->sampleRate, channelAmount, _segment->weights
+    );
+    float *samples = (float*)malloc(
+        (size_t)LOUDNESS_CHUNK_FRAMES * channelAmount * sizeof(float)
+    );
+    int16_t *shortSamples = (int16_t*)malloc(
+        (size_t)LOUDNESS_CHUNK_FRAMES * channelAmount * sizeof(int16_t)
+    );
+    uint8_t *scratch = (uint8_t*)malloc(
+        _getScratchSize(parsed, LOUDNESS_CHUNK_FRAMES)
+    );
+    int32_t *flacSamples = riffData->format == AUDIO_FORMAT_FLAC 
+        ? _allocFlacSamples(parsed) 
+        : NULL;
+    _segment->isComputed = isInitialized && samples != NULL 
+        && shortSamples != NULL && scratch != NULL 
+        && (riffData->format != AUDIO_FORMAT_FLAC || flacSamples != NULL);
+
+    // A second of frames in front of the range settles the filters, so the
+    // range is measured like in one pass over the file.
+    uint64_t firstFrame = _segment->firstFrame;
+    uint64_t endFrame = firstFrame + _segment->frameCount;
+    uint64_t frame = firstFrame > riffData->sampleRate 
+        ? firstFrame - riffData->sampleRate 
+        : 0;
+    while (_segment->isComputed && frame < endFrame) {
+        if (frame == firstFrame) {
+            loudnessStartMeasuring(
+                &meter, _segment->segmentEnergies + firstFrame / meter.segmentFrames
+            );
+        }
+        uint64_t chunkEnd = frame < firstFrame ? firstFrame : endFrame;
+        uint32_t frameCount = chunkEnd - frame < LOUDNESS_CHUNK_FRAMES 
+            ? chunkEnd - frame 
+            : LOUDNESS_CHUNK_FRAMES;
+        _readFloatFrames(
+            parsed, frame, frameCount, samples, shortSamples, scratch, flacSamples
+        );
+        loudnessAddFrames(&meter, samples, frameCount);
+        frame += frameCount;
     }
+    _segment->truePeak = meter.truePeak;
+    if (isInitialized) loudnessFree(&meter);
+    free(samples);
+    free(shortSamples);
+    free(scratch);
+    free(flacSamples);
+    return NULL;
+}
 
-    // Initialize an ALSA pcm object
-    if ((audioObject->error->alsaErrorNumber = snd_pcm_open(
-        &audioObject->pcmHandle, 
-        audioObject->soundDeviceName, 
-        SND_PCM_STREAM_PLAYBACK, 
-        PCM_BLOCK_MODE
-    )) < 0) {
-        audioObject->error->type = AUDIO_ERROR_ALSA_ERROR;
-        audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return (AudioObject*)audioObject;
+bool _computeLoudness(
+    const _AudioBuffer *buffer, uint32_t threadCount, LoudnessFile *file
+) {
+    // The segments are measured into one array, every thread a contiguous
+    // range of them. Gating needs all of them and follows the join.
+    const AudioRiffData *riffData = &buffer->parsed->riffData;
+    uint64_t frameCount = _getPeakFrameCount(buffer);
+    uint32_t segmentFrames = loudnessGetSegmentFrames(riffData->sampleRate);
+    uint64_t segmentCount = frameCount / segmentFrames;
+    threadCount = _getThreadCount(threadCount, segmentCount > 0 ? segmentCount : 1);
+    double *segmentEnergies = (double*)malloc(
+        (segmentCount > 0 ? segmentCount : 1) * sizeof(double)
+    );
+    double *weights = _getLoudnessWeights(riffData);
+    AudioLoudnessSegment *segments = (AudioLoudnessSegment*)calloc(
+        threadCount, sizeof(AudioLoudnessSegment)
+    );
+    bool isComputed = segmentEnergies != NULL && weights != NULL && segments != NULL;
+    for (uint32_t i = 0; isComputed && i < threadCount; ++i) {
+        uint64_t firstFrame = segmentCount * i / threadCount * segmentFrames;
+        // The last range also holds the frames of an incomplete segment.
+        uint64_t endFrame = i + 1 < threadCount 
+            ? segmentCount * (i + 1) / threadCount * segmentFrames 
+            : frameCount;
+        segments[i] = (AudioLoudnessSegment){
+            .parsed = buffer->parsed,
+            .segmentEnergies = segmentEnergies,
+            .weights = weights,
+            .firstFrame = firstFrame,
+            .frameCount = endFrame - firstFrame
+        };
+    }
+    if (isComputed) {
+        _runOnThreads(
+            segments, sizeof(AudioLoudnessSegment), threadCount, _loudnessLoop
+        );
     }
 
-    // Set the channel map
-    if (!_setChannelMap(audioObject)) {
-        return (AudioObject*)audioObject;
+    float truePeak = 0;
+    for (uint32_t i = 0; isComputed && i < threadCount; ++i) {
+        isComputed = segments[i].isComputed;
+        if (segments[i].truePeak > truePeak) truePeak = segments[i].truePeak;
+    }
+    if (isComputed) {
+        loudnessInitFile(file);
+        file->fileSize = buffer->size;
+        file->modificationSeconds = buffer->modificationTime.tv_sec;
+        file->modificationNanoseconds = buffer->modificationTime.tv_nsec;
+        file->integratedLoudness = loudnessGetIntegrated(
+            segmentEnergies, segmentCount, segmentFrames
+        );
+        file->truePeak = truePeak > 0 ? 20.0 * log10(truePeak) : -INFINITY;
+        isComputed = loudnessGetRange(
+            segmentEnergies, segmentCount, segmentFrames, &file->loudnessRange
+        );
     }
+    free(segmentEnergies);
+    free(weights);
+    free(segments);
+    return isComputed;
+}
 
-    // Allocate space for pcm hardware parameters and initialize them.
-    snd_pcm_hw_params_t *hardwareParameters;
-    snd_pcm_hw_params_alloca(&hardwareParameters);
+bool _readLoudnessFile(
+    LoudnessFile *file, const char *sidecarPath, const struct stat *fileStats
+) {
+    int fileDescriptor = open(sidecarPath, O_RDONLY | O_CLOEXEC);
+    if (fileDescriptor == -1) return false;
+    ssize_t bytesRead = pread(fileDescriptor, file, sizeof(LoudnessFile), 0);
+    close(fileDescriptor);
+
+    // The loudness of an older version of the audio file is measured again.
+    return bytesRead == sizeof(LoudnessFile) 
+        && loudnessIsValidFile(file) 
+        && file->fileSize == (uint64_t)fileStats->st_size 
+        && file->modificationSeconds == fileStats->st_mtim.tv_sec 
+        && file->modificationNanoseconds == fileStats->st_mtim.tv_nsec;
+}
 
-    if ((audioObject->error->alsaErrorNumber = snd_pcm_hw_params_any(
-        audioObject->pcmHandle, hardwareParameters
-    )) < 0) {
-        audioObject->error->type = AUDIO_ERROR_ALSA_ERROR;
-        audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return (AudioObject*)audioObject;
+bool audioAnalyzeLoudness(
+    const char *path, uint32_t threadCount, AudioLoudness *loudness, 
+    AudioError *error
+) {
+    *error = (AudioError){ .level = AUDIO_ERROR_LEVEL_INFO };
+    char *sidecarPath = _getSidecarPath(path, LOUDNESS_SUFFIX);
+    if (sidecarPath == NULL) {
+        error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
     }
 
-    // Tell ALSA that the channels are stored in an interleaved format
-    if ((audioObject->error->alsaErrorNumber = snd_pcm_hw_params_set_access(
-        audioObject->pcmHandle, 
-        hardwareParameters, 
-        SND_PCM_ACCESS_RW_INTERLEAVED
-    )) < 0) {
-        audioObject->error->type = AUDIO_ERROR_ALSA_ERROR;
-        audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return (AudioObject*)audioObject;
+    // A valid sidecar file spares reading the audio file.
+    LoudnessFile file;
+    struct stat fileStats;
+    bool success = stat(path, &fileStats) == 0;
+    if (!success) {
+        error->type = AUDIO_ERROR_FILE_OPEN_FAILED;
+        error->level = AUDIO_ERROR_LEVEL_ERROR;
+    } else if (!_readLoudnessFile(&file, sidecarPath, &fileStats)) {
+        _AudioBuffer *buffer = _mapBuffer(path, 0, true);
+        if (buffer != NULL && buffer->parsed == NULL) {
+            buffer = _finishBuffer(buffer, 0);
+        }
+        success = buffer != NULL;
+        if (!success) {
+            error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+            error->level = AUDIO_ERROR_LEVEL_ERROR;
+        } else if (buffer->parsed->error->level == AUDIO_ERROR_LEVEL_ERROR) {
+            *error = *buffer->parsed->error;
+            success = false;
+        } else if (!_computeLoudness(buffer, threadCount, &file)) {
+            error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+            error->level = AUDIO_ERROR_LEVEL_ERROR;
+            success = false;
+        } else if (!_writeSidecarFile(
+            sidecarPath, (const uint8_t*)&file, sizeof(LoudnessFile)
+        )) {
+            error->type = AUDIO_WARNING_LOUDNESS_NOT_CACHED;
+            error->level = AUDIO_ERROR_LEVEL_WARNING;
+        }
+        if (buffer != NULL) _releaseBuffer(buffer);
     }
+    free(sidecarPath);
+    if (!success) return false;
 
-    // Determine the pcm format from the WAV format and the bits per sample
-    snd_pcm_format_t format;
-    switch (audioObject->riffData.format) {
-        case WAVE_FORMAT_PCM:
-            switch (audioObject->riffData.bitsPerSample) {
-                case 8:  format = SND_PCM_FORMAT_U8;         break;
-                case 16: format = SND_PCM_FORMAT_S16_LE;     break;
-                case 24: format = SND_PCM_FORMAT_S24_3LE;    break;
-                case 32: format = SND_PCM_FORMAT_S32_LE;     break;
-                default:
-                    audioObject->error->type = AUDIO_UNSUPPORTED_BITS_PER_SAMPLE;
-                    audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-                    return (AudioObject*)audioObject;
-            }
-            break;
+    loudness->integratedLoudness = file.integratedLoudness;
+    loudness->loudnessRange = file.loudnessRange;
+    loudness->truePeak = file.truePeak;
+    return true;
+}
 
-        case WAVE_FORMAT_IEEE_FLOAT:
-            switch (audioObject->riffData.bitsPerSample) {
-                case 32: format = SND_PCM_FORMAT_FLOAT_LE; break;
-                case 64: format = SND_PCM_FORMAT_FLOAT64_LE; break;
-                default:
-                    audioObject->error->type = AUDIO_UNSUPPORTED_BITS_PER_SAMPLE;
-                    audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-                    return (AudioObject*)audioObject;
-            }
-            break;
+bool _readProbeHeader(
+    int fileDescriptor, size_t size, uint8_t **header, size_t *headerSize
+) {
+    // The header grows, so the bytes read before are kept. The parser
+    // reads the fixed size chunks of short files beyond their end, which
+    // is zeroed padding here.
+    uint8_t *grown = (uint8_t*)realloc(*header, size + PROBE_HEADER_PADDING);
+    if (grown == NULL) return false;
+    *header = grown;
+    memset(grown + size, 0, PROBE_HEADER_PADDING);
+    while (*headerSize < size) {
+        ssize_t result = pread(
+            fileDescriptor, grown + *headerSize, size - *headerSize, *headerSize
+        );
+        if (result == -1 && errno == EINTR) continue;
+        if (result <= 0) return false;
+        *headerSize += result;
+    }
+    return true;
+}
 
-        case WAVE_FORMAT_ALAW:
-            switch (audioObject->riffData.bitsPerSample) {
-                case 8: format = SND_PCM_FORMAT_A_LAW; break;
-                default:
-                    audioObject->error->type = AUDIO_UNSUPPORTED_BITS_PER_SAMPLE;
-                    audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-                    return (AudioObject*)audioObject;
-            }
+void _probeChunks(
+    AudioProbe *probe, int fileDescriptor, const uint8_t *header, 
+    size_t headerSize
+) {
+    // Chunk headers behind the read header pages, e.g. behind the data
+    // chunk, are read on their own.
+    uint64_t offset = sizeof(AudioRiffHeader);
+    while (
+        probe->chunkCount < AUDIO_PROBE_MAX_CHUNKS 
+        && offset + sizeof(AudioChunkHeader) <= probe->fileSize
+    ) {
+        AudioChunkHeader chunkHeader;
+        if (offset + sizeof(AudioChunkHeader) <= headerSize) {
+            memcpy(&chunkHeader, header + offset, sizeof(AudioChunkHeader));
+        } else if (pread(
+            fileDescriptor, &chunkHeader, sizeof(AudioChunkHeader), offset
+        ) != sizeof(AudioChunkHeader)) {
             break;
+        }
+        AudioChunk *chunk = &probe->chunks[probe->chunkCount++];
+        memcpy(chunk->id, chunkHeader.magic, MAGIC_SIZE);
+        chunk->size = chunkHeader.size;
+        chunk->offset = offset;
+        offset += sizeof(AudioChunkHeader) + chunkHeader.size + (chunkHeader.size & 1);
+    }
+}
 
-        case WAVE_FORMAT_MULAW:
-            switch (audioObject->riffData.bitsPerSample) {
-                case 8: format = SND_PCM_FORMAT_MU_LAW; break;
-                default:
-                    audioObject->error->type = AUDIO_UNSUPPORTED_BITS_PER_SAMPLE;
-                    audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-                    return (AudioObject*)audioObject;
-            }
-            break;
+void _describeProbe(
+    AudioProbe *probe, _AudioObject *parsed, int fileDescriptor, 
+    const uint8_t *header, size_t headerSize
+) {
+    const AudioRiffData *riffData = &parsed->riffData;
+    probe->format = riffData->format;
+    probe->channelAmount = riffData->channelAmount;
+    probe->bitsPerSample = riffData->bitsPerSample;
+    probe->sampleRate = riffData->sampleRate;
+    probe->dataSize = riffData->dataSize;
+    if (parsed->decoder != NULL) {
+        probe->frameCount = riffData->samplesPerChannel;
+    } else if (riffData->blockAlign > 0) {
+        probe->frameCount = riffData->dataSize / riffData->blockAlign;
+    }
+    probe->durationMilliseconds = riffData->audioLength;
+    probe->cueCount = parsed->cueCount;
+    if (riffData->format != AUDIO_FORMAT_FLAC) {
+        _probeChunks(probe, fileDescriptor, header, headerSize);
+    }
 
-        default:
-            audioObject->error->type = AUDIO_UNSUPPORTED_FORMAT;
-            audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-            return (AudioObject*)audioObject;
+    // The format has to be playable as well.
+    snd_pcm_format_t format;
+    _getPcmFormat(parsed, &format);
+}
+
+bool audioProbe(const char *path, AudioProbe *probe) {
+    *probe = (AudioProbe){ .error.level = AUDIO_ERROR_LEVEL_INFO };
+    int fileDescriptor = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat fileStats;
+    if (fileDescriptor == -1 || fstat(fileDescriptor, &fileStats) == -1) {
+        if (fileDescriptor != -1) close(fileDescriptor);
+        probe->error.type = AUDIO_ERROR_FILE_OPEN_FAILED;
+        probe->error.level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    probe->fileSize = fileStats.st_size;
+    _AudioObject *parsed = _allocAudioObject();
+    if (parsed == NULL) {
+        close(fileDescriptor);
+        probe->error.type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        probe->error.level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
     }
 
-    if ((audioObject->error->alsaErrorNumber = snd_pcm_hw_params_set_format(
-        audioObject->pcmHandle, hardwareParameters, format
-    )) < 0) {
-        audioObject->error->type = AUDIO_ERROR_ALSA_ERROR;
-        audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return (AudioObject*)audioObject;
+    // Only the header pages are read. Files with large chunks in front of
+    // the data or large FLAC metadata are read further.
+    uint8_t *header = NULL;
+    size_t headerSize = 0;
+    size_t size = STREAM_HEADER_SIZE;
+    while (true) {
+        if (size > probe->fileSize) size = probe->fileSize;
+        if (!_readProbeHeader(fileDescriptor, size, &header, &headerSize)) {
+            parsed->error->type = AUDIO_ERROR_FILE_MAP_FAILED;
+            parsed->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            break;
+        }
+        if (_readAudioData(parsed, header, probe->fileSize, headerSize)) {
+            _describeProbe(probe, parsed, fileDescriptor, header, headerSize);
+            break;
+        }
+        bool isIncomplete = parsed->error->type == AUDIO_ERROR_DATA_CHUNK_NOT_FOUND 
+            || parsed->error->type == AUDIO_ERROR_INVALID_FLAC_STREAM;
+        if (!isIncomplete || size == probe->fileSize || size >= PROBE_MAX_HEADER_SIZE) {
+            break;
+        }
+        // The next attempt parses from scratch.
+        _freeParsedData(parsed);
+        parsed = _allocAudioObject();
+        if (parsed == NULL) {
+            free(header);
+            close(fileDescriptor);
+            probe->error.type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+            probe->error.level = AUDIO_ERROR_LEVEL_ERROR;
+            return false;
+        }
+        size *= 2;
     }
+    probe->error = *parsed->error;
+    _freeParsedData(parsed);
+    free(header);
+    close(fileDescriptor);
+    return probe->error.level != AUDIO_ERROR_LEVEL_ERROR;
+}
 
-    // Set the amount of channels (1 in mono, 2 is stereo, ...)
-    if ((audioObject->error->alsaErrorNumber = snd_pcm_hw_params_set_channels(
-        audioObject->pcmHandle, 
-        hardwareParameters, 
-        audioObject->riffData.channelAmount
-    )) < 0) {
-        audioObject->error->type = AUDIO_ERROR_ALSA_ERROR;
-        audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return (AudioObject*)audioObject;
+void * _probeLoop(void *segment) {
+    AudioProbeSegment *_segment = (AudioProbeSegment*)segment;
+    uint32_t path;
+    while ((path = atomic_fetch_add(_segment->nextPath, 1)) < _segment->pathCount) {
+        audioProbe(_segment->paths[path], &_segment->probes[path]);
     }
+    return NULL;
+}
 
-    // Set the sample rate
-    if ((audioObject->error->alsaErrorNumber = snd_pcm_hw_params_set_rate(
-        audioObject->pcmHandle, 
-        hardwareParameters, 
-        audioObject->riffData.sampleRate, 
-        PCM_SEARCH_DIRECTION_NEAR
-    )) < 0) {
-        audioObject->error->type = AUDIO_ERROR_ALSA_ERROR;
-        audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return (AudioObject*)audioObject;
+void audioProbeFiles(
+    const char **paths, uint32_t pathCount, uint32_t threadCount, 
+    AudioProbe *probes
+) {
+    // Without memory for the threads every file is probed here.
+    _Atomic uint32_t nextPath = 0;
+    AudioProbeSegment segment = {
+        .paths = paths,
+        .probes = probes,
+        .nextPath = &nextPath,
+        .pathCount = pathCount
+    };
+    threadCount = _getThreadCount(threadCount, pathCount);
+    AudioProbeSegment *segments = threadCount > 0 
+        ? (AudioProbeSegment*)calloc(threadCount, sizeof(AudioProbeSegment)) 
+        : NULL;
+    if (segments == NULL) {
+        _probeLoop(&segment);
+        return;
     }
+    for (uint32_t i = 0; i < threadCount; ++i) segments[i] = segment;
+    _runOnThreads(segments, sizeof(AudioProbeSegment), threadCount, _probeLoop);
+    free(segments);
+}
 
-    // Set the ALSA ring buffer size
-    snd_pcm_uframes_t bufferSizeInSamples = audioObject->riffData.sampleRate 
-        * BUFFER_SIZE_FACTOR
-        * configuration->timeResolution
-        / MILLISECONDS_PER_SECOND;
-    audioObject->alsaBufferSize = bufferSizeInSamples;
-    if ((audioObject->error->alsaErrorNumber = snd_pcm_hw_params_set_buffer_size(
-        audioObject->pcmHandle, hardwareParameters, bufferSizeInSamples
-    )) < 0) {
-        audioObject->error->type = AUDIO_ERROR_ALSA_ERROR;
-        audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return (AudioObject*)audioObject;
+void * _batchLoop(void *batch) {
+    _AudioBatch *_batch = (_AudioBatch*)batch;
+    uint32_t index;
+    while (
+        (index = atomic_fetch_add(&_batch->nextConfiguration, 1)) 
+            < _batch->configurationCount
+    ) {
+        // The callback comes first, so audioBatchWait() returns after the last one.
+        AudioObject object = audioInit(&_batch->configurations[index]);
+        if (_batch->callback != NULL) {
+            _batch->callback(_batch->userData, index, object);
+        }
+        pthread_mutex_lock(&_batch->lock);
+        _batch->objects[index] = object;
+        _batch->isReady[index] = true;
+        _batch->readyIndices[_batch->readyCount++] = index;
+        if (_batch->fileDescriptor != -1) {
+            uint64_t value = 1;
+            ssize_t result = write(_batch->fileDescriptor, &value, sizeof(value));
+            (void)result;
+        }
+        if (_batch->readyCount == _batch->configurationCount) {
+            pthread_cond_broadcast(&_batch->readyCondition);
+        }
+        pthread_mutex_unlock(&_batch->lock);
     }
+    return NULL;
+}
 
-    // Put the parameters into the pcm object
-    if ((audioObject->error->alsaErrorNumber = snd_pcm_hw_params(
-        audioObject->pcmHandle, hardwareParameters
-    )) < 0) {
-        audioObject->error->type = AUDIO_ERROR_ALSA_ERROR;
-        audioObject->error->level = AUDIO_ERROR_LEVEL_ERROR;
-        return (AudioObject*)audioObject;
+AudioBatch audioInitBatch(
+    AudioConfiguration *configurations, uint32_t configurationCount, 
+    uint32_t threadCount, AudioBatchCallback callback, void *userData
+) {
+    _AudioBatch *batch = (_AudioBatch*)calloc(1, sizeof(_AudioBatch));
+    if (batch == NULL) return NULL;
+    size_t allocationCount = configurationCount > 0 ? configurationCount : 1;
+    threadCount = _getThreadCount(threadCount, allocationCount);
+    batch->objects = (AudioObject*)calloc(allocationCount, sizeof(AudioObject));
+    batch->isReady = (Bool8*)calloc(allocationCount, sizeof(Bool8));
+    batch->readyIndices = (uint32_t*)calloc(allocationCount, sizeof(uint32_t));
+    batch->threads = (pthread_t*)calloc(threadCount, sizeof(pthread_t));
+    if (
+        batch->objects == NULL || batch->isReady == NULL 
+        || batch->readyIndices == NULL || batch->threads == NULL
+    ) {
+        free(batch->objects);
+        free(batch->isReady);
+        free(batch->readyIndices);
+        free(batch->threads);
+        free(batch);
+        return NULL;
+    }
+    batch->configurations = configurations;
+    batch->configurationCount = configurationCount;
+    batch->callback = callback;
+    batch->userData = userData;
+    batch->fileDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pthread_mutex_init(&batch->lock, NULL);
+    pthread_cond_init(&batch->readyCondition, NULL);
+
+    // Without any worker thread every object is initialized here.
+    while (
+        batch->threadCount < threadCount
+        && !pthread_create(
+            &batch->threads[batch->threadCount], NULL, _batchLoop, batch
+        )
+    ) {
+        ++batch->threadCount;
     }
+    if (batch->threadCount == 0) _batchLoop(batch);
+    return (AudioBatch)batch;
+}
 
-    // Set the remaining members of the audioObject. For explanation see
-    // the type definition.
+int audioBatchGetFd(AudioBatch self) {
+    return ((_AudioBatch*)self)->fileDescriptor;
+}
 
-    audioObject->timeResolution = configuration->timeResolution;
-    audioObject->currentFrame = 0;
-    audioObject->lastFrame = audioObject->riffData.dataSize 
-        / audioObject->riffData.blockAlign;
+uint32_t audioBatchReadObjects(AudioBatch self, uint32_t *indices, uint32_t maxIndexCount) {
+    _AudioBatch *batch = (_AudioBatch*)self;
+    pthread_mutex_lock(&batch->lock);
+    uint64_t value;
+    if (batch->fileDescriptor != -1) {
+        ssize_t result = read(batch->fileDescriptor, &value, sizeof(value));
+        (void)result;
+    }
+    uint32_t indexCount = batch->readyCount - batch->readCount;
+    if (indexCount > maxIndexCount) indexCount = maxIndexCount;
+    memcpy(indices, &batch->readyIndices[batch->readCount], indexCount * sizeof(uint32_t));
+    batch->readCount += indexCount;
+    if (batch->readCount != batch->readyCount && batch->fileDescriptor != -1) {
+        value = 1;
+        ssize_t result = write(batch->fileDescriptor, &value, sizeof(value));
+        (void)result;
+    }
+    pthread_mutex_unlock(&batch->lock);
+    return indexCount;
+}
+
+bool audioBatchGetObject(AudioBatch self, uint32_t index, AudioObject *object) {
+    _AudioBatch *batch = (_AudioBatch*)self;
+    if (index >= batch->configurationCount) return false;
+    pthread_mutex_lock(&batch->lock);
+    bool isReady = batch->isReady[index];
+    *object = batch->objects[index];
+    pthread_mutex_unlock(&batch->lock);
+    return isReady;
+}
 
-    audioObject->thread = (pthread_t*)calloc(1, sizeof(pthread_t));
-    audioObject->externalBarrier = NULL;
-    audioObject->internalBarrier = (pthread_barrier_t*)calloc(
-        1, sizeof(pthread_barrier_t)
-    );
-    audioObject->actionLock = (pthread_mutex_t*)calloc(
-        1, sizeof(pthread_mutex_t)
-    );
-    pthread_mutex_init(audioObject->actionLock, NULL);
+uint32_t audioBatchWait(AudioBatch self) {
+    _AudioBatch *batch = (_AudioBatch*)self;
+    pthread_mutex_lock(&batch->lock);
+    while (batch->readyCount < batch->configurationCount) {
+        pthread_cond_wait(&batch->readyCondition, &batch->lock);
+    }
+    pthread_mutex_unlock(&batch->lock);
+    return batch->configurationCount;
+}
 
-    audioObject->isPlaying = false;
-    audioObject->isPaused = false;
+void audioBatchDestroy(AudioBatch self) {
+    _AudioBatch *batch = (_AudioBatch*)self;
+    for (uint32_t i = 0; i < batch->threadCount; ++i) {
+        pthread_join(batch->threads[i], NULL);
+    }
+    if (batch->fileDescriptor != -1) close(batch->fileDescriptor);
+    pthread_mutex_destroy(&batch->lock);
+    pthread_cond_destroy(&batch->readyCondition);
+    free(batch->objects);
+    free(batch->isReady);
+    free(batch->readyIndices);
+    free(batch->threads);
+    free(batch);
+}
 
-    audioObject->playFlag = false;
-    audioObject->pauseFlag = false;
-    audioObject->stopFlag = false;
-    audioObject->haltFlag = false;
-    audioObject->jumpFlag = false;
-    audioObject->jumpTarget = 0;
+void _freeCuePreload(AudioCuePreload *cuePreload) {
+    // Unmapping unlocks as well.
+    if (cuePreload->frames != NULL) munmap(cuePreload->frames, cuePreload->size);
+    *cuePreload = (AudioCuePreload){ 0 };
+}
 
-    // Start the audio thread and return the assembled object
-    pthread_create(audioObject->thread, NULL, _mainloop, (void*)audioObject);
-    return (AudioObject)audioObject;
+void _closeOutput(_AudioObject *_self) {
+    // A configured output that was not linked to added devices goes back
+    // to the pool.
+    if (_self->isOutputConfigured && _self->deviceCount == 0) {
+        snd_pcm_chmap_t *channelMap = _getChannelMap(_self);
+        if (channelMap != NULL) {
+            BackendParameters parameters;
+            _getBackendParameters(_self, channelMap, &parameters);
+            bool isPooled = poolCheckIn(
+                _self->output, _self->soundDeviceName, &parameters
+            );
+            free(channelMap);
+            if (isPooled) return;
+        }
+    }
+    backendClose(_self->output);
 }
 
 void audioDestroy(AudioObject self) {
@@ -890,13 +5390,14 @@ void audioDestroy(AudioObject self) {
 
     _self->haltFlag = true;
     if (_self->thread) {
+        backendWake(_self->output);
         pthread_join(*(_self->thread), NULL);
         free(_self->thread);
     }
     
-    if (_self->pcmHandle) {
-        snd_pcm_drop(_self->pcmHandle);
-        snd_pcm_close(_self->pcmHandle);
+    if (_self->output) _closeOutput(_self);
+    for (uint32_t i = 0; i < _self->deviceCount; ++i) {
+        _closeDevice(&_self->devices[i]);
     }
 
     if (_self->externalBarrier) {
@@ -907,6 +5408,45 @@ void audioDestroy(AudioObject self) {
         pthread_mutex_destroy(_self->actionLock);
         free(_self->actionLock);
     }
+    if (_self->markerLock) {
+        pthread_mutex_destroy(_self->markerLock);
+        free(_self->markerLock);
+    }
+    if (_self->segmentLock) {
+        pthread_mutex_destroy(_self->segmentLock);
+        free(_self->segmentLock);
+    }
+    if (_self->events.fileDescriptor != -1) close(_self->events.fileDescriptor);
+
+    // The FLAC stream reads the loader's mapping, so it is closed first.
+    if (_self->decoder && _self->decoder->flacStream) {
+        flacStreamClose(_self->decoder->flacStream);
+    }
+    if (_self->loader) _freeLoader(_self->loader);
+    if (_self->decoder) {
+        flacFreeInfo(&_self->decoder->flacInfo);
+        free(_self->decoder->frames);
+        free(_self->decoder->samples);
+        free(_self->decoder);
+    }
+    free(_self->compactData);
+    free(_self->gainFrames);
+    free(_self->cues);
+    free(_self->markers);
+    free(_self->pendingMarkers);
+    if (_self->trace) traceFree(_self->trace);
+    _freeCuePreload(&_self->cuePreload);
+    _freeCuePreload(&_self->pendingCuePreload);
+    free(_self->loop.frames);
+    free(_self->gatherFrames);
+    for (uint32_t i = 0; i < _self->segmentCount; ++i) {
+        _releaseBuffer(_self->segments[i].buffer);
+    }
+    free(_self->segments);
+    if (_self->replacement.buffer) _releaseBuffer(_self->replacement.buffer);
+    free(_self->fadeFrames);
+    // The buffer's data may be read by the loader and the decoder until here.
+    if (_self->buffer) _releaseBuffer(_self->buffer);
 
     if (_self->soundDeviceNameSetByUser) free(_self->soundDeviceName);
     if (_self->error) free(_self->error);
@@ -931,6 +5471,7 @@ bool _lockAction(
     }
 
     // If an external barrier is used, wait for it.
+    backendGetTime(_self->output, &_self->actionTime);
     _self->externalBarrier = barrier;
     pthread_barrier_init(
         _self->internalBarrier, NULL, INTERNAL_BARRIER_COUNT
@@ -944,6 +5485,7 @@ bool _lockAction(
 */
 void _unlockAction(_AudioObject *_self) {
     // wait for the audio thread to process the action
+    backendWake(_self->output);
     pthread_barrier_wait(_self->internalBarrier);
     pthread_barrier_destroy(_self->internalBarrier);
 
@@ -996,49 +5538,817 @@ void audioStop(AudioObject self, pthread_barrier_t *barrier) {
     _unlockAction(_self);
 }
 
+uint32_t _getTotalMilliseconds(_AudioObject *_self) {
+    // The segments are counted from the frame behind the audio data.
+    uint32_t sampleRate = _self->riffData.sampleRate;
+    uint32_t dataMilliseconds = _self->replacement.buffer != NULL 
+        ? _self->replacement.buffer->parsed->riffData.audioLength 
+        : _self->riffData.audioLength;
+    return dataMilliseconds 
+        + (uint64_t)_self->lastFrame * MILLISECONDS_PER_SECOND / sampleRate 
+        - (uint64_t)_self->dataFrameCount * MILLISECONDS_PER_SECOND / sampleRate;
+}
+
 bool audioJump(
     AudioObject self, pthread_barrier_t *barrier, uint32_t milliseconds
 ) {
     _AudioObject *_self = (_AudioObject*)self;
     _resetError(_self);
+    if (milliseconds > _getTotalMilliseconds(_self)) {
+        _self->error->type = AUDIO_WARNING_JUMPED_BEYOND_END;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
     _lockAction(_self, barrier, true);
 
     _self->jumpFlag = true;
-    if (milliseconds > _self->riffData.audioLength) {
-        _self->error->type = AUDIO_WARNING_JUMPED_BEYOND_END;
+    _self->jumpTarget = (uint64_t)milliseconds * _self->riffData.sampleRate 
+        / MILLISECONDS_PER_SECOND;
+    _self->jumpCue = NO_CUE;
+
+    _unlockAction(_self);
+    return true;
+}
+
+const AudioCue * audioGetCues(AudioObject self, uint32_t *cueCount) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    *cueCount = _self->cueCount;
+    return _self->cueCount > 0 ? _self->cues : NULL;
+}
+
+bool audioJumpToCue(AudioObject self, pthread_barrier_t *barrier, uint32_t id) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    uint32_t cue = 0;
+    while (cue < _self->cueCount && _self->cues[cue].id != id) ++cue;
+    if (cue == _self->cueCount) {
+        _self->error->type = AUDIO_WARNING_CUE_NOT_FOUND;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    _lockAction(_self, barrier, true);
+
+    _self->jumpFlag = true;
+    _self->jumpTarget = _self->cues[cue].frame;
+    _self->jumpCue = cue;
+
+    _unlockAction(_self);
+    return true;
+}
+
+bool _copyEncodedData(
+    _AudioObject *_self, uint64_t offset, uint8_t *bytes, size_t size
+) {
+    // Streamed data is read from the file, everything else is in memory
+    // or mapped.
+    AudioLoader *loader = _self->loader;
+    if (loader->stream == NULL || _self->compactData != NULL) {
+        memcpy(bytes, _self->riffData.data + offset, size);
+        return true;
+    }
+    uint64_t fileOffset = (_self->riffData.data - loader->mapping) + offset;
+    size_t bytesRead = 0;
+    while (bytesRead < size) {
+        ssize_t result = pread(
+            loader->fileDescriptor, bytes + bytesRead, size - bytesRead, 
+            fileOffset + bytesRead
+        );
+        if (result == -1 && errno == EINTR) continue;
+        if (result <= 0) return false;
+        bytesRead += result;
+    }
+    return true;
+}
+
+bool _readFrames(
+    _AudioObject *_self, uint32_t frame, uint32_t frameCount, uint8_t *frames, 
+    uint8_t *scratch
+) {
+    // Copy or decode frameCount frames starting at frame.
+    AudioDecoder *decoder = _self->decoder;
+    if (decoder == NULL) {
+        return _copyEncodedData(
+            _self, (uint64_t)frame * _self->riffData.blockAlign, frames, 
+            (size_t)frameCount * _self->riffData.blockAlign
+        );
+    }
+    uint32_t framesPerBlock = _self->riffData.framesPerBlock;
+    uint32_t filled = 0;
+    while (filled < frameCount) {
+        uint64_t block = (frame + filled) / framesPerBlock;
+        uint32_t decodedFrames;
+        if (decoder->samples != NULL) {
+            decodedFrames = flacDecodeFrame(
+                &decoder->flacInfo, decoder->flacInfo.seekPoints[block].offset, 
+                decoder->samples, scratch
+            );
+        } else {
+            uint64_t blockOffset = block * _self->riffData.blockAlign;
+            size_t blockSize = _self->riffData.blockAlign;
+            if (_self->riffData.dataSize - blockOffset < blockSize) {
+                blockSize = _self->riffData.dataSize - blockOffset;
+            }
+            uint8_t *encodedBlock = scratch 
+                + (size_t)framesPerBlock * decoder->frameSize;
+            if (!_copyEncodedData(_self, blockOffset, encodedBlock, blockSize)) {
+                return false;
+            }
+            decodedFrames = adpcmDecodeBlock(
+                &decoder->format, encodedBlock, blockSize, (int16_t*)scratch
+            );
+        }
+        uint32_t frameInBlock = (frame + filled) % framesPerBlock;
+        if (frameInBlock >= decodedFrames) return false;
+        uint32_t count = decodedFrames - frameInBlock;
+        if (count > frameCount - filled) count = frameCount - filled;
+        memcpy(
+            frames + (size_t)filled * decoder->frameSize, 
+            scratch + (size_t)frameInBlock * decoder->frameSize, 
+            (size_t)count * decoder->frameSize
+        );
+        filled += count;
+    }
+    return true;
+}
+
+bool audioSetCuePreload(AudioObject self, uint32_t milliseconds) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    if (_self->thread == NULL) return false;
+    AudioDecoder *decoder = _self->decoder;
+    // Native FLAC files have no cue chunk.
+    if (decoder != NULL && decoder->flacStream != NULL) return false;
+
+    // The frames of all cue points are kept in one mapping.
+    AudioCuePreload cuePreload = { 0 };
+    size_t frameSize = decoder != NULL 
+        ? decoder->frameSize 
+        : _self->riffData.blockAlign;
+    cuePreload.frameCount = (uint64_t)milliseconds * _self->riffData.sampleRate 
+        / MILLISECONDS_PER_SECOND;
+    cuePreload.size = (size_t)_self->cueCount * cuePreload.frameCount * frameSize;
+    bool success = true;
+    if (cuePreload.size > 0) {
+        cuePreload.frames = (uint8_t*)mmap(
+            NULL, cuePreload.size, PROT_READ | PROT_WRITE, 
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+        );
+        // The scratch holds one decoded and one encoded block.
+        uint8_t *scratch = NULL;
+        if (cuePreload.frames == MAP_FAILED) {
+            cuePreload.frames = NULL;
+        } else if (decoder != NULL) {
+            scratch = (uint8_t*)malloc(
+                (size_t)_self->riffData.framesPerBlock * decoder->frameSize 
+                    + _self->riffData.blockAlign
+            );
+        }
+        success = cuePreload.frames != NULL && (decoder == NULL || scratch != NULL);
+        for (uint32_t cue = 0; success && cue < _self->cueCount; ++cue) {
+            // The frames behind the last cue point may end early.
+            uint32_t frameCount = cuePreload.frameCount;
+            if (_self->cues[cue].frame >= _self->dataFrameCount) {
+                frameCount = 0;
+            } else if (frameCount > _self->dataFrameCount - _self->cues[cue].frame) {
+                frameCount = _self->dataFrameCount - _self->cues[cue].frame;
+            }
+            success = _readFrames(
+                _self, _self->cues[cue].frame, frameCount, 
+                cuePreload.frames + (size_t)cue * cuePreload.frameCount * frameSize, 
+                scratch
+            );
+        }
+        free(scratch);
+        if (!success) {
+            _freeCuePreload(&cuePreload);
+            _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+            _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        } else {
+            cuePreload.isLocked = mlock(cuePreload.frames, cuePreload.size) == 0;
+            if (!cuePreload.isLocked) {
+                _self->error->type = AUDIO_WARNING_LOCKED_WINDOW_REDUCED;
+                _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+            }
+        }
+    }
+
+    // The audio thread hands the frames it played from back.
+    _lockAction(_self, NULL, true);
+    _self->pendingCuePreload = cuePreload;
+    _self->cuePreloadFlag = true;
+    _unlockAction(_self);
+    _freeCuePreload(&_self->pendingCuePreload);
+    return success && cuePreload.size > 0;
+}
+
+bool audioGetFileLoop(AudioObject self, AudioLoop *loop) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    if (!_self->hasFileLoop) {
+        _self->error->type = AUDIO_WARNING_NO_LOOP;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    *loop = _self->fileLoop;
+    return true;
+}
+
+bool _crossfadeLoop(_AudioObject *_self, AudioLoopRegion *loop) {
+    // The last frames of the loop fade linearly into the frames in front
+    // of its start, which lead into the start without a seam.
+    AudioDecoder *decoder = _self->decoder;
+    size_t frameSize = decoder != NULL 
+        ? decoder->frameSize 
+        : _self->riffData.blockAlign;
+    size_t size = (size_t)loop->seamFrameCount * frameSize;
+    uint8_t *before = (uint8_t*)malloc(size);
+    uint8_t *scratch = NULL;
+    if (decoder != NULL) {
+        scratch = (uint8_t*)malloc(
+            (size_t)_self->riffData.framesPerBlock * decoder->frameSize 
+                + _self->riffData.blockAlign
+        );
+    }
+    bool success = before != NULL && (decoder == NULL || scratch != NULL) 
+        && _readFrames(
+            _self, loop->endFrame - loop->seamFrameCount, loop->seamFrameCount, 
+            loop->frames, scratch
+        )
+        && _readFrames(
+            _self, loop->startFrame - loop->seamFrameCount, loop->seamFrameCount, 
+            before, scratch
+        );
+    if (success) {
+        size_t sampleSize = snd_pcm_format_physical_width(_self->format) 
+            / BITS_PER_BYTE;
+        uint16_t channelAmount = _self->riffData.channelAmount;
+        for (uint32_t i = 0; i < loop->seamFrameCount; ++i) {
+            double weight = (i + 1.0) / (loop->seamFrameCount + 1.0);
+            for (uint16_t channel = 0; channel < channelAmount; ++channel) {
+                size_t offset = i * frameSize + channel * sampleSize;
+                double sample = _loadSample(_self->format, loop->frames + offset) 
+                    * (1.0 - weight) 
+                    + _loadSample(_self->format, before + offset) * weight;
+                _storeSample(_self->format, loop->frames + offset, sample);
+            }
+        }
+    }
+    free(before);
+    free(scratch);
+    return success;
+}
+
+bool _allocGatherFrames(_AudioObject *_self) {
+    // The audio thread gathers frames into memory allocated once here.
+    if (_self->gatherFrames != NULL) return true;
+    size_t frameSize = _self->decoder != NULL 
+        ? _self->decoder->frameSize 
+        : _self->riffData.blockAlign;
+    _self->gatherFrames = (uint8_t*)malloc(
+        (size_t)_self->alsaBufferSize * frameSize
+    );
+    if (_self->gatherFrames == NULL) {
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    return true;
+}
+
+bool audioSetLoop(AudioObject self, const AudioLoop *loop) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    if (_self->thread == NULL) return false;
+    AudioLoopRegion region = { 0 };
+    if (loop != NULL) {
+        if (
+            loop->endFrame < loop->startFrame 
+            || loop->endFrame >= _self->dataFrameCount
+        ) {
+            _self->error->type = AUDIO_WARNING_INVALID_LOOP;
+            _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+            return false;
+        }
+        AudioDecoder *decoder = _self->decoder;
+        bool isCompanded = _self->format == SND_PCM_FORMAT_A_LAW 
+            || _self->format == SND_PCM_FORMAT_MU_LAW;
+        if (
+            loop->crossfadeMilliseconds > 0 
+            && (isCompanded || (decoder != NULL && decoder->flacStream != NULL))
+        ) {
+            _self->error->type = AUDIO_WARNING_LOOP_CROSSFADE_UNSUPPORTED;
+            _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+            return false;
+        }
+
+        // The crossfade cannot reach in front of the audio or across the
+        // start of the loop.
+        region.startFrame = loop->startFrame;
+        region.endFrame = loop->endFrame + 1;
+        region.count = loop->count;
+        uint64_t seamFrameCount = (uint64_t)loop->crossfadeMilliseconds 
+            * _self->riffData.sampleRate / MILLISECONDS_PER_SECOND;
+        if (seamFrameCount > region.startFrame) seamFrameCount = region.startFrame;
+        if (seamFrameCount > region.endFrame - region.startFrame) {
+            seamFrameCount = region.endFrame - region.startFrame;
+        }
+        region.seamFrameCount = seamFrameCount;
+        if (!_allocGatherFrames(_self)) return false;
+        if (seamFrameCount > 0) {
+            size_t frameSize = decoder != NULL 
+                ? decoder->frameSize 
+                : _self->riffData.blockAlign;
+            region.frames = (uint8_t*)malloc(seamFrameCount * frameSize);
+        }
+        if (
+            (seamFrameCount > 0 && region.frames == NULL) 
+            || (seamFrameCount > 0 && !_crossfadeLoop(_self, &region))
+        ) {
+            free(region.frames);
+            _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+            _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return false;
+        }
+    }
+
+    // The audio thread hands the loop it played back.
+    _lockAction(_self, NULL, true);
+    _self->pendingLoop = region;
+    _self->loopFlag = true;
+    _unlockAction(_self);
+    free(_self->pendingLoop.frames);
+    _self->pendingLoop = (AudioLoopRegion){ 0 };
+    return true;
+}
+
+void audioGetClock(AudioObject self, AudioClock *clock) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    uint64_t position = atomic_load(&_self->clockPosition);
+    clock->frame = (uint32_t)position;
+    clock->milliseconds = (uint64_t)clock->frame * MILLISECONDS_PER_SECOND 
+        / _self->riffData.sampleRate;
+    clock->loopCount = position >> CLOCK_LOOP_SHIFT;
+}
+
+bool _isSegmentFormat(_AudioObject *_self, const _AudioObject *parsed) {
+    // The frames of a segment are written like those of the audio data.
+    uint16_t format = parsed->riffData.format;
+    return _self->decoder == NULL 
+        && (
+            format == WAVE_FORMAT_PCM || format == WAVE_FORMAT_IEEE_FLOAT 
+            || format == WAVE_FORMAT_ALAW || format == WAVE_FORMAT_MULAW
+        )
+        && format == _self->riffData.format 
+        && parsed->riffData.bitsPerSample == _self->riffData.bitsPerSample 
+        && parsed->riffData.blockAlign == _self->riffData.blockAlign 
+        && parsed->riffData.channelAmount == _self->riffData.channelAmount 
+        && parsed->riffData.sampleRate == _self->riffData.sampleRate;
+}
+
+void _prefetchSegment(const _AudioBuffer *buffer, const AudioSegment *segment) {
+    // Mapped frames are read ahead, so the audio thread does not wait for
+    // the disk at the boundary.
+    if (!buffer->isMapped) return;
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t begin = segment->frames - buffer->data;
+    size_t end = begin 
+        + (size_t)segment->frameCount * buffer->parsed->riffData.blockAlign;
+    begin -= begin % pageSize;
+    madvise(buffer->data + begin, end - begin, MADV_WILLNEED);
+}
+
+bool audioAppendSegment(
+    AudioObject self, AudioBuffer buffer, uint32_t startFrame, 
+    uint32_t frameCount, uint32_t *timelineFrame
+) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    if (_self->thread == NULL) return false;
+    _AudioBuffer *_buffer = (_AudioBuffer*)buffer;
+    const _AudioObject *parsed = _buffer->parsed;
+    if (parsed->error->level == AUDIO_ERROR_LEVEL_ERROR || parsed->riffData.data == NULL) {
+        _self->error->type = AUDIO_WARNING_INVALID_SEGMENT;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    if (!_isSegmentFormat(_self, parsed)) {
+        _self->error->type = AUDIO_WARNING_SEGMENT_FORMAT_MISMATCH;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    uint32_t bufferFrameCount = parsed->riffData.dataSize / parsed->riffData.blockAlign;
+    if (frameCount == 0 && startFrame < bufferFrameCount) {
+        frameCount = bufferFrameCount - startFrame;
+    }
+
+    // Only the user threads change the segments, one at a time.
+    pthread_mutex_lock(_self->segmentLock);
+    if (
+        startFrame >= bufferFrameCount || frameCount > bufferFrameCount - startFrame 
+        || frameCount > UINT32_MAX - _self->lastFrame
+    ) {
+        pthread_mutex_unlock(_self->segmentLock);
+        _self->error->type = AUDIO_WARNING_INVALID_SEGMENT;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    AudioSegment *segments = (AudioSegment*)malloc(
+        (_self->segmentCount + 1) * sizeof(AudioSegment)
+    );
+    if (segments == NULL || !_allocGatherFrames(_self)) {
+        pthread_mutex_unlock(_self->segmentLock);
+        free(segments);
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    memcpy(segments, _self->segments, _self->segmentCount * sizeof(AudioSegment));
+    AudioSegment *segment = &segments[_self->segmentCount];
+    *segment = (AudioSegment){
+        .buffer = _buffer,
+        .frames = parsed->riffData.data 
+            + (size_t)startFrame * parsed->riffData.blockAlign,
+        .startFrame = _self->lastFrame,
+        .frameCount = frameCount
+    };
+    _retainBuffer(_buffer);
+    _prefetchSegment(_buffer, segment);
+    if (timelineFrame != NULL) *timelineFrame = segment->startFrame;
+
+    // The audio thread hands the previous segments back. Their buffers
+    // stay referenced by the new ones.
+    _lockAction(_self, NULL, true);
+    _self->pendingSegments = segments;
+    _self->pendingSegmentCount = _self->segmentCount + 1;
+    _self->segmentFlag = true;
+    _unlockAction(_self);
+    free(_self->pendingSegments);
+    _self->pendingSegments = NULL;
+    _self->pendingSegmentCount = 0;
+    pthread_mutex_unlock(_self->segmentLock);
+    return true;
+}
+
+bool audioReplaceData(
+    AudioObject self, AudioBuffer buffer, uint32_t crossfadeMilliseconds
+) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    if (_self->thread == NULL) return false;
+    _AudioBuffer *_buffer = (_AudioBuffer*)buffer;
+    const _AudioObject *parsed = _buffer->parsed;
+    uint32_t frameCount = parsed->riffData.blockAlign > 0 
+        ? parsed->riffData.dataSize / parsed->riffData.blockAlign 
+        : 0;
+    if (
+        parsed->error->level == AUDIO_ERROR_LEVEL_ERROR 
+        || parsed->riffData.data == NULL || frameCount == 0 
+        || !_isSegmentFormat(_self, parsed)
+    ) {
+        _self->error->type = AUDIO_WARNING_INVALID_REPLACEMENT;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+
+    // The audio thread mixes the fade into memory allocated here. Companded
+    // samples switch without one.
+    uint8_t *fadeFrames = NULL;
+    uint64_t fadeFrameCount = (uint64_t)crossfadeMilliseconds 
+        * _self->riffData.sampleRate / MILLISECONDS_PER_SECOND;
+    if (_self->format == SND_PCM_FORMAT_A_LAW || _self->format == SND_PCM_FORMAT_MU_LAW) {
+        fadeFrameCount = 0;
+    }
+    if (fadeFrameCount > frameCount) fadeFrameCount = frameCount;
+    if (fadeFrameCount > 0) {
+        fadeFrames = (uint8_t*)malloc(fadeFrameCount * _self->riffData.blockAlign);
+        if (fadeFrames == NULL) {
+            _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+            _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return false;
+        }
+    }
+
+    // The audio thread moves the segments, so they are not appended to at
+    // the same time.
+    pthread_mutex_lock(_self->segmentLock);
+    if (frameCount > UINT32_MAX - (_self->lastFrame - _self->dataFrameCount)) {
+        pthread_mutex_unlock(_self->segmentLock);
+        free(fadeFrames);
+        _self->error->type = AUDIO_WARNING_INVALID_REPLACEMENT;
         _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
         return false;
     }
-    _self->jumpTarget = milliseconds;
-
-    _unlockAction(_self);
-    return true;
+    _retainBuffer(_buffer);
+    AudioSegment replacement = {
+        .buffer = _buffer,
+        .frames = parsed->riffData.data,
+        .startFrame = 0,
+        .frameCount = frameCount
+    };
+    _prefetchSegment(_buffer, &replacement);
+
+    // The audio thread hands back the replacement and the fade it played
+    // before. Their frames were copied to the sound device, so nothing
+    // references them anymore.
+    _lockAction(_self, NULL, true);
+    _self->pendingReplacement = replacement;
+    _self->pendingFadeFrames = fadeFrames;
+    _self->pendingFadeFrameCount = fadeFrameCount;
+    _self->replaceFlag = true;
+    _unlockAction(_self);
+    pthread_mutex_unlock(_self->segmentLock);
+    if (_self->pendingReplacement.buffer) _releaseBuffer(_self->pendingReplacement.buffer);
+    free(_self->pendingFadeFrames);
+    _self->pendingReplacement = (AudioSegment){ 0 };
+    _self->pendingFadeFrames = NULL;
+    _self->pendingFadeFrameCount = 0;
+    return true;
+}
+
+bool audioGetIsPlaying(AudioObject self) { 
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    return _self->isPlaying; 
+}
+
+bool audioGetIsPaused(AudioObject self) { 
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    return _self->isPaused; 
+}
+
+uint32_t audioGetCurrentTime(AudioObject self) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    return _self->currentFrame
+        * (uint64_t)MILLISECONDS_PER_SECOND
+        / _self->riffData.sampleRate;
+}
+
+uint32_t audioGetTotalDuration(AudioObject self) { 
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    return _getTotalMilliseconds(_self); 
+}
+
+float audioGetMajorFaultsPerMinute(AudioObject self) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    if (_self->playedFrames == 0) return 0.0f;
+    float playedMinutes = (float)_self->playedFrames 
+        / _self->riffData.sampleRate / SECONDS_PER_MINUTE;
+    return _self->majorFaults / playedMinutes;
+}
+
+float audioGetDecoderLoad(AudioObject self) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    AudioDecoder *decoder = _self->decoder;
+    if (decoder == NULL) return 0.0f;
+    uint64_t nanoseconds = decoder->decodeNanoseconds;
+    uint64_t frames = decoder->decodedFrameCount;
+    if (decoder->flacStream != NULL) {
+        flacStreamGetDecodeTime(decoder->flacStream, &nanoseconds, &frames);
+    }
+    if (frames == 0) return 0.0f;
+    float decodedSeconds = (float)frames / _self->riffData.sampleRate;
+    return (float)nanoseconds / NANOSECONDS_PER_SECOND / decodedSeconds;
+}
+
+float audioGetCompressionRatio(AudioObject self) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    return _self->compressionRatio;
+}
+
+uint64_t _loadCounter(_Atomic uint64_t *counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+void _readHistogram(StatsRecorder *recorder, AudioHistogram *histogram) {
+    histogram->count = _loadCounter(&recorder->count);
+    histogram->averageMicroseconds = histogram->count > 0 
+        ? (float)_loadCounter(&recorder->sum) / histogram->count 
+        : 0.0f;
+    histogram->maxMicroseconds = _loadCounter(&recorder->max);
+    for (uint32_t i = 0; i < AUDIO_HISTOGRAM_BUCKETS; ++i) {
+        histogram->buckets[i] = _loadCounter(&recorder->buckets[i]);
+    }
+}
+
+void audioGetStats(AudioObject self, AudioStats *stats) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    AudioCounters *counters = &_self->counters;
+    uint64_t levelSamples = _loadCounter(&counters->levelSamples);
+    stats->wakeups = _loadCounter(&counters->wakeups);
+    stats->refills = _loadCounter(&counters->refills);
+    stats->framesWritten = _loadCounter(&counters->framesWritten);
+    stats->xruns = _loadCounter(&counters->xruns);
+    stats->minorFaults = _loadCounter(&counters->minorFaults);
+    stats->majorFaults = _loadCounter(&counters->majorFaults);
+    stats->bufferFrames = _self->alsaBufferSize;
+    stats->maxAvailFrames = _loadCounter(&counters->maxAvailFrames);
+    stats->minDelayFrames = levelSamples > 0 
+        ? _loadCounter(&counters->minDelayFrames) 
+        : 0;
+    stats->averageAvailFrames = levelSamples > 0 
+        ? (float)_loadCounter(&counters->availFrames) / levelSamples 
+        : 0.0f;
+    stats->averageDelayFrames = levelSamples > 0 
+        ? (float)_loadCounter(&counters->delayFrames) / levelSamples 
+        : 0.0f;
+    _readHistogram(&counters->refill, &stats->refill);
+    _readHistogram(&counters->command, &stats->command);
+    _readHistogram(&counters->headroom, &stats->headroom);
+    stats->commands = stats->command.count;
+}
+
+uint64_t audioGetHistogramBucketStart(uint32_t bucket) {
+    return statsGetBucketStart(bucket);
+}
+
+float audioGetHistogramPercentile(const AudioHistogram *histogram, float percentile) {
+    // Find the bucket of the duration with the rank of the percentile.
+    if (histogram->count == 0) return 0.0f;
+    uint64_t rank = (uint64_t)ceil(percentile / 100.0 * histogram->count);
+    if (rank < 1) rank = 1;
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < AUDIO_HISTOGRAM_BUCKETS; ++i) {
+        count += histogram->buckets[i];
+        if (count >= rank) {
+            float end = statsGetBucketStart(i + 1);
+            return end < histogram->maxMicroseconds ? end : histogram->maxMicroseconds;
+        }
+    }
+    return histogram->maxMicroseconds;
+}
+
+void _appendText(char *text, size_t size, size_t *length, const char *format, ...) {
+    // Like snprintf() the length grows even if the text is cut off.
+    va_list arguments;
+    va_start(arguments, format);
+    int written = vsnprintf(
+        *length < size ? text + *length : NULL, 
+        *length < size ? size - *length : 0, 
+        format, arguments
+    );
+    va_end(arguments);
+    if (written > 0) *length += written;
+}
+
+void _formatHistogram(
+    const AudioHistogram *histogram, const char *name, bool asJson, 
+    char *text, size_t size, size_t *length
+) {
+    float percentiles[] = { 50.0f, 99.0f, 99.9f };
+    const char *percentileNames[] = { "p50", "p99", "p999" };
+    if (asJson) {
+        _appendText(
+            text, size, length, 
+            ",\"%s\":{\"count\":%lu,\"average_us\":%.1f,\"max_us\":%.0f", 
+            name, histogram->count, histogram->averageMicroseconds, 
+            histogram->maxMicroseconds
+        );
+    } else {
+        _appendText(
+            text, size, length, 
+            "%s_count %lu\n%s_average_us %.1f\n%s_max_us %.0f\n", 
+            name, histogram->count, name, histogram->averageMicroseconds, 
+            name, histogram->maxMicroseconds
+        );
+    }
+    for (uint32_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i) {
+        float value = audioGetHistogramPercentile(histogram, percentiles[i]);
+        if (asJson) {
+            _appendText(
+                text, size, length, ",\"%s_us\":%.0f", percentileNames[i], value
+            );
+        } else {
+            _appendText(
+                text, size, length, "%s_%s_us %.0f\n", 
+                name, percentileNames[i], value
+            );
+        }
+    }
+    if (!asJson) return;
+    _appendText(text, size, length, ",\"buckets\":[");
+    bool isFirst = true;
+    for (uint32_t i = 0; i < AUDIO_HISTOGRAM_BUCKETS; ++i) {
+        if (histogram->buckets[i] == 0) continue;
+        _appendText(
+            text, size, length, "%s[%lu,%lu]", isFirst ? "" : ",", 
+            statsGetBucketStart(i), histogram->buckets[i]
+        );
+        isFirst = false;
+    }
+    _appendText(text, size, length, "]}");
 }
 
-bool audioGetIsPlaying(AudioObject self) { 
-    _AudioObject *_self = (_AudioObject*)self;
-    _resetError(_self);
-    return _self->isPlaying; 
+size_t audioFormatStats(const AudioStats *stats, bool asJson, char *text, size_t size) {
+    size_t length = 0;
+    if (size > 0) text[0] = '\0';
+    const char *format = asJson 
+        ? "{\"wakeups\":%lu,\"refills\":%lu,\"frames_written\":%lu,"
+            "\"xruns\":%lu,\"commands\":%lu,\"minor_faults\":%lu,"
+            "\"major_faults\":%lu,\"buffer_frames\":%u,"
+            "\"max_avail_frames\":%u,\"min_delay_frames\":%u,"
+            "\"average_avail_frames\":%.1f,\"average_delay_frames\":%.1f"
+        : "wakeups %lu\nrefills %lu\nframes_written %lu\n"
+            "xruns %lu\ncommands %lu\nminor_faults %lu\n"
+            "major_faults %lu\nbuffer_frames %u\n"
+            "max_avail_frames %u\nmin_delay_frames %u\n"
+            "average_avail_frames %.1f\naverage_delay_frames %.1f\n";
+    _appendText(
+        text, size, &length, format, 
+        stats->wakeups, stats->refills, stats->framesWritten, 
+        stats->xruns, stats->commands, stats->minorFaults, 
+        stats->majorFaults, stats->bufferFrames, 
+        stats->maxAvailFrames, stats->minDelayFrames, 
+        stats->averageAvailFrames, stats->averageDelayFrames
+    );
+    _formatHistogram(&stats->refill, "refill", asJson, text, size, &length);
+    _formatHistogram(&stats->command, "command", asJson, text, size, &length);
+    _formatHistogram(&stats->headroom, "headroom", asJson, text, size, &length);
+    if (asJson) _appendText(text, size, &length, "}");
+    return length;
 }
 
-bool audioGetIsPaused(AudioObject self) { 
+bool audioSetLockedWindow(
+    AudioObject self, 
+    uint32_t aheadMilliseconds, 
+    uint32_t behindMilliseconds, 
+    size_t budgetBytes
+) {
     _AudioObject *_self = (_AudioObject*)self;
     _resetError(_self);
-    return _self->isPaused; 
-}
+    AudioLoader *loader = _self->loader;
+    if (loader == NULL) return false;
+    if (_self->riffData.data == NULL && loader->stream == NULL) return false;
+
+    size_t aheadBytes = (uint64_t)_self->riffData.byteRate 
+        * aheadMilliseconds / MILLISECONDS_PER_SECOND;
+    size_t behindBytes = (uint64_t)_self->riffData.byteRate 
+        * behindMilliseconds / MILLISECONDS_PER_SECOND;
+
+    // The budget is limited by RLIMIT_MEMLOCK unless locking is unlimited.
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t budget = budgetBytes ? budgetBytes : SIZE_MAX;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 
+        && limit.rlim_cur != RLIM_INFINITY 
+        && limit.rlim_cur < budget) {
+        budget = limit.rlim_cur;
+    }
+    budget -= budget % pageSize;
+
+    // Apply the window right away so it is in place before this returns.
+    // Afterwards the loader thread moves it.
+    pthread_mutex_lock(&loader->windowLock);
+    loader->lockAheadBytes = aheadBytes;
+    loader->lockBehindBytes = behindBytes;
+    loader->lockBudget = budget;
+    loader->lockEnabled = aheadMilliseconds > 0 
+        && budget >= MIN_LOCKED_PAGES * pageSize;
+    if (loader->lockEnabled && !_startLoaderThread(_self)) {
+        loader->lockEnabled = false;
+    }
+    _moveLockedWindow(_self);
+    bool reduced = aheadMilliseconds > 0 && (!loader->lockEnabled 
+        || (loader->stream == NULL 
+            && aheadBytes + behindBytes + 2 * pageSize > loader->lockBudget));
+    bool locked = loader->lockEnabled;
+    pthread_mutex_unlock(&loader->windowLock);
+
+    // Wake the loader thread up often enough to stay ahead of the playhead.
+    if (locked) {
+        uint32_t stepFrames = (uint64_t)_self->riffData.sampleRate 
+            * aheadMilliseconds / MILLISECONDS_PER_SECOND 
+            / LOADER_STEPS_PER_WINDOW;
+        if (stepFrames == 0) stepFrames = 1;
+        if (!loader->isWindowed || stepFrames < loader->stepFrames) {
+            loader->stepFrames = stepFrames;
+        }
+    }
 
-uint32_t audioGetCurrentTime(AudioObject self) {
-    _AudioObject *_self = (_AudioObject*)self;
-    _resetError(_self);
-    return _self->currentFrame
-        * MILLISECONDS_PER_SECOND
-        / _self->riffData.sampleRate;
+    if (reduced && _self->error->level != AUDIO_ERROR_LEVEL_ERROR) {
+        _self->error->type = AUDIO_WARNING_LOCKED_WINDOW_REDUCED;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+    }
+    return locked;
 }
 
-uint32_t audioGetTotalDuration(AudioObject self) { 
+size_t audioGetLockedBytes(AudioObject self) {
     _AudioObject *_self = (_AudioObject*)self;
     _resetError(_self);
-    return _self->riffData.audioLength; 
+    AudioLoader *loader = _self->loader;
+    if (loader == NULL) return 0;
+    pthread_mutex_lock(&loader->windowLock);
+    size_t lockedBytes = loader->lockedBytes;
+    pthread_mutex_unlock(&loader->windowLock);
+    return lockedBytes;
 }
 
 bool _getMixerMasterElement(
@@ -1143,6 +6453,460 @@ bool audioSetVolume(AudioObject self, uint8_t volume) {
     return true;
 }
 
+bool audioSetGain(AudioObject self, float decibels) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    if (_self->thread == NULL) return false;
+    if (
+        _self->format == SND_PCM_FORMAT_A_LAW 
+        || _self->format == SND_PCM_FORMAT_MU_LAW
+    ) {
+        _self->error->type = AUDIO_WARNING_GAIN_UNSUPPORTED;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+
+    // The audio thread scales the frames into memory allocated once here.
+    if (_self->gainFrames == NULL) {
+        _self->gainFrames = (uint8_t*)malloc(
+            (size_t)_self->alsaBufferSize * _self->riffData.channelAmount 
+                * snd_pcm_format_physical_width(_self->format) / BITS_PER_BYTE
+        );
+        if (_self->gainFrames == NULL) {
+            _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+            _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return false;
+        }
+    }
+
+    _lockAction(_self, NULL, true);
+    _self->pendingGain = powf(10.0f, decibels / 20.0f);
+    _self->gainFlag = true;
+    _unlockAction(_self);
+    return true;
+}
+
+bool audioNormalizeLoudness(
+    AudioObject self, const AudioLoudness *loudness, float targetLoudness
+) {
+    // Silence is left as it is and the gain never pushes the true peak
+    // above NORMALIZED_TRUE_PEAK.
+    float decibels = isfinite(loudness->integratedLoudness) 
+        ? targetLoudness - loudness->integratedLoudness 
+        : 0.0f;
+    if (
+        isfinite(loudness->truePeak) 
+        && loudness->truePeak + decibels > NORMALIZED_TRUE_PEAK
+    ) {
+        decibels = NORMALIZED_TRUE_PEAK - loudness->truePeak;
+    }
+    return audioSetGain(self, decibels);
+}
+
+bool audioAddDevice(AudioObject self, const char *soundDeviceName) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    if (_self->thread == NULL) return false;
+    if (_self->deviceCount >= AUDIO_MAX_DEVICES - 1) {
+        _self->error->type = AUDIO_WARNING_TOO_MANY_DEVICES;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+
+    // The device is opened with the parameters of the first one. Resampled
+    // frames never take more than twice the room of the ALSA buffer.
+    size_t frameSize = (size_t)_self->riffData.channelAmount 
+        * snd_pcm_format_physical_width(_self->format) / BITS_PER_BYTE;
+    AudioDevice device = { .step = 1.0 };
+    device.soundDeviceName = strdup(soundDeviceName);
+    device.frames = (uint8_t*)malloc(2 * (size_t)_self->alsaBufferSize * frameSize);
+    device.history = (uint8_t*)malloc(frameSize);
+    if (
+        device.soundDeviceName == NULL || device.frames == NULL 
+        || device.history == NULL
+    ) {
+        _closeDevice(&device);
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    if (
+        (backendGetType(soundDeviceName) == BACKEND_TYPE_MEMORY) 
+        != (_self->output->type == BACKEND_TYPE_MEMORY)
+    ) {
+        _closeDevice(&device);
+        _self->error->type = AUDIO_WARNING_BACKEND_MISMATCH;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    if (!_openOutput(_self, device.soundDeviceName, &device.output)) {
+        _closeDevice(&device);
+        return false;
+    }
+    if ((_self->error->alsaErrorNumber = backendSetManualStart(device.output)) < 0) {
+        _closeDevice(&device);
+        _self->error->type = AUDIO_ERROR_ALSA_ERROR;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+
+    // The audio thread counts the device once it is linked.
+    if (!_lockAction(
+        _self, NULL, 
+        _self->deviceCount < AUDIO_MAX_DEVICES - 1  // Another thread may have added one
+    )) {
+        _closeDevice(&device);
+        _self->error->type = AUDIO_WARNING_TOO_MANY_DEVICES;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    _self->devices[_self->deviceCount] = device;
+    _self->addDeviceFlag = true;
+    _unlockAction(_self);
+    return true;
+}
+
+uint32_t audioGetDeviceCount(AudioObject self) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    return _self->deviceCount + 1;
+}
+
+bool audioGetDeviceSync(AudioObject self, uint32_t device, AudioDeviceSync *sync) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    if (device > _self->deviceCount) {
+        _self->error->type = AUDIO_WARNING_DEVICE_NOT_FOUND;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    if (device == 0) {
+        *sync = (AudioDeviceSync){ .driftPpm = _self->clock.driftPpm };
+        return true;
+    }
+    const AudioDevice *audioDevice = &_self->devices[device - 1];
+    sync->offsetMicroseconds = audioDevice->offset / _self->riffData.sampleRate 
+        * MICROSECONDS_PER_SECOND;
+    sync->driftPpm = audioDevice->clock.driftPpm;
+    sync->correctionPpm = (audioDevice->step - 1.0) * PARTS_PER_MILLION;
+    sync->isLinked = audioDevice->isLinked;
+    return true;
+}
+
+bool audioSetSinkWriteDelay(AudioObject self, uint32_t device, uint32_t microseconds) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    if (device > _self->deviceCount) {
+        _self->error->type = AUDIO_WARNING_DEVICE_NOT_FOUND;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    Backend *output = device == 0 ? _self->output : _self->devices[device - 1].output;
+    if (output == NULL || output->type != BACKEND_TYPE_MEMORY) {
+        _self->error->type = AUDIO_WARNING_NOT_A_MEMORY_SINK;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    sinkSetWriteDelay(output, microseconds);
+    return true;
+}
+
+bool audioGetPipeBacklog(AudioObject self, uint32_t device, uint32_t *microseconds) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    if (device > _self->deviceCount) {
+        _self->error->type = AUDIO_WARNING_DEVICE_NOT_FOUND;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    Backend *output = device == 0 ? _self->output : _self->devices[device - 1].output;
+    if (output == NULL || output->type != BACKEND_TYPE_PIPE) {
+        _self->error->type = AUDIO_WARNING_NOT_A_PIPE;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    uint64_t backlog = pipeGetBacklog(output);
+    *microseconds = backlog > UINT32_MAX ? UINT32_MAX : backlog;
+    return true;
+}
+
+int audioGetEventFd(AudioObject self) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    return _self->events.fileDescriptor;
+}
+
+uint32_t audioReadEvents(AudioObject self, AudioEvent *events, uint32_t maxEventCount) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    AudioEventQueue *queue = &_self->events;
+
+    // The counter is cleared before the ring is read, so an event queued
+    // meanwhile makes the file descriptor readable again.
+    uint64_t value;
+    if (queue->fileDescriptor != -1) {
+        ssize_t result = read(queue->fileDescriptor, &value, sizeof(value));
+        (void)result;
+    }
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    uint32_t eventCount = tail - head;
+    if (eventCount > maxEventCount) eventCount = maxEventCount;
+    for (uint32_t i = 0; i < eventCount; ++i) {
+        events[i] = queue->events[(head + i) % EVENT_QUEUE_SIZE];
+    }
+    atomic_store_explicit(&queue->head, head + eventCount, memory_order_release);
+    if (head + eventCount != tail && queue->fileDescriptor != -1) {
+        value = 1;
+        ssize_t result = write(queue->fileDescriptor, &value, sizeof(value));
+        (void)result;
+    }
+    return eventCount;
+}
+
+void _replaceMarkers(
+    _AudioObject *_self, AudioMarker *markers, uint32_t markerCount
+) {
+    // The audio thread hands the markers it reported from back.
+    _lockAction(_self, NULL, true);
+    _self->pendingMarkers = markers;
+    _self->pendingMarkerCount = markerCount;
+    _self->markerFlag = true;
+    _unlockAction(_self);
+    free(_self->pendingMarkers);
+    _self->pendingMarkers = NULL;
+    _self->pendingMarkerCount = 0;
+}
+
+bool audioAddMarker(AudioObject self, uint32_t id, uint32_t frame) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    if (_self->thread == NULL) return false;
+    if (frame > _self->lastFrame) {
+        _self->error->type = AUDIO_WARNING_MARKER_BEYOND_END;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+
+    // Only the user threads change the markers, one at a time.
+    pthread_mutex_lock(_self->markerLock);
+    AudioMarker *markers = (AudioMarker*)malloc(
+        (_self->markerCount + 1) * sizeof(AudioMarker)
+    );
+    if (markers == NULL) {
+        pthread_mutex_unlock(_self->markerLock);
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    // Markers on the same frame are reported in the order they were added.
+    uint32_t index = 0;
+    while (index < _self->markerCount && _self->markers[index].frame <= frame) {
+        ++index;
+    }
+    memcpy(markers, _self->markers, index * sizeof(AudioMarker));
+    markers[index] = (AudioMarker){ .id = id, .frame = frame };
+    memcpy(
+        markers + index + 1, _self->markers + index, 
+        (_self->markerCount - index) * sizeof(AudioMarker)
+    );
+    _replaceMarkers(_self, markers, _self->markerCount + 1);
+    pthread_mutex_unlock(_self->markerLock);
+    return true;
+}
+
+bool audioRemoveMarker(AudioObject self, uint32_t id) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    if (_self->thread == NULL) return false;
+
+    pthread_mutex_lock(_self->markerLock);
+    uint32_t markerCount = 0;
+    for (uint32_t i = 0; i < _self->markerCount; ++i) {
+        if (_self->markers[i].id != id) ++markerCount;
+    }
+    if (markerCount == _self->markerCount) {
+        pthread_mutex_unlock(_self->markerLock);
+        _self->error->type = AUDIO_WARNING_MARKER_NOT_FOUND;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    AudioMarker *markers = NULL;
+    if (markerCount > 0) {
+        markers = (AudioMarker*)malloc(markerCount * sizeof(AudioMarker));
+        if (markers == NULL) {
+            pthread_mutex_unlock(_self->markerLock);
+            _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+            _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+            return false;
+        }
+    }
+    uint32_t index = 0;
+    for (uint32_t i = 0; i < _self->markerCount; ++i) {
+        if (_self->markers[i].id != id) markers[index++] = _self->markers[i];
+    }
+    _replaceMarkers(_self, markers, markerCount);
+    pthread_mutex_unlock(_self->markerLock);
+    return true;
+}
+
+bool audioSetTracing(AudioObject self, uint32_t eventCount) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    if (_self->thread == NULL) return false;
+    TraceRing *trace = NULL;
+    if (eventCount > 0 && (trace = traceInit(eventCount)) == NULL) {
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+
+    // The audio thread hands the ring it recorded into back.
+    _lockAction(_self, NULL, true);
+    _self->pendingTrace = trace;
+    _self->traceFlag = true;
+    _unlockAction(_self);
+    if (_self->pendingTrace) traceFree(_self->pendingTrace);
+    _self->pendingTrace = NULL;
+    return true;
+}
+
+bool audioWriteTrace(AudioObject self, const char *path, bool atLastXrun) {
+    _AudioObject *_self = (_AudioObject*)self;
+    _resetError(_self);
+    if (_self->thread == NULL) return false;
+
+    // The ring is only swapped while the action lock is held, so it stays
+    // while it is copied.
+    pthread_mutex_lock(_self->actionLock);
+    TraceRing *trace = _self->trace;
+    if (trace == NULL) {
+        pthread_mutex_unlock(_self->actionLock);
+        _self->error->type = AUDIO_WARNING_TRACING_DISABLED;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+    TraceEvent *events = (TraceEvent*)malloc((size_t)trace->size * sizeof(TraceEvent));
+    if (events == NULL) {
+        pthread_mutex_unlock(_self->actionLock);
+        _self->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    uint32_t eventCount = 0;
+    bool hasEvents = true;
+    if (atLastXrun) {
+        hasEvents = traceCopySnapshot(trace, events, &eventCount);
+    } else {
+        eventCount = traceCopy(trace, events);
+    }
+    pthread_mutex_unlock(_self->actionLock);
+    if (!hasEvents) {
+        free(events);
+        _self->error->type = AUDIO_WARNING_NO_XRUN_TRACED;
+        _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+        return false;
+    }
+
+    FILE *file = fopen(path, "w");
+    bool success = file != NULL && traceWriteChrome(file, events, eventCount);
+    if (file != NULL && fclose(file) != 0) success = false;
+    free(events);
+    if (!success) {
+        _self->error->type = AUDIO_ERROR_FILE_WRITE_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+    }
+    return success;
+}
+
+void _giveRenderCommand(AudioObject object, const AudioRenderCommand *command) {
+    switch (command->action) {
+        case AUDIO_RENDER_PLAY: audioPlay(object, NULL); break;
+        case AUDIO_RENDER_PAUSE: audioPause(object, NULL); break;
+        case AUDIO_RENDER_STOP: audioStop(object, NULL); break;
+        case AUDIO_RENDER_JUMP: audioJump(object, NULL, command->value); break;
+        case AUDIO_RENDER_JUMP_TO_CUE: audioJumpToCue(object, NULL, command->value); break;
+        case AUDIO_RENDER_VOLUME: audioSetVolume(object, command->value); break;
+        case AUDIO_RENDER_GAIN: audioSetGain(object, command->value); break;
+    }
+}
+
+bool _finishRender(_AudioObject *_self) {
+    // Added render devices write their own files.
+    int error = sinkFinishCapture(_self->output);
+    for (uint32_t i = 0; i < _self->deviceCount; ++i) {
+        int deviceError = sinkFinishCapture(_self->devices[i].output);
+        if (error == 0) error = deviceError;
+    }
+    if (error < 0) {
+        _self->error->type = AUDIO_ERROR_FILE_WRITE_FAILED;
+        _self->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        _self->error->alsaErrorNumber = error;
+        return false;
+    }
+    return true;
+}
+
+bool audioRender(
+    AudioObject *objects, uint32_t objectCount, 
+    const AudioRenderCommand *commands, uint32_t commandCount, 
+    uint64_t endMilliseconds
+) {
+    if (objectCount == 0) return false;
+    for (uint32_t i = 0; i < objectCount; ++i) {
+        _AudioObject *_self = (_AudioObject*)objects[i];
+        _resetError(_self);
+        if (_self->thread == NULL) return false;
+        if (!sinkIsStepped(_self->output)) {
+            _self->error->type = AUDIO_WARNING_NOT_A_RENDER_DEVICE;
+            _self->error->level = AUDIO_ERROR_LEVEL_WARNING;
+            return false;
+        }
+    }
+    _AudioObject *first = (_AudioObject*)objects[0];
+    for (uint32_t i = 0; i < commandCount; ++i) {
+        if (
+            commands[i].object >= objectCount 
+            || commands[i].milliseconds > endMilliseconds 
+            || (i > 0 && commands[i].milliseconds < commands[i - 1].milliseconds)
+        ) {
+            first->error->type = AUDIO_WARNING_INVALID_RENDER_SCRIPT;
+            first->error->level = AUDIO_ERROR_LEVEL_WARNING;
+            return false;
+        }
+    }
+
+    // Every audio object renders from where its clock stands.
+    uint64_t *starts = (uint64_t*)malloc(objectCount * sizeof(uint64_t));
+    if (starts == NULL) {
+        first->error->type = AUDIO_ERROR_MEMORY_ALLOCATION_FAILED;
+        first->error->level = AUDIO_ERROR_LEVEL_ERROR;
+        return false;
+    }
+    for (uint32_t i = 0; i < objectCount; ++i) {
+        starts[i] = sinkWaitUntilParked(((_AudioObject*)objects[i])->output);
+    }
+    for (uint32_t i = 0; i < commandCount; ++i) {
+        _AudioObject *_self = (_AudioObject*)objects[commands[i].object];
+        sinkAdvanceTo(
+            _self->output, 
+            starts[commands[i].object] 
+                + commands[i].milliseconds * NANOSECONDS_PER_MILLISECOND
+        );
+        _giveRenderCommand(_self, &commands[i]);
+    }
+    bool success = true;
+    for (uint32_t i = 0; i < objectCount; ++i) {
+        _AudioObject *_self = (_AudioObject*)objects[i];
+        sinkAdvanceTo(
+            _self->output, starts[i] + endMilliseconds * NANOSECONDS_PER_MILLISECOND
+        );
+        if (!_finishRender(_self)) success = false;
+    }
+    free(starts);
+    return success;
+}
+
 AudioError * audioGetError(AudioObject self) {
     _AudioObject *_self = (_AudioObject*)self;
     return _self->error;
@@ -1240,6 +7004,103 @@ const char * audioGetErrorString(AudioError *error) {
         case AUDIO_UNSUPPORTED_BITS_PER_SAMPLE:
             return "Unsupported bits per sample";
 
+        // loading files
+        case AUDIO_ERROR_FILE_OPEN_FAILED:
+            return "File could not be opened";
+
+        case AUDIO_ERROR_FILE_MAP_FAILED:
+            return "File could not be mapped";
+
+        // locking memory
+        case AUDIO_WARNING_LOCKED_WINDOW_REDUCED:
+            return "Locked window was reduced";
+
+        // FLAC
+        case AUDIO_ERROR_INVALID_FLAC_STREAM:
+            return "Invalid FLAC stream";
+
+        // compact residency
+        case AUDIO_WARNING_RESIDENCY_UNSUPPORTED:
+            return "Audio data kept as given";
+
+        case AUDIO_ERROR_INVALID_BANK:
+            return "Sound bank is invalid";
+
+        case AUDIO_ERROR_CLIP_NOT_FOUND:
+            return "Clip not found in sound bank";
+
+        case AUDIO_ERROR_FILE_WRITE_FAILED:
+            return "File could not be written";
+
+        case AUDIO_ERROR_DUPLICATE_CLIP_NAME:
+            return "Clip name used more than once";
+
+        case AUDIO_WARNING_CUE_NOT_FOUND:
+            return "No cue point with the given identifier";
+
+        case AUDIO_WARNING_PEAKS_NOT_CACHED:
+            return "Peaks could not be written to their sidecar file";
+
+        case AUDIO_WARNING_LOUDNESS_NOT_CACHED:
+            return "Loudness could not be written to its sidecar file";
+
+        case AUDIO_WARNING_GAIN_UNSUPPORTED:
+            return "Gain not supported for companded samples";
+
+        case AUDIO_WARNING_TOO_MANY_DEVICES:
+            return "No more sound devices can be added";
+
+        case AUDIO_WARNING_DEVICE_NOT_FOUND:
+            return "No sound device with the given index";
+
+        case AUDIO_WARNING_MARKER_BEYOND_END:
+            return "Marker beyond the end of the audio";
+
+        case AUDIO_WARNING_MARKER_NOT_FOUND:
+            return "No marker with the given identifier";
+
+        case AUDIO_WARNING_TRACING_DISABLED:
+            return "Tracing is disabled";
+
+        case AUDIO_WARNING_NO_XRUN_TRACED:
+            return "No xrun was traced";
+
+        case AUDIO_WARNING_NOT_A_MEMORY_SINK:
+            return "The sound device is not a memory sink";
+
+        case AUDIO_WARNING_BACKEND_MISMATCH:
+            return "The sound device has another backend than the first one";
+
+        case AUDIO_WARNING_NOT_A_RENDER_DEVICE:
+            return "The sound device is not a render device";
+
+        case AUDIO_WARNING_INVALID_RENDER_SCRIPT:
+            return "Invalid render script";
+
+        case AUDIO_WARNING_NOT_A_PIPE:
+            return "The sound device is not a pipe";
+
+        case AUDIO_WARNING_NO_LOOP:
+            return "The file has no forward loop";
+
+        case AUDIO_WARNING_INVALID_LOOP:
+            return "The loop is empty or beyond the end of the audio";
+
+        case AUDIO_WARNING_LOOP_CROSSFADE_UNSUPPORTED:
+            return "The audio cannot be crossfaded";
+
+        case AUDIO_WARNING_INVALID_SEGMENT:
+            return "The segment is invalid, empty or beyond the end of the buffer";
+
+        case AUDIO_WARNING_SEGMENT_FORMAT_MISMATCH:
+            return "The frames of the segment differ from the frames of the audio";
+
+        case AUDIO_WARNING_INVALID_REPLACEMENT:
+            return "The new audio data is invalid or differs in its format";
+
+        case AUDIO_ERROR_FILE_READ_FAILED:
+            return "The streamed file could not be read";
+
         default:
             return "Unknown error";
     }
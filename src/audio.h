@@ -46,7 +46,56 @@ enum AudioErrorType {
     AUDIO_ERROR_MIXER_ELEMENT_NOT_FOUND,  /* The mixer element was not found. */
     // other
     AUDIO_ERROR_MEMORY_ALLOCATION_FAILED,  /* Memory allocation failed. */
-    AUDIO_UNSUPPORTED_BITS_PER_SAMPLE  /* The bits per sample are not supported. */
+    AUDIO_UNSUPPORTED_BITS_PER_SAMPLE,  /* The bits per sample are not supported. */
+    // loading files
+    AUDIO_ERROR_FILE_OPEN_FAILED,  /* The file could not be opened. */
+    AUDIO_ERROR_FILE_MAP_FAILED,  /* The file could not be mapped or read into memory. */
+    // locking memory
+    AUDIO_WARNING_LOCKED_WINDOW_REDUCED,  /* Less memory than requested could be locked. */
+    // FLAC
+    AUDIO_ERROR_INVALID_FLAC_STREAM,  /* The FLAC metadata is invalid or not supported. */
+    // compact residency
+    AUDIO_WARNING_RESIDENCY_UNSUPPORTED,  /* The audio data is kept as given since it is not integer PCM. */
+    // sound banks
+    AUDIO_ERROR_INVALID_BANK,  /* The sound bank header or index is invalid. */
+    AUDIO_ERROR_CLIP_NOT_FOUND,  /* The sound bank has no clip with the given number. */
+    AUDIO_ERROR_FILE_WRITE_FAILED,  /* The file could not be written. */
+    AUDIO_ERROR_DUPLICATE_CLIP_NAME,  /* Two clips of a sound bank have the same name. */
+    // cues
+    AUDIO_WARNING_CUE_NOT_FOUND,  /* The audio data has no cue point with the given identifier. */
+    // peaks
+    AUDIO_WARNING_PEAKS_NOT_CACHED,  /* The peaks could not be written to their sidecar file. */
+    // loudness
+    AUDIO_WARNING_LOUDNESS_NOT_CACHED,  /* The loudness could not be written to its sidecar file. */
+    AUDIO_WARNING_GAIN_UNSUPPORTED,  /* A-law and µ-law samples are played without gain. */
+    // fan-out
+    AUDIO_WARNING_TOO_MANY_DEVICES,  /* The audio object feeds AUDIO_MAX_DEVICES sound devices already. */
+    AUDIO_WARNING_DEVICE_NOT_FOUND,  /* The audio object has no sound device with the given index. */
+    // events
+    AUDIO_WARNING_MARKER_BEYOND_END,  /* The given frame is beyond the end of the audio. */
+    AUDIO_WARNING_MARKER_NOT_FOUND,  /* The audio object has no marker with the given identifier. */
+    // tracing
+    AUDIO_WARNING_TRACING_DISABLED,  /* Tracing was not enabled with audioSetTracing(). */
+    AUDIO_WARNING_NO_XRUN_TRACED,  /* No sound device ran out of frames while tracing. */
+    // output backends
+    AUDIO_WARNING_NOT_A_MEMORY_SINK,  /* The sound device is not a memory sink. */
+    AUDIO_WARNING_BACKEND_MISMATCH,  /* The added sound device has another backend than the first one. */
+    // offline render
+    AUDIO_WARNING_NOT_A_RENDER_DEVICE,  /* The sound device of the audio object is not a render device. */
+    AUDIO_WARNING_INVALID_RENDER_SCRIPT,  /* A render command is out of order, after the end or for a missing audio object. */
+    // pipe output
+    AUDIO_WARNING_NOT_A_PIPE,  /* The sound device is not a pipe. */
+    // looping
+    AUDIO_WARNING_NO_LOOP,  /* The file has no forward loop in a smpl chunk. */
+    AUDIO_WARNING_INVALID_LOOP,  /* The loop is empty or beyond the end of the audio. */
+    AUDIO_WARNING_LOOP_CROSSFADE_UNSUPPORTED,  /* A-law, µ-law and native FLAC audio cannot be crossfaded. */
+    // timeline
+    AUDIO_WARNING_INVALID_SEGMENT,  /* The buffer has an error or the segment is empty, beyond its end or too long for the timeline. */
+    AUDIO_WARNING_SEGMENT_FORMAT_MISMATCH,  /* The segment is compressed or its frames differ from the frames of the audio object. */
+    // hot swap
+    AUDIO_WARNING_INVALID_REPLACEMENT,  /* The buffer has an error, is empty, compressed or its frames differ from the frames of the audio object. */
+    // streaming
+    AUDIO_ERROR_FILE_READ_FAILED  /* The streamed file could not be read, alsaErrorNumber holds the negative error number. */
 };
 
 /**
@@ -72,23 +121,332 @@ typedef struct {
  * 
  * The time resolution determines every how many milliseconds commands
  * like audioPlay() or audioPause() are processed.
+ * 
+ * The sound device "memory" or "memory:SPEED" is a memory sink instead of
+ * an ALSA device. It plays the frames on a virtual clock that runs SPEED
+ * times faster than real time, so playback, refills and commands can be
+ * tested without a sound card and faster than real time. Event times and
+ * statistics of such an audio object are measured on the virtual clock.
+ * 
+ * The sound device "pipe:TARGET" streams the raw frames in real time to a
+ * pipe, FIFO, socket or file that another process reads, "pipe-free:TARGET"
+ * as fast as the reader takes them. TARGET is the number of an open file
+ * descriptor, which the library duplicates, or a path. Opening a FIFO waits
+ * for its reader. A reader that falls behind holds the playback back
+ * instead of losing frames, see audioGetPipeBacklog().
 */
 typedef struct {
-    void *rawData;  /* The raw audio data as found in a WAV file. */
+    void *rawData;  /* The raw audio data as found in a WAV or FLAC file. */
     size_t rawDataSize;  /* The size of the raw audio data. */
     char *soundDeviceName;  /* The name of the sound device to use. */
     size_t soundDeviceNameSize;  /* The size of the sound device name. */
     uint32_t timeResolution;  /* The time resolution in milliseconds. */
 } AudioConfiguration;
 
+/**
+ * @brief This configures how audioInitFromPath() loads a WAV file.
+ * 
+ * Files up to populateThreshold bytes are loaded completely at init time.
+ * Larger files are mapped and a helper thread keeps a window of
+ * readaheadMilliseconds ahead of the playhead in the page cache. If
+ * dropBehind is set, pages more than keepBehindMilliseconds behind the
+ * playhead are released again.
+ * 
+ * If useStreaming is set the file is neither loaded nor mapped. Instead
+ * streamQueueDepth blocks of streamBlockSize bytes ahead of the playhead
+ * are read asynchronously into memory owned by the library. A single
+ * reader thread serves all streaming audio objects. It uses io_uring if
+ * available and plain reads otherwise. The queue depth is raised if the
+ * blocks cannot hold twice the sound device buffer. FLAC files are always
+ * mapped since their frames vary in size.
+ * 
+ * Zero values select the defaults.
+*/
+typedef struct {
+    uint32_t readaheadMilliseconds;  /* How far ahead of the playhead data is prefetched. */
+    uint32_t keepBehindMilliseconds;  /* How much played data stays resident for quick rewinds. */
+    size_t populateThreshold;  /* Files up to this size in bytes are loaded completely. */
+    bool dropBehind;  /* Whether pages behind the playhead are released. */
+    bool useHugePages;  /* Whether completely loaded files are placed in transparent huge pages. */
+    bool useStreaming;  /* Whether the file is read in blocks instead of being mapped. */
+    uint32_t streamBlockSize;  /* The size of one streamed block in bytes. */
+    uint32_t streamQueueDepth;  /* The amount of blocks read ahead of the playhead. */
+} AudioLoaderConfiguration;
+
+/**
+ * @brief This selects how audioInitCompact() keeps the audio data in memory.
+ * 
+ * Except for AUDIO_RESIDENCY_RAW the data is transcoded into blocks that
+ * can be decoded without any other block, so jumps stay as cheap as before.
+*/
+enum AudioResidency {
+    AUDIO_RESIDENCY_RAW,  /* The data is used as given. */
+    AUDIO_RESIDENCY_LOSSLESS,  /* FLAC frames decoded by a helper thread, bit exact. */
+    AUDIO_RESIDENCY_16_BIT,  /* Samples wider than 16 bits are rounded to 16 bits. */
+    AUDIO_RESIDENCY_ADPCM  /* IMA ADPCM, 4 bits per sample, decoded block by block. */
+};
+
+/**
+ * @brief These flags select how audioBufferInit() and audioBufferInitFromPath() hold the data.
+*/
+enum AudioBufferFlag {
+    AUDIO_BUFFER_COPY = 1,  /* The bytes are copied, so the caller may free them afterwards. */
+    AUDIO_BUFFER_DEDUPLICATE = 2  /* An existing buffer with the same file or bytes is returned instead. */
+};
+
+/**
+ * @brief This represents a cue point of a WAV file.
+ * 
+ * Cue points are read from the cue chunk, their labels from the labl
+ * chunks of an associated data list (LIST/adtl).
+*/
+typedef struct {
+    uint32_t id;  /* The identifier of the cue point in the file. */
+    uint32_t frame;  /* The position in frames. */
+    uint32_t milliseconds;  /* The position in milliseconds. */
+    const char *label;  /* The label of the cue point or an empty string. */
+} AudioCue;
+
+/**
+ * @brief This represents a loop of the audio.
+ * 
+ * The frames of a loop are played again and again until the loop was
+ * played count times, then the playback continues behind it.
+*/
+typedef struct {
+    uint32_t startFrame;  /* The first frame of the loop. */
+    uint32_t endFrame;  /* The last frame of the loop, which is played as well. */
+    uint32_t count;  /* How often the loop is played, 0 for endlessly. */
+    uint32_t crossfadeMilliseconds;  /* How long the end of the loop fades into the audio before its start. */
+} AudioLoop;
+
+/**
+ * @brief This represents the position that is heard.
+*/
+typedef struct {
+    uint32_t frame;  /* The frame that is heard. */
+    uint32_t milliseconds;  /* The position of the frame in milliseconds. */
+    uint32_t loopCount;  /* How often the playback went back to the start of the loop. */
+} AudioClock;
+
+/**
+ * @brief The zoom levels of waveform peaks.
+*/
+enum AudioPeakLevel {
+    AUDIO_PEAK_LEVEL_64,  /* One bucket per 64 frames. */
+    AUDIO_PEAK_LEVEL_512,  /* One bucket per 512 frames. */
+    AUDIO_PEAK_LEVEL_4096  /* One bucket per 4096 frames. */
+};
+
+/**
+ * @brief This holds the peaks of one channel in one bucket of frames.
+ * 
+ * The samples are scaled to 16 bit no matter the format of the audio.
+*/
+typedef struct {
+    int16_t min;  /* The smallest sample. */
+    int16_t max;  /* The largest sample. */
+    uint16_t rms;  /* The root mean square of the samples. */
+} AudioPeak;
+
+/**
+ * @brief The loudness of an audio file as described by EBU R 128.
+ * 
+ * Silence has a loudness and a true peak of -INFINITY.
+*/
+typedef struct {
+    float integratedLoudness;  /* The gated loudness of the whole file in LUFS. */
+    float loudnessRange;  /* The spread of the short term loudness in LU. */
+    float truePeak;  /* The peak of the 4 times oversampled signal in dBTP. */
+} AudioLoudness;
+
+#define AUDIO_PROBE_MAX_CHUNKS (16)
+
+/**
+ * @brief A chunk of a WAV file.
+*/
+typedef struct {
+    char id[4];  /* The four character code, e.g. "fmt " or "data". */
+    uint32_t size;  /* The size of the chunk body in bytes. */
+    uint64_t offset;  /* The offset of the chunk header in the file. */
+} AudioChunk;
+
+/**
+ * @brief What probing a WAV or FLAC file found out about it.
+*/
+typedef struct {
+    AudioError error;  /* Why the file cannot be played, if it cannot. */
+    uint64_t fileSize;  /* The size of the file in bytes. */
+    uint64_t frameCount;  /* The amount of frames. */
+    uint32_t durationMilliseconds;  /* The duration of the audio. */
+    uint32_t sampleRate;  /* The sample rate in frames/second. */
+    uint32_t dataSize;  /* The size of the audio data in bytes. */
+    uint32_t cueCount;  /* The amount of cue points. */
+    uint16_t format;  /* The WAVE format tag, 0xF1AC for native FLAC files. */
+    uint16_t channelAmount;  /* The amount of channels. */
+    uint16_t bitsPerSample;  /* The bits per sample, 4 for ADPCM. */
+    uint16_t chunkCount;  /* The amount of chunks, at most AUDIO_PROBE_MAX_CHUNKS. */
+    AudioChunk chunks[AUDIO_PROBE_MAX_CHUNKS];  /* The chunks of a WAV file in file order. */
+} AudioProbe;
+
+#define AUDIO_MAX_DEVICES (8)
+
+/**
+ * @brief How a sound device fed by audioAddDevice() keeps up with the first one.
+ * 
+ * The first sound device is the one of the audio configuration. Its
+ * offset and correction are always 0.
+*/
+typedef struct {
+    float offsetMicroseconds;  /* How far the device plays ahead of the first device. */
+    float driftPpm;  /* How much faster the device clock runs than CLOCK_MONOTONIC in parts per million. */
+    float correctionPpm;  /* How much faster the resampler reads frames than the device plays them in parts per million. */
+    bool isLinked;  /* Whether the device is on the card of the first device and starts together with it. */
+} AudioDeviceSync;
+
+/**
+ * @brief What an event of an audio object reports.
+*/
+enum AudioEventType {
+    AUDIO_EVENT_END_REACHED,  /* The last frame was written and the audio stops. */
+    AUDIO_EVENT_STATE_CHANGED,  /* The audio started playing, was paused or was stopped. */
+    AUDIO_EVENT_MARKER,  /* A marker set by audioAddMarker() was played. */
+    AUDIO_EVENT_XRUN,  /* A sound device ran out of frames and was restarted. */
+    AUDIO_EVENT_ERROR  /* Writing to a sound device or reading a streamed file failed. */
+};
+
+/**
+ * @brief The playback state of an audio object.
+*/
+enum AudioState {
+    AUDIO_STATE_STOPPED,  /* The audio is at the beginning and not playing. */
+    AUDIO_STATE_PLAYING,  /* The audio is playing. */
+    AUDIO_STATE_PAUSED  /* The audio is paused. */
+};
+
+/**
+ * @brief An event queued by the audio thread.
+ * 
+ * If the queue is full, events are dropped and counted in the next event
+ * that fits.
+*/
+typedef struct {
+    enum AudioEventType type;  /* What happened. */
+    enum AudioState state;  /* The playback state after the event. */
+    uint32_t frame;  /* The frame of the playhead, for markers the frame of the marker. */
+    uint32_t markerId;  /* The identifier of the marker for AUDIO_EVENT_MARKER. */
+    uint32_t droppedEvents;  /* How many events were dropped right before this one. */
+    uint64_t nanoseconds;  /* When the event was queued on CLOCK_MONOTONIC or the clock of a memory sink. */
+    AudioError error;  /* The error for AUDIO_EVENT_ERROR. */
+} AudioEvent;
+
+#define AUDIO_HISTOGRAM_BUCKETS (200)
+
+/**
+ * @brief The distribution of a duration in microseconds.
+ * 
+ * Bucket i counts the durations from audioGetHistogramBucketStart(i) up
+ * to the start of bucket i + 1. Durations below 8 µs get a bucket each,
+ * longer ones get 8 buckets per power of two, so every bucket is at most
+ * 12.5% wide. The last bucket counts everything from about 2 minutes.
+*/
+typedef struct {
+    uint64_t count;  /* The amount of durations. */
+    float averageMicroseconds;  /* The average duration. */
+    float maxMicroseconds;  /* The longest duration. */
+    uint64_t buckets[AUDIO_HISTOGRAM_BUCKETS];  /* How many durations fell into each bucket. */
+} AudioHistogram;
+
+/**
+ * @brief What the audio thread of an audio object did since it started.
+ * 
+ * The counters only grow, so a monitor can subtract two snapshots. The
+ * ALSA buffer statistics are taken whenever the audio thread wakes up
+ * while playing. A small delay means the sound device was about to run
+ * out of frames.
+*/
+typedef struct {
+    uint64_t wakeups;  /* How often the audio thread woke up. */
+    uint64_t refills;  /* How often the audio thread wrote frames. */
+    uint64_t framesWritten;  /* The frames written to the first sound device. */
+    uint64_t xruns;  /* How often a sound device ran out of frames. */
+    uint64_t commands;  /* How many actions like audioPlay() the audio thread applied. */
+    uint64_t minorFaults;  /* The minor page faults the audio thread took while writing. */
+    uint64_t majorFaults;  /* The major page faults the audio thread took while writing. */
+    uint32_t bufferFrames;  /* The size of the ALSA buffer in frames. */
+    uint32_t maxAvailFrames;  /* The most frames the ALSA buffer had room for. */
+    uint32_t minDelayFrames;  /* The fewest frames queued ahead of the playhead. */
+    float averageAvailFrames;  /* The average room in the ALSA buffer in frames. */
+    float averageDelayFrames;  /* The average frames queued ahead of the playhead. */
+    AudioHistogram refill;  /* How long writing the frames of a refill took. */
+    AudioHistogram command;  /* How long an action took from the call until the audio thread applied it. */
+    AudioHistogram headroom;  /* How much audio was queued ahead of the playhead at a wakeup. */
+} AudioStats;
+
+/**
+ * @brief What a render command does.
+*/
+enum AudioRenderAction {
+    AUDIO_RENDER_PLAY,  /* audioPlay() */
+    AUDIO_RENDER_PAUSE,  /* audioPause() */
+    AUDIO_RENDER_STOP,  /* audioStop() */
+    AUDIO_RENDER_JUMP,  /* audioJump() to value milliseconds */
+    AUDIO_RENDER_JUMP_TO_CUE,  /* audioJumpToCue() with the identifier value */
+    AUDIO_RENDER_VOLUME,  /* audioSetVolume() to value [0..100] */
+    AUDIO_RENDER_GAIN  /* audioSetGain() to value decibels */
+};
+
+/**
+ * @brief A command of a render script.
+*/
+typedef struct {
+    uint64_t milliseconds;  /* When the command is given, counted from the start of the render. */
+    uint32_t object;  /* The index of the audio object it is given to. */
+    enum AudioRenderAction action;  /* What it does. */
+    double value;  /* The argument of the action. */
+} AudioRenderCommand;
+
 /**
  * @brief This represents an opaque audio object. 
  * */ 
 typedef void* AudioObject;
 
+/**
+ * @brief This represents opaque audio data shared by audio objects.
+ * */ 
+typedef void* AudioBuffer;
+
+/**
+ * @brief This represents an opaque sound bank.
+ * */ 
+typedef void* AudioBank;
+
+/**
+ * @brief This represents the opaque waveform peaks of an audio file.
+ * */ 
+typedef void* AudioPeaks;
+
+/**
+ * @brief This represents an opaque batch of audio objects being initialized.
+ * */ 
+typedef void* AudioBatch;
+
+/**
+ * @brief This is called on a worker thread of a batch when an audio object is ready.
+ * 
+ * The object belongs to the caller from then on, even if its
+ * initialization failed.
+ * */ 
+typedef void (*AudioBatchCallback)(void *userData, uint32_t index, AudioObject object);
+
 /**
  * Initializes the audio object with the given configuration.
  * 
+ * The raw data is either a WAV file or a native FLAC file with up to 8
+ * channels of up to 24 bits. FLAC frames are decoded by a helper thread
+ * ahead of the playhead. Jumps are found through the SEEKTABLE if the file
+ * has one and by bisecting the file otherwise.
+ * 
  * Only if the initial memory allocation failed this function returns NULL.
  * Otherwise an AudioObject is returned. Therefore make sure to call
  * audioGetError() afterwards to check if the initialization was successful.
@@ -99,6 +457,422 @@ typedef void* AudioObject;
  * @return The audio object or NULL.
  * */
 AudioObject * audioInit(AudioConfiguration *configuration);
+/**
+ * Initializes the audio object with a compact copy of the raw data.
+ * 
+ * Integer PCM data is transcoded at init time as selected by residency.
+ * Afterwards the raw data is not needed anymore and may be freed. Other
+ * formats are used as given like by audioInit(), so their raw data must
+ * stay valid, and AUDIO_WARNING_RESIDENCY_UNSUPPORTED is set.
+ * Use audioGetCompressionRatio() and audioGetDecoderLoad() to weigh the
+ * saved memory against the decoding cost. Apart from that this behaves like
+ * audioInit().
+ * 
+ * @param configuration The configuration to use.
+ * @param residency How the audio data is kept in memory.
+ * @return The audio object or NULL.
+*/
+AudioObject * audioInitCompact(
+    AudioConfiguration *configuration, enum AudioResidency residency
+);
+/**
+ * Initializes the audio object with the WAV or FLAC file at the given path.
+ * 
+ * The file is loaded by the library as described in
+ * AudioLoaderConfiguration. The rawData and rawDataSize members of the
+ * configuration are ignored. Pass NULL as loaderConfiguration to use the
+ * defaults. Apart from that this behaves like audioInit().
+ * 
+ * @param configuration The configuration to use.
+ * @param path The path of the WAV or FLAC file.
+ * @param loaderConfiguration The loader configuration or NULL.
+ * @return The audio object or NULL.
+*/
+AudioObject * audioInitFromPath(
+    AudioConfiguration *configuration, 
+    const char *path, 
+    AudioLoaderConfiguration *loaderConfiguration
+);
+/**
+ * Keeps the ALSA pcms of destroyed audio objects open for new ones.
+ * 
+ * Opening and configuring a pcm takes most of the time of initializing an
+ * audio object. With the pool enabled, audioDestroy() stops the pcm and
+ * keeps it configured, and the next audio object for the same sound
+ * device, sample format, sample rate, channel layout and time resolution
+ * takes it over. A kept pcm blocks the sound device for other processes
+ * unless it is shared by a plugin like dmix, so the pool is disabled by
+ * default. Pcms of audio objects with added devices are not kept. Memory
+ * sinks and pipes are never kept.
+ * 
+ * Idle pcms beyond maxPcms are closed when a pcm is returned. A thread of
+ * the pool closes every idle pcm once it was kept for idleMilliseconds,
+ * even if no audio object is created anymore. It only runs while pcms are
+ * idle. Any thread may call this.
+ * 
+ * @param maxPcms How many idle pcms are kept, 0 to close all and disable
+ * the pool.
+ * @param idleMilliseconds How long an idle pcm is kept, 0 closes every pcm
+ * as soon as it is returned, which disables the pool like maxPcms 0.
+*/
+void audioSetPcmPool(uint32_t maxPcms, uint32_t idleMilliseconds);
+/**
+ * Returns how many idle pcms the pool keeps after closing expired ones.
+ * 
+ * @return The amount of idle pcms.
+*/
+uint32_t audioGetPcmPoolSize(void);
+/**
+ * Initializes many audio objects with audioInit() on several threads.
+ * 
+ * The threads take the configurations one at a time, so parsing the data
+ * and opening the sound devices of the objects overlap. Every object is
+ * handed over as soon as it is ready: callback is called for it on the
+ * thread that initialized it, then the file descriptor of audioBatchGetFd()
+ * becomes readable and audioBatchGetObject() returns it. Enable the pcm
+ * pool with audioSetPcmPool() to have objects for the same setup take over
+ * configured pcms instead of opening their own.
+ * 
+ * The configurations must stay valid until audioBatchWait() returns. Check
+ * every object with audioGetError() and destroy it with audioDestroy().
+ * An object whose memory allocation failed is NULL.
+ * 
+ * @param configurations The configurations to use.
+ * @param configurationCount The amount of configurations.
+ * @param threadCount The amount of threads, 0 for one per processor.
+ * @param callback The function called for every object or NULL.
+ * @param userData The first argument of callback.
+ * @return The batch or NULL if its memory allocation failed.
+*/
+AudioBatch audioInitBatch(
+    AudioConfiguration *configurations, uint32_t configurationCount, 
+    uint32_t threadCount, AudioBatchCallback callback, void *userData
+);
+/**
+ * Returns a file descriptor that is readable while ready objects were not
+ * taken with audioBatchReadObjects().
+ * 
+ * Do not read or close it. Only one thread may read the objects.
+ * 
+ * @param self The batch.
+ * @return The file descriptor or -1 if none could be created.
+*/
+int audioBatchGetFd(AudioBatch self);
+/**
+ * Takes the indices of the objects that became ready since the last call
+ * in the order they became ready.
+ * 
+ * The file descriptor stays readable if ready objects are left.
+ * 
+ * @param self The batch.
+ * @param indices Room for the indices of the configurations.
+ * @param maxIndexCount The amount of indices that fit into indices.
+ * @return The amount of indices taken.
+*/
+uint32_t audioBatchReadObjects(AudioBatch self, uint32_t *indices, uint32_t maxIndexCount);
+/**
+ * Returns the audio object of a configuration if it is ready.
+ * 
+ * @param self The batch.
+ * @param index The index of the configuration.
+ * @param object The object, which may be NULL if its memory allocation failed.
+ * @return Whether the object is ready.
+*/
+bool audioBatchGetObject(AudioBatch self, uint32_t index, AudioObject *object);
+/**
+ * Blocks until every object of the batch is ready.
+ * 
+ * @param self The batch.
+ * @return The amount of objects.
+*/
+uint32_t audioBatchWait(AudioBatch self);
+/**
+ * Waits for the batch and frees it. The audio objects are not destroyed.
+ * 
+ * @param self The batch.
+*/
+void audioBatchDestroy(AudioBatch self);
+/**
+ * Creates a buffer from a WAV or FLAC file in memory.
+ * 
+ * The data is parsed and validated once. Every audio object created from
+ * the buffer with audioInitFromBuffer() reads the same bytes, so many
+ * voices of one clip need no further memory for the data. Without
+ * AUDIO_BUFFER_COPY the bytes are borrowed and must stay valid until the
+ * buffer and every audio object created from it are gone.
+ * 
+ * With AUDIO_BUFFER_DEDUPLICATE an existing buffer holding the same bytes
+ * is returned with an added reference. Only buffers owning their data
+ * are found this way, so combine it with AUDIO_BUFFER_COPY for buffers
+ * that should be found by later calls.
+ * 
+ * Only if a memory allocation failed this function returns NULL. Check
+ * audioBufferGetError() afterwards and call audioBufferRelease() in any
+ * other case.
+ * 
+ * @param rawData The raw audio data as found in a WAV or FLAC file.
+ * @param rawDataSize The size of the raw audio data.
+ * @param flags A combination of AudioBufferFlag values.
+ * @return The buffer or NULL.
+*/
+AudioBuffer * audioBufferInit(
+    const void *rawData, size_t rawDataSize, uint32_t flags
+);
+/**
+ * Creates a buffer from the WAV or FLAC file at the given path.
+ * 
+ * The file is mapped and faulted in completely, the flag AUDIO_BUFFER_COPY
+ * has no effect. With AUDIO_BUFFER_DEDUPLICATE a buffer of the same
+ * unchanged file or with the same bytes is returned if there is one.
+ * Apart from that this behaves like audioBufferInit().
+ * 
+ * @param path The path of the WAV or FLAC file.
+ * @param flags A combination of AudioBufferFlag values.
+ * @return The buffer or NULL.
+*/
+AudioBuffer * audioBufferInitFromPath(const char *path, uint32_t flags);
+/**
+ * Adds a reference to the buffer.
+ * 
+ * @param self The buffer.
+*/
+void audioBufferRetain(AudioBuffer self);
+/**
+ * Drops a reference to the buffer.
+ * 
+ * The buffer is freed once neither the caller nor an audio object holds a
+ * reference anymore. Audio objects created from the buffer stay usable
+ * after the caller's last release.
+ * 
+ * @param self The buffer.
+*/
+void audioBufferRelease(AudioBuffer self);
+/**
+ * Returns the error of parsing or loading the buffer.
+ * 
+ * @param self The buffer.
+ * @return The error object.
+*/
+AudioError * audioBufferGetError(AudioBuffer self);
+/**
+ * Initializes the audio object with the data of the given buffer.
+ * 
+ * The rawData and rawDataSize members of the configuration are ignored.
+ * The audio object holds a reference to the buffer until audioDestroy().
+ * If the buffer has an error, the audio object gets the same error.
+ * Apart from that this behaves like audioInit().
+ * 
+ * Memory locks of audioSetLockedWindow() do not stack: unlocking a range
+ * in one audio object unlocks it for all audio objects sharing the buffer.
+ * 
+ * @param configuration The configuration to use.
+ * @param buffer The buffer to play.
+ * @return The audio object or NULL.
+*/
+AudioObject * audioInitFromBuffer(
+    AudioConfiguration *configuration, AudioBuffer buffer
+);
+/**
+ * Packs WAV or FLAC files into a sound bank.
+ * 
+ * Every file is validated and described in the index of the bank, so
+ * opening the bank and creating audio objects from it later on needs no
+ * parsing. The files are stored unmodified, each starting on its own page.
+ * Clips are found by name with audioBankFindClip(), the names must be
+ * unique.
+ * 
+ * @param path The path of the bank to write.
+ * @param clipPaths The paths of the WAV or FLAC files.
+ * @param clipNames The names of the clips.
+ * @param clipCount The amount of clips.
+ * @param error The error that is filled, e.g. with the error of an invalid file.
+ * @return Whether the bank was written.
+*/
+bool audioBankPack(
+    const char *path, const char **clipPaths, const char **clipNames, 
+    uint32_t clipCount, AudioError *error
+);
+/**
+ * Opens a sound bank written by audioBankPack().
+ * 
+ * The bank is mapped and only its index is read, which takes a single
+ * mapping no matter how many clips the bank holds. The clips are faulted
+ * in when they are played.
+ * 
+ * Only if a memory allocation failed this function returns NULL. Check
+ * audioBankGetError() afterwards and call audioBankClose() in any other
+ * case.
+ * 
+ * @param path The path of the bank.
+ * @return The bank or NULL.
+*/
+AudioBank * audioBankOpen(const char *path);
+/**
+ * Closes the sound bank.
+ * 
+ * Audio objects created from the bank keep it mapped until they are
+ * destroyed.
+ * 
+ * @param self The bank.
+*/
+void audioBankClose(AudioBank self);
+/**
+ * Returns the error of opening the sound bank.
+ * 
+ * @param self The bank.
+ * @return The error object.
+*/
+AudioError * audioBankGetError(AudioBank self);
+/**
+ * Returns the amount of clips in the sound bank.
+ * 
+ * Clips are numbered from 0 in an order determined by their names.
+ * 
+ * @param self The bank.
+*/
+uint32_t audioBankGetClipCount(AudioBank self);
+/**
+ * Looks up the number of a clip by its name.
+ * 
+ * @param self The bank.
+ * @param name The name given to audioBankPack().
+ * @param clip The number of the clip if it was found.
+ * @return Whether the clip was found.
+*/
+bool audioBankFindClip(AudioBank self, const char *name, uint32_t *clip);
+/**
+ * Returns the duration of a clip in milliseconds without creating an audio object.
+ * 
+ * @param self The bank.
+ * @param clip The number of the clip.
+ * @return The duration or 0 if there is no such clip.
+*/
+uint32_t audioBankGetClipDuration(AudioBank self, uint32_t clip);
+/**
+ * Initializes the audio object with a clip of the sound bank.
+ * 
+ * Uncompressed clips are played right from the index entry, only ADPCM
+ * and FLAC clips have their header read again. The rawData and
+ * rawDataSize members of the configuration are ignored. The audio object
+ * keeps the bank mapped until audioDestroy(). Apart from that this behaves
+ * like audioInit().
+ * 
+ * @param configuration The configuration to use.
+ * @param bank The bank.
+ * @param clip The number of the clip.
+ * @return The audio object or NULL.
+*/
+AudioObject * audioInitFromBank(
+    AudioConfiguration *configuration, AudioBank bank, uint32_t clip
+);
+/**
+ * Computes the waveform peaks of a WAV or FLAC file at every level.
+ * 
+ * The peaks are cached in a sidecar file next to the audio file, named
+ * like it with ".peaks" appended. If the sidecar file matches the size and
+ * the modification time of the audio file it is mapped instead of reading
+ * the audio file. Otherwise the file is decoded once, split into segments
+ * that are scanned on threadCount threads, and the sidecar file is
+ * written. If that fails WARNING_PEAKS_NOT_CACHED is set.
+ * 
+ * Only if a memory allocation failed this function returns NULL. Check
+ * audioPeaksGetError() afterwards and call audioPeaksDestroy() in any
+ * other case.
+ * 
+ * @param path The path of the audio file.
+ * @param threadCount The amount of threads, 0 for one per processor.
+ * @return The peaks or NULL.
+*/
+AudioPeaks * audioPeaksInit(const char *path, uint32_t threadCount);
+/**
+ * Frees the peaks.
+ * 
+ * @param self The peaks.
+*/
+void audioPeaksDestroy(AudioPeaks self);
+/**
+ * Returns the error of computing the peaks.
+ * 
+ * @param self The peaks.
+ * @return The error object.
+*/
+AudioError * audioPeaksGetError(AudioPeaks self);
+/**
+ * Returns the amount of channels, which is the amount of AudioPeak per bucket.
+ * 
+ * @param self The peaks.
+*/
+uint16_t audioPeaksGetChannelAmount(AudioPeaks self);
+/**
+ * Copies the buckets of a time range at a level.
+ * 
+ * The buckets overlapping [startMilliseconds, endMilliseconds) are copied,
+ * each as one AudioPeak per channel. The cost only depends on the amount of
+ * buckets copied. Pass NULL as peaks to get the amount of buckets.
+ * 
+ * @param self The peaks.
+ * @param level The zoom level.
+ * @param startMilliseconds The start of the range.
+ * @param endMilliseconds The end of the range.
+ * @param peaks Room for bucketCapacity buckets or NULL.
+ * @param bucketCapacity The most buckets to copy.
+ * @return The amount of buckets in the range, at most bucketCapacity if peaks is given.
+*/
+uint32_t audioPeaksGet(
+    AudioPeaks self, enum AudioPeakLevel level, uint32_t startMilliseconds, 
+    uint32_t endMilliseconds, AudioPeak *peaks, uint32_t bucketCapacity
+);
+/**
+ * Reads and validates the header of a WAV or FLAC file.
+ * 
+ * This runs the checks of audioInit() without opening the sound device or
+ * starting a thread. Only the first pages of the file are read, and the
+ * headers of chunks behind them. Everything else is left to the page
+ * cache.
+ * 
+ * @param path The path of the file.
+ * @param probe The probe that is filled, its error tells why the file cannot be played.
+ * @return Whether the file can be played.
+*/
+bool audioProbe(const char *path, AudioProbe *probe);
+/**
+ * Probes many files with audioProbe() on several threads.
+ * 
+ * The threads take the files one at a time, so a file on a slow disk only
+ * holds up its own thread.
+ * 
+ * @param paths The paths of the files.
+ * @param pathCount The amount of files.
+ * @param threadCount The amount of threads, 0 for one per processor.
+ * @param probes Room for one probe per file, in the order of paths.
+*/
+void audioProbeFiles(
+    const char **paths, uint32_t pathCount, uint32_t threadCount, 
+    AudioProbe *probes
+);
+/**
+ * Measures the loudness of a WAV or FLAC file.
+ * 
+ * The file is split into ranges of whole 100 ms segments that are measured
+ * on threadCount threads, each starting one second early so its filters
+ * are settled. The 400 ms and 3 s gating blocks are built from the
+ * segments afterwards, so the result does not depend on threadCount.
+ * 
+ * The loudness is cached in a sidecar file named like the audio file with
+ * ".loudness" appended, which is used while it matches the size and the
+ * modification time of the audio file. If it cannot be written
+ * WARNING_LOUDNESS_NOT_CACHED is set.
+ * 
+ * @param path The path of the audio file.
+ * @param threadCount The amount of threads, 0 for one per processor.
+ * @param loudness The loudness that is filled.
+ * @param error The error that is filled, e.g. with the error of an invalid file.
+ * @return Whether the loudness was measured.
+*/
+bool audioAnalyzeLoudness(
+    const char *path, uint32_t threadCount, AudioLoudness *loudness, 
+    AudioError *error
+);
 /**
  * Frees the resources of the audio object.
  * 
@@ -161,6 +935,168 @@ void audioStop(AudioObject self, pthread_barrier_t *barrier);
 bool audioJump(
     AudioObject self, pthread_barrier_t *barrier, uint32_t milliseconds
 );
+/**
+ * Returns the cue points of the audio, sorted by position.
+ * 
+ * The cue points stay valid until audioDestroy(). Only cue points within
+ * the audio data are returned. Files loaded with useStreaming only have
+ * the cue points that are stored in front of the audio data.
+ * 
+ * @param self The audio object.
+ * @param cueCount The amount of cue points.
+ * @return The cue points or NULL if there are none.
+*/
+const AudioCue * audioGetCues(AudioObject self, uint32_t *cueCount);
+/**
+ * Jumps to the cue point with the given identifier.
+ * 
+ * This behaves like audioJump() but is exact to the frame. If the frames
+ * behind the cue point are preloaded with audioSetCuePreload() they are
+ * played from memory until the regular data takes over.
+ * 
+ * If you call audioGetError() after this function you might get a 
+ * WARNING_CUE_NOT_FOUND error if there is no such cue point. In that case
+ * nothing happens.
+ * 
+ * @param self The audio object.
+ * @param barrier An optional barrier to wait on.
+ * @param id The identifier of the cue point.
+ * @return Whether the cue point was found.
+*/
+bool audioJumpToCue(AudioObject self, pthread_barrier_t *barrier, uint32_t id);
+/**
+ * Keeps the frames behind every cue point decoded and locked in memory.
+ * 
+ * A jump to a cue point then starts sound without waiting for pages to be
+ * read or for blocks to be decoded. The frames are copied, or decoded for
+ * ADPCM and compact audio data, before this function returns. Pass 0 to
+ * free them again.
+ * 
+ * If the frames could not be locked, e.g. because RLIMIT_MEMLOCK is too
+ * low, they are kept unlocked and WARNING_LOCKED_WINDOW_REDUCED is set.
+ * 
+ * @param self The audio object.
+ * @param milliseconds How much audio behind every cue point is preloaded.
+ * @return Whether the frames were preloaded.
+*/
+bool audioSetCuePreload(AudioObject self, uint32_t milliseconds);
+/**
+ * Reads the loop of a WAV file.
+ * 
+ * The loop is the first forward loop of the smpl chunk. Its count is the
+ * play count of the chunk, its crossfade is 0.
+ * 
+ * If you call audioGetError() after this function you might get a 
+ * WARNING_NO_LOOP error if the file has no such loop.
+ * 
+ * @param self The audio object.
+ * @param loop The loop.
+ * @return Whether the file has a loop.
+*/
+bool audioGetFileLoop(AudioObject self, AudioLoop *loop);
+/**
+ * Loops a part of the audio.
+ * 
+ * When the playback reaches the end of the loop it continues at its start
+ * within the same write to the sound device, so the buffer never runs
+ * empty and the loop is seamless to the frame. Pass the loop of
+ * audioGetFileLoop() to play a file the way it was authored.
+ * 
+ * With a crossfade the last frames of the loop are faded into the frames
+ * in front of its start, which smooths loops whose ends do not match. The
+ * faded frames are computed before this function returns. The crossfade
+ * is shortened to the frames in front of the start and to the loop.
+ * 
+ * The loop count of audioGetClock() starts over. If the playback is
+ * behind the end of the loop, it only loops after a jump in front of it.
+ * Native FLAC files and files loaded with useStreaming decode or read
+ * ahead in order, so they may run out of frames right after the end of
+ * the loop.
+ * 
+ * If you call audioGetError() after this function you might get a 
+ * WARNING_INVALID_LOOP error if the loop is empty or beyond the end of
+ * the audio data, which excludes appended segments, or
+ * WARNING_LOOP_CROSSFADE_UNSUPPORTED if the audio cannot be crossfaded.
+ * In that case nothing happens.
+ * 
+ * @param self The audio object.
+ * @param loop The loop or NULL to stop looping.
+ * @return Whether the loop was set.
+*/
+bool audioSetLoop(AudioObject self, const AudioLoop *loop);
+/**
+ * Reads the position that is heard and how often it looped.
+ * 
+ * The audio thread updates the clock every time it wakes up, so reading it
+ * never waits for the audio thread or the sound device.
+ * 
+ * @param self The audio object.
+ * @param clock The clock.
+*/
+void audioGetClock(AudioObject self, AudioClock *clock);
+/**
+ * Appends a segment of a buffer to the timeline of the audio object.
+ * 
+ * The timeline starts with the audio data of the audio object, the
+ * segments follow it in the order they were appended. The playback moves
+ * from one to the next within the same write to the sound device, so
+ * there is no gap between them. audioJump(), audioGetCurrentTime(),
+ * audioGetTotalDuration() and markers address the whole timeline. The
+ * segments can be appended while the audio plays.
+ * 
+ * The buffer is validated and its frames are prefetched before this
+ * function returns. The audio object holds a reference to the buffer
+ * until audioDestroy().
+ * 
+ * If you call audioGetError() after this function you might get a 
+ * WARNING_INVALID_SEGMENT error if the buffer has an error or the segment
+ * lies beyond its end, or WARNING_SEGMENT_FORMAT_MISMATCH if the audio
+ * object or the buffer holds compressed audio or the buffer has another
+ * sample format, sample rate or amount of channels. In that case nothing
+ * happens.
+ * 
+ * @param self The audio object.
+ * @param buffer The buffer holding the frames.
+ * @param startFrame The first frame of the buffer that is played.
+ * @param frameCount The amount of frames, 0 for all frames behind startFrame.
+ * @param timelineFrame Where the segment starts on the timeline, may be NULL.
+ * @return Whether the segment was appended.
+*/
+bool audioAppendSegment(
+    AudioObject self, AudioBuffer buffer, uint32_t startFrame, 
+    uint32_t frameCount, uint32_t *timelineFrame
+);
+/**
+ * Replaces the audio data of the audio object with the audio data of a
+ * buffer while it plays.
+ * 
+ * The buffer is parsed when it is created, so the audio thread only swaps
+ * a pointer at its next wakeup. The playback keeps its position, the
+ * sound device stays open and the frames already in its buffer are played
+ * first. Segments move with the end of the audio data. A loop stays if it
+ * lies within the new audio data, but without its crossfade. Preloaded cue
+ * points are not played until audioSetCuePreload() is called again.
+ * 
+ * With a crossfade the frames behind the switch fade from the replaced
+ * into the new audio data. A-law and µ-law audio switch without one.
+ * 
+ * The audio object holds a reference to the buffer until the data is
+ * replaced again or audioDestroy() is called.
+ * 
+ * If you call audioGetError() after this function you might get a 
+ * WARNING_INVALID_REPLACEMENT error if the buffer has an error, is empty,
+ * the audio object or the buffer holds compressed audio or the buffer has
+ * another sample format, sample rate or amount of channels. In that case
+ * nothing happens.
+ * 
+ * @param self The audio object.
+ * @param buffer The buffer holding the new audio data.
+ * @param crossfadeMilliseconds The length of the crossfade, 0 for none.
+ * @return Whether the audio data was replaced.
+*/
+bool audioReplaceData(
+    AudioObject self, AudioBuffer buffer, uint32_t crossfadeMilliseconds
+);
 
 /**
  * Returns whether the audio is playing.
@@ -183,11 +1119,116 @@ bool audioGetIsPaused(AudioObject self);
 */
 uint32_t audioGetCurrentTime(AudioObject self);
 /**
- * Returns the total duration of the audio in milliseconds.
+ * Returns the total duration of the audio in milliseconds, including the
+ * segments appended with audioAppendSegment().
  * 
  * @param self The audio object.
 */
 uint32_t audioGetTotalDuration(AudioObject self);
+/**
+ * Returns the major page faults the audio thread took per minute of
+ * played audio.
+ * 
+ * Use this to check whether the audio data is resident when it is
+ * written to the sound device.
+ * 
+ * @param self The audio object.
+*/
+float audioGetMajorFaultsPerMinute(AudioObject self);
+/**
+ * Returns the CPU time spent decoding per second of decoded audio.
+ * 
+ * 0.01 means decoding takes 1% of one core. This is 0 for uncompressed
+ * audio and before anything was decoded.
+ * 
+ * @param self The audio object.
+*/
+float audioGetDecoderLoad(AudioObject self);
+/**
+ * Returns how many times smaller the audio data in memory is than the data
+ * it was created from. This is 1 unless audioInitCompact() transcoded it.
+ * 
+ * @param self The audio object.
+*/
+float audioGetCompressionRatio(AudioObject self);
+/**
+ * Takes a snapshot of the statistics of the audio thread.
+ * 
+ * The audio thread updates them with relaxed atomic stores and two clock
+ * reads per refill, so they cost nearly nothing when they are not read.
+ * A snapshot taken while playing may be off by the refill in progress.
+ * 
+ * @param self The audio object.
+ * @param stats The statistics.
+*/
+void audioGetStats(AudioObject self, AudioStats *stats);
+/**
+ * Returns the smallest duration counted in a bucket of a histogram.
+ * 
+ * @param bucket The bucket, AUDIO_HISTOGRAM_BUCKETS for the end of the last one.
+ * @return The duration in microseconds.
+*/
+uint64_t audioGetHistogramBucketStart(uint32_t bucket);
+/**
+ * Returns the duration a share of the durations in a histogram stays within.
+ * 
+ * The end of the bucket that reaches the share is returned, but at most
+ * the longest duration.
+ * 
+ * @param histogram The histogram.
+ * @param percentile The share in percent, e.g. 99.9.
+ * @return The duration in microseconds, 0 if the histogram is empty.
+*/
+float audioGetHistogramPercentile(const AudioHistogram *histogram, float percentile);
+/**
+ * Writes statistics as text or JSON for a monitoring agent.
+ * 
+ * The text has one "name value" line per number, e.g. "xruns 0" or
+ * "refill_p99_us 180". The JSON object holds the same numbers with the
+ * histograms as nested objects, e.g. {"xruns":0,...,"refill":{"p99_us":180,
+ * ...}}, which also list their buckets that are not empty as [start, count]
+ * pairs. Percentiles are given for 50%, 99% and 99.9%. Like snprintf() the
+ * output is cut off to fit and always terminated.
+ * 
+ * @param stats The statistics.
+ * @param asJson Whether JSON is written instead of text.
+ * @param text Room for the output.
+ * @param size The size of text in bytes.
+ * @return The length of the whole output without the terminating 0.
+*/
+size_t audioFormatStats(const AudioStats *stats, bool asJson, char *text, size_t size);
+
+/**
+ * Keeps a window around the playhead locked in memory.
+ * 
+ * The window covers aheadMilliseconds after and behindMilliseconds before
+ * the playhead. It is moved by a helper thread while playing and after
+ * jumps, so the audio thread never takes a page fault on the audio data.
+ * Streamed audio only keeps its read blocks in memory, so those are locked
+ * instead.
+ * 
+ * If the window does not fit into budgetBytes or RLIMIT_MEMLOCK the part
+ * behind the playhead is shrunk first, then the part ahead of it. In that
+ * case AUDIO_WARNING_LOCKED_WINDOW_REDUCED is set.
+ * 
+ * @param self The audio object.
+ * @param aheadMilliseconds The window ahead of the playhead. 0 unlocks everything.
+ * @param behindMilliseconds The window behind the playhead.
+ * @param budgetBytes The maximum amount of locked bytes. 0 uses RLIMIT_MEMLOCK.
+ * @return Whether any memory is locked.
+*/
+bool audioSetLockedWindow(
+    AudioObject self, 
+    uint32_t aheadMilliseconds, 
+    uint32_t behindMilliseconds, 
+    size_t budgetBytes
+);
+/**
+ * Returns how many bytes of audio data are currently locked in memory.
+ * 
+ * @param self The audio object.
+*/
+size_t audioGetLockedBytes(AudioObject self);
 
 /**
  * Sets the master volume.
@@ -221,6 +1262,239 @@ bool audioSetVolume(AudioObject self, uint8_t volume);
 */
 uint8_t audioGetVolume(AudioObject self);
 
+/**
+ * Sets the gain applied to the frames before they are written.
+ * 
+ * Unlike audioSetVolume() this only affects this audio object. Samples
+ * are clipped to their range. A-law and µ-law samples are written as they
+ * are and WARNING_GAIN_UNSUPPORTED is set.
+ * 
+ * @param self The audio object.
+ * @param decibels The gain in dB, 0 for none.
+ * @return Whether the gain is applied.
+*/
+bool audioSetGain(AudioObject self, float decibels);
+/**
+ * Sets the gain that brings the audio to a target loudness.
+ * 
+ * The gain is reduced so the true peak stays at or below -1 dBTP. The
+ * gain of silence is 0 dB.
+ * 
+ * @param self The audio object.
+ * @param loudness The loudness measured by audioAnalyzeLoudness().
+ * @param targetLoudness The target in LUFS, e.g. -23 for EBU R 128.
+ * @return Whether the gain is applied.
+*/
+bool audioNormalizeLoudness(
+    AudioObject self, const AudioLoudness *loudness, float targetLoudness
+);
+
+/**
+ * Plays the audio on another sound device as well.
+ * 
+ * The audio thread writes the same frames to every sound device. Each
+ * clock is measured against CLOCK_MONOTONIC and a resampler stretches the
+ * frames of every added device by up to 0.1% so it stays aligned with the
+ * first device. Devices on the card of the first device are linked, so
+ * they start together in hardware and are not resampled. If the audio is
+ * playing, the frames in the buffers are dropped and all devices start
+ * again from the frame that was heard.
+ * 
+ * If you call audioGetError() after this function you might get a 
+ * WARNING_TOO_MANY_DEVICES error if AUDIO_MAX_DEVICES sound devices are
+ * fed already, a WARNING_BACKEND_MISMATCH error if only one of the devices
+ * is a memory sink, or an ALSA error if the device could not be opened
+ * with the format of the audio. In all cases nothing happens.
+ * 
+ * @param self The audio object.
+ * @param soundDeviceName The name of the sound device.
+ * @return Whether the device was added.
+*/
+bool audioAddDevice(AudioObject self, const char *soundDeviceName);
+/**
+ * Returns the amount of sound devices including the first one.
+ * 
+ * @param self The audio object.
+*/
+uint32_t audioGetDeviceCount(AudioObject self);
+/**
+ * Returns how well a sound device keeps up with the first one.
+ * 
+ * The drift is measured from the frames each device played since it was
+ * started, so it gets more precise the longer the audio plays.
+ * 
+ * If you call audioGetError() after this function you might get a 
+ * WARNING_DEVICE_NOT_FOUND error if there is no such device.
+ * 
+ * @param self The audio object.
+ * @param device The index of the device, 0 for the first one.
+ * @param sync The state of the device.
+ * @return Whether the device was found.
+*/
+bool audioGetDeviceSync(AudioObject self, uint32_t device, AudioDeviceSync *sync);
+/**
+ * Makes every write to a memory sink take time, like a slow device.
+ * 
+ * The delay passes on the virtual clock before the frames land. If it is
+ * longer than the frames in the buffer last, the sink runs out of frames
+ * like an ALSA device does.
+ * 
+ * If you call audioGetError() after this function you might get a 
+ * WARNING_DEVICE_NOT_FOUND error if there is no such device or a
+ * WARNING_NOT_A_MEMORY_SINK error if it is an ALSA device.
+ * 
+ * @param self The audio object.
+ * @param device The index of the device, 0 for the first one.
+ * @param microseconds How long every write takes, 0 for no delay.
+ * @return Whether the delay was set.
+*/
+bool audioSetSinkWriteDelay(AudioObject self, uint32_t device, uint32_t microseconds);
+/**
+ * Reads how far the reader of a pipe is behind the playback.
+ * 
+ * This is how long the frames last that were written but not read yet,
+ * both the ones queued in the audio object and the ones in the pipe or
+ * socket. A reader that is behind by the whole buffer holds the playback
+ * back. Any thread may call this.
+ * 
+ * If you call audioGetError() after this function you might get a 
+ * WARNING_DEVICE_NOT_FOUND error if there is no such device or a
+ * WARNING_NOT_A_PIPE error if it is not a pipe.
+ * 
+ * @param self The audio object.
+ * @param device The index of the device, 0 for the first one.
+ * @param microseconds How long the unread frames last.
+ * @return Whether the backlog was read.
+*/
+bool audioGetPipeBacklog(AudioObject self, uint32_t device, uint32_t *microseconds);
+
+/**
+ * Returns a file descriptor that is readable while events are queued.
+ * 
+ * It is an eventfd that can be polled with poll() or epoll() together
+ * with other file descriptors. Do not read or close it, use
+ * audioReadEvents() instead. The audio thread queues the events of an
+ * audio object for one reader, so only one thread may read them.
+ * 
+ * @param self The audio object.
+ * @return The file descriptor or -1 if none could be created. Events can
+ * still be read without it.
+*/
+int audioGetEventFd(AudioObject self);
+/**
+ * Takes queued events in the order they happened.
+ * 
+ * The file descriptor stays readable if events are left.
+ * 
+ * @param self The audio object.
+ * @param events Room for the events.
+ * @param maxEventCount The amount of events that fit into events.
+ * @return The amount of events taken.
+*/
+uint32_t audioReadEvents(AudioObject self, AudioEvent *events, uint32_t maxEventCount);
+/**
+ * Queues an AUDIO_EVENT_MARKER event whenever a frame is played.
+ * 
+ * The audio thread checks the markers every time resolution, so an event
+ * is queued at most one time resolution after the frame is heard. Markers
+ * jumped over are not reported. Markers behind the last frame written
+ * are reported before AUDIO_EVENT_END_REACHED.
+ * 
+ * If you call audioGetError() after this function you might get a 
+ * WARNING_MARKER_BEYOND_END error if the frame is behind the last frame.
+ * 
+ * @param self The audio object.
+ * @param id The identifier reported in the event. It need not be unique.
+ * @param frame The frame that is reported.
+ * @return Whether the marker was added.
+*/
+bool audioAddMarker(AudioObject self, uint32_t id, uint32_t frame);
+/**
+ * Removes every marker with an identifier.
+ * 
+ * If you call audioGetError() after this function you might get a 
+ * WARNING_MARKER_NOT_FOUND error if there is no such marker.
+ * 
+ * @param self The audio object.
+ * @param id The identifier given to audioAddMarker().
+ * @return Whether any marker was removed.
+*/
+bool audioRemoveMarker(AudioObject self, uint32_t id);
+
+/**
+ * Records a timeline of the audio thread for audioWriteTrace().
+ * 
+ * The audio thread records its wakeups, the room and delay of the ALSA
+ * buffer, every write with its result, drops, prepares and starts, and
+ * when actions were handed over, applied and released. The events go into
+ * a ring that keeps the last eventCount of them. Recording neither blocks
+ * nor allocates. When a sound device runs out of frames, the ring is
+ * copied, so the moments before the xrun are kept until the next one.
+ * 
+ * @param self The audio object.
+ * @param eventCount The amount of events kept, 0 to stop recording.
+ * About 12 events are recorded per refill.
+ * @return Whether recording was started or stopped.
+*/
+bool audioSetTracing(AudioObject self, uint32_t eventCount);
+/**
+ * Writes the recorded events as Chrome trace JSON.
+ * 
+ * The file can be opened in Perfetto or chrome://tracing. The audio
+ * thread and the user threads waiting for actions are shown as two
+ * threads, the ALSA buffer levels as counters.
+ * 
+ * If you call audioGetError() after this function you might get a 
+ * WARNING_TRACING_DISABLED error if audioSetTracing() was not called,
+ * a WARNING_NO_XRUN_TRACED error if the events at the last xrun are
+ * asked for but there was none, or ERROR_FILE_WRITE_FAILED.
+ * 
+ * @param self The audio object.
+ * @param path Where the trace is written.
+ * @param atLastXrun Whether the events up to the last xrun are written
+ * instead of the latest ones.
+ * @return Whether the trace was written.
+*/
+bool audioWriteTrace(AudioObject self, const char *path, bool atLastXrun);
+
+/**
+ * Plays audio objects through a timed script as fast as the CPU allows.
+ * 
+ * The audio objects must use the sound device "render:PATH". Such a
+ * device plays on a virtual clock that stands still except during a
+ * render, and writes what it plays to the WAV file at PATH, with silence
+ * while nothing plays. The audio thread runs the same refills, actions and
+ * events as on a sound card, so the file holds exactly the frames that
+ * would have been heard, including gain, jumps, underruns and the time
+ * every action takes to be applied.
+ * 
+ * Each command is given when the virtual clock of its audio object
+ * reaches its time, like a user thread calling the function at that
+ * moment. Commands that fail, like pausing a paused object, are skipped.
+ * Every audio object runs on its own thread between the commands. When
+ * the end is reached the WAV files are complete, later playback is not
+ * written to them.
+ * 
+ * If you call audioGetError() on the first audio object after this
+ * function you might get a WARNING_INVALID_RENDER_SCRIPT error if the
+ * commands are not sorted by time, lie behind the end or name a missing
+ * audio object. The audio object that is not a render device gets a
+ * WARNING_NOT_A_RENDER_DEVICE error, the one whose file could not be
+ * written an ERROR_FILE_WRITE_FAILED error.
+ * 
+ * @param objects The audio objects.
+ * @param objectCount The amount of audio objects.
+ * @param commands The commands sorted by time.
+ * @param commandCount The amount of commands.
+ * @param endMilliseconds When the render ends.
+ * @return Whether the render completed.
+*/
+bool audioRender(
+    AudioObject *objects, uint32_t objectCount, 
+    const AudioRenderCommand *commands, uint32_t commandCount, 
+    uint64_t endMilliseconds
+);
+
 /**
  * Returns the last error that occurred.
  * 
@@ -0,0 +1,273 @@
+#include "backend.h"
+#include "pipe.h"
+#include "sink.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define PCM_BLOCK_MODE (0)
+#define PCM_SEARCH_DIRECTION_NEAR (0)
+
+/**
+ * @brief An ALSA pcm.
+*/
+typedef struct {
+    Backend backend;  /* The operations */
+    snd_pcm_t *pcmHandle;  /* The ALSA pcm handle */
+} AlsaBackend;
+
+snd_pcm_t * _getPcm(Backend *backend) {
+    return ((AlsaBackend*)backend)->pcmHandle;
+}
+
+int _alsaConfigure(Backend *backend, const BackendParameters *parameters) {
+    // ENXIO means that the device does not support channel mapping, which
+    // is not an error.
+    snd_pcm_t *pcmHandle = _getPcm(backend);
+    int error = snd_pcm_set_chmap(pcmHandle, parameters->channelMap);
+    if (error && error != -ENXIO) return error;
+
+    snd_pcm_hw_params_t *hardwareParameters;
+    snd_pcm_hw_params_alloca(&hardwareParameters);
+    if (
+        (error = snd_pcm_hw_params_any(pcmHandle, hardwareParameters)) < 0
+        || (error = snd_pcm_hw_params_set_access(
+            pcmHandle, hardwareParameters, SND_PCM_ACCESS_RW_INTERLEAVED
+        )) < 0
+        || (error = snd_pcm_hw_params_set_format(
+            pcmHandle, hardwareParameters, parameters->format
+        )) < 0
+        || (error = snd_pcm_hw_params_set_channels(
+            pcmHandle, hardwareParameters, parameters->channelAmount
+        )) < 0
+        || (error = snd_pcm_hw_params_set_rate(
+            pcmHandle, hardwareParameters, parameters->sampleRate,
+            PCM_SEARCH_DIRECTION_NEAR
+        )) < 0
+        || (error = snd_pcm_hw_params_set_buffer_size(
+            pcmHandle, hardwareParameters, parameters->bufferSize
+        )) < 0
+    ) {
+        return error;
+    }
+    return snd_pcm_hw_params(pcmHandle, hardwareParameters);
+}
+
+int _alsaSetManualStart(Backend *backend) {
+    // The device only starts when snd_pcm_start() is called.
+    snd_pcm_t *pcmHandle = _getPcm(backend);
+    snd_pcm_sw_params_t *softwareParameters;
+    snd_pcm_sw_params_alloca(&softwareParameters);
+    snd_pcm_uframes_t boundary;
+    int error;
+    if (
+        (error = snd_pcm_sw_params_current(pcmHandle, softwareParameters)) < 0
+        || (error = snd_pcm_sw_params_get_boundary(softwareParameters, &boundary)) < 0
+        || (error = snd_pcm_sw_params_set_start_threshold(
+            pcmHandle, softwareParameters, boundary
+        )) < 0
+    ) {
+        return error;
+    }
+    return snd_pcm_sw_params(pcmHandle, softwareParameters);
+}
+
+int _alsaGetCard(Backend *backend) {
+    // Plugins that are not backed by one card return a negative card.
+    snd_pcm_info_t *info;
+    snd_pcm_info_alloca(&info);
+    if (snd_pcm_info(_getPcm(backend), info) < 0) return -1;
+    return snd_pcm_info_get_card(info);
+}
+
+int _alsaLink(Backend *backend, Backend *other) {
+    return snd_pcm_link(_getPcm(backend), _getPcm(other));
+}
+
+int _alsaStatus(Backend *backend, BackendStatus *status) {
+    snd_pcm_status_t *alsaStatus;
+    snd_pcm_status_alloca(&alsaStatus);
+    int error = snd_pcm_status(_getPcm(backend), alsaStatus);
+    status->avail = snd_pcm_status_get_avail(alsaStatus);
+    status->delay = snd_pcm_status_get_delay(alsaStatus);
+    status->state = snd_pcm_status_get_state(alsaStatus);
+    return error;
+}
+
+snd_pcm_sframes_t _alsaAvail(Backend *backend) {
+    return snd_pcm_avail_update(_getPcm(backend));
+}
+
+int _alsaDelay(Backend *backend, snd_pcm_sframes_t *delay) {
+    return snd_pcm_delay(_getPcm(backend), delay);
+}
+
+snd_pcm_state_t _alsaState(Backend *backend) {
+    return snd_pcm_state(_getPcm(backend));
+}
+
+snd_pcm_sframes_t _alsaWrite(
+    Backend *backend, const void *frames, snd_pcm_uframes_t frameCount
+) {
+    return snd_pcm_writei(_getPcm(backend), frames, frameCount);
+}
+
+int _alsaStart(Backend *backend) {
+    return snd_pcm_start(_getPcm(backend));
+}
+
+int _alsaDrop(Backend *backend) {
+    return snd_pcm_drop(_getPcm(backend));
+}
+
+int _alsaPrepare(Backend *backend) {
+    return snd_pcm_prepare(_getPcm(backend));
+}
+
+void _alsaGetTime(Backend *backend, struct timespec *time) {
+    clock_gettime(CLOCK_MONOTONIC, time);
+}
+
+void _alsaSleep(Backend *backend, uint32_t microseconds) {
+    usleep(microseconds);
+}
+
+void _alsaWake(Backend *backend) {
+}
+
+void _alsaClose(Backend *backend) {
+    snd_pcm_drop(_getPcm(backend));
+    snd_pcm_close(_getPcm(backend));
+    free(backend);
+}
+
+static const BackendOperations alsaOperations = {
+    .configure = _alsaConfigure,
+    .setManualStart = _alsaSetManualStart,
+    .getCard = _alsaGetCard,
+    .link = _alsaLink,
+    .status = _alsaStatus,
+    .avail = _alsaAvail,
+    .delay = _alsaDelay,
+    .state = _alsaState,
+    .write = _alsaWrite,
+    .start = _alsaStart,
+    .drop = _alsaDrop,
+    .prepare = _alsaPrepare,
+    .getTime = _alsaGetTime,
+    .sleep = _alsaSleep,
+    .wake = _alsaWake,
+    .close = _alsaClose
+};
+
+enum BackendType backendGetType(const char *deviceName) {
+    if (sinkMatchesName(deviceName)) return BACKEND_TYPE_MEMORY;
+    if (pipeMatchesName(deviceName)) return BACKEND_TYPE_PIPE;
+    return BACKEND_TYPE_ALSA;
+}
+
+int backendOpen(Backend **backend, const char *deviceName, Backend *clockSource) {
+    *backend = NULL;
+    switch (backendGetType(deviceName)) {
+        case BACKEND_TYPE_MEMORY:
+            return sinkOpen(backend, deviceName, clockSource);
+
+        case BACKEND_TYPE_PIPE:
+            return pipeOpen(backend, deviceName);
+
+        default:
+            break;
+    }
+
+    AlsaBackend *alsaBackend = (AlsaBackend*)calloc(1, sizeof(AlsaBackend));
+    if (alsaBackend == NULL) return -ENOMEM;
+    int error = snd_pcm_open(
+        &alsaBackend->pcmHandle, deviceName, SND_PCM_STREAM_PLAYBACK,
+        PCM_BLOCK_MODE
+    );
+    if (error < 0) {
+        free(alsaBackend);
+        return error;
+    }
+    alsaBackend->backend.operations = &alsaOperations;
+    alsaBackend->backend.type = BACKEND_TYPE_ALSA;
+    *backend = &alsaBackend->backend;
+    return 0;
+}
+
+int backendConfigure(Backend *backend, const BackendParameters *parameters) {
+    return backend->operations->configure(backend, parameters);
+}
+
+int backendSetManualStart(Backend *backend) {
+    return backend->operations->setManualStart(backend);
+}
+
+int backendGetCard(Backend *backend) {
+    return backend->operations->getCard(backend);
+}
+
+int backendLink(Backend *backend, Backend *other) {
+    if (backend->type != other->type) return -ENOSYS;
+    return backend->operations->link(backend, other);
+}
+
+int backendStatus(Backend *backend, BackendStatus *status) {
+    return backend->operations->status(backend, status);
+}
+
+snd_pcm_sframes_t backendAvail(Backend *backend) {
+    return backend->operations->avail(backend);
+}
+
+int backendDelay(Backend *backend, snd_pcm_sframes_t *delay) {
+    return backend->operations->delay(backend, delay);
+}
+
+snd_pcm_state_t backendState(Backend *backend) {
+    return backend->operations->state(backend);
+}
+
+snd_pcm_sframes_t backendWrite(
+    Backend *backend, const void *frames, snd_pcm_uframes_t frameCount
+) {
+    return backend->operations->write(backend, frames, frameCount);
+}
+
+snd_pcm_sframes_t backendWriteStable(
+    Backend *backend, const void *frames, snd_pcm_uframes_t frameCount
+) {
+    if (backend->operations->writeStable == NULL) {
+        return backend->operations->write(backend, frames, frameCount);
+    }
+    return backend->operations->writeStable(backend, frames, frameCount);
+}
+
+int backendStart(Backend *backend) {
+    return backend->operations->start(backend);
+}
+
+int backendDrop(Backend *backend) {
+    return backend->operations->drop(backend);
+}
+
+int backendPrepare(Backend *backend) {
+    return backend->operations->prepare(backend);
+}
+
+void backendGetTime(Backend *backend, struct timespec *time) {
+    backend->operations->getTime(backend, time);
+}
+
+void backendSleep(Backend *backend, uint32_t microseconds) {
+    backend->operations->sleep(backend, microseconds);
+}
+
+void backendWake(Backend *backend) {
+    backend->operations->wake(backend);
+}
+
+void backendClose(Backend *backend) {
+    backend->operations->close(backend);
+}
@@ -0,0 +1,235 @@
+#ifndef __BACKEND_H__
+#define __BACKEND_H__
+
+#include <alsa/asoundlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * @brief What plays the frames of a sound device.
+*/
+enum BackendType {
+    BACKEND_TYPE_ALSA,  /* An ALSA pcm */
+    BACKEND_TYPE_MEMORY,  /* A memory sink driven by a virtual clock */
+    BACKEND_TYPE_PIPE  /* A pipe, socket or file another process reads */
+};
+
+/**
+ * @brief The parameters an output is configured with.
+*/
+typedef struct {
+    snd_pcm_format_t format;  /* The sample format */
+    uint32_t sampleRate;  /* The frames per second */
+    snd_pcm_uframes_t bufferSize;  /* The size of the ring buffer in frames */
+    const snd_pcm_chmap_t *channelMap;  /* The channel positions */
+    uint16_t channelAmount;  /* The amount of interleaved channels */
+    uint8_t __align[6];
+} BackendParameters;
+
+/**
+ * @brief The state of the ring buffer of an output.
+*/
+typedef struct {
+    snd_pcm_uframes_t avail;  /* The room for frames */
+    snd_pcm_sframes_t delay;  /* The frames that are not played yet */
+    snd_pcm_state_t state;  /* Whether it is prepared, running or ran out of frames */
+    uint8_t __align[4];
+} BackendStatus;
+
+typedef struct Backend Backend;
+
+/**
+ * @brief The operations an output implements.
+ *
+ * They behave like the snd_pcm_* functions of the same name on a blocking
+ * pcm and return negative error numbers. Only one thread may use an output
+ * at a time. writeStable may be NULL if the output copies all frames.
+*/
+typedef struct {
+    int (*configure)(Backend *backend, const BackendParameters *parameters);
+    int (*setManualStart)(Backend *backend);
+    int (*getCard)(Backend *backend);
+    int (*link)(Backend *backend, Backend *other);
+    int (*status)(Backend *backend, BackendStatus *status);
+    snd_pcm_sframes_t (*avail)(Backend *backend);
+    int (*delay)(Backend *backend, snd_pcm_sframes_t *delay);
+    snd_pcm_state_t (*state)(Backend *backend);
+    snd_pcm_sframes_t (*write)(
+        Backend *backend, const void *frames, snd_pcm_uframes_t frameCount
+    );
+    snd_pcm_sframes_t (*writeStable)(
+        Backend *backend, const void *frames, snd_pcm_uframes_t frameCount
+    );
+    int (*start)(Backend *backend);
+    int (*drop)(Backend *backend);
+    int (*prepare)(Backend *backend);
+    void (*getTime)(Backend *backend, struct timespec *time);
+    void (*sleep)(Backend *backend, uint32_t microseconds);
+    void (*wake)(Backend *backend);
+    void (*close)(Backend *backend);
+} BackendOperations;
+
+/**
+ * @brief The part every output starts with.
+*/
+struct Backend {
+    const BackendOperations *operations;  /* The implementation */
+    enum BackendType type;  /* Which implementation it is */
+    uint8_t __align[4];
+};
+
+/**
+ * Returns which backend plays a sound device.
+ *
+ * @param deviceName "memory", "memory:SPEED" or "render:PATH" for a memory
+ * sink, "pipe:TARGET" or "pipe-free:TARGET" for a pipe output, anything
+ * else is an ALSA pcm.
+*/
+enum BackendType backendGetType(const char *deviceName);
+/**
+ * Opens an output.
+ *
+ * @param backend The output, NULL if it could not be opened.
+ * @param deviceName The name of the sound device.
+ * @param clockSource The output whose clock a memory sink shares, or NULL.
+ * @return 0 or a negative error number.
+*/
+int backendOpen(Backend **backend, const char *deviceName, Backend *clockSource);
+/**
+ * Sets the format, the channel map and the buffer size.
+ *
+ * @param backend The output.
+ * @param parameters The parameters.
+ * @return 0 or a negative error number.
+*/
+int backendConfigure(Backend *backend, const BackendParameters *parameters);
+/**
+ * Makes the output wait for backendStart() instead of starting with the
+ * first write.
+ *
+ * @param backend The output.
+ * @return 0 or a negative error number.
+*/
+int backendSetManualStart(Backend *backend);
+/**
+ * Returns the sound card of an output or a negative number if it is not
+ * backed by one card.
+ *
+ * @param backend The output.
+*/
+int backendGetCard(Backend *backend);
+/**
+ * Links two outputs, so they start and stop together.
+ *
+ * @param backend The output.
+ * @param other The output that is linked to it.
+ * @return 0 or a negative error number.
+*/
+int backendLink(Backend *backend, Backend *other);
+/**
+ * Reads the room, the delay and the state at once.
+ *
+ * @param backend The output.
+ * @param status The status.
+ * @return 0 or a negative error number.
+*/
+int backendStatus(Backend *backend, BackendStatus *status);
+/**
+ * Returns the room for frames or a negative error number.
+ *
+ * @param backend The output.
+*/
+snd_pcm_sframes_t backendAvail(Backend *backend);
+/**
+ * Reads the frames that are not played yet.
+ *
+ * @param backend The output.
+ * @param delay The frames.
+ * @return 0 or a negative error number.
+*/
+int backendDelay(Backend *backend, snd_pcm_sframes_t *delay);
+/**
+ * Returns the state of an output.
+ *
+ * @param backend The output.
+*/
+snd_pcm_state_t backendState(Backend *backend);
+/**
+ * Writes interleaved frames, blocking until they fit.
+ *
+ * @param backend The output.
+ * @param frames The frames.
+ * @param frameCount The amount of frames.
+ * @return The frames written, -EPIPE if the output ran out of frames or
+ * another negative error number.
+*/
+snd_pcm_sframes_t backendWrite(
+    Backend *backend, const void *frames, snd_pcm_uframes_t frameCount
+);
+/**
+ * Writes interleaved frames that never change, even after they are
+ * unmapped, like frames in a read-only mapping of a file. An output may
+ * keep a reference to them instead of copying them.
+ *
+ * @param backend The output.
+ * @param frames The frames.
+ * @param frameCount The amount of frames.
+ * @return The same as backendWrite().
+*/
+snd_pcm_sframes_t backendWriteStable(
+    Backend *backend, const void *frames, snd_pcm_uframes_t frameCount
+);
+/**
+ * Starts a prepared output.
+ *
+ * @param backend The output.
+ * @return 0 or a negative error number.
+*/
+int backendStart(Backend *backend);
+/**
+ * Stops an output and discards its frames.
+ *
+ * @param backend The output.
+ * @return 0 or a negative error number.
+*/
+int backendDrop(Backend *backend);
+/**
+ * Prepares an output for writing after it was dropped or ran out of frames.
+ *
+ * @param backend The output.
+ * @return 0 or a negative error number.
+*/
+int backendPrepare(Backend *backend);
+/**
+ * Reads the clock of an output.
+ *
+ * ALSA pcms use CLOCK_MONOTONIC, memory sinks their virtual clock. Any
+ * thread may read it.
+ *
+ * @param backend The output.
+ * @param time The time.
+*/
+void backendGetTime(Backend *backend, struct timespec *time);
+/**
+ * Sleeps on the clock of an output.
+ *
+ * @param backend The output.
+ * @param microseconds How long.
+*/
+void backendSleep(Backend *backend, uint32_t microseconds);
+/**
+ * Ends the current or next sleep of an output whose clock waits to be
+ * stepped, so a pending action is applied. Other outputs ignore it.
+ *
+ * @param backend The output.
+*/
+void backendWake(Backend *backend);
+/**
+ * Stops and closes an output.
+ *
+ * @param backend The output.
+*/
+void backendClose(Backend *backend);
+
+#endif // __BACKEND_H__
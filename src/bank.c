@@ -0,0 +1,227 @@
+#define _GNU_SOURCE
+
+#include "bank.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BANK_MAGIC ("SNDBANK\0")
+#define NAME_HASH_OFFSET (0xCBF29CE484222325ull)
+#define NAME_HASH_PRIME (0x100000001B3ull)
+
+/**
+ * @brief A clip while the bank is written.
+*/
+typedef struct {
+    BankEntry entry;  /* The entry of the clip */
+    const char *name;  /* The name of the clip */
+    const uint8_t *clip;  /* The file of the clip */
+} BankClip;
+
+uint64_t _alignBankOffset(uint64_t offset) {
+    return (offset + BANK_ALIGNMENT - 1) / BANK_ALIGNMENT * BANK_ALIGNMENT;
+}
+
+uint64_t bankHashName(const char *name, size_t nameSize) {
+    uint64_t hash = NAME_HASH_OFFSET;
+    for (size_t i = 0; i < nameSize; ++i) {
+        hash = (hash ^ (uint8_t)name[i]) * NAME_HASH_PRIME;
+    }
+    return hash;
+}
+
+bool _isValidBankEntry(
+    const BankIndex *index, const BankEntry *entry, uint64_t namesSize
+) {
+    // Every name is followed by a terminator inside the names.
+    if (
+        entry->nameOffset >= namesSize
+        || entry->nameSize >= namesSize - entry->nameOffset
+        || index->names[entry->nameOffset + entry->nameSize] != '\0'
+        || entry->nameHash != bankHashName(
+            index->names + entry->nameOffset, entry->nameSize
+        )
+    ) {
+        return false;
+    }
+    if (
+        entry->clipOffset % BANK_ALIGNMENT != 0
+        || entry->clipOffset > index->size
+        || entry->clipSize > index->size - entry->clipOffset
+    ) {
+        return false;
+    }
+    // Clips that are parsed at runtime are validated then.
+    if (entry->flags & BANK_CLIP_NEEDS_PARSING) return true;
+    return entry->dataOffset <= entry->clipSize
+        && entry->dataSize <= entry->clipSize - entry->dataOffset
+        && entry->sampleRate > 0
+        && entry->byteRate > 0
+        && entry->channelAmount > 0
+        && entry->blockAlign > 0
+        && entry->framesPerBlock > 0;
+}
+
+bool bankReadIndex(const uint8_t *data, size_t size, BankIndex *index) {
+    if (size < sizeof(BankHeader)) return false;
+    const BankHeader *header = (const BankHeader*)data;
+    if (
+        memcmp(header->magic, BANK_MAGIC, BANK_MAGIC_SIZE)
+        || header->version != BANK_VERSION
+    ) {
+        return false;
+    }
+
+    // The entries are used in place, so they have to be aligned.
+    if (
+        header->indexOffset % _Alignof(BankEntry) != 0
+        || header->indexOffset > size
+        || header->clipCount > (size - header->indexOffset) / sizeof(BankEntry)
+        || header->namesOffset > size
+        || header->namesSize > size - header->namesOffset
+    ) {
+        return false;
+    }
+    index->data = data;
+    index->size = size;
+    index->entries = (const BankEntry*)(data + header->indexOffset);
+    index->names = (const char*)(data + header->namesOffset);
+    index->clipCount = header->clipCount;
+
+    for (uint32_t i = 0; i < index->clipCount; ++i) {
+        const BankEntry *entry = &index->entries[i];
+        if (!_isValidBankEntry(index, entry, header->namesSize)) return false;
+        if (i > 0 && entry->nameHash < index->entries[i - 1].nameHash) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool bankFindClip(const BankIndex *index, const char *name, uint32_t *clip) {
+    size_t nameSize = strlen(name);
+    uint64_t hash = bankHashName(name, nameSize);
+
+    // Find the first entry with the hash, then compare the names of all
+    // entries sharing it.
+    uint32_t low = 0;
+    uint32_t high = index->clipCount;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (index->entries[middle].nameHash < hash) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    for (; low < index->clipCount && index->entries[low].nameHash == hash; ++low) {
+        const BankEntry *entry = &index->entries[low];
+        if (
+            entry->nameSize == nameSize
+            && !memcmp(index->names + entry->nameOffset, name, nameSize)
+        ) {
+            *clip = low;
+            return true;
+        }
+    }
+    return false;
+}
+
+int _compareBankClips(const void *a, const void *b) {
+    const BankClip *clipA = (const BankClip*)a;
+    const BankClip *clipB = (const BankClip*)b;
+    if (clipA->entry.nameHash != clipB->entry.nameHash) {
+        return clipA->entry.nameHash < clipB->entry.nameHash ? -1 : 1;
+    }
+    return strcmp(clipA->name, clipB->name);
+}
+
+bool _writeBankData(
+    int fileDescriptor, const uint8_t *data, size_t size, uint64_t offset
+) {
+    size_t bytesWritten = 0;
+    while (bytesWritten < size) {
+        ssize_t result = pwrite(
+            fileDescriptor, data + bytesWritten, size - bytesWritten,
+            offset + bytesWritten
+        );
+        if (result == -1 && errno == EINTR) continue;
+        if (result <= 0) return false;
+        bytesWritten += result;
+    }
+    return true;
+}
+
+bool bankWrite(
+    int fileDescriptor, BankEntry *entries, const char **names,
+    const uint8_t **clips, uint32_t clipCount
+) {
+    BankClip *bankClips = (BankClip*)calloc(clipCount ? clipCount : 1, sizeof(BankClip));
+    if (bankClips == NULL) return false;
+    uint64_t namesSize = 0;
+    for (uint32_t i = 0; i < clipCount; ++i) {
+        bankClips[i].entry = entries[i];
+        bankClips[i].name = names[i];
+        bankClips[i].clip = clips[i];
+        BankEntry *entry = &bankClips[i].entry;
+        entry->nameSize = strlen(names[i]);
+        entry->nameHash = bankHashName(names[i], entry->nameSize);
+        namesSize += entry->nameSize + 1;
+    }
+    qsort(bankClips, clipCount, sizeof(BankClip), _compareBankClips);
+
+    // Lay out the index and the names behind the header and every clip
+    // on its own pages behind them.
+    BankHeader header = { .version = BANK_VERSION, .clipCount = clipCount };
+    memcpy(header.magic, BANK_MAGIC, BANK_MAGIC_SIZE);
+    header.indexOffset = sizeof(BankHeader);
+    header.namesOffset = header.indexOffset + (uint64_t)clipCount * sizeof(BankEntry);
+    header.namesSize = namesSize;
+    uint64_t nameOffset = 0;
+    uint64_t clipOffset = _alignBankOffset(header.namesOffset + namesSize);
+    for (uint32_t i = 0; i < clipCount; ++i) {
+        BankEntry *entry = &bankClips[i].entry;
+        if (i > 0 && !_compareBankClips(&bankClips[i - 1], &bankClips[i])) {
+            free(bankClips);
+            errno = EEXIST;
+            return false;
+        }
+        entry->nameOffset = nameOffset;
+        entry->clipOffset = clipOffset;
+        nameOffset += entry->nameSize + 1;
+        clipOffset = _alignBankOffset(clipOffset + entry->clipSize);
+    }
+
+    // The header, the index and the names are written at once.
+    size_t indexSize = header.namesOffset + namesSize;
+    uint8_t *index = (uint8_t*)calloc(1, indexSize);
+    bool success = index != NULL;
+    if (success) {
+        memcpy(index, &header, sizeof(BankHeader));
+        for (uint32_t i = 0; i < clipCount; ++i) {
+            BankEntry *entry = &bankClips[i].entry;
+            entries[i] = *entry;
+            names[i] = bankClips[i].name;
+            clips[i] = bankClips[i].clip;
+            memcpy(
+                index + header.indexOffset + i * sizeof(BankEntry), entry,
+                sizeof(BankEntry)
+            );
+            memcpy(
+                index + header.namesOffset + entry->nameOffset, names[i],
+                entry->nameSize
+            );
+        }
+        success = _writeBankData(fileDescriptor, index, indexSize, 0);
+        free(index);
+    }
+    for (uint32_t i = 0; success && i < clipCount; ++i) {
+        success = _writeBankData(
+            fileDescriptor, clips[i], entries[i].clipSize, entries[i].clipOffset
+        );
+    }
+    free(bankClips);
+    return success;
+}
@@ -0,0 +1,125 @@
+#ifndef __BANK_H__
+#define __BANK_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BANK_VERSION (1)
+#define BANK_ALIGNMENT (4096)
+#define BANK_MAGIC_SIZE (8)
+
+#define BANK_CLIP_NEEDS_PARSING (0x0001)
+
+/**
+ * @brief The header at the start of a sound bank.
+ *
+ * A bank consists of the header, the index entries sorted by name hash,
+ * the names and the unmodified WAV or FLAC files. Every file starts at a
+ * multiple of BANK_ALIGNMENT bytes, so it can be locked, advised and
+ * dropped from the page cache on its own. All numbers are little endian.
+*/
+typedef struct {
+    uint8_t magic[BANK_MAGIC_SIZE];  /* BANK_MAGIC */
+    uint32_t version;  /* BANK_VERSION */
+    uint32_t clipCount;  /* The amount of index entries */
+    uint64_t indexOffset;  /* The offset of the first index entry */
+    uint64_t namesOffset;  /* The offset of the names */
+    uint64_t namesSize;  /* The size of all names in bytes */
+} BankHeader;
+
+/**
+ * @brief The index entry of one clip of a sound bank.
+ *
+ * Except for clips with BANK_CLIP_NEEDS_PARSING the entry holds everything
+ * needed to play the clip, so the file itself is never parsed at runtime.
+ * Compressed clips need decoder state that is read from the file instead.
+*/
+typedef struct {
+    uint64_t nameHash;  /* The hash of the name as returned by bankHashName() */
+    uint64_t clipOffset;  /* The offset of the file in the bank */
+    uint64_t clipSize;  /* The size of the file in bytes */
+    uint32_t nameOffset;  /* The offset of the name from the start of the names */
+    uint32_t nameSize;  /* The size of the name in bytes, without terminator */
+    uint32_t dataOffset;  /* The offset of the audio data from the start of the file */
+    uint32_t dataSize;  /* The amount of audio data in bytes */
+    uint32_t audioLength;  /* The length of the audio in milliseconds */
+    uint32_t sampleRate;  /* The sample rate in frames/second */
+    uint32_t byteRate;  /* How many bytes are played per second */
+    uint32_t channelMap;  /* The mapping from channel to speaker */
+    uint32_t samplesPerChannel;  /* The amount of samples per channel */
+    uint16_t channelAmount;  /* The amount of channels */
+    uint16_t blockAlign;  /* Amount of bytes per block */
+    uint16_t bitsPerSample;  /* The amount of bits per sample */
+    uint16_t format;  /* The WAV format tag of the audio data */
+    uint16_t framesPerBlock;  /* Amount of frames per block */
+    uint16_t flags;  /* BANK_CLIP_NEEDS_PARSING or 0 */
+} BankEntry;
+
+/**
+ * @brief This describes a sound bank in memory.
+ *
+ * Everything points into the bank itself, so reading the index neither
+ * allocates nor touches the clips.
+*/
+typedef struct {
+    const uint8_t *data;  /* The entire bank */
+    const BankEntry *entries;  /* The index entries, sorted by name hash */
+    const char *names;  /* The names of the clips */
+    size_t size;  /* The size of the bank in bytes */
+    uint32_t clipCount;  /* The amount of clips */
+} BankIndex;
+
+/**
+ * Returns the hash a clip name is indexed by.
+ *
+ * @param name The name.
+ * @param nameSize The size of the name in bytes.
+*/
+uint64_t bankHashName(const char *name, size_t nameSize);
+/**
+ * Validates the header and the index of a sound bank.
+ *
+ * Only the header, the index and the names are read.
+ *
+ * @param data The entire bank.
+ * @param size The size of the bank in bytes.
+ * @param index The index that is filled.
+ * @return Whether the bank is valid.
+*/
+bool bankReadIndex(const uint8_t *data, size_t size, BankIndex *index);
+/**
+ * Looks up a clip by name.
+ *
+ * The entries with the hash of the name are found by bisection, so the
+ * lookup takes O(log n) for n clips.
+ *
+ * @param index The index.
+ * @param name The null terminated name.
+ * @param clip The number of the clip if it was found.
+ * @return Whether the clip was found.
+*/
+bool bankFindClip(const BankIndex *index, const char *name, uint32_t *clip);
+/**
+ * Writes a sound bank.
+ *
+ * The entries describe the audio data of the clips. Their name and
+ * location members are filled in here. The entries are sorted by name hash
+ * in place, names and clips are reordered alongside.
+ *
+ * On failure errno is EEXIST if two clips have the same name and describes
+ * the failed write otherwise.
+ *
+ * @param fileDescriptor The file to write to, which should be empty.
+ * @param entries The entries of the clips.
+ * @param names The null terminated names of the clips.
+ * @param clips The WAV or FLAC files.
+ * @param clipCount The amount of clips.
+ * @return Whether the bank was written.
+*/
+bool bankWrite(
+    int fileDescriptor, BankEntry *entries, const char **names,
+    const uint8_t **clips, uint32_t clipCount
+);
+
+#endif // __BANK_H__
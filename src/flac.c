@@ -0,0 +1,1488 @@
+#define _GNU_SOURCE
+
+#include "flac.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+#define FLAC_MAGIC ("fLaC")
+#define FLAC_MAGIC_SIZE (4)
+#define ID3_MAGIC ("ID3")
+#define ID3_MAGIC_SIZE (3)
+#define ID3_HEADER_SIZE (10)
+#define ID3_FOOTER_FLAG (0x10)
+
+#define METADATA_HEADER_SIZE (4)
+#define METADATA_TYPE_STREAMINFO (0)
+#define METADATA_TYPE_SEEKTABLE (3)
+#define STREAMINFO_SIZE (34)
+#define SEEK_POINT_SIZE (18)
+#define PLACEHOLDER_SEEK_POINT (UINT64_MAX)
+
+#define MIN_BITS_PER_SAMPLE (4)
+#define MAX_BITS_PER_SAMPLE (24)
+#define MIN_BLOCK_SIZE (16)
+#define MIN_FRAME_HEADER_SIZE (6)
+#define FRAME_FOOTER_SIZE (2)
+
+#define CHANNEL_ASSIGNMENT_LEFT_SIDE (8)
+#define CHANNEL_ASSIGNMENT_SIDE_RIGHT (9)
+#define CHANNEL_ASSIGNMENT_MID_SIDE (10)
+
+#define SUBFRAME_TYPE_CONSTANT (0)
+#define SUBFRAME_TYPE_VERBATIM (1)
+#define SUBFRAME_TYPE_FIXED (8)
+#define SUBFRAME_TYPE_LPC (32)
+#define MAX_FIXED_ORDER (4)
+#define MAX_LPC_ORDER (32)
+#define INVALID_LPC_PRECISION (16)
+#define MAX_PARTITION_ORDER (8)
+#define RICE_PARAMETER_BITS (5)
+#define ESCAPE_PARAMETER (31)
+#define MAX_RICE_PARAMETER (30)
+#define MAX_ESCAPE_BITS (31)
+// Partitions with larger quotients are stored unencoded when encoding.
+#define MAX_RICE_QUOTIENT (64)
+#define MAX_FRAME_HEADER_SIZE (16)
+#define MAX_SUBFRAME_HEADER_SIZE (6)
+
+// Seeking decodes linearly once the range is below this many frames.
+#define LINEAR_SEEK_FRAMES (4)
+#define DEFAULT_MAX_FRAME_SIZE (16 * 1024)
+// Jumps further ahead than this many blocks are seeks instead of decoding.
+#define SEEK_AHEAD_BLOCKS (4)
+
+#define NANOSECONDS_PER_SECOND (1000000000ull)
+
+static const uint32_t sampleRates[] = {
+    0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100,
+    48000, 96000
+};
+
+static const uint8_t sampleSizes[] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+
+/**
+ * @brief The header of one FLAC frame.
+*/
+typedef struct {
+    uint64_t firstSample;  /* The first sample of the frame */
+    size_t headerSize;  /* The size of the header in bytes */
+    uint32_t blockSize;  /* The amount of samples per channel */
+    uint8_t channelAssignment;  /* Independent channels or a stereo decorrelation */
+    uint8_t channelAmount;  /* The amount of channels */
+    uint8_t bitsPerSample;  /* The amount of bits per sample */
+} FlacFrameHeader;
+
+/**
+ * @brief Reads a big endian bitstream.
+*/
+typedef struct {
+    const uint8_t *data;  /* The bytes */
+    size_t size;  /* The amount of bytes */
+    size_t position;  /* The position in bits */
+} BitReader;
+
+/**
+ * @brief The states of a slot.
+ *
+ * Only the decoding thread moves a slot from EMPTY to READY. Only the audio
+ * thread moves it from READY back to EMPTY.
+*/
+enum FlacSlotState {
+    FLAC_SLOT_EMPTY,  /* The slot can be filled. */
+    FLAC_SLOT_READY  /* The slot contains the block. */
+};
+
+/**
+ * @brief A buffer for one block of decoded frames.
+*/
+typedef struct {
+    uint8_t *buffer;  /* The decoded frames */
+    uint64_t block;  /* The block the slot contains */
+    uint32_t length;  /* The amount of frames in the block */
+    _Atomic uint32_t state;  /* One of FlacSlotState */
+} FlacSlot;
+
+struct FlacStream {
+    const FlacInfo *info;  /* The file */
+    FlacSlot *slots;  /* The queueDepth slots */
+    uint8_t *buffers;  /* The memory of all slots */
+    int32_t *channels[FLAC_MAX_CHANNELS];  /* The samples of the last decoded FLAC frame */
+    pthread_t thread;  /* The decoding thread */
+    sem_t wakeup;  /* Posted when the decoding thread has work */
+    _Atomic uint64_t base;  /* The first block of the window */
+    _Atomic uint64_t playheadBlock;  /* The block containing the playhead */
+    _Atomic uint64_t starvations;  /* How often a frame was requested too early */
+    _Atomic uint64_t decodeNanoseconds;  /* The CPU time of the decoding thread */
+    _Atomic uint64_t decodedFrames;  /* The amount of frames decoded into slots */
+    uint64_t blockCount;  /* The amount of blocks in the file */
+    uint64_t decodedFirstSample;  /* The first sample in channels */
+    uint64_t nextSample;  /* The first sample of the FLAC frame at nextFrameOffset */
+    size_t nextFrameOffset;  /* The offset of the next FLAC frame to decode */
+    uint32_t decodedLength;  /* The amount of samples in channels */
+    uint32_t blockFrames;  /* The amount of frames in one block */
+    uint32_t queueDepth;  /* The amount of slots */
+    uint32_t sampleSize;  /* The size of one decoded sample in bytes */
+    _Atomic bool haltFlag;  /* Whether the decoding thread should be stopped */
+};
+
+// Bitstream
+
+static inline uint64_t _peekBits(const BitReader *reader) {
+    // Returns the next 57 to 64 bits left aligned. Bits beyond the end
+    // are zero.
+    size_t byte = reader->position >> 3;
+    uint64_t word = 0;
+    if (byte + sizeof(uint64_t) <= reader->size) {
+        memcpy(&word, reader->data + byte, sizeof(uint64_t));
+        word = __builtin_bswap64(word);
+    } else {
+        for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+            word <<= 8;
+            if (byte + i < reader->size) word |= reader->data[byte + i];
+        }
+    }
+    return word << (reader->position & 7);
+}
+
+static inline uint32_t _readBits(BitReader *reader, uint32_t count) {
+    if (count == 0) return 0;
+    uint32_t value = _peekBits(reader) >> (64 - count);
+    reader->position += count;
+    return value;
+}
+
+static inline int32_t _readSignedBits(BitReader *reader, uint32_t count) {
+    if (count == 0) return 0;
+    int32_t value = (int64_t)_peekBits(reader) >> (64 - count);
+    reader->position += count;
+    return value;
+}
+
+static inline uint32_t _readUnary(BitReader *reader) {
+    // Counts the zeros before the next one.
+    uint32_t zeros = 0;
+    size_t end = reader->size * 8;
+    while (reader->position < end) {
+        uint64_t word = _peekBits(reader);
+        uint32_t validBits = 64 - (reader->position & 7);
+        if (word != 0) {
+            uint32_t leadingZeros = __builtin_clzll(word);
+            if (leadingZeros < validBits) {
+                reader->position += leadingZeros + 1;
+                return zeros + leadingZeros;
+            }
+        }
+        zeros += validBits;
+        reader->position += validBits;
+    }
+    return zeros;
+}
+
+static inline bool _isOverrun(const BitReader *reader) {
+    return reader->position > reader->size * 8;
+}
+
+// Metadata
+
+size_t _skipId3Tag(const uint8_t *data, size_t size) {
+    // Some files start with an ID3v2 tag. Its size is stored in 4 bytes
+    // of 7 bits each.
+    if (size < ID3_HEADER_SIZE || memcmp(data, ID3_MAGIC, ID3_MAGIC_SIZE)) {
+        return 0;
+    }
+    size_t tagSize = ((size_t)(data[6] & 0x7F) << 21)
+        | ((size_t)(data[7] & 0x7F) << 14)
+        | ((size_t)(data[8] & 0x7F) << 7)
+        | (size_t)(data[9] & 0x7F);
+    tagSize += ID3_HEADER_SIZE;
+    if (data[5] & ID3_FOOTER_FLAG) tagSize += ID3_HEADER_SIZE;
+    return tagSize;
+}
+
+bool _readStreamInfo(const uint8_t *data, FlacInfo *info) {
+    BitReader reader = { data, STREAMINFO_SIZE, 0 };
+    info->minBlockSize = _readBits(&reader, 16);
+    info->maxBlockSize = _readBits(&reader, 16);
+    _readBits(&reader, 24);  // minimum frame size
+    info->maxFrameSize = _readBits(&reader, 24);
+    info->sampleRate = _readBits(&reader, 20);
+    info->channelAmount = _readBits(&reader, 3) + 1;
+    info->bitsPerSample = _readBits(&reader, 5) + 1;
+    info->totalSamples = (uint64_t)_readBits(&reader, 4) << 32;
+    info->totalSamples |= _readBits(&reader, 32);
+
+    return info->minBlockSize >= MIN_BLOCK_SIZE
+        && info->maxBlockSize >= info->minBlockSize
+        && info->sampleRate > 0
+        && info->bitsPerSample >= MIN_BITS_PER_SAMPLE
+        && info->bitsPerSample <= MAX_BITS_PER_SAMPLE
+        && info->totalSamples > 0;
+}
+
+bool _readSeekTable(const uint8_t *data, uint32_t length, FlacInfo *info) {
+    uint32_t pointCount = length / SEEK_POINT_SIZE;
+    info->seekPoints = (FlacSeekPoint*)calloc(pointCount, sizeof(FlacSeekPoint));
+    if (info->seekPoints == NULL && pointCount > 0) return false;
+
+    // Placeholders and points out of order are skipped.
+    for (uint32_t i = 0; i < pointCount; ++i) {
+        BitReader reader = { data + i * SEEK_POINT_SIZE, SEEK_POINT_SIZE, 0 };
+        uint64_t sample = (uint64_t)_readBits(&reader, 32) << 32;
+        sample |= _readBits(&reader, 32);
+        uint64_t offset = (uint64_t)_readBits(&reader, 32) << 32;
+        offset |= _readBits(&reader, 32);
+        if (sample == PLACEHOLDER_SEEK_POINT) continue;
+        if (info->seekPointCount > 0) {
+            FlacSeekPoint *last = &info->seekPoints[info->seekPointCount - 1];
+            if (sample <= last->sample || offset <= last->offset) continue;
+        }
+        info->seekPoints[info->seekPointCount].sample = sample;
+        info->seekPoints[info->seekPointCount].offset = offset;
+        info->seekPointCount++;
+    }
+    return true;
+}
+
+// Frames
+
+uint8_t _crc8(const uint8_t *bytes, size_t size) {
+    // Polynomial x^8 + x^2 + x + 1. Headers are short, so no table.
+    uint8_t crc = 0;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = crc & 0x80 ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+bool _readFrameHeader(
+    const FlacInfo *info, size_t offset, FlacFrameHeader *header
+) {
+    // Besides the CRC every field is checked against STREAMINFO, so a sync
+    // code inside of audio data is hardly ever mistaken for a header.
+    if (offset + MIN_FRAME_HEADER_SIZE > info->size) return false;
+    const uint8_t *bytes = info->data + offset;
+    size_t available = info->size - offset;
+    if (bytes[0] != 0xFF || (bytes[1] & 0xFE) != 0xF8) return false;
+
+    bool isVariableBlockSize = bytes[1] & 1;
+    uint8_t blockSizeCode = bytes[2] >> 4;
+    uint8_t sampleRateCode = bytes[2] & 0x0F;
+    uint8_t channelAssignment = bytes[3] >> 4;
+    uint8_t sampleSizeCode = (bytes[3] >> 1) & 0x07;
+    if (
+        blockSizeCode == 0
+        || sampleRateCode == 15
+        || channelAssignment > CHANNEL_ASSIGNMENT_MID_SIDE
+        || sampleSizeCode == 3
+        || (bytes[3] & 1)
+    ) {
+        return false;
+    }
+
+    // The frame or sample number is coded like UTF-8.
+    size_t position = 4;
+    uint64_t number = bytes[position++];
+    uint32_t extraBytes;
+    if (!(number & 0x80)) { extraBytes = 0; }
+    else if ((number & 0xE0) == 0xC0) { extraBytes = 1; number &= 0x1F; }
+    else if ((number & 0xF0) == 0xE0) { extraBytes = 2; number &= 0x0F; }
+    else if ((number & 0xF8) == 0xF0) { extraBytes = 3; number &= 0x07; }
+    else if ((number & 0xFC) == 0xF8) { extraBytes = 4; number &= 0x03; }
+    else if ((number & 0xFE) == 0xFC) { extraBytes = 5; number &= 0x01; }
+    else if (number == 0xFE) { extraBytes = 6; number = 0; }
+    else { return false; }
+    // The optional block size and sample rate take at most 4 more bytes.
+    if (position + extraBytes + 5 > available) return false;
+    for (uint32_t i = 0; i < extraBytes; ++i) {
+        if ((bytes[position] & 0xC0) != 0x80) return false;
+        number = (number << 6) | (bytes[position++] & 0x3F);
+    }
+
+    uint32_t blockSize;
+    if (blockSizeCode == 1) {
+        blockSize = 192;
+    } else if (blockSizeCode <= 5) {
+        blockSize = 576 << (blockSizeCode - 2);
+    } else if (blockSizeCode == 6) {
+        blockSize = bytes[position++] + 1;
+    } else if (blockSizeCode == 7) {
+        blockSize = ((bytes[position] << 8) | bytes[position + 1]) + 1;
+        position += 2;
+    } else {
+        blockSize = 256 << (blockSizeCode - 8);
+    }
+
+    uint32_t sampleRate;
+    if (sampleRateCode < sizeof(sampleRates) / sizeof(sampleRates[0])) {
+        sampleRate = sampleRates[sampleRateCode];
+    } else if (sampleRateCode == 12) {
+        sampleRate = bytes[position++] * 1000;
+    } else {
+        sampleRate = (bytes[position] << 8) | bytes[position + 1];
+        if (sampleRateCode == 14) sampleRate *= 10;
+        position += 2;
+    }
+
+    if (_crc8(bytes, position) != bytes[position]) return false;
+    position++;
+
+    header->bitsPerSample = sampleSizeCode == 0
+        ? info->bitsPerSample
+        : sampleSizes[sampleSizeCode];
+    header->channelAssignment = channelAssignment;
+    header->channelAmount = channelAssignment < CHANNEL_ASSIGNMENT_LEFT_SIDE
+        ? channelAssignment + 1
+        : 2;
+    header->blockSize = blockSize;
+    header->firstSample = isVariableBlockSize
+        ? number
+        : number * info->maxBlockSize;
+    header->headerSize = position;
+
+    return header->blockSize <= info->maxBlockSize
+        && header->channelAmount == info->channelAmount
+        && header->bitsPerSample == info->bitsPerSample
+        && (sampleRate == 0 || sampleRate == info->sampleRate)
+        && header->firstSample < info->totalSamples;
+}
+
+bool _findFrameHeader(
+    const FlacInfo *info, size_t offset, size_t end,
+    size_t *frameOffset, FlacFrameHeader *header
+) {
+    // Finds the first frame header starting in [offset, end).
+    if (end > info->size) end = info->size;
+    while (offset < end) {
+        const uint8_t *sync = memchr(info->data + offset, 0xFF, end - offset);
+        if (sync == NULL) return false;
+        offset = sync - info->data;
+        if (_readFrameHeader(info, offset, header)) {
+            *frameOffset = offset;
+            return true;
+        }
+        offset++;
+    }
+    return false;
+}
+
+bool _decodeResidual(
+    BitReader *reader, uint32_t blockSize, uint32_t order, int32_t *residual
+) {
+    // The residual is split into partitions with a Rice parameter each.
+    uint32_t method = _readBits(reader, 2);
+    if (method > 1) return false;
+    uint32_t parameterBits = method == 0 ? 4 : 5;
+    uint32_t escapeParameter = (1u << parameterBits) - 1;
+    uint32_t partitionOrder = _readBits(reader, 4);
+    uint32_t partitionSize = blockSize >> partitionOrder;
+    if ((partitionSize << partitionOrder) != blockSize || partitionSize < order) {
+        return false;
+    }
+
+    for (uint32_t partition = 0; partition < (1u << partitionOrder); ++partition) {
+        uint32_t count = partition == 0 ? partitionSize - order : partitionSize;
+        uint32_t parameter = _readBits(reader, parameterBits);
+        if (parameter == escapeParameter) {
+            // Unencoded partition
+            uint32_t bits = _readBits(reader, 5);
+            for (uint32_t i = 0; i < count; ++i) {
+                *residual++ = _readSignedBits(reader, bits);
+            }
+        } else {
+            for (uint32_t i = 0; i < count; ++i) {
+                uint32_t quotient = _readUnary(reader);
+                uint32_t value = (quotient << parameter)
+                    | _readBits(reader, parameter);
+                *residual++ = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+            }
+        }
+        if (_isOverrun(reader)) return false;
+    }
+    return true;
+}
+
+void _restoreFixed(int32_t *samples, uint32_t blockSize, uint32_t order) {
+    // The fixed predictors are polynomials of the previous samples. Corrupt
+    // frames can overflow, so the arithmetic wraps around unsigned.
+    uint32_t *values = (uint32_t*)samples;
+    switch (order) {
+        case 1:
+            for (uint32_t i = 1; i < blockSize; ++i) {
+                values[i] += values[i - 1];
+            }
+            break;
+        case 2:
+            for (uint32_t i = 2; i < blockSize; ++i) {
+                values[i] += 2 * values[i - 1] - values[i - 2];
+            }
+            break;
+        case 3:
+            for (uint32_t i = 3; i < blockSize; ++i) {
+                values[i] += 3 * (values[i - 1] - values[i - 2]) + values[i - 3];
+            }
+            break;
+        case 4:
+            for (uint32_t i = 4; i < blockSize; ++i) {
+                values[i] += 4 * (values[i - 1] + values[i - 3])
+                    - 6 * values[i - 2] - values[i - 4];
+            }
+            break;
+    }
+}
+
+void _restoreLpc(
+    int32_t *samples, uint32_t blockSize, uint32_t order,
+    const int32_t *coefficients, uint32_t shift, bool needsWideSum
+) {
+    // The sum fits into 32 bits unless samples and coefficients are wide,
+    // which saves the 64 bit multiplications for 16 bit audio.
+    uint32_t *values = (uint32_t*)samples;
+    if (!needsWideSum) {
+        for (uint32_t i = order; i < blockSize; ++i) {
+            uint32_t sum = 0;
+            for (uint32_t j = 0; j < order; ++j) {
+                sum += (uint32_t)coefficients[j] * values[i - 1 - j];
+            }
+            values[i] += (uint32_t)((int32_t)sum >> shift);
+        }
+        return;
+    }
+    for (uint32_t i = order; i < blockSize; ++i) {
+        int64_t sum = 0;
+        for (uint32_t j = 0; j < order; ++j) {
+            sum += (int64_t)coefficients[j] * samples[i - 1 - j];
+        }
+        values[i] += (uint32_t)(sum >> shift);
+    }
+}
+
+bool _decodeSubframe(
+    BitReader *reader, uint32_t blockSize, uint32_t bitsPerSample,
+    int32_t *samples
+) {
+    if (_readBits(reader, 1)) return false;
+    uint32_t type = _readBits(reader, 6);
+    uint32_t wastedBits = 0;
+    if (_readBits(reader, 1)) wastedBits = _readUnary(reader) + 1;
+    if (wastedBits >= bitsPerSample) return false;
+    bitsPerSample -= wastedBits;
+
+    if (type == SUBFRAME_TYPE_CONSTANT) {
+        int32_t value = _readSignedBits(reader, bitsPerSample);
+        for (uint32_t i = 0; i < blockSize; ++i) samples[i] = value;
+    } else if (type == SUBFRAME_TYPE_VERBATIM) {
+        for (uint32_t i = 0; i < blockSize; ++i) {
+            samples[i] = _readSignedBits(reader, bitsPerSample);
+        }
+    } else if (
+        type >= SUBFRAME_TYPE_FIXED
+        && type <= SUBFRAME_TYPE_FIXED + MAX_FIXED_ORDER
+    ) {
+        uint32_t order = type - SUBFRAME_TYPE_FIXED;
+        if (order > blockSize) return false;
+        for (uint32_t i = 0; i < order; ++i) {
+            samples[i] = _readSignedBits(reader, bitsPerSample);
+        }
+        if (!_decodeResidual(reader, blockSize, order, samples + order)) {
+            return false;
+        }
+        _restoreFixed(samples, blockSize, order);
+    } else if (type >= SUBFRAME_TYPE_LPC) {
+        uint32_t order = type - SUBFRAME_TYPE_LPC + 1;
+        if (order > blockSize) return false;
+        for (uint32_t i = 0; i < order; ++i) {
+            samples[i] = _readSignedBits(reader, bitsPerSample);
+        }
+        uint32_t precision = _readBits(reader, 4) + 1;
+        if (precision == INVALID_LPC_PRECISION) return false;
+        int32_t shift = _readSignedBits(reader, 5);
+        if (shift < 0) return false;
+        int32_t coefficients[MAX_LPC_ORDER];
+        for (uint32_t i = 0; i < order; ++i) {
+            coefficients[i] = _readSignedBits(reader, precision);
+        }
+        if (!_decodeResidual(reader, blockSize, order, samples + order)) {
+            return false;
+        }
+        uint32_t orderBits = 32 - __builtin_clz(order);
+        _restoreLpc(
+            samples, blockSize, order, coefficients, shift,
+            bitsPerSample + precision + orderBits > 32
+        );
+    } else {
+        return false;
+    }
+
+    if (wastedBits > 0) {
+        for (uint32_t i = 0; i < blockSize; ++i) {
+            samples[i] = (int32_t)((uint32_t)samples[i] << wastedBits);
+        }
+    }
+    return !_isOverrun(reader);
+}
+
+bool _decodeFrame(
+    const FlacInfo *info, size_t offset, int32_t **channels,
+    FlacFrameHeader *header, size_t *frameSize
+) {
+    if (!_readFrameHeader(info, offset, header)) return false;
+    BitReader reader = {
+        info->data, info->size, (offset + header->headerSize) * 8
+    };
+
+    for (uint32_t channel = 0; channel < header->channelAmount; ++channel) {
+        // Side channels have one bit more.
+        uint32_t bitsPerSample = header->bitsPerSample;
+        if (
+            (header->channelAssignment == CHANNEL_ASSIGNMENT_LEFT_SIDE && channel == 1)
+            || (header->channelAssignment == CHANNEL_ASSIGNMENT_SIDE_RIGHT && channel == 0)
+            || (header->channelAssignment == CHANNEL_ASSIGNMENT_MID_SIDE && channel == 1)
+        ) {
+            bitsPerSample++;
+        }
+        if (!_decodeSubframe(
+            &reader, header->blockSize, bitsPerSample, channels[channel]
+        )) {
+            return false;
+        }
+    }
+
+    uint32_t *left = (uint32_t*)channels[0];
+    uint32_t *right = (uint32_t*)channels[1];
+    switch (header->channelAssignment) {
+        case CHANNEL_ASSIGNMENT_LEFT_SIDE:
+            for (uint32_t i = 0; i < header->blockSize; ++i) {
+                right[i] = left[i] - right[i];
+            }
+            break;
+        case CHANNEL_ASSIGNMENT_SIDE_RIGHT:
+            for (uint32_t i = 0; i < header->blockSize; ++i) {
+                left[i] += right[i];
+            }
+            break;
+        case CHANNEL_ASSIGNMENT_MID_SIDE:
+            for (uint32_t i = 0; i < header->blockSize; ++i) {
+                uint32_t side = right[i];
+                uint32_t mid = (left[i] << 1) | (side & 1);
+                left[i] = (uint32_t)((int32_t)(mid + side) >> 1);
+                right[i] = (uint32_t)((int32_t)(mid - side) >> 1);
+            }
+            break;
+    }
+
+    // The frame ends byte aligned with a CRC-16.
+    size_t end = (reader.position + 7) / 8 + FRAME_FOOTER_SIZE;
+    if (end > info->size) return false;
+    *frameSize = end - offset;
+    return true;
+}
+
+// Decoding thread
+
+bool _isInFlacWindow(FlacStream *stream, uint64_t block) {
+    uint64_t base = atomic_load_explicit(&stream->base, memory_order_acquire);
+    return block >= base && block < base + stream->queueDepth;
+}
+
+FlacSlot * _getEmptySlot(FlacStream *stream, uint64_t *block) {
+    // The first block from the playhead on that is not decoded yet. Blocks
+    // behind the playhead only matter for rewinds, so they come last. A
+    // slot still holding a block from before a jump is skipped until the
+    // audio thread hands it back.
+    uint64_t base = atomic_load_explicit(&stream->base, memory_order_acquire);
+    uint64_t playheadBlock = atomic_load_explicit(
+        &stream->playheadBlock, memory_order_relaxed
+    );
+    uint64_t end = base + stream->queueDepth;
+    if (playheadBlock < base || playheadBlock >= end) playheadBlock = base;
+    for (uint32_t i = 0; i < stream->queueDepth; ++i) {
+        uint64_t candidate = playheadBlock + i;
+        if (candidate >= end) candidate -= stream->queueDepth;
+        if (candidate >= stream->blockCount) continue;
+        FlacSlot *slot = &stream->slots[candidate % stream->queueDepth];
+        uint32_t state = atomic_load_explicit(&slot->state, memory_order_acquire);
+        if (state == FLAC_SLOT_EMPTY) {
+            *block = candidate;
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+void _interleaveFrames(
+    const FlacInfo *info, int32_t *const *channels, uint32_t sampleOffset,
+    uint32_t frameCount, uint8_t *output
+) {
+    // Interleave and left justify the samples.
+    uint16_t channelAmount = info->channelAmount;
+    uint32_t sampleSize = flacGetSampleSize(info);
+    uint32_t shift = sampleSize * 8 - info->bitsPerSample;
+    if (sampleSize == sizeof(int16_t)) {
+        int16_t *frames = (int16_t*)output;
+        for (uint16_t channel = 0; channel < channelAmount; ++channel) {
+            const int32_t *samples = channels[channel] + sampleOffset;
+            for (uint32_t i = 0; i < frameCount; ++i) {
+                frames[i * channelAmount + channel] =
+                    (int16_t)((uint32_t)samples[i] << shift);
+            }
+        }
+    } else {
+        int32_t *frames = (int32_t*)output;
+        for (uint16_t channel = 0; channel < channelAmount; ++channel) {
+            const int32_t *samples = channels[channel] + sampleOffset;
+            for (uint32_t i = 0; i < frameCount; ++i) {
+                frames[i * channelAmount + channel] =
+                    (int32_t)((uint32_t)samples[i] << shift);
+            }
+        }
+    }
+}
+
+uint32_t _decodeBlock(FlacStream *stream, uint64_t block, uint8_t *output) {
+    const FlacInfo *info = stream->info;
+    size_t frameSize = (size_t)info->channelAmount * stream->sampleSize;
+    uint64_t firstSample = block * stream->blockFrames;
+    uint32_t frameCount = stream->blockFrames;
+    if (firstSample + frameCount > info->totalSamples) {
+        frameCount = info->totalSamples - firstSample;
+    }
+
+    // Samples that cannot be decoded are silent. Seeking only happens
+    // once per block so a corrupt file cannot make this loop forever.
+    bool maySeek = true;
+    uint32_t filled = 0;
+    while (filled < frameCount) {
+        uint64_t sample = firstSample + filled;
+        uint8_t *frames = output + filled * frameSize;
+
+        // Copy what the last decoded FLAC frame has.
+        if (
+            sample >= stream->decodedFirstSample
+            && sample < stream->decodedFirstSample + stream->decodedLength
+        ) {
+            uint32_t count = stream->decodedFirstSample
+                + stream->decodedLength - sample;
+            if (count > frameCount - filled) count = frameCount - filled;
+            _interleaveFrames(
+                info, stream->channels, sample - stream->decodedFirstSample,
+                count, frames
+            );
+            filled += count;
+            maySeek = true;
+            continue;
+        }
+
+        // Decode the next FLAC frame unless the sample is behind or far
+        // ahead of it.
+        if (maySeek && (
+            sample < stream->nextSample
+            || sample - stream->nextSample
+                >= (uint64_t)SEEK_AHEAD_BLOCKS * info->maxBlockSize
+        )) {
+            stream->nextFrameOffset = flacFindFrame(info, sample);
+            stream->nextSample = sample;
+            maySeek = false;
+        }
+
+        FlacFrameHeader header;
+        size_t flacFrameSize;
+        if (_decodeFrame(
+            info, stream->nextFrameOffset, stream->channels,
+            &header, &flacFrameSize
+        )) {
+            stream->decodedFirstSample = header.firstSample;
+            stream->decodedLength = header.blockSize;
+            stream->nextFrameOffset += flacFrameSize;
+            stream->nextSample = header.firstSample + header.blockSize;
+        } else {
+            // Skip to the next frame.
+            stream->decodedLength = 0;
+            size_t frameOffset;
+            if (!_findFrameHeader(
+                info, stream->nextFrameOffset + 1, info->size,
+                &frameOffset, &header
+            )) {
+                memset(frames, 0, (frameCount - filled) * frameSize);
+                break;
+            }
+            stream->nextFrameOffset = frameOffset;
+            stream->nextSample = header.firstSample;
+            header.blockSize = 0;
+        }
+
+        // Fill the gap up to the frame with silence.
+        if (sample < header.firstSample) {
+            uint64_t count = header.firstSample - sample;
+            if (count > frameCount - filled) count = frameCount - filled;
+            memset(frames, 0, count * frameSize);
+            filled += count;
+        }
+    }
+    return frameCount;
+}
+
+void * _decoderLoop(void *self) {
+    FlacStream *stream = (FlacStream*)self;
+
+    while (!atomic_load_explicit(&stream->haltFlag, memory_order_acquire)) {
+        uint64_t block;
+        FlacSlot *slot = _getEmptySlot(stream, &block);
+        if (slot == NULL) {
+            // Sleep until the playhead moves or the stream is closed.
+            sem_wait(&stream->wakeup);
+            continue;
+        }
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+        slot->length = _decodeBlock(stream, block, slot->buffer);
+        slot->block = block;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+        atomic_fetch_add_explicit(
+            &stream->decodeNanoseconds,
+            (end.tv_sec - start.tv_sec) * NANOSECONDS_PER_SECOND
+                + end.tv_nsec - start.tv_nsec,
+            memory_order_relaxed
+        );
+        atomic_fetch_add_explicit(
+            &stream->decodedFrames, slot->length, memory_order_relaxed
+        );
+
+        // The playhead might have jumped away meanwhile.
+        if (_isInFlacWindow(stream, block)) {
+            atomic_store_explicit(
+                &slot->state, FLAC_SLOT_READY, memory_order_release
+            );
+        }
+    }
+
+    pthread_exit(NULL);
+    return NULL;
+}
+
+// Encoding
+
+/**
+ * @brief Writes a big endian bitstream.
+*/
+typedef struct {
+    uint8_t *data;  /* The bytes */
+    size_t position;  /* The amount of complete bytes */
+    uint64_t buffer;  /* The bits not written yet in its lowest bitCount bits */
+    uint32_t bitCount;  /* The amount of bits in buffer */
+} BitWriter;
+
+/**
+ * @brief How a subframe is going to be encoded.
+*/
+typedef struct {
+    uint64_t bits;  /* The size of the subframe in bits */
+    uint32_t type;  /* The subframe type */
+    uint32_t wastedBits;  /* The amount of zero bits below every sample */
+    uint32_t partitionOrder;  /* The partition order of the residual */
+} FlacSubframePlan;
+
+static inline void _writeBits(BitWriter *writer, uint32_t value, uint32_t count) {
+    if (count == 0) return;
+    writer->buffer = (writer->buffer << count)
+        | ((uint64_t)value & ((1ull << count) - 1));
+    writer->bitCount += count;
+    while (writer->bitCount >= 8) {
+        writer->bitCount -= 8;
+        writer->data[writer->position++] = writer->buffer >> writer->bitCount;
+    }
+}
+
+static inline void _writeUnary(BitWriter *writer, uint32_t zeros) {
+    for (; zeros >= 32; zeros -= 32) _writeBits(writer, 0, 32);
+    _writeBits(writer, 1, zeros + 1);
+}
+
+static inline uint32_t _zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline uint32_t _getSignedBitCount(int32_t value) {
+    // The amount of bits needed to store value in two's complement.
+    uint32_t magnitude = value < 0 ? ~(uint32_t)value : (uint32_t)value;
+    return magnitude == 0 ? 1 : 33 - __builtin_clz(magnitude);
+}
+
+uint32_t _getRiceParameter(
+    const int32_t *residual, uint32_t count, uint32_t *escapeBits,
+    uint64_t *bits
+) {
+    // The parameter is estimated from the mean of the zigzag coded values.
+    // Partitions with outliers that would need long unary codes are stored
+    // unencoded instead.
+    uint64_t sum = 0;
+    uint32_t maxValue = 0;
+    uint32_t signedBits = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t value = _zigzag(residual[i]);
+        sum += value;
+        if (value > maxValue) maxValue = value;
+        uint32_t valueBits = _getSignedBitCount(residual[i]);
+        if (valueBits > signedBits) signedBits = valueBits;
+    }
+    uint32_t parameter = 0;
+    while (parameter < MAX_RICE_PARAMETER && ((uint64_t)count << (parameter + 1)) <= sum) {
+        parameter++;
+    }
+    if ((maxValue >> parameter) <= MAX_RICE_QUOTIENT) {
+        *escapeBits = 0;
+        *bits = RICE_PARAMETER_BITS + (uint64_t)count * (parameter + 1)
+            + (sum >> parameter);
+        return parameter;
+    }
+    *escapeBits = signedBits;
+    *bits = RICE_PARAMETER_BITS + 5 + (uint64_t)count * signedBits;
+    return ESCAPE_PARAMETER;
+}
+
+uint64_t _getResidualBits(
+    const int32_t *residual, uint32_t blockSize, uint32_t order,
+    uint32_t partitionOrder
+) {
+    uint32_t partitionSize = blockSize >> partitionOrder;
+    uint64_t totalBits = 2 + 4;
+    for (uint32_t partition = 0; partition < (1u << partitionOrder); ++partition) {
+        uint32_t count = partition == 0 ? partitionSize - order : partitionSize;
+        uint32_t escapeBits;
+        uint64_t bits;
+        _getRiceParameter(residual, count, &escapeBits, &bits);
+        if (escapeBits > MAX_ESCAPE_BITS) return UINT64_MAX;
+        totalBits += bits;
+        residual += count;
+    }
+    return totalBits;
+}
+
+void _computeFixedResidual(
+    const int32_t *samples, uint32_t blockSize, uint32_t order,
+    int32_t *residual
+) {
+    // The inverse of _restoreFixed(), wrapping around like it.
+    const uint32_t *values = (const uint32_t*)samples;
+    for (uint32_t i = order; i < blockSize; ++i) {
+        uint32_t prediction = 0;
+        switch (order) {
+            case 1: prediction = values[i - 1]; break;
+            case 2: prediction = 2 * values[i - 1] - values[i - 2]; break;
+            case 3:
+                prediction = 3 * (values[i - 1] - values[i - 2]) + values[i - 3];
+                break;
+            case 4:
+                prediction = 4 * (values[i - 1] + values[i - 3])
+                    - 6 * values[i - 2] - values[i - 4];
+                break;
+        }
+        residual[i - order] = (int32_t)(values[i] - prediction);
+    }
+}
+
+void _planSubframe(
+    const int32_t *samples, uint32_t blockSize, uint32_t bitsPerSample,
+    int32_t *shifted, int32_t *residual, FlacSubframePlan *plan
+) {
+    // Fills shifted with the samples without wasted bits and residual with
+    // the residual of the chosen fixed predictor.
+    uint32_t allBits = 0;
+    bool isConstant = true;
+    for (uint32_t i = 0; i < blockSize; ++i) {
+        allBits |= (uint32_t)samples[i];
+        isConstant = isConstant && samples[i] == samples[0];
+    }
+    plan->wastedBits = 0;
+    plan->partitionOrder = 0;
+    if (isConstant) {
+        shifted[0] = samples[0];
+        plan->type = SUBFRAME_TYPE_CONSTANT;
+        plan->bits = 8 + bitsPerSample;
+        return;
+    }
+    plan->wastedBits = __builtin_ctz(allBits);
+    if (plan->wastedBits >= bitsPerSample) plan->wastedBits = 0;
+    uint32_t wastedBits = plan->wastedBits;
+    uint32_t sampleBits = bitsPerSample - wastedBits;
+    for (uint32_t i = 0; i < blockSize; ++i) shifted[i] = samples[i] >> wastedBits;
+
+    plan->type = SUBFRAME_TYPE_VERBATIM;
+    plan->bits = 8 + wastedBits + (uint64_t)blockSize * sampleBits;
+
+    // Choose the predictor order with the smallest residual.
+    uint32_t bestOrder = 0;
+    uint64_t bestSum = UINT64_MAX;
+    for (uint32_t order = 0; order <= MAX_FIXED_ORDER && order < blockSize; ++order) {
+        _computeFixedResidual(shifted, blockSize, order, residual);
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < blockSize - order; ++i) sum += _zigzag(residual[i]);
+        if (sum < bestSum) {
+            bestSum = sum;
+            bestOrder = order;
+        }
+    }
+    _computeFixedResidual(shifted, blockSize, bestOrder, residual);
+
+    // Choose the partition order with the smallest size.
+    for (
+        uint32_t partitionOrder = 0;
+        partitionOrder <= MAX_PARTITION_ORDER;
+        ++partitionOrder
+    ) {
+        uint32_t partitionSize = blockSize >> partitionOrder;
+        if ((partitionSize << partitionOrder) != blockSize) break;
+        if (partitionSize <= bestOrder) break;
+        uint64_t bits = _getResidualBits(
+            residual, blockSize, bestOrder, partitionOrder
+        );
+        if (bits == UINT64_MAX) break;
+        bits += 8 + wastedBits + (uint64_t)bestOrder * sampleBits;
+        if (bits < plan->bits) {
+            plan->bits = bits;
+            plan->type = SUBFRAME_TYPE_FIXED + bestOrder;
+            plan->partitionOrder = partitionOrder;
+        }
+    }
+}
+
+void _writeSubframe(
+    BitWriter *writer, const FlacSubframePlan *plan, const int32_t *shifted,
+    const int32_t *residual, uint32_t blockSize, uint32_t bitsPerSample
+) {
+    _writeBits(writer, 0, 1);
+    _writeBits(writer, plan->type, 6);
+    if (plan->wastedBits > 0) {
+        _writeBits(writer, 1, 1);
+        _writeUnary(writer, plan->wastedBits - 1);
+    } else {
+        _writeBits(writer, 0, 1);
+    }
+    uint32_t sampleBits = bitsPerSample - plan->wastedBits;
+
+    if (plan->type == SUBFRAME_TYPE_CONSTANT) {
+        _writeBits(writer, shifted[0], sampleBits);
+        return;
+    }
+    if (plan->type == SUBFRAME_TYPE_VERBATIM) {
+        for (uint32_t i = 0; i < blockSize; ++i) {
+            _writeBits(writer, shifted[i], sampleBits);
+        }
+        return;
+    }
+
+    uint32_t order = plan->type - SUBFRAME_TYPE_FIXED;
+    for (uint32_t i = 0; i < order; ++i) _writeBits(writer, shifted[i], sampleBits);
+    _writeBits(writer, 1, 2);  // Rice coding with 5 bit parameters
+    _writeBits(writer, plan->partitionOrder, 4);
+    uint32_t partitionSize = blockSize >> plan->partitionOrder;
+    for (
+        uint32_t partition = 0;
+        partition < (1u << plan->partitionOrder);
+        ++partition
+    ) {
+        uint32_t count = partition == 0 ? partitionSize - order : partitionSize;
+        uint32_t escapeBits;
+        uint64_t bits;
+        uint32_t parameter = _getRiceParameter(residual, count, &escapeBits, &bits);
+        _writeBits(writer, parameter, RICE_PARAMETER_BITS);
+        if (parameter == ESCAPE_PARAMETER) {
+            _writeBits(writer, escapeBits, 5);
+            for (uint32_t i = 0; i < count; ++i) {
+                _writeBits(writer, residual[i], escapeBits);
+            }
+        } else {
+            for (uint32_t i = 0; i < count; ++i) {
+                uint32_t value = _zigzag(residual[i]);
+                _writeUnary(writer, value >> parameter);
+                _writeBits(writer, value, parameter);
+            }
+        }
+        residual += count;
+    }
+}
+
+size_t _writeFrameHeader(
+    uint8_t *output, uint64_t frameNumber, uint32_t blockSize,
+    uint8_t channelAssignment
+) {
+    // Fixed block size, explicit 16 bit block size, sample rate and sample
+    // size from STREAMINFO.
+    size_t position = 0;
+    output[position++] = 0xFF;
+    output[position++] = 0xF8;
+    output[position++] = 7 << 4;
+    output[position++] = channelAssignment << 4;
+
+    // The frame number is coded like UTF-8.
+    if (frameNumber < 0x80) {
+        output[position++] = frameNumber;
+    } else {
+        uint32_t extraBytes = 1;
+        while (frameNumber >> (5 * extraBytes + 6)) extraBytes++;
+        output[position++] = (uint8_t)(0xFF00 >> (extraBytes + 1))
+            | (frameNumber >> (6 * extraBytes));
+        for (uint32_t i = extraBytes; i > 0; --i) {
+            output[position++] = 0x80 | ((frameNumber >> (6 * (i - 1))) & 0x3F);
+        }
+    }
+
+    output[position++] = (blockSize - 1) >> 8;
+    output[position++] = (blockSize - 1) & 0xFF;
+    output[position] = _crc8(output, position);
+    return position + 1;
+}
+
+// Public functions
+
+bool flacIsFlac(const uint8_t *data, size_t size) {
+    size_t offset = _skipId3Tag(data, size);
+    return offset + FLAC_MAGIC_SIZE <= size
+        && !memcmp(data + offset, FLAC_MAGIC, FLAC_MAGIC_SIZE);
+}
+
+bool flacReadInfo(
+    const uint8_t *data, size_t size, size_t availableSize, FlacInfo *info
+) {
+    memset(info, 0, sizeof(FlacInfo));
+    info->data = data;
+    info->size = size;
+    if (availableSize > size) availableSize = size;
+    if (!flacIsFlac(data, availableSize)) return false;
+
+    // Read all metadata blocks. Only STREAMINFO and SEEKTABLE are used.
+    size_t offset = _skipId3Tag(data, availableSize) + FLAC_MAGIC_SIZE;
+    bool hasStreamInfo = false;
+    bool isValid = true;
+    bool isLast = false;
+    while (!isLast) {
+        if (offset + METADATA_HEADER_SIZE > availableSize) {
+            isValid = false;
+            break;
+        }
+        isLast = data[offset] & 0x80;
+        uint8_t type = data[offset] & 0x7F;
+        uint32_t length = (data[offset + 1] << 16)
+            | (data[offset + 2] << 8)
+            | data[offset + 3];
+        offset += METADATA_HEADER_SIZE;
+        if (offset + length > availableSize) {
+            isValid = false;
+            break;
+        }
+
+        if (type == METADATA_TYPE_STREAMINFO) {
+            if (length != STREAMINFO_SIZE || !_readStreamInfo(data + offset, info)) {
+                isValid = false;
+                break;
+            }
+            hasStreamInfo = true;
+        } else if (type == METADATA_TYPE_SEEKTABLE && info->seekPoints == NULL) {
+            if (!_readSeekTable(data + offset, length, info)) {
+                isValid = false;
+                break;
+            }
+        }
+        offset += length;
+    }
+    info->firstFrameOffset = offset;
+
+    // Seek points beyond the end of the file are useless.
+    while (
+        info->seekPointCount > 0
+        && info->firstFrameOffset
+            + info->seekPoints[info->seekPointCount - 1].offset >= size
+    ) {
+        info->seekPointCount--;
+    }
+
+    if (!isValid || !hasStreamInfo || info->firstFrameOffset >= size) {
+        flacFreeInfo(info);
+        return false;
+    }
+    return true;
+}
+
+void flacFreeInfo(FlacInfo *info) {
+    free(info->seekPoints);
+    info->seekPoints = NULL;
+    info->seekPointCount = 0;
+}
+
+uint32_t flacGetSampleSize(const FlacInfo *info) {
+    return info->bitsPerSample <= 16 ? sizeof(int16_t) : sizeof(int32_t);
+}
+
+size_t flacFindFrame(const FlacInfo *info, uint64_t sample) {
+    // Narrow the range with the SEEKTABLE.
+    size_t low = info->firstFrameOffset;
+    uint64_t lowSample = 0;
+    size_t high = info->size;
+    for (uint32_t i = 0; i < info->seekPointCount; ++i) {
+        const FlacSeekPoint *point = &info->seekPoints[i];
+        if (point->sample > sample) {
+            high = info->firstFrameOffset + point->offset;
+            break;
+        }
+        low = info->firstFrameOffset + point->offset;
+        lowSample = point->sample;
+    }
+
+    // Bisect until only a few frames are left.
+    size_t maxFrameSize = info->maxFrameSize
+        ? info->maxFrameSize
+        : DEFAULT_MAX_FRAME_SIZE;
+    size_t linearSize = LINEAR_SEEK_FRAMES * maxFrameSize;
+    FlacFrameHeader header;
+    size_t frameOffset;
+    while (high - low > linearSize) {
+        size_t middle = low + (high - low) / 2;
+        if (
+            !_findFrameHeader(info, middle, high, &frameOffset, &header)
+            || header.firstSample > sample
+            || header.firstSample < lowSample
+        ) {
+            high = middle;
+            continue;
+        }
+        low = frameOffset;
+        lowSample = header.firstSample;
+        if (sample < header.firstSample + header.blockSize) return low;
+    }
+
+    // Walk the frame headers of the rest.
+    size_t result = low;
+    size_t offset = low;
+    while (_findFrameHeader(info, offset, info->size, &frameOffset, &header)) {
+        if (header.firstSample > sample) break;
+        if (header.firstSample >= lowSample) {
+            result = frameOffset;
+            lowSample = header.firstSample;
+            if (sample < header.firstSample + header.blockSize) break;
+        }
+        offset = frameOffset + header.headerSize;
+    }
+    return result;
+}
+
+size_t flacGetMaxEncodedSize(const FlacInfo *info, uint32_t frameCount) {
+    // Subframes are never larger than verbatim ones with a side channel bit
+    // and a few bits of subframe header.
+    size_t subframeSize = ((size_t)frameCount * (info->bitsPerSample + 1) + 7) / 8
+        + MAX_SUBFRAME_HEADER_SIZE;
+    return MAX_FRAME_HEADER_SIZE + info->channelAmount * subframeSize
+        + FRAME_FOOTER_SIZE;
+}
+
+size_t flacEncodeFrame(
+    const FlacInfo *info, const int32_t *samples, uint32_t frameCount,
+    uint64_t frameNumber, int32_t *scratch, uint8_t *output
+) {
+    uint32_t channelAmount = info->channelAmount;
+    uint32_t bitsPerSample = info->bitsPerSample;
+    int32_t *channels[FLAC_MAX_CHANNELS];
+    for (uint32_t channel = 0; channel < channelAmount; ++channel) {
+        channels[channel] = scratch + (size_t)channel * frameCount;
+        for (uint32_t i = 0; i < frameCount; ++i) {
+            channels[channel][i] = samples[(size_t)i * channelAmount + channel];
+        }
+    }
+    int32_t *mid = scratch + (size_t)channelAmount * frameCount;
+    int32_t *side = mid + frameCount;
+    int32_t *shifted = side + frameCount;
+    int32_t *residual = shifted + frameCount;
+
+    uint8_t channelAssignment = channelAmount - 1;
+    int32_t *coded[FLAC_MAX_CHANNELS];
+    uint32_t codedBits[FLAC_MAX_CHANNELS];
+    for (uint32_t channel = 0; channel < channelAmount; ++channel) {
+        coded[channel] = channels[channel];
+        codedBits[channel] = bitsPerSample;
+    }
+
+    // Stereo is decorrelated the way that gives the smallest frame. The side
+    // channel has one bit more, so 32 bit samples stay independent.
+    if (channelAmount == 2 && bitsPerSample < 32) {
+        int32_t *left = channels[0];
+        int32_t *right = channels[1];
+        for (uint32_t i = 0; i < frameCount; ++i) {
+            mid[i] = (int32_t)(((int64_t)left[i] + right[i]) >> 1);
+            side[i] = left[i] - right[i];
+        }
+        FlacSubframePlan plan;
+        uint64_t leftBits, rightBits, midBits, sideBits;
+        _planSubframe(left, frameCount, bitsPerSample, shifted, residual, &plan);
+        leftBits = plan.bits;
+        _planSubframe(right, frameCount, bitsPerSample, shifted, residual, &plan);
+        rightBits = plan.bits;
+        _planSubframe(mid, frameCount, bitsPerSample, shifted, residual, &plan);
+        midBits = plan.bits;
+        _planSubframe(side, frameCount, bitsPerSample + 1, shifted, residual, &plan);
+        sideBits = plan.bits;
+
+        uint64_t bestBits = leftBits + rightBits;
+        if (leftBits + sideBits < bestBits) {
+            bestBits = leftBits + sideBits;
+            channelAssignment = CHANNEL_ASSIGNMENT_LEFT_SIDE;
+            coded[1] = side;
+            codedBits[1] = bitsPerSample + 1;
+        }
+        if (sideBits + rightBits < bestBits) {
+            bestBits = sideBits + rightBits;
+            channelAssignment = CHANNEL_ASSIGNMENT_SIDE_RIGHT;
+            coded[0] = side;
+            codedBits[0] = bitsPerSample + 1;
+            coded[1] = right;
+            codedBits[1] = bitsPerSample;
+        }
+        if (midBits + sideBits < bestBits) {
+            channelAssignment = CHANNEL_ASSIGNMENT_MID_SIDE;
+            coded[0] = mid;
+            codedBits[0] = bitsPerSample;
+            coded[1] = side;
+            codedBits[1] = bitsPerSample + 1;
+        }
+    }
+
+    size_t headerSize = _writeFrameHeader(
+        output, frameNumber, frameCount, channelAssignment
+    );
+    BitWriter writer = { output, headerSize, 0, 0 };
+    for (uint32_t channel = 0; channel < channelAmount; ++channel) {
+        FlacSubframePlan plan;
+        _planSubframe(
+            coded[channel], frameCount, codedBits[channel], shifted, residual,
+            &plan
+        );
+        _writeSubframe(
+            &writer, &plan, shifted, residual, frameCount, codedBits[channel]
+        );
+    }
+
+    // Pad to a byte boundary. The CRC-16 is not checked when decoding, so
+    // it is left zero.
+    _writeBits(&writer, 0, (8 - writer.bitCount) & 7);
+    output[writer.position++] = 0;
+    output[writer.position++] = 0;
+    return writer.position;
+}
+
+uint32_t flacDecodeFrame(
+    const FlacInfo *info, size_t offset, int32_t *samples, uint8_t *frames
+) {
+    int32_t *channels[FLAC_MAX_CHANNELS];
+    for (uint16_t channel = 0; channel < info->channelAmount; ++channel) {
+        channels[channel] = samples + (size_t)channel * info->maxBlockSize;
+    }
+    FlacFrameHeader header;
+    size_t frameSize;
+    if (!_decodeFrame(info, offset, channels, &header, &frameSize)) return 0;
+    _interleaveFrames(info, channels, 0, header.blockSize, frames);
+    return header.blockSize;
+}
+
+uint32_t flacDecodeFrames(
+    const FlacInfo *info, uint64_t firstSample, uint32_t frameCount,
+    int32_t *samples, uint8_t *frames
+) {
+    int32_t *channels[FLAC_MAX_CHANNELS];
+    for (uint16_t channel = 0; channel < info->channelAmount; ++channel) {
+        channels[channel] = samples + (size_t)channel * info->maxBlockSize;
+    }
+    size_t frameSize = (size_t)info->channelAmount * flacGetSampleSize(info);
+
+    // Seek once, then decode frame after frame. Like in a stream, gaps and
+    // what cannot be decoded are silent.
+    size_t offset = flacFindFrame(info, firstSample);
+    uint32_t filled = 0;
+    while (filled < frameCount) {
+        uint64_t sample = firstSample + filled;
+        FlacFrameHeader header;
+        size_t flacFrameSize;
+        if (!_decodeFrame(info, offset, channels, &header, &flacFrameSize)) {
+            memset(frames + filled * frameSize, 0, (frameCount - filled) * frameSize);
+            break;
+        }
+        offset += flacFrameSize;
+        if (header.firstSample + header.blockSize <= sample) continue;
+        if (sample < header.firstSample) {
+            uint64_t count = header.firstSample - sample;
+            if (count > frameCount - filled) count = frameCount - filled;
+            memset(frames + filled * frameSize, 0, count * frameSize);
+            filled += count;
+            sample += count;
+            if (filled == frameCount) break;
+        }
+        uint32_t count = header.firstSample + header.blockSize - sample;
+        if (count > frameCount - filled) count = frameCount - filled;
+        _interleaveFrames(
+            info, channels, sample - header.firstSample, count,
+            frames + filled * frameSize
+        );
+        filled += count;
+    }
+    return frameCount;
+}
+
+void _freeFlacStream(FlacStream *stream) {
+    for (uint16_t channel = 0; channel < stream->info->channelAmount; ++channel) {
+        free(stream->channels[channel]);
+    }
+    free(stream->buffers);
+    free(stream->slots);
+    free(stream);
+}
+
+FlacStream * flacStreamOpen(
+    const FlacInfo *info, uint32_t blockFrames, uint32_t queueDepth
+) {
+    if (
+        blockFrames == 0
+        || queueDepth == 0
+        || info->channelAmount > FLAC_MAX_CHANNELS
+    ) {
+        return NULL;
+    }
+    FlacStream *stream = (FlacStream*)calloc(1, sizeof(FlacStream));
+    if (stream == NULL) return NULL;
+
+    stream->info = info;
+    stream->blockFrames = blockFrames;
+    stream->queueDepth = queueDepth;
+    stream->blockCount = (info->totalSamples + blockFrames - 1) / blockFrames;
+    stream->sampleSize = flacGetSampleSize(info);
+    stream->nextFrameOffset = info->firstFrameOffset;
+
+    size_t blockSize = (size_t)blockFrames * info->channelAmount
+        * stream->sampleSize;
+    stream->buffers = (uint8_t*)malloc(blockSize * queueDepth);
+    stream->slots = (FlacSlot*)calloc(queueDepth, sizeof(FlacSlot));
+    bool allocated = stream->buffers != NULL && stream->slots != NULL;
+    for (uint16_t channel = 0; channel < info->channelAmount; ++channel) {
+        stream->channels[channel] = (int32_t*)malloc(
+            (size_t)info->maxBlockSize * sizeof(int32_t)
+        );
+        allocated = allocated && stream->channels[channel] != NULL;
+    }
+    if (!allocated) {
+        _freeFlacStream(stream);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < queueDepth; ++i) {
+        stream->slots[i].buffer = stream->buffers + i * blockSize;
+        atomic_init(&stream->slots[i].state, FLAC_SLOT_EMPTY);
+    }
+    atomic_init(&stream->base, 0);
+    atomic_init(&stream->playheadBlock, 0);
+    atomic_init(&stream->starvations, 0);
+    atomic_init(&stream->decodeNanoseconds, 0);
+    atomic_init(&stream->decodedFrames, 0);
+    atomic_init(&stream->haltFlag, false);
+
+    if (sem_init(&stream->wakeup, 0, 0)) {
+        _freeFlacStream(stream);
+        return NULL;
+    }
+    if (pthread_create(&stream->thread, NULL, _decoderLoop, (void*)stream)) {
+        sem_destroy(&stream->wakeup);
+        _freeFlacStream(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+void flacStreamClose(FlacStream *stream) {
+    atomic_store_explicit(&stream->haltFlag, true, memory_order_release);
+    sem_post(&stream->wakeup);
+    pthread_join(stream->thread, NULL);
+    sem_destroy(&stream->wakeup);
+    _freeFlacStream(stream);
+}
+
+const uint8_t * flacStreamGetFrames(
+    FlacStream *stream, uint64_t frame, uint32_t *frameCount
+) {
+    uint64_t block = frame / stream->blockFrames;
+    FlacSlot *slot = &stream->slots[block % stream->queueDepth];
+    uint32_t state = atomic_load_explicit(&slot->state, memory_order_acquire);
+
+    if (state != FLAC_SLOT_READY || slot->block != block) {
+        // A ready slot with a block outside of the window is left over
+        // from before a jump. Hand it back so it can be filled.
+        if (state == FLAC_SLOT_READY && !_isInFlacWindow(stream, slot->block)) {
+            atomic_store_explicit(
+                &slot->state, FLAC_SLOT_EMPTY, memory_order_release
+            );
+            sem_post(&stream->wakeup);
+        }
+        atomic_fetch_add_explicit(
+            &stream->starvations, 1, memory_order_relaxed
+        );
+        *frameCount = 0;
+        return NULL;
+    }
+
+    uint32_t frameInBlock = frame % stream->blockFrames;
+    if (frameInBlock >= slot->length) {
+        *frameCount = 0;
+        return NULL;
+    }
+    if (*frameCount > slot->length - frameInBlock) {
+        *frameCount = slot->length - frameInBlock;
+    }
+    size_t frameSize = (size_t)stream->info->channelAmount * stream->sampleSize;
+    return slot->buffer + frameInBlock * frameSize;
+}
+
+void flacStreamSetPlayhead(
+    FlacStream *stream, uint64_t frame, uint32_t keepBehindFrames
+) {
+    // At least half of the window must be ahead of the playhead.
+    uint32_t maxKeepBehindFrames = stream->blockFrames * (stream->queueDepth / 2);
+    if (keepBehindFrames > maxKeepBehindFrames) {
+        keepBehindFrames = maxKeepBehindFrames;
+    }
+    uint64_t keptFrame = frame > keepBehindFrames ? frame - keepBehindFrames : 0;
+    uint64_t base = keptFrame / stream->blockFrames;
+    atomic_store_explicit(
+        &stream->playheadBlock, frame / stream->blockFrames, memory_order_relaxed
+    );
+    if (base == atomic_load_explicit(&stream->base, memory_order_relaxed)) {
+        return;
+    }
+    atomic_store_explicit(&stream->base, base, memory_order_release);
+
+    // Hand all ready slots outside the new window back to the decoding
+    // thread.
+    for (uint32_t i = 0; i < stream->queueDepth; ++i) {
+        FlacSlot *slot = &stream->slots[i];
+        if (atomic_load_explicit(&slot->state, memory_order_acquire)
+            != FLAC_SLOT_READY) continue;
+        if (slot->block >= base && slot->block < base + stream->queueDepth) {
+            continue;
+        }
+        atomic_store_explicit(&slot->state, FLAC_SLOT_EMPTY, memory_order_release);
+    }
+    sem_post(&stream->wakeup);
+}
+
+uint64_t flacStreamGetStarvationCount(FlacStream *stream) {
+    return atomic_load_explicit(&stream->starvations, memory_order_relaxed);
+}
+
+void flacStreamGetDecodeTime(
+    FlacStream *stream, uint64_t *nanoseconds, uint64_t *frames
+) {
+    *nanoseconds = atomic_load_explicit(
+        &stream->decodeNanoseconds, memory_order_relaxed
+    );
+    *frames = atomic_load_explicit(&stream->decodedFrames, memory_order_relaxed);
+}
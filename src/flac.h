@@ -0,0 +1,218 @@
+#ifndef __FLAC_H__
+#define __FLAC_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLAC_MAX_CHANNELS (8)
+
+/**
+ * @brief A point of the SEEKTABLE of a FLAC file.
+*/
+typedef struct {
+    uint64_t sample;  /* The first sample of the target frame */
+    uint64_t offset;  /* The offset of the target frame from the first frame */
+} FlacSeekPoint;
+
+/**
+ * @brief This describes a native FLAC file in memory.
+ *
+ * Only the metadata has to be resident when it is read. The frames are
+ * accessed through data while decoding, so a mapped file works as well.
+*/
+typedef struct {
+    const uint8_t *data;  /* The entire file */
+    FlacSeekPoint *seekPoints;  /* The valid points of the SEEKTABLE, sorted */
+    size_t size;  /* The size of the file in bytes */
+    size_t firstFrameOffset;  /* The offset of the first frame */
+    uint64_t totalSamples;  /* The amount of samples per channel */
+    uint32_t sampleRate;  /* The sample rate in frames/second */
+    uint32_t maxFrameSize;  /* The size of the largest frame in bytes, 0 if unknown */
+    uint32_t seekPointCount;  /* The amount of seek points */
+    uint16_t channelAmount;  /* The amount of channels */
+    uint16_t bitsPerSample;  /* The amount of bits per decoded sample */
+    uint16_t minBlockSize;  /* The smallest block size in samples */
+    uint16_t maxBlockSize;  /* The largest block size in samples */
+} FlacInfo;
+
+/**
+ * @brief This represents a FLAC file that is decoded in blocks ahead of
+ * the playhead.
+ *
+ * Each stream owns queueDepth blocks of blockFrames decoded frames and a
+ * thread that decodes into them. The block containing frame f lives in slot
+ * (f / blockFrames) % queueDepth. Decoded frames are interleaved signed
+ * little endian samples of flacGetSampleSize() bytes.
+ *
+ * flacStreamGetFrames() and flacStreamSetPlayhead() are meant to be called
+ * by the audio thread. They never block.
+*/
+typedef struct FlacStream FlacStream;
+
+/**
+ * Returns whether the data starts like a native FLAC file.
+ *
+ * @param data The data.
+ * @param size The size of the data in bytes.
+*/
+bool flacIsFlac(const uint8_t *data, size_t size);
+/**
+ * Reads the metadata of a FLAC file.
+ *
+ * Only the first availableSize bytes of data have to be resident.
+ *
+ * @param data The entire file.
+ * @param size The size of the file in bytes.
+ * @param availableSize How many bytes of the file are resident.
+ * @param info The info that is filled.
+ * @return Whether the metadata is valid and supported.
+*/
+bool flacReadInfo(
+    const uint8_t *data, size_t size, size_t availableSize, FlacInfo *info
+);
+/**
+ * Frees what flacReadInfo() allocated.
+ *
+ * @param info The info.
+*/
+void flacFreeInfo(FlacInfo *info);
+/**
+ * Returns the size of one decoded sample in bytes. Samples of up to 16 bits
+ * are decoded to 2 bytes, all others to 4 bytes. They are left justified.
+ *
+ * @param info The info.
+*/
+uint32_t flacGetSampleSize(const FlacInfo *info);
+/**
+ * Returns the offset of a frame that starts at or before the given sample
+ * and close to it.
+ *
+ * The SEEKTABLE narrows the search if there is one. The rest is bisected,
+ * so the cost is bounded by the logarithm of the file size.
+ *
+ * @param info The info.
+ * @param sample The sample.
+ * @return The offset of the frame in the file.
+*/
+size_t flacFindFrame(const FlacInfo *info, uint64_t sample);
+/**
+ * Returns how many bytes flacEncodeFrame() writes at most.
+ *
+ * @param info The info.
+ * @param frameCount The amount of frames.
+*/
+size_t flacGetMaxEncodedSize(const FlacInfo *info, uint32_t frameCount);
+/**
+ * Encodes one FLAC frame with fixed predictors.
+ *
+ * The frame has a fixed block size and takes its sample rate and sample size
+ * from info, so it is only meant to be decoded with the same info. Its
+ * CRC-16 is left zero because the decoder does not check it. bitsPerSample
+ * may be up to 32 here.
+ *
+ * @param info The info. maxBlockSize gives the block size of all frames.
+ * @param samples The interleaved right justified samples.
+ * @param frameCount The amount of frames, at most maxBlockSize.
+ * @param frameNumber The index of the frame.
+ * @param scratch Room for (channelAmount + 4) * frameCount samples.
+ * @param output Room for flacGetMaxEncodedSize() bytes.
+ * @return The size of the frame in bytes.
+*/
+size_t flacEncodeFrame(
+    const FlacInfo *info, const int32_t *samples, uint32_t frameCount,
+    uint64_t frameNumber, int32_t *scratch, uint8_t *output
+);
+/**
+ * Decodes the FLAC frame at the given offset like a FLAC stream would.
+ *
+ * @param info The info.
+ * @param offset The offset of the frame in the file.
+ * @param samples Room for channelAmount * maxBlockSize samples.
+ * @param frames Room for maxBlockSize decoded frames.
+ * @return The amount of decoded frames, 0 if the frame is invalid.
+*/
+uint32_t flacDecodeFrame(
+    const FlacInfo *info, size_t offset, int32_t *samples, uint8_t *frames
+);
+/**
+ * Decodes a range of frames without a stream, e.g. to scan a whole file.
+ *
+ * @param info The info.
+ * @param firstSample The first sample to decode.
+ * @param frameCount The amount of frames to decode.
+ * @param samples Room for channelAmount * maxBlockSize samples.
+ * @param frames Room for frameCount decoded frames.
+ * @return The amount of frames, samples that cannot be decoded are silent.
+*/
+uint32_t flacDecodeFrames(
+    const FlacInfo *info, uint64_t firstSample, uint32_t frameCount,
+    int32_t *samples, uint8_t *frames
+);
+
+/**
+ * Opens a stream and starts its decoding thread.
+ *
+ * The info must stay valid until flacStreamClose() returned.
+ *
+ * @param info The info.
+ * @param blockFrames The amount of frames in one block.
+ * @param queueDepth The amount of blocks decoded ahead.
+ * @return The stream or NULL if it could not be created.
+*/
+FlacStream * flacStreamOpen(
+    const FlacInfo *info, uint32_t blockFrames, uint32_t queueDepth
+);
+/**
+ * Stops the decoding thread and frees the stream.
+ *
+ * @param stream The stream.
+*/
+void flacStreamClose(FlacStream *stream);
+/**
+ * Returns a pointer to the given frame if it was decoded already.
+ *
+ * On return frameCount holds the amount of consecutive frames that can be
+ * read from the pointer. It is never larger than on input. If the frame is
+ * not decoded yet frameCount is 0.
+ *
+ * @param stream The stream.
+ * @param frame The first frame.
+ * @param frameCount The maximum amount of frames.
+ * @return The pointer to the frame.
+*/
+const uint8_t * flacStreamGetFrames(
+    FlacStream *stream, uint64_t frame, uint32_t *frameCount
+);
+/**
+ * Tells the decoding thread where the playhead is.
+ *
+ * Blocks starting with the one that contains frame - keepBehindFrames are
+ * kept or decoded. keepBehindFrames is limited to half of the window.
+ *
+ * @param stream The stream.
+ * @param frame The frame at the playhead.
+ * @param keepBehindFrames How many frames behind the playhead are kept.
+*/
+void flacStreamSetPlayhead(
+    FlacStream *stream, uint64_t frame, uint32_t keepBehindFrames
+);
+/**
+ * Returns how often flacStreamGetFrames() did not find the requested frame.
+ *
+ * @param stream The stream.
+*/
+uint64_t flacStreamGetStarvationCount(FlacStream *stream);
+/**
+ * Returns the CPU time the decoding thread used and how many frames it
+ * decoded in that time.
+ *
+ * @param stream The stream.
+ * @param nanoseconds The CPU time in nanoseconds.
+ * @param frames The amount of decoded frames.
+*/
+void flacStreamGetDecodeTime(
+    FlacStream *stream, uint64_t *nanoseconds, uint64_t *frames
+);
+
+#endif // __FLAC_H__
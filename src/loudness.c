@@ -0,0 +1,320 @@
+#define _GNU_SOURCE
+
+#include "loudness.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOUDNESS_MAGIC ("WAVLOUDN")
+#define LOUDNESS_HISTORY_SIZE (LOUDNESS_TRUE_PEAK_TAPS - 1)
+#define LOUDNESS_OFFSET (-0.691)
+#define LOUDNESS_ABSOLUTE_GATE (-70.0)
+#define LOUDNESS_RELATIVE_GATE (-10.0)
+#define LOUDNESS_RANGE_RELATIVE_GATE (-20.0)
+#define LOUDNESS_BLOCK_SEGMENTS (4)
+#define LOUDNESS_SHORT_TERM_SEGMENTS (30)
+#define LOUDNESS_RANGE_LOW_PERCENTILE (0.10)
+#define LOUDNESS_RANGE_HIGH_PERCENTILE (0.95)
+
+// The 4 phases of the 48 tap interpolation filter of ITU-R BS.1770 Annex 2
+static const float TRUE_PEAK_COEFFICIENTS[LOUDNESS_TRUE_PEAK_PHASES][LOUDNESS_TRUE_PEAK_TAPS] = {
+    {
+        0.0017089843750f, 0.0109863281250f, -0.0196533203125f, 0.0332031250000f,
+        -0.0594482421875f, 0.1373291015625f, 0.9721679687500f, -0.1022949218750f,
+        0.0476074218750f, -0.0266113281250f, 0.0148925781250f, -0.0083007812500f
+    },
+    {
+        -0.0291748046875f, 0.0292968750000f, -0.0517578125000f, 0.0891113281250f,
+        -0.1665039062500f, 0.4650878906250f, 0.7797851562500f, -0.2003173828125f,
+        0.1015625000000f, -0.0582275390625f, 0.0330810546875f, -0.0189208984375f
+    },
+    {
+        -0.0189208984375f, 0.0330810546875f, -0.0582275390625f, 0.1015625000000f,
+        -0.2003173828125f, 0.7797851562500f, 0.4650878906250f, -0.1665039062500f,
+        0.0891113281250f, -0.0517578125000f, 0.0292968750000f, -0.0291748046875f
+    },
+    {
+        -0.0083007812500f, 0.0148925781250f, -0.0266113281250f, 0.0476074218750f,
+        -0.1022949218750f, 0.9721679687500f, 0.1373291015625f, -0.0594482421875f,
+        0.0332031250000f, -0.0196533203125f, 0.0109863281250f, 0.0017089843750f
+    }
+};
+
+uint32_t loudnessGetSegmentFrames(uint32_t sampleRate) {
+    return (sampleRate * LOUDNESS_SEGMENT_MILLISECONDS + 500) / 1000;
+}
+
+void _initKWeighting(LoudnessBiquad *stages, uint32_t sampleRate) {
+    // The pre-filter of ITU-R BS.1770 with coefficients for any sample
+    // rate, as derived for libebur128.
+    double k = tan(M_PI * 1681.974450955533 / sampleRate);
+    double q = 0.7071752369554196;
+    double highGain = pow(10.0, 3.999843853973347 / 20.0);
+    double bandGain = pow(highGain, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    stages[0] = (LoudnessBiquad){
+        .b0 = (highGain + bandGain * k / q + k * k) / a0,
+        .b1 = 2.0 * (k * k - highGain) / a0,
+        .b2 = (highGain - bandGain * k / q + k * k) / a0,
+        .a1 = 2.0 * (k * k - 1.0) / a0,
+        .a2 = (1.0 - k / q + k * k) / a0
+    };
+
+    // The RLB high pass
+    k = tan(M_PI * 38.13547087602444 / sampleRate);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    stages[1] = (LoudnessBiquad){
+        .b0 = 1.0,
+        .b1 = -2.0,
+        .b2 = 1.0,
+        .a1 = 2.0 * (k * k - 1.0) / a0,
+        .a2 = (1.0 - k / q + k * k) / a0
+    };
+}
+
+bool loudnessInit(
+    LoudnessMeter *meter, uint32_t sampleRate, uint16_t channelAmount,
+    const double *weights
+) {
+    *meter = (LoudnessMeter){
+        .weights = weights,
+        .segmentFrames = loudnessGetSegmentFrames(sampleRate),
+        .channelAmount = channelAmount
+    };
+    _initKWeighting(meter->stages, sampleRate);
+    for (uint32_t phase = 0; phase < LOUDNESS_TRUE_PEAK_PHASES; ++phase) {
+        float gain = 0;
+        for (uint32_t tap = 0; tap < LOUDNESS_TRUE_PEAK_TAPS; ++tap) {
+            gain += fabsf(TRUE_PEAK_COEFFICIENTS[phase][tap]);
+        }
+        if (gain > meter->truePeakGain) meter->truePeakGain = gain;
+    }
+
+    bool success = true;
+    for (uint32_t i = 0; i < 4; ++i) {
+        meter->states[i] = (double*)calloc(channelAmount, sizeof(double));
+        success = success && meter->states[i] != NULL;
+    }
+    meter->history = (float*)calloc(
+        (size_t)channelAmount * LOUDNESS_HISTORY_SIZE, sizeof(float)
+    );
+    meter->scratch = (float*)malloc(
+        (LOUDNESS_HISTORY_SIZE + LOUDNESS_CHUNK_FRAMES) * sizeof(float)
+    );
+    if (!success || meter->history == NULL || meter->scratch == NULL) {
+        loudnessFree(meter);
+        return false;
+    }
+    return true;
+}
+
+void loudnessFree(LoudnessMeter *meter) {
+    for (uint32_t i = 0; i < 4; ++i) free(meter->states[i]);
+    free(meter->history);
+    free(meter->scratch);
+    *meter = (LoudnessMeter){ 0 };
+}
+
+void loudnessStartMeasuring(LoudnessMeter *meter, double *segmentEnergies) {
+    meter->segmentEnergies = segmentEnergies;
+    meter->segmentCount = 0;
+    meter->energy = 0;
+    meter->framesInSegment = 0;
+    meter->isMeasuring = true;
+}
+
+void _filterFrames(LoudnessMeter *meter, const float *samples, uint32_t frameCount) {
+    // The channels of a frame are independent, so the inner loop runs
+    // over the interleaved channels with the states side by side.
+    const LoudnessBiquad *shelf = &meter->stages[0];
+    const LoudnessBiquad *highPass = &meter->stages[1];
+    double *shelfStates0 = meter->states[0];
+    double *shelfStates1 = meter->states[1];
+    double *highPassStates0 = meter->states[2];
+    double *highPassStates1 = meter->states[3];
+    const double *weights = meter->weights;
+    uint16_t channelAmount = meter->channelAmount;
+    for (uint32_t i = 0; i < frameCount; ++i) {
+        const float *frame = samples + (size_t)i * channelAmount;
+        double energy = 0;
+        for (uint16_t channel = 0; channel < channelAmount; ++channel) {
+            double x = frame[channel];
+            double y = shelf->b0 * x + shelfStates0[channel];
+            shelfStates0[channel] = shelf->b1 * x - shelf->a1 * y + shelfStates1[channel];
+            shelfStates1[channel] = shelf->b2 * x - shelf->a2 * y;
+            double z = highPass->b0 * y + highPassStates0[channel];
+            highPassStates0[channel] = highPass->b1 * y - highPass->a1 * z
+                + highPassStates1[channel];
+            highPassStates1[channel] = highPass->b2 * y - highPass->a2 * z;
+            energy += weights[channel] * z * z;
+        }
+        if (!meter->isMeasuring) continue;
+        meter->energy += energy;
+        if (++meter->framesInSegment == meter->segmentFrames) {
+            meter->segmentEnergies[meter->segmentCount++] = meter->energy;
+            meter->energy = 0;
+            meter->framesInSegment = 0;
+        }
+    }
+}
+
+void _findTruePeak(LoudnessMeter *meter, const float *samples, uint32_t frameCount) {
+    // Interpolating only matters if it could exceed the peak found so far.
+    uint16_t channelAmount = meter->channelAmount;
+    float *scratch = meter->scratch;
+    for (uint16_t channel = 0; channel < channelAmount; ++channel) {
+        float *history = meter->history + (size_t)channel * LOUDNESS_HISTORY_SIZE;
+        memcpy(scratch, history, LOUDNESS_HISTORY_SIZE * sizeof(float));
+        float historyPeak = 0;
+        for (uint32_t i = 0; i < LOUDNESS_HISTORY_SIZE; ++i) {
+            historyPeak = fmaxf(historyPeak, fabsf(scratch[i]));
+        }
+        float samplePeak = 0;
+        for (uint32_t i = 0; i < frameCount; ++i) {
+            float sample = samples[(size_t)i * channelAmount + channel];
+            scratch[LOUDNESS_HISTORY_SIZE + i] = sample;
+            samplePeak = fmaxf(samplePeak, fabsf(sample));
+        }
+        memcpy(
+            history, scratch + frameCount, LOUDNESS_HISTORY_SIZE * sizeof(float)
+        );
+        if (!meter->isMeasuring) continue;
+
+        float truePeak = fmaxf(meter->truePeak, samplePeak);
+        if (fmaxf(historyPeak, samplePeak) * meter->truePeakGain > truePeak) {
+            for (uint32_t i = 0; i < frameCount; ++i) {
+                const float *window = scratch + i;
+                for (uint32_t phase = 0; phase < LOUDNESS_TRUE_PEAK_PHASES; ++phase) {
+                    float sample = 0;
+                    for (uint32_t tap = 0; tap < LOUDNESS_TRUE_PEAK_TAPS; ++tap) {
+                        sample += TRUE_PEAK_COEFFICIENTS[phase][tap]
+                            * window[LOUDNESS_HISTORY_SIZE - tap];
+                    }
+                    truePeak = fmaxf(truePeak, fabsf(sample));
+                }
+            }
+        }
+        meter->truePeak = truePeak;
+    }
+}
+
+void loudnessAddFrames(LoudnessMeter *meter, const float *samples, uint32_t frameCount) {
+    _filterFrames(meter, samples, frameCount);
+    for (uint32_t frame = 0; frame < frameCount; frame += LOUDNESS_CHUNK_FRAMES) {
+        uint32_t chunkFrames = frameCount - frame < LOUDNESS_CHUNK_FRAMES
+            ? frameCount - frame
+            : LOUDNESS_CHUNK_FRAMES;
+        _findTruePeak(
+            meter, samples + (size_t)frame * meter->channelAmount, chunkFrames
+        );
+    }
+}
+
+double _getBlockEnergy(
+    const double *segmentEnergies, uint64_t firstSegment, uint32_t blockSegments,
+    uint32_t segmentFrames
+) {
+    double energy = 0;
+    for (uint32_t i = 0; i < blockSegments; ++i) {
+        energy += segmentEnergies[firstSegment + i];
+    }
+    return energy / ((double)blockSegments * segmentFrames);
+}
+
+double _getGateEnergy(double loudness) {
+    return pow(10.0, (loudness - LOUDNESS_OFFSET) / 10.0);
+}
+
+double _getLoudness(double energy) {
+    return LOUDNESS_OFFSET + 10.0 * log10(energy);
+}
+
+double loudnessGetIntegrated(
+    const double *segmentEnergies, uint64_t segmentCount, uint32_t segmentFrames
+) {
+    // Blocks of 400 ms overlap by 75 %, so every segment starts one.
+    if (segmentCount < LOUDNESS_BLOCK_SEGMENTS) return -INFINITY;
+    uint64_t blockCount = segmentCount - LOUDNESS_BLOCK_SEGMENTS + 1;
+    double absoluteGate = _getGateEnergy(LOUDNESS_ABSOLUTE_GATE);
+    double sum = 0;
+    uint64_t count = 0;
+    for (uint64_t block = 0; block < blockCount; ++block) {
+        double energy = _getBlockEnergy(
+            segmentEnergies, block, LOUDNESS_BLOCK_SEGMENTS, segmentFrames
+        );
+        if (energy <= absoluteGate) continue;
+        sum += energy;
+        ++count;
+    }
+    if (count == 0) return -INFINITY;
+
+    double relativeGate = sum / count * pow(10.0, LOUDNESS_RELATIVE_GATE / 10.0);
+    sum = 0;
+    count = 0;
+    for (uint64_t block = 0; block < blockCount; ++block) {
+        double energy = _getBlockEnergy(
+            segmentEnergies, block, LOUDNESS_BLOCK_SEGMENTS, segmentFrames
+        );
+        if (energy <= absoluteGate || energy <= relativeGate) continue;
+        sum += energy;
+        ++count;
+    }
+    return count == 0 ? -INFINITY : _getLoudness(sum / count);
+}
+
+int _compareEnergies(const void *a, const void *b) {
+    double difference = *(const double*)a - *(const double*)b;
+    return (difference > 0) - (difference < 0);
+}
+
+bool loudnessGetRange(
+    const double *segmentEnergies, uint64_t segmentCount, uint32_t segmentFrames,
+    double *range
+) {
+    // Short term blocks of 3 s start every segment.
+    *range = 0;
+    if (segmentCount < LOUDNESS_SHORT_TERM_SEGMENTS) return true;
+    uint64_t blockCount = segmentCount - LOUDNESS_SHORT_TERM_SEGMENTS + 1;
+    double *energies = (double*)malloc(blockCount * sizeof(double));
+    if (energies == NULL) return false;
+    double absoluteGate = _getGateEnergy(LOUDNESS_ABSOLUTE_GATE);
+    double sum = 0;
+    uint64_t count = 0;
+    for (uint64_t block = 0; block < blockCount; ++block) {
+        double energy = _getBlockEnergy(
+            segmentEnergies, block, LOUDNESS_SHORT_TERM_SEGMENTS, segmentFrames
+        );
+        if (energy <= absoluteGate) continue;
+        energies[count++] = energy;
+        sum += energy;
+    }
+
+    // The relative gate keeps the blocks above it in front.
+    double relativeGate = count == 0
+        ? 0
+        : sum / count * pow(10.0, LOUDNESS_RANGE_RELATIVE_GATE / 10.0);
+    uint64_t gatedCount = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        if (energies[i] > relativeGate) energies[gatedCount++] = energies[i];
+    }
+    if (gatedCount > 0) {
+        qsort(energies, gatedCount, sizeof(double), _compareEnergies);
+        uint64_t low = (uint64_t)((gatedCount - 1) * LOUDNESS_RANGE_LOW_PERCENTILE + 0.5);
+        uint64_t high = (uint64_t)((gatedCount - 1) * LOUDNESS_RANGE_HIGH_PERCENTILE + 0.5);
+        *range = _getLoudness(energies[high]) - _getLoudness(energies[low]);
+    }
+    free(energies);
+    return true;
+}
+
+void loudnessInitFile(LoudnessFile *file) {
+    memcpy(file->magic, LOUDNESS_MAGIC, LOUDNESS_MAGIC_SIZE);
+    file->version = LOUDNESS_VERSION;
+}
+
+bool loudnessIsValidFile(const LoudnessFile *file) {
+    return !memcmp(file->magic, LOUDNESS_MAGIC, LOUDNESS_MAGIC_SIZE)
+        && file->version == LOUDNESS_VERSION;
+}
@@ -0,0 +1,151 @@
+#ifndef __LOUDNESS_H__
+#define __LOUDNESS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOUDNESS_VERSION (1)
+#define LOUDNESS_MAGIC_SIZE (8)
+#define LOUDNESS_SEGMENT_MILLISECONDS (100)
+#define LOUDNESS_TRUE_PEAK_PHASES (4)
+#define LOUDNESS_TRUE_PEAK_TAPS (12)
+#define LOUDNESS_CHUNK_FRAMES (4096)
+
+/**
+ * @brief One second order section of the K-weighting filter.
+*/
+typedef struct {
+    double b0, b1, b2;  /* The feedforward coefficients */
+    double a1, a2;  /* The feedback coefficients */
+} LoudnessBiquad;
+
+/**
+ * @brief This measures a range of frames as described by ITU-R BS.1770.
+ *
+ * The frames are K-weighted and the weighted sum of squares of every
+ * segment of LOUDNESS_SEGMENT_MILLISECONDS is stored. Gating blocks are
+ * made of whole segments, so the segments of ranges measured separately
+ * give the same gating as measuring the file at once. The true peak is
+ * found by oversampling LOUDNESS_TRUE_PEAK_PHASES times.
+ *
+ * Frames added before loudnessStartMeasuring() only settle the filters,
+ * so a range can be measured as if the frames in front of it were
+ * measured as well.
+*/
+typedef struct {
+    LoudnessBiquad stages[2];  /* The high shelf and the high pass of the K-weighting */
+    double *states[4];  /* The two states of both stages for every channel */
+    const double *weights;  /* The weight of every channel */
+    float *history;  /* The last LOUDNESS_TRUE_PEAK_TAPS - 1 samples of every channel */
+    float *scratch;  /* One channel of a chunk behind its history */
+    double *segmentEnergies;  /* Where the energies of completed segments are stored */
+    uint64_t segmentCount;  /* The amount of completed segments */
+    double energy;  /* The weighted sum of squares of the current segment */
+    float truePeak;  /* The largest absolute oversampled sample */
+    float truePeakGain;  /* How much oversampling amplifies a sample at most */
+    uint32_t segmentFrames;  /* The amount of frames of a segment */
+    uint32_t framesInSegment;  /* The amount of frames of the current segment */
+    uint16_t channelAmount;  /* The amount of channels */
+    bool isMeasuring;  /* Whether segments and true peaks are stored */
+    uint8_t __align[5];
+} LoudnessMeter;
+
+/**
+ * @brief The loudness of an audio file as it is cached in a sidecar file.
+ *
+ * The size and the modification time of the audio file tell whether the
+ * loudness is still valid. All numbers are little endian.
+*/
+typedef struct {
+    uint8_t magic[LOUDNESS_MAGIC_SIZE];  /* LOUDNESS_MAGIC */
+    uint32_t version;  /* LOUDNESS_VERSION */
+    uint8_t __align[4];
+    uint64_t fileSize;  /* The size of the audio file in bytes */
+    int64_t modificationSeconds;  /* The modification time of the audio file */
+    int64_t modificationNanoseconds;  /* The nanoseconds of the modification time */
+    double integratedLoudness;  /* The integrated loudness in LUFS */
+    double loudnessRange;  /* The loudness range in LU */
+    double truePeak;  /* The true peak in dBTP */
+} LoudnessFile;
+
+/**
+ * Returns the amount of frames of a segment.
+ *
+ * @param sampleRate The sample rate in frames/second.
+*/
+uint32_t loudnessGetSegmentFrames(uint32_t sampleRate);
+/**
+ * Initializes a meter.
+ *
+ * @param meter The meter.
+ * @param sampleRate The sample rate in frames/second.
+ * @param channelAmount The amount of channels.
+ * @param weights The weight of every channel, 0 for LFE channels. They must stay valid.
+ * @return Whether the memory of the meter could be allocated.
+*/
+bool loudnessInit(
+    LoudnessMeter *meter, uint32_t sampleRate, uint16_t channelAmount,
+    const double *weights
+);
+/**
+ * Frees the memory of a meter.
+ *
+ * @param meter The meter.
+*/
+void loudnessFree(LoudnessMeter *meter);
+/**
+ * Starts storing segments and true peaks.
+ *
+ * @param meter The meter.
+ * @param segmentEnergies Room for the energies of the segments that follow.
+*/
+void loudnessStartMeasuring(LoudnessMeter *meter, double *segmentEnergies);
+/**
+ * Filters frames and measures them.
+ *
+ * A segment that is not completed is not stored.
+ *
+ * @param meter The meter.
+ * @param samples The interleaved samples, full scale is 1.
+ * @param frameCount The amount of frames.
+*/
+void loudnessAddFrames(LoudnessMeter *meter, const float *samples, uint32_t frameCount);
+/**
+ * Returns the gated integrated loudness.
+ *
+ * @param segmentEnergies The energies of all segments of the file.
+ * @param segmentCount The amount of segments.
+ * @param segmentFrames The amount of frames of a segment.
+ * @return The loudness in LUFS, -INFINITY if every block is gated.
+*/
+double loudnessGetIntegrated(
+    const double *segmentEnergies, uint64_t segmentCount, uint32_t segmentFrames
+);
+/**
+ * Computes the loudness range as described by EBU Tech 3342.
+ *
+ * @param segmentEnergies The energies of all segments of the file.
+ * @param segmentCount The amount of segments.
+ * @param segmentFrames The amount of frames of a segment.
+ * @param range The loudness range in LU.
+ * @return Whether the memory for sorting could be allocated.
+*/
+bool loudnessGetRange(
+    const double *segmentEnergies, uint64_t segmentCount, uint32_t segmentFrames,
+    double *range
+);
+/**
+ * Fills the magic and the version of a sidecar file.
+ *
+ * @param file The sidecar file.
+*/
+void loudnessInitFile(LoudnessFile *file);
+/**
+ * Validates the magic and the version of a sidecar file.
+ *
+ * @param file The sidecar file.
+*/
+bool loudnessIsValidFile(const LoudnessFile *file);
+
+#endif // __LOUDNESS_H__
@@ -7,19 +7,69 @@
 
 #include "audio.h"
 
+#define LOCKED_BEHIND_MILLISECONDS (1000)
+
 void printCommands() {
     printf("h\t\tShow help.\n");
     printf("p\t\tPause playback.\n");
     printf("r\t\tResume/start playback.\n");
     printf("s\t\tStop playback.\n");
     printf("j T\t\tJump to T milliseconds.\n");
+    printf("c ID\t\tJump to the cue point ID.\n");
     printf("t\t\tShow current milliseconds.\n");
     printf("v V\t\tSet volume to V [0..100].\n");
     printf("?\t\tShow current volume [0..100].\n");
+    printf("f\t\tShow major page faults per minute of playback.\n");
+    printf("d\t\tShow the CPU load of decoding compressed audio.\n");
+    printf("k S\t\tKeep S seconds ahead of the playhead locked in memory. 0 unlocks.\n");
+    printf("o NAME\t\tAlso play on the sound device NAME.\n");
+    printf("y\t\tShow how the sound devices are kept in sync.\n");
+    printf("m ID F\t\tReport the marker ID when frame F is played.\n");
+    printf("e\t\tShow the events since the last time.\n");
+    printf("x\t\tShow the statistics of the audio thread.\n");
+    printf("T N\t\tTrace the last N events of the audio thread. 0 stops.\n");
+    printf("w PATH\t\tWrite the traced events to PATH.\n");
+    printf("W PATH\t\tWrite the events traced up to the last underrun to PATH.\n");
     printf("q\t\tQuit program.\n");
     putchar('\n');
 }
 
+void printEvent(const AudioEvent *event) {
+    static const char *states[] = { "stopped", "playing", "paused" };
+    if (event->droppedEvents > 0) {
+        printf("%u events dropped\n", event->droppedEvents);
+    }
+    switch (event->type) {
+        case AUDIO_EVENT_END_REACHED:
+            printf("End reached at frame %u\n", event->frame);
+            break;
+
+        case AUDIO_EVENT_STATE_CHANGED:
+            printf("Now %s at frame %u\n", states[event->state], event->frame);
+            break;
+
+        case AUDIO_EVENT_MARKER:
+            printf("Marker %u at frame %u\n", event->markerId, event->frame);
+            break;
+
+        case AUDIO_EVENT_XRUN:
+            printf("Underrun at frame %u\n", event->frame);
+            break;
+
+        case AUDIO_EVENT_ERROR:
+            // ALSA errors are described by snd_strerror() already.
+            printf("%s", audioGetErrorString((AudioError*)&event->error));
+            if (
+                event->error.type != AUDIO_ERROR_ALSA_ERROR
+                && event->error.alsaErrorNumber < 0
+            ) {
+                printf(": %s", snd_strerror(event->error.alsaErrorNumber));
+            }
+            putchar('\n');
+            break;
+    }
+}
+
 void mainloop(AudioObject audio) {
     pthread_barrier_t barrier;
     pthread_barrier_init(&barrier, NULL, 1);
@@ -59,6 +109,19 @@ void mainloop(AudioObject audio) {
                 printf("Jumped to %lu milliseconds\n", milliseconds);                
                 break;
 
+            case 'c':
+                uint32_t cueId;
+                if (scanf("%u", &cueId) == EOF) {
+                    fprintf(stderr, "Could not read cue point.");
+                    break;
+                }
+                if (audioJumpToCue(audio, &barrier, cueId)) {
+                    printf("Jumped to cue point %u\n", cueId);
+                } else {
+                    printf("%s\n", audioGetErrorString(error));
+                }
+                break;
+
             case 't':
                 uint64_t currentTime = audioGetCurrentTime(audio);
                 float currentTimeSeconds = currentTime / 1000.0f;
@@ -80,6 +143,118 @@ void mainloop(AudioObject audio) {
                 printf("Current volume: %u\n", currentVolume);
                 break;
 
+            case 'f':
+                float faultsPerMinute = audioGetMajorFaultsPerMinute(audio);
+                printf("Major page faults per minute: %.2f\n", faultsPerMinute);
+                break;
+
+            case 'd':
+                float decoderLoad = audioGetDecoderLoad(audio);
+                printf("Decoder load: %.3f%% of one core\n", decoderLoad * 100);
+                break;
+
+            case 'k':
+                uint32_t seconds;
+                if (scanf("%u", &seconds) == EOF) {
+                    fprintf(stderr, "Could not read seconds.");
+                    break;
+                }
+                audioSetLockedWindow(
+                    audio, seconds * 1000, LOCKED_BEHIND_MILLISECONDS, 0
+                );
+                printf("Locked %zu bytes\n", audioGetLockedBytes(audio));
+                break;
+
+            case 'o':
+                char deviceName[256];
+                if (scanf("%255s", deviceName) == EOF) {
+                    fprintf(stderr, "Could not read device name.");
+                    break;
+                }
+                if (audioAddDevice(audio, deviceName)) {
+                    printf("Playing on %s too\n", deviceName);
+                } else {
+                    printf("%s\n", audioGetErrorString(error));
+                }
+                break;
+
+            case 'y':
+                uint32_t deviceCount = audioGetDeviceCount(audio);
+                for (uint32_t device = 0; device < deviceCount; ++device) {
+                    AudioDeviceSync sync;
+                    audioGetDeviceSync(audio, device, &sync);
+                    printf(
+                        "Device %u: offset %.1f us, drift %.1f ppm, correction %.1f ppm%s\n",
+                        device, sync.offsetMicroseconds, sync.driftPpm,
+                        sync.correctionPpm, sync.isLinked ? ", linked" : ""
+                    );
+                }
+                break;
+
+            case 'm':
+                uint32_t markerId, markerFrame;
+                if (scanf("%u %u", &markerId, &markerFrame) == EOF) {
+                    fprintf(stderr, "Could not read marker.");
+                    break;
+                }
+                if (audioAddMarker(audio, markerId, markerFrame)) {
+                    printf("Added marker %u at frame %u\n", markerId, markerFrame);
+                } else {
+                    printf("%s\n", audioGetErrorString(error));
+                }
+                break;
+
+            case 'e':
+                AudioEvent events[16];
+                uint32_t eventCount;
+                while ((eventCount = audioReadEvents(audio, events, 16)) > 0) {
+                    for (uint32_t i = 0; i < eventCount; ++i) {
+                        printEvent(&events[i]);
+                    }
+                }
+                break;
+
+            case 'x':
+                AudioStats stats;
+                char statsText[4096];
+                audioGetStats(audio, &stats);
+                audioFormatStats(&stats, false, statsText, sizeof(statsText));
+                printf("%s", statsText);
+                break;
+
+            case 'T':
+                uint32_t traceEventCount;
+                if (scanf("%u", &traceEventCount) == EOF) {
+                    fprintf(stderr, "Could not read event count.");
+                    break;
+                }
+                if (audioSetTracing(audio, traceEventCount)) {
+                    printf("Tracing %u events\n", traceEventCount);
+                }
+                break;
+
+            case 'w':
+                char tracePath[256];
+                if (scanf("%255s", tracePath) == EOF) {
+                    fprintf(stderr, "Could not read path.");
+                    break;
+                }
+                if (audioWriteTrace(audio, tracePath, false)) {
+                    printf("Wrote %s\n", tracePath);
+                }
+                break;
+
+            case 'W':
+                char xrunTracePath[256];
+                if (scanf("%255s", xrunTracePath) == EOF) {
+                    fprintf(stderr, "Could not read path.");
+                    break;
+                }
+                if (audioWriteTrace(audio, xrunTracePath, true)) {
+                    printf("Wrote %s\n", xrunTracePath);
+                }
+                break;
+
             case 'q':
                 printf("Quitting\n");
                 audioDestroy(audio);
@@ -127,7 +302,10 @@ void * mapFile(int fileDescriptor,  size_t fileSize) {
 }
 
 void printUsage(char *programName) {
-    fprintf(stderr, "Usage: %s [-m | -h] <WAV file>\n", programName);
+    fprintf(
+        stderr, "Usage: %s [-m | -l | -c MODE | -b BANK | -h] <WAV or FLAC file or clip>\n", 
+        programName
+    );
 }
 
 void printHelp(char *programName) {
@@ -135,6 +313,9 @@ void printHelp(char *programName) {
     putchar('\n');
 
     printf("-m\t\tMap the file to memory instead of reading it.\n");
+    printf("-l\t\tLet the library load the file.\n");
+    printf("-c MODE\t\tKeep a compact copy in memory. MODE is lossless, 16bit or adpcm.\n");
+    printf("-b BANK\t\tPlay the clip with the given name from a sound bank.\n");
     printf("-h\t\tShow this help.\n");
     putchar('\n');
 
@@ -145,7 +326,24 @@ void printHelp(char *programName) {
     printCommands();
 }
 
-void parseArguments(int argc, char *argv[], char **filename, bool *map, bool *showHelp) {
+bool parseResidency(const char *mode, enum AudioResidency *residency) {
+    if (!strcmp(mode, "lossless")) {
+        *residency = AUDIO_RESIDENCY_LOSSLESS;
+    } else if (!strcmp(mode, "16bit")) {
+        *residency = AUDIO_RESIDENCY_16_BIT;
+    } else if (!strcmp(mode, "adpcm")) {
+        *residency = AUDIO_RESIDENCY_ADPCM;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void parseArguments(
+    int argc, char *argv[], 
+    char **filename, bool *map, bool *load, enum AudioResidency *residency, 
+    char **bankname, bool *showHelp
+) {
     switch (argc) {
         case 2:
             if (!strncmp(argv[1], "-h", strnlen(argv[1], 3))) {
@@ -160,6 +358,9 @@ void parseArguments(int argc, char *argv[], char **filename, bool *map, bool *sh
             if (!strncmp(argv[1], "-m", strnlen(argv[1], 3))) {
                 *filename = argv[2];
                 *map = true;
+            } else if (!strncmp(argv[1], "-l", strnlen(argv[1], 3))) {
+                *filename = argv[2];
+                *load = true;
             } else if (!strncmp(argv[1], "-h", strnlen(argv[1], 3))) {
                 *showHelp = true;
                 return;
@@ -169,6 +370,19 @@ void parseArguments(int argc, char *argv[], char **filename, bool *map, bool *sh
             }
             break;
 
+        case 4:
+            if (!strncmp(argv[1], "-b", strnlen(argv[1], 3))) {
+                *bankname = argv[2];
+            } else if (
+                strncmp(argv[1], "-c", strnlen(argv[1], 3)) 
+                || !parseResidency(argv[2], residency)
+            ) {
+                printUsage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            *filename = argv[3];
+            break;
+
         default:
             printUsage(argv[0]);
             exit(EXIT_FAILURE);
@@ -178,14 +392,90 @@ void parseArguments(int argc, char *argv[], char **filename, bool *map, bool *sh
 int main(int argc, char *argv[]) {
     char *filename = NULL;
     bool map = false;
+    bool load = false;
+    enum AudioResidency residency = AUDIO_RESIDENCY_RAW;
+    char *bankname = NULL;
     bool showHelp = false;
-    parseArguments(argc, argv, &filename, &map, &showHelp);
+    parseArguments(
+        argc, argv, &filename, &map, &load, &residency, &bankname, &showHelp
+    );
 
     if (showHelp) {
         printHelp(argv[0]);
         return EXIT_SUCCESS;
     }
 
+    AudioConfiguration configuration = {
+        .rawData = NULL,
+        .rawDataSize = 0,
+        .soundDeviceName = "default",
+        .soundDeviceNameSize = 8,
+        .timeResolution = 10
+    };
+
+    if (load) {
+        printf("Loading file.\n");
+        AudioObject audio = audioInitFromPath(&configuration, filename, NULL);
+        if (audio == NULL) {
+            fprintf(stderr, "Failed to initialize audio\n");
+            return EXIT_FAILURE;
+        }
+        AudioError *error = audioGetError(audio);
+        if (error->level == AUDIO_ERROR_LEVEL_ERROR) {
+            const char *errorString = audioGetErrorString(error);
+            fprintf(stderr, "Error: %s\n", errorString);
+            audioDestroy(audio);
+            return EXIT_FAILURE;
+        }
+
+        uint32_t totalDuration = audioGetTotalDuration(audio);
+        float totalDurationSeconds = totalDuration / 1000.0f;
+        printf("Total duration: %.2f seconds\n", totalDurationSeconds);
+
+        mainloop(audio);
+        return EXIT_SUCCESS;
+    }
+
+    if (bankname) {
+        printf("Opening sound bank.\n");
+        AudioBank bank = audioBankOpen(bankname);
+        if (bank == NULL) {
+            fprintf(stderr, "Failed to open sound bank\n");
+            return EXIT_FAILURE;
+        }
+        AudioError *error = audioBankGetError(bank);
+        uint32_t clip;
+        if (error->level == AUDIO_ERROR_LEVEL_ERROR) {
+            fprintf(stderr, "Error: %s\n", audioGetErrorString(error));
+            audioBankClose(bank);
+            return EXIT_FAILURE;
+        }
+        if (!audioBankFindClip(bank, filename, &clip)) {
+            fprintf(stderr, "No clip named %s\n", filename);
+            audioBankClose(bank);
+            return EXIT_FAILURE;
+        }
+        AudioObject audio = audioInitFromBank(&configuration, bank, clip);
+        audioBankClose(bank);
+        if (audio == NULL) {
+            fprintf(stderr, "Failed to initialize audio\n");
+            return EXIT_FAILURE;
+        }
+        error = audioGetError(audio);
+        if (error->level == AUDIO_ERROR_LEVEL_ERROR) {
+            fprintf(stderr, "Error: %s\n", audioGetErrorString(error));
+            audioDestroy(audio);
+            return EXIT_FAILURE;
+        }
+
+        uint32_t totalDuration = audioGetTotalDuration(audio);
+        float totalDurationSeconds = totalDuration / 1000.0f;
+        printf("Total duration: %.2f seconds\n", totalDurationSeconds);
+
+        mainloop(audio);
+        return EXIT_SUCCESS;
+    }
+
     FILE *file = fopen(filename, "rb");
     if (file == NULL) {
         perror("fopen");
@@ -216,15 +506,10 @@ int main(int argc, char *argv[]) {
         fclose(file);
     }
 
-    AudioConfiguration configuration = {
-        .rawData = rawData,
-        .rawDataSize = fileSize,
-        .soundDeviceName = "default",
-        .soundDeviceNameSize = 8,
-        .timeResolution = 10
-    };
+    configuration.rawData = rawData;
+    configuration.rawDataSize = fileSize;
 
-    AudioObject audio = audioInit(&configuration);
+    AudioObject audio = audioInitCompact(&configuration, residency);
     if (audio == NULL) {
         fprintf(stderr, "Failed to initialize audio\n");
         free(rawData);
@@ -238,6 +523,13 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    if (error->level == AUDIO_ERROR_LEVEL_WARNING) {
+        fprintf(stderr, "Warning: %s\n", audioGetErrorString(error));
+    }
+    if (residency != AUDIO_RESIDENCY_RAW) {
+        printf("Compression ratio: %.2f\n", audioGetCompressionRatio(audio));
+    }
+
     uint32_t totalDuration = audioGetTotalDuration(audio);
     float totalDurationSeconds = totalDuration / 1000.0f;
     printf("Total duration: %.2f seconds\n", totalDurationSeconds);
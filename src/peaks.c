@@ -0,0 +1,181 @@
+#define _GNU_SOURCE
+
+#include "peaks.h"
+
+#include <string.h>
+
+#define PEAKS_MAGIC ("WAVPEAKS")
+
+uint32_t peaksGetBucketFrames(uint32_t level) {
+    uint32_t bucketFrames = PEAKS_BASE_BUCKET_FRAMES;
+    for (uint32_t i = 0; i < level; ++i) bucketFrames *= PEAKS_LEVEL_FACTOR;
+    return bucketFrames;
+}
+
+uint64_t _getBucketCount(uint64_t frameCount, uint32_t level) {
+    uint32_t bucketFrames = peaksGetBucketFrames(level);
+    return (frameCount + bucketFrames - 1) / bucketFrames;
+}
+
+size_t peaksGetSize(uint64_t frameCount, uint16_t channelAmount) {
+    size_t size = sizeof(PeaksHeader);
+    for (uint32_t level = 0; level < PEAKS_LEVEL_COUNT; ++level) {
+        size += _getBucketCount(frameCount, level) * channelAmount
+            * sizeof(PeaksBucket);
+    }
+    return size;
+}
+
+void _layOutPeaks(Peaks *peaks, uint8_t *data, size_t size) {
+    peaks->data = data;
+    peaks->size = size;
+    peaks->header = (PeaksHeader*)data;
+    for (uint32_t level = 0; level < PEAKS_LEVEL_COUNT; ++level) {
+        peaks->levels[level] = (PeaksBucket*)(
+            data + peaks->header->levelOffsets[level]
+        );
+        peaks->bucketCounts[level] = _getBucketCount(
+            peaks->header->frameCount, level
+        );
+    }
+}
+
+void peaksInit(Peaks *peaks, uint8_t *data, const PeaksHeader *header) {
+    PeaksHeader *peaksHeader = (PeaksHeader*)data;
+    *peaksHeader = *header;
+    memcpy(peaksHeader->magic, PEAKS_MAGIC, PEAKS_MAGIC_SIZE);
+    peaksHeader->version = PEAKS_VERSION;
+    peaksHeader->levelCount = PEAKS_LEVEL_COUNT;
+    uint64_t offset = sizeof(PeaksHeader);
+    for (uint32_t level = 0; level < PEAKS_LEVEL_COUNT; ++level) {
+        peaksHeader->levelOffsets[level] = offset;
+        offset += _getBucketCount(header->frameCount, level)
+            * header->channelAmount * sizeof(PeaksBucket);
+    }
+    _layOutPeaks(peaks, data, offset);
+}
+
+bool peaksRead(Peaks *peaks, const uint8_t *data, size_t size) {
+    if (size < sizeof(PeaksHeader)) return false;
+    const PeaksHeader *header = (const PeaksHeader*)data;
+    if (
+        memcmp(header->magic, PEAKS_MAGIC, PEAKS_MAGIC_SIZE)
+        || header->version != PEAKS_VERSION
+        || header->levelCount != PEAKS_LEVEL_COUNT
+        || header->channelAmount == 0
+        || header->sampleRate == 0
+        // Every finest bucket takes space, so this bounds the layout.
+        || header->frameCount / PEAKS_BASE_BUCKET_FRAMES > size
+        || peaksGetSize(header->frameCount, header->channelAmount) != size
+    ) {
+        return false;
+    }
+
+    // The levels have to be where peaksInit() puts them.
+    uint64_t offset = sizeof(PeaksHeader);
+    for (uint32_t level = 0; level < PEAKS_LEVEL_COUNT; ++level) {
+        if (header->levelOffsets[level] != offset) return false;
+        offset += _getBucketCount(header->frameCount, level)
+            * header->channelAmount * sizeof(PeaksBucket);
+    }
+    _layOutPeaks(peaks, (uint8_t*)data, size);
+    return true;
+}
+
+uint16_t _squareRoot(uint64_t value) {
+    // Newton's method from above converges to the rounded down root.
+    if (value == 0) return 0;
+    uint64_t root = value;
+    uint64_t next = (root + 1) / 2;
+    while (next < root) {
+        root = next;
+        next = (root + value / root) / 2;
+    }
+    return root > UINT16_MAX ? UINT16_MAX : (uint16_t)root;
+}
+
+void _computeBucket(
+    const int16_t *samples, uint16_t stride, uint32_t sampleCount,
+    PeaksBucket *bucket
+) {
+    int16_t min = INT16_MAX;
+    int16_t max = INT16_MIN;
+    uint64_t sumOfSquares = 0;
+    for (uint32_t i = 0; i < sampleCount; ++i) {
+        int32_t sample = samples[(size_t)i * stride];
+        min = sample < min ? sample : min;
+        max = sample > max ? sample : max;
+        sumOfSquares += (uint64_t)(sample * sample);
+    }
+    bucket->min = min;
+    bucket->max = max;
+    bucket->rms = _squareRoot(sumOfSquares / sampleCount);
+}
+
+void _mergeBuckets(Peaks *peaks, uint32_t level, uint64_t bucket) {
+    // The root mean square is weighted by the frames of every bucket below.
+    uint16_t channelAmount = peaks->header->channelAmount;
+    uint64_t frameCount = peaks->header->frameCount;
+    uint32_t childFrames = peaksGetBucketFrames(level - 1);
+    uint64_t firstChild = bucket * PEAKS_LEVEL_FACTOR;
+    uint64_t lastChild = firstChild + PEAKS_LEVEL_FACTOR;
+    if (lastChild > peaks->bucketCounts[level - 1]) {
+        lastChild = peaks->bucketCounts[level - 1];
+    }
+    for (uint16_t channel = 0; channel < channelAmount; ++channel) {
+        int16_t min = INT16_MAX;
+        int16_t max = INT16_MIN;
+        uint64_t sumOfSquares = 0;
+        uint64_t frames = 0;
+        for (uint64_t child = firstChild; child < lastChild; ++child) {
+            const PeaksBucket *childBucket = &peaks->levels[level - 1][
+                child * channelAmount + channel
+            ];
+            uint64_t weight = frameCount - child * childFrames;
+            if (weight > childFrames) weight = childFrames;
+            min = childBucket->min < min ? childBucket->min : min;
+            max = childBucket->max > max ? childBucket->max : max;
+            sumOfSquares += (uint64_t)childBucket->rms * childBucket->rms * weight;
+            frames += weight;
+        }
+        PeaksBucket *merged = &peaks->levels[level][bucket * channelAmount + channel];
+        merged->min = min;
+        merged->max = max;
+        merged->rms = _squareRoot(sumOfSquares / frames);
+    }
+}
+
+void peaksAddFrames(
+    Peaks *peaks, const int16_t *samples, uint64_t firstFrame,
+    uint32_t frameCount
+) {
+    uint16_t channelAmount = peaks->header->channelAmount;
+    uint64_t firstBucket = firstFrame / PEAKS_BASE_BUCKET_FRAMES;
+    uint32_t bucketCount = (frameCount + PEAKS_BASE_BUCKET_FRAMES - 1)
+        / PEAKS_BASE_BUCKET_FRAMES;
+    for (uint32_t i = 0; i < bucketCount; ++i) {
+        uint32_t bucketFrames = frameCount - i * PEAKS_BASE_BUCKET_FRAMES;
+        if (bucketFrames > PEAKS_BASE_BUCKET_FRAMES) {
+            bucketFrames = PEAKS_BASE_BUCKET_FRAMES;
+        }
+        const int16_t *bucketSamples = samples
+            + (size_t)i * PEAKS_BASE_BUCKET_FRAMES * channelAmount;
+        PeaksBucket *buckets = peaks->levels[0]
+            + (firstBucket + i) * channelAmount;
+        for (uint16_t channel = 0; channel < channelAmount; ++channel) {
+            _computeBucket(
+                bucketSamples + channel, channelAmount, bucketFrames,
+                &buckets[channel]
+            );
+        }
+    }
+
+    for (uint32_t level = 1; level < PEAKS_LEVEL_COUNT; ++level) {
+        uint32_t bucketFrames = peaksGetBucketFrames(level);
+        uint64_t first = firstFrame / bucketFrames;
+        uint64_t last = (firstFrame + frameCount + bucketFrames - 1) / bucketFrames;
+        for (uint64_t bucket = first; bucket < last; ++bucket) {
+            _mergeBuckets(peaks, level, bucket);
+        }
+    }
+}
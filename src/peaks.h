@@ -0,0 +1,112 @@
+#ifndef __PEAKS_H__
+#define __PEAKS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PEAKS_VERSION (1)
+#define PEAKS_MAGIC_SIZE (8)
+#define PEAKS_LEVEL_COUNT (3)
+#define PEAKS_BASE_BUCKET_FRAMES (64)
+#define PEAKS_LEVEL_FACTOR (8)
+#define PEAKS_TOP_BUCKET_FRAMES (PEAKS_BASE_BUCKET_FRAMES * PEAKS_LEVEL_FACTOR * PEAKS_LEVEL_FACTOR)
+
+/**
+ * @brief The peaks of one channel in one bucket.
+ *
+ * The samples are scaled to 16 bit.
+*/
+typedef struct {
+    int16_t min;  /* The smallest sample */
+    int16_t max;  /* The largest sample */
+    uint16_t rms;  /* The root mean square of the samples */
+} PeaksBucket;
+
+/**
+ * @brief The header at the start of a peaks file.
+ *
+ * The header is followed by the buckets of every level, finest first. A
+ * level holds one bucket per channel for every PEAKS_BASE_BUCKET_FRAMES *
+ * PEAKS_LEVEL_FACTOR^level frames, the last bucket may hold fewer frames.
+ * The size and the modification time of the audio file tell whether the
+ * peaks are still valid. All numbers are little endian.
+*/
+typedef struct {
+    uint8_t magic[PEAKS_MAGIC_SIZE];  /* PEAKS_MAGIC */
+    uint32_t version;  /* PEAKS_VERSION */
+    uint32_t sampleRate;  /* The sample rate of the audio in frames/second */
+    uint64_t frameCount;  /* The amount of frames of the audio */
+    uint64_t fileSize;  /* The size of the audio file in bytes */
+    int64_t modificationSeconds;  /* The modification time of the audio file */
+    int64_t modificationNanoseconds;  /* The nanoseconds of the modification time */
+    uint64_t levelOffsets[PEAKS_LEVEL_COUNT];  /* The offset of the buckets of every level */
+    uint16_t channelAmount;  /* The amount of channels */
+    uint16_t levelCount;  /* PEAKS_LEVEL_COUNT */
+    uint8_t __align[4];
+} PeaksHeader;
+
+/**
+ * @brief This describes the peaks of an audio file in memory.
+ *
+ * Everything points into data.
+*/
+typedef struct {
+    uint8_t *data;  /* The header followed by the buckets */
+    PeaksHeader *header;  /* The header */
+    PeaksBucket *levels[PEAKS_LEVEL_COUNT];  /* The buckets of every level */
+    uint64_t bucketCounts[PEAKS_LEVEL_COUNT];  /* The amount of buckets per channel of every level */
+    size_t size;  /* The size of data in bytes */
+} Peaks;
+
+/**
+ * Returns how many frames one bucket of the level covers.
+ *
+ * @param level The level, 0 is the finest.
+*/
+uint32_t peaksGetBucketFrames(uint32_t level);
+/**
+ * Returns the size of the peaks of an audio file.
+ *
+ * @param frameCount The amount of frames of the audio.
+ * @param channelAmount The amount of channels.
+ * @return The size in bytes.
+*/
+size_t peaksGetSize(uint64_t frameCount, uint16_t channelAmount);
+/**
+ * Lays out empty peaks.
+ *
+ * @param peaks The peaks that are filled.
+ * @param data Room for peaksGetSize() bytes.
+ * @param header The header. The layout members are filled in here.
+*/
+void peaksInit(Peaks *peaks, uint8_t *data, const PeaksHeader *header);
+/**
+ * Validates and reads peaks, e.g. from a mapped peaks file.
+ *
+ * @param peaks The peaks that are filled.
+ * @param data The peaks file.
+ * @param size The size of the peaks file in bytes.
+ * @return Whether the peaks are valid.
+*/
+bool peaksRead(Peaks *peaks, const uint8_t *data, size_t size);
+/**
+ * Computes the buckets of every level for a range of frames.
+ *
+ * The finest buckets are computed from the samples, every coarser level
+ * from the level below it, so the samples are read once. Ranges starting
+ * at different multiples of PEAKS_TOP_BUCKET_FRAMES share no bucket and
+ * can be computed on different threads.
+ *
+ * @param peaks The peaks.
+ * @param samples The interleaved 16 bit samples of the frames.
+ * @param firstFrame The first frame, a multiple of PEAKS_TOP_BUCKET_FRAMES.
+ * @param frameCount The amount of frames, a multiple of
+ * PEAKS_TOP_BUCKET_FRAMES unless the range ends with the audio.
+*/
+void peaksAddFrames(
+    Peaks *peaks, const int16_t *samples, uint64_t firstFrame,
+    uint32_t frameCount
+);
+
+#endif // __PEAKS_H__
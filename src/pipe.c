@@ -0,0 +1,571 @@
+#define _GNU_SOURCE
+
+#include "pipe.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/sockios.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define PIPE_DEVICE_NAME ("pipe:")
+#define PIPE_DEVICE_NAME_SIZE (5)
+#define FREE_PIPE_DEVICE_NAME ("pipe-free:")
+#define FREE_PIPE_DEVICE_NAME_SIZE (10)
+#define PIPE_SEGMENT_COUNT (64)
+#define FILE_DESCRIPTOR_PATH_SIZE (32)
+#define NANOSECONDS_PER_SECOND (1000000000ull)
+#define NANOSECONDS_PER_MILLISECOND (1000000ull)
+#define NANOSECONDS_PER_MICROSECOND (1000ull)
+#define MICROSECONDS_PER_SECOND (1000000ull)
+#define MICROSECONDS_PER_MILLISECOND (1000ull)
+#define MILLISECONDS_PER_SECOND (1000ull)
+#define BITS_PER_BYTE (8)
+
+/**
+ * @brief What a pipe output writes to.
+*/
+enum PipeTargetType {
+    PIPE_TARGET_PIPE,  /* A pipe or FIFO, which takes vmsplice() */
+    PIPE_TARGET_SOCKET,  /* A socket */
+    PIPE_TARGET_FILE  /* Anything else, usually a regular file */
+};
+
+/**
+ * @brief Consecutive bytes waiting in the queue of a pipe output.
+*/
+typedef struct {
+    const uint8_t *bytes;  /* The first byte that was not sent yet */
+    size_t size;  /* The bytes that were not sent yet */
+    bool isReferenced;  /* Whether the bytes are stable frames of the writer instead of copies */
+    uint8_t __align[7];
+} PipeSegment;
+
+/**
+ * @brief A pipe output.
+ *
+ * Written frames wait in a queue of segments that is as long as the
+ * buffer. Stable frames are referenced, all others are copied into a ring
+ * of the same size. The queue is sent to the target when the frames are
+ * due, which is right away for a free running output.
+*/
+typedef struct {
+    Backend backend;  /* The operations */
+    int fileDescriptor;  /* The non-blocking target, owned by the output */
+    enum PipeTargetType targetType;  /* What the target is */
+    uint8_t *copies;  /* The ring holding copied frames */
+    size_t copyBegin;  /* The offset of the first copied byte that was not sent yet */
+    size_t copyUsed;  /* The copied bytes that were not sent yet */
+    PipeSegment segments[PIPE_SEGMENT_COUNT];  /* The ring of queued segments */
+    uint32_t firstSegment;  /* The index of the oldest segment */
+    uint32_t segmentCount;  /* The amount of queued segments */
+    size_t frameSize;  /* The size of one frame in bytes */
+    uint32_t sampleRate;  /* The frames sent per second while paced */
+    snd_pcm_state_t state;  /* Whether it is prepared, running or ran out of frames */
+    snd_pcm_uframes_t bufferSize;  /* The size of the queue in frames */
+    _Atomic uint64_t queuedBytes;  /* The bytes in the queue */
+    uint64_t sentBytes;  /* The bytes sent since the output was opened */
+    uint64_t startBytes;  /* The bytes sent when it started */
+    uint64_t preparedFrames;  /* The frames written since it was prepared */
+    uint64_t startThreshold;  /* The written frames it starts with by itself */
+    struct timespec startTime;  /* When it started on CLOCK_MONOTONIC */
+    int error;  /* The negative error number that broke the target, 0 if none */
+    bool isPaced;  /* Whether frames are sent in real time */
+    bool wroteSinceSleep;  /* Whether frames were written since the last sleep */
+    uint8_t __align[2];
+} PipeBackend;
+
+size_t _getQueueCapacity(PipeBackend *pipe) {
+    return pipe->bufferSize * pipe->frameSize;
+}
+
+uint64_t _getQueuedBytes(PipeBackend *pipe) {
+    return atomic_load_explicit(&pipe->queuedBytes, memory_order_relaxed);
+}
+
+void _clearQueue(PipeBackend *pipe, size_t keptBytes) {
+    // Keeps the first keptBytes of the oldest segment, so a frame that was
+    // sent in part is completed and the reader stays aligned.
+    if (keptBytes > 0 && pipe->segmentCount > 0) {
+        PipeSegment *segment = &pipe->segments[pipe->firstSegment];
+        segment->size = keptBytes;
+        pipe->segmentCount = 1;
+        pipe->copyUsed = segment->isReferenced ? 0 : keptBytes;
+    } else {
+        keptBytes = 0;
+        pipe->segmentCount = 0;
+        pipe->copyUsed = 0;
+    }
+    atomic_store_explicit(&pipe->queuedBytes, keptBytes, memory_order_relaxed);
+}
+
+void _failPipe(PipeBackend *pipe, int error) {
+    // A broken target discards everything, so the writer does not wait for
+    // room that never comes.
+    if (pipe->error == 0) pipe->error = error;
+    _clearQueue(pipe, 0);
+}
+
+bool _appendSegment(
+    PipeBackend *pipe, const uint8_t *bytes, size_t size, bool isReferenced
+) {
+    // Bytes that continue the newest segment extend it.
+    if (pipe->segmentCount > 0) {
+        PipeSegment *last = &pipe->segments[
+            (pipe->firstSegment + pipe->segmentCount - 1) % PIPE_SEGMENT_COUNT
+        ];
+        if (last->isReferenced == isReferenced && last->bytes + last->size == bytes) {
+            last->size += size;
+            atomic_fetch_add_explicit(&pipe->queuedBytes, size, memory_order_relaxed);
+            return true;
+        }
+    }
+    if (pipe->segmentCount == PIPE_SEGMENT_COUNT) return false;
+    pipe->segments[(pipe->firstSegment + pipe->segmentCount) % PIPE_SEGMENT_COUNT] =
+        (PipeSegment){ .bytes = bytes, .size = size, .isReferenced = isReferenced };
+    ++pipe->segmentCount;
+    atomic_fetch_add_explicit(&pipe->queuedBytes, size, memory_order_relaxed);
+    return true;
+}
+
+size_t _queueBytes(
+    PipeBackend *pipe, const uint8_t *bytes, size_t size, bool isReferenced
+) {
+    // Returns the bytes queued, which are whole frames. The copy ring is as
+    // long as the queue and its end stays frame aligned, so it always has
+    // room for what fits into the queue.
+    if (size == 0) return 0;
+    if (isReferenced) return _appendSegment(pipe, bytes, size, true) ? size : 0;
+    size_t capacity = _getQueueCapacity(pipe);
+    size_t end = (pipe->copyBegin + pipe->copyUsed) % capacity;
+    size_t tailSize = capacity - end < size ? capacity - end : size;
+    if (!_appendSegment(pipe, pipe->copies + end, tailSize, false)) return 0;
+    memcpy(pipe->copies + end, bytes, tailSize);
+    pipe->copyUsed += tailSize;
+    if (tailSize == size || !_appendSegment(pipe, pipe->copies, size - tailSize, false)) {
+        return tailSize;
+    }
+    memcpy(pipe->copies, bytes + tailSize, size - tailSize);
+    pipe->copyUsed += size - tailSize;
+    return size;
+}
+
+void _consumeSegment(PipeBackend *pipe, PipeSegment *segment, size_t size) {
+    segment->bytes += size;
+    segment->size -= size;
+    if (!segment->isReferenced) {
+        pipe->copyBegin = (pipe->copyBegin + size) % _getQueueCapacity(pipe);
+        pipe->copyUsed -= size;
+    }
+    pipe->sentBytes += size;
+    atomic_fetch_sub_explicit(&pipe->queuedBytes, size, memory_order_relaxed);
+    if (segment->size == 0) {
+        pipe->firstSegment = (pipe->firstSegment + 1) % PIPE_SEGMENT_COUNT;
+        --pipe->segmentCount;
+    }
+}
+
+ssize_t _sendSegment(PipeBackend *pipe, const PipeSegment *segment, size_t size) {
+    // Referenced frames are moved into a pipe by reference. Writing them to
+    // a socket or a file does not copy them in user space either.
+    switch (pipe->targetType) {
+        case PIPE_TARGET_PIPE:
+            if (segment->isReferenced) {
+                struct iovec vector = { .iov_base = (void*)segment->bytes, .iov_len = size };
+                return vmsplice(pipe->fileDescriptor, &vector, 1, SPLICE_F_NONBLOCK);
+            }
+            return write(pipe->fileDescriptor, segment->bytes, size);
+
+        case PIPE_TARGET_SOCKET:
+            return send(
+                pipe->fileDescriptor, segment->bytes, size, MSG_DONTWAIT | MSG_NOSIGNAL
+            );
+
+        default:
+            return write(pipe->fileDescriptor, segment->bytes, size);
+    }
+}
+
+void _sendQueued(PipeBackend *pipe, uint64_t maxBytes) {
+    // Sends until the target is full. A pipe without a reader raises
+    // SIGPIPE, which is blocked meanwhile and taken back if it was raised.
+    sigset_t brokenPipe, previousMask;
+    sigemptyset(&brokenPipe);
+    sigaddset(&brokenPipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &brokenPipe, &previousMask);
+    while (pipe->segmentCount > 0 && maxBytes > 0) {
+        PipeSegment *segment = &pipe->segments[pipe->firstSegment];
+        size_t size = segment->size < maxBytes ? segment->size : maxBytes;
+        ssize_t result = _sendSegment(pipe, segment, size);
+        if (result < 0 && errno == EINTR) continue;
+        if (result < 0 && errno == EPIPE) {
+            if (!sigismember(&previousMask, SIGPIPE)) {
+                struct timespec noWait = { 0 };
+                sigtimedwait(&brokenPipe, NULL, &noWait);
+            }
+            // -EPIPE would read as an xrun.
+            _failPipe(pipe, -ESHUTDOWN);
+            break;
+        }
+        if (result < 0 && errno != EAGAIN) _failPipe(pipe, -errno);
+        if (result <= 0) break;
+        _consumeSegment(pipe, segment, result);
+        maxBytes -= result;
+    }
+    pthread_sigmask(SIG_SETMASK, &previousMask, NULL);
+}
+
+uint64_t _getPipeNanosecondsSince(const struct timespec *time) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - time->tv_sec) * NANOSECONDS_PER_SECOND
+        + now.tv_nsec - time->tv_nsec;
+}
+
+void _updatePipe(PipeBackend *pipe) {
+    // A paced output sends the frames that are due by now. It runs out of
+    // frames when everything written is due and sent, like a sound card.
+    if (pipe->state != SND_PCM_STATE_RUNNING) return;
+    if (!pipe->isPaced) {
+        _sendQueued(pipe, UINT64_MAX);
+        return;
+    }
+    uint64_t dueFrames = (unsigned __int128)_getPipeNanosecondsSince(&pipe->startTime)
+        * pipe->sampleRate / NANOSECONDS_PER_SECOND;
+    uint64_t dueBytes = pipe->startBytes + dueFrames * pipe->frameSize;
+    if (dueBytes > pipe->sentBytes) _sendQueued(pipe, dueBytes - pipe->sentBytes);
+    if (pipe->error == 0 && _getQueuedBytes(pipe) == 0 && dueBytes >= pipe->sentBytes) {
+        pipe->state = SND_PCM_STATE_XRUN;
+    }
+}
+
+void _startPipe(PipeBackend *pipe) {
+    pipe->state = SND_PCM_STATE_RUNNING;
+    pipe->startBytes = pipe->sentBytes;
+    clock_gettime(CLOCK_MONOTONIC, &pipe->startTime);
+}
+
+void _waitForRoom(PipeBackend *pipe) {
+    // A paced output frees room as frames become due, a free running one
+    // as soon as the target takes them.
+    uint64_t halfBufferMilliseconds = pipe->bufferSize / 2 * MILLISECONDS_PER_SECOND
+        / pipe->sampleRate + 1;
+    if (pipe->isPaced) {
+        usleep(halfBufferMilliseconds * MICROSECONDS_PER_MILLISECOND);
+    } else {
+        struct pollfd target = { .fd = pipe->fileDescriptor, .events = POLLOUT };
+        poll(&target, 1, halfBufferMilliseconds);
+    }
+    _updatePipe(pipe);
+}
+
+snd_pcm_uframes_t _getPipeDelay(PipeBackend *pipe) {
+    return _getQueuedBytes(pipe) / pipe->frameSize;
+}
+
+snd_pcm_uframes_t _getPipeAvail(PipeBackend *pipe) {
+    return (_getQueueCapacity(pipe) - _getQueuedBytes(pipe)) / pipe->frameSize;
+}
+
+int _pipeConfigure(Backend *backend, const BackendParameters *parameters) {
+    PipeBackend *pipe = (PipeBackend*)backend;
+    size_t frameSize = (size_t)parameters->channelAmount
+        * snd_pcm_format_physical_width(parameters->format) / BITS_PER_BYTE;
+    if (frameSize == 0 || parameters->sampleRate == 0 || parameters->bufferSize < 2) {
+        return -EINVAL;
+    }
+    uint8_t *copies = (uint8_t*)realloc(pipe->copies, parameters->bufferSize * frameSize);
+    if (copies == NULL) return -ENOMEM;
+    pipe->copies = copies;
+    pipe->frameSize = frameSize;
+    pipe->sampleRate = parameters->sampleRate;
+    pipe->bufferSize = parameters->bufferSize;
+    pipe->copyBegin = 0;
+    pipe->startThreshold = 1;
+    pipe->preparedFrames = 0;
+    pipe->state = SND_PCM_STATE_PREPARED;
+    _clearQueue(pipe, 0);
+    return 0;
+}
+
+int _pipeSetManualStart(Backend *backend) {
+    ((PipeBackend*)backend)->startThreshold = UINT64_MAX;
+    return 0;
+}
+
+int _pipeGetCard(Backend *backend) {
+    return -1;
+}
+
+int _pipeLink(Backend *backend, Backend *other) {
+    return -ENOSYS;
+}
+
+int _pipeStatus(Backend *backend, BackendStatus *status) {
+    PipeBackend *pipe = (PipeBackend*)backend;
+    _updatePipe(pipe);
+    status->delay = _getPipeDelay(pipe);
+    status->avail = _getPipeAvail(pipe);
+    status->state = pipe->state;
+    return 0;
+}
+
+snd_pcm_sframes_t _pipeAvail(Backend *backend) {
+    PipeBackend *pipe = (PipeBackend*)backend;
+    _updatePipe(pipe);
+    if (pipe->state == SND_PCM_STATE_XRUN) return -EPIPE;
+    return _getPipeAvail(pipe);
+}
+
+int _pipeDelay(Backend *backend, snd_pcm_sframes_t *delay) {
+    PipeBackend *pipe = (PipeBackend*)backend;
+    _updatePipe(pipe);
+    if (pipe->state == SND_PCM_STATE_XRUN) return -EPIPE;
+    *delay = _getPipeDelay(pipe);
+    return 0;
+}
+
+snd_pcm_state_t _pipeState(Backend *backend) {
+    PipeBackend *pipe = (PipeBackend*)backend;
+    _updatePipe(pipe);
+    return pipe->state;
+}
+
+snd_pcm_sframes_t _writePipe(
+    PipeBackend *pipe, const uint8_t *frames, snd_pcm_uframes_t frameCount,
+    bool isReferenced
+) {
+    _updatePipe(pipe);
+    if (pipe->error) return pipe->error;
+    if (pipe->state == SND_PCM_STATE_XRUN) return -EPIPE;
+    if (pipe->state != SND_PCM_STATE_PREPARED && pipe->state != SND_PCM_STATE_RUNNING) {
+        return -EBADFD;
+    }
+
+    snd_pcm_uframes_t framesWritten = 0;
+    while (framesWritten < frameCount) {
+        snd_pcm_uframes_t count = _getPipeAvail(pipe);
+        if (count > frameCount - framesWritten) count = frameCount - framesWritten;
+        count = _queueBytes(
+            pipe, frames + framesWritten * pipe->frameSize, count * pipe->frameSize,
+            isReferenced
+        ) / pipe->frameSize;
+        if (count == 0) {
+            // An output that waits for its start never frees room.
+            if (pipe->state != SND_PCM_STATE_RUNNING) break;
+            _waitForRoom(pipe);
+            if (pipe->error) {
+                return framesWritten > 0 ? (snd_pcm_sframes_t)framesWritten : pipe->error;
+            }
+            continue;
+        }
+        framesWritten += count;
+        pipe->preparedFrames += count;
+        if (
+            pipe->state == SND_PCM_STATE_PREPARED
+            && pipe->preparedFrames >= pipe->startThreshold
+        ) {
+            _startPipe(pipe);
+        }
+        if (!pipe->isPaced) _updatePipe(pipe);
+    }
+    pipe->wroteSinceSleep = true;
+    return framesWritten;
+}
+
+snd_pcm_sframes_t _pipeWrite(
+    Backend *backend, const void *frames, snd_pcm_uframes_t frameCount
+) {
+    return _writePipe((PipeBackend*)backend, (const uint8_t*)frames, frameCount, false);
+}
+
+snd_pcm_sframes_t _pipeWriteStable(
+    Backend *backend, const void *frames, snd_pcm_uframes_t frameCount
+) {
+    return _writePipe((PipeBackend*)backend, (const uint8_t*)frames, frameCount, true);
+}
+
+int _pipeStart(Backend *backend) {
+    PipeBackend *pipe = (PipeBackend*)backend;
+    if (pipe->state != SND_PCM_STATE_PREPARED) return -EBADFD;
+    _startPipe(pipe);
+    return 0;
+}
+
+int _pipeDrop(Backend *backend) {
+    // The frames that were sent are in the hands of the reader. The rest
+    // of a frame that was sent in part still follows.
+    PipeBackend *pipe = (PipeBackend*)backend;
+    _updatePipe(pipe);
+    size_t partialBytes = pipe->sentBytes % pipe->frameSize;
+    _clearQueue(pipe, partialBytes > 0 ? pipe->frameSize - partialBytes : 0);
+    pipe->state = SND_PCM_STATE_SETUP;
+    return 0;
+}
+
+int _pipePrepare(Backend *backend) {
+    PipeBackend *pipe = (PipeBackend*)backend;
+    pipe->state = SND_PCM_STATE_PREPARED;
+    pipe->preparedFrames = 0;
+    return 0;
+}
+
+void _pipeGetTime(Backend *backend, struct timespec *time) {
+    clock_gettime(CLOCK_MONOTONIC, time);
+}
+
+void _pipeSleep(Backend *backend, uint32_t microseconds) {
+    // A free running output returns as soon as the target took enough to
+    // refill half of the queue, so it runs as fast as the reader. Without
+    // writes in between it sleeps as usual, e.g. while paused.
+    PipeBackend *pipe = (PipeBackend*)backend;
+    if (pipe->isPaced || !pipe->wroteSinceSleep || pipe->state != SND_PCM_STATE_RUNNING) {
+        pipe->wroteSinceSleep = false;
+        usleep(microseconds);
+        return;
+    }
+    pipe->wroteSinceSleep = false;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t timeout = (uint64_t)microseconds * NANOSECONDS_PER_MICROSECOND;
+    while (true) {
+        _updatePipe(pipe);
+        if (pipe->error || _getPipeAvail(pipe) > pipe->bufferSize / 2) return;
+        uint64_t elapsed = _getPipeNanosecondsSince(&start);
+        if (elapsed >= timeout) return;
+        struct pollfd target = { .fd = pipe->fileDescriptor, .events = POLLOUT };
+        poll(
+            &target, 1,
+            (timeout - elapsed + NANOSECONDS_PER_MILLISECOND - 1) / NANOSECONDS_PER_MILLISECOND
+        );
+    }
+}
+
+void _pipeWake(Backend *backend) {
+}
+
+void _pipeClose(Backend *backend) {
+    // Queued frames are discarded, the reader sees the end of the stream.
+    PipeBackend *pipe = (PipeBackend*)backend;
+    close(pipe->fileDescriptor);
+    free(pipe->copies);
+    free(pipe);
+}
+
+static const BackendOperations pipeOperations = {
+    .configure = _pipeConfigure,
+    .setManualStart = _pipeSetManualStart,
+    .getCard = _pipeGetCard,
+    .link = _pipeLink,
+    .status = _pipeStatus,
+    .avail = _pipeAvail,
+    .delay = _pipeDelay,
+    .state = _pipeState,
+    .write = _pipeWrite,
+    .writeStable = _pipeWriteStable,
+    .start = _pipeStart,
+    .drop = _pipeDrop,
+    .prepare = _pipePrepare,
+    .getTime = _pipeGetTime,
+    .sleep = _pipeSleep,
+    .wake = _pipeWake,
+    .close = _pipeClose
+};
+
+bool pipeMatchesName(const char *deviceName) {
+    return strncmp(deviceName, PIPE_DEVICE_NAME, PIPE_DEVICE_NAME_SIZE) == 0
+        || strncmp(deviceName, FREE_PIPE_DEVICE_NAME, FREE_PIPE_DEVICE_NAME_SIZE) == 0;
+}
+
+int _openPipeTarget(const char *target, enum PipeTargetType *targetType) {
+    // Returns a non-blocking file descriptor of the output's own or a
+    // negative error number. A pipe given by number is opened again through
+    // /proc, so the owner's file descriptor stays blocking.
+    int fileDescriptor;
+    char *end;
+    long number = strtol(target, &end, 10);
+    bool isNumber = *target >= '0' && *target <= '9' && *end == '\0';
+    if (isNumber) {
+        if (number > INT32_MAX) return -EBADF;
+        fileDescriptor = fcntl((int)number, F_DUPFD_CLOEXEC, 0);
+    } else {
+        fileDescriptor = open(target, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    }
+    if (fileDescriptor == -1) return -errno;
+
+    struct stat stats;
+    if (fstat(fileDescriptor, &stats) == -1) {
+        int error = -errno;
+        close(fileDescriptor);
+        return error;
+    }
+    *targetType = S_ISFIFO(stats.st_mode) ? PIPE_TARGET_PIPE
+        : S_ISSOCK(stats.st_mode) ? PIPE_TARGET_SOCKET
+        : PIPE_TARGET_FILE;
+    if (*targetType == PIPE_TARGET_PIPE) {
+        if (isNumber) {
+            char path[FILE_DESCRIPTOR_PATH_SIZE];
+            snprintf(path, sizeof(path), "/proc/self/fd/%d", fileDescriptor);
+            int reopened = open(path, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+            if (reopened == -1) {
+                int error = -errno;
+                close(fileDescriptor);
+                return error;
+            }
+            close(fileDescriptor);
+            fileDescriptor = reopened;
+        } else {
+            fcntl(fileDescriptor, F_SETFL, fcntl(fileDescriptor, F_GETFL) | O_NONBLOCK);
+        }
+    }
+    return fileDescriptor;
+}
+
+int pipeOpen(Backend **backend, const char *deviceName) {
+    *backend = NULL;
+    bool isPaced = strncmp(deviceName, PIPE_DEVICE_NAME, PIPE_DEVICE_NAME_SIZE) == 0;
+    const char *target = deviceName
+        + (isPaced ? PIPE_DEVICE_NAME_SIZE : FREE_PIPE_DEVICE_NAME_SIZE);
+    if (*target == '\0') return -EINVAL;
+
+    PipeBackend *pipe = (PipeBackend*)calloc(1, sizeof(PipeBackend));
+    if (pipe == NULL) return -ENOMEM;
+    pipe->fileDescriptor = _openPipeTarget(target, &pipe->targetType);
+    if (pipe->fileDescriptor < 0) {
+        int error = pipe->fileDescriptor;
+        free(pipe);
+        return error;
+    }
+    pipe->backend.operations = &pipeOperations;
+    pipe->backend.type = BACKEND_TYPE_PIPE;
+    pipe->state = SND_PCM_STATE_OPEN;
+    pipe->isPaced = isPaced;
+    atomic_init(&pipe->queuedBytes, 0);
+    *backend = &pipe->backend;
+    return 0;
+}
+
+uint64_t pipeGetBacklog(Backend *backend) {
+    // The target's own buffer counts as well: FIONREAD reads the bytes in a
+    // pipe from either end, SIOCOUTQ the bytes a socket's peer did not read.
+    PipeBackend *pipe = (PipeBackend*)backend;
+    if (pipe->frameSize == 0) return 0;
+    uint64_t bytes = _getQueuedBytes(pipe);
+    int targetBytes = 0;
+    if (pipe->targetType == PIPE_TARGET_PIPE) {
+        if (ioctl(pipe->fileDescriptor, FIONREAD, &targetBytes) == 0) bytes += targetBytes;
+    } else if (pipe->targetType == PIPE_TARGET_SOCKET) {
+        if (ioctl(pipe->fileDescriptor, SIOCOUTQ, &targetBytes) == 0) bytes += targetBytes;
+    }
+    return bytes / pipe->frameSize * MICROSECONDS_PER_SECOND / pipe->sampleRate;
+}
@@ -0,0 +1,46 @@
+#ifndef __PIPE_H__
+#define __PIPE_H__
+
+#include "backend.h"
+
+/**
+ * Returns whether a sound device name is one of a pipe output.
+ *
+ * @param deviceName "pipe:TARGET" or "pipe-free:TARGET" for a pipe output.
+*/
+bool pipeMatchesName(const char *deviceName);
+/**
+ * Opens a pipe output.
+ *
+ * A pipe output streams the raw interleaved frames to a pipe, a FIFO, a
+ * socket or a file, where another process reads them. It behaves like a
+ * blocking ALSA pcm whose buffer is a queue in front of the target.
+ *
+ * "pipe:TARGET" hands the frames to the target in real time, as a sound
+ * card would play them. Its buffer runs out of frames like an ALSA buffer
+ * if nothing is written in time. "pipe-free:TARGET" hands them over as
+ * fast as the reader takes them. A reader that does not keep up fills the
+ * queue, which stops the writer until there is room again.
+ *
+ * Frames written with backendWriteStable() are queued by reference and
+ * moved into a pipe or FIFO with vmsplice(), so they are not copied.
+ *
+ * @param backend The output, NULL if it could not be opened.
+ * @param deviceName The name. TARGET is the number of an open file
+ * descriptor, which is duplicated, or a path that is opened for writing.
+ * Opening a FIFO waits until it has a reader.
+ * @return 0 or a negative error number.
+*/
+int pipeOpen(Backend **backend, const char *deviceName);
+/**
+ * Returns how far the reader of a pipe output is behind the writer, which
+ * is the time the frames queued in the output and in the target last.
+ *
+ * Any thread may call this.
+ *
+ * @param backend The output.
+ * @return The time in microseconds.
+*/
+uint64_t pipeGetBacklog(Backend *backend);
+
+#endif // __PIPE_H__
@@ -0,0 +1,225 @@
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NANOSECONDS_PER_SECOND (1000000000ull)
+#define NANOSECONDS_PER_MILLISECOND (1000000ull)
+
+/**
+ * @brief An idle output and what it was configured for.
+*/
+typedef struct PoolEntry PoolEntry;
+struct PoolEntry {
+    Backend *backend;  /* The open and prepared output */
+    char *deviceName;  /* The name of the sound device */
+    BackendParameters parameters;  /* The parameters, channelMap points to the copy behind the entry */
+    uint64_t returnTime;  /* When it was returned in nanoseconds on CLOCK_MONOTONIC */
+    PoolEntry *next;  /* The entry returned before it */
+};
+
+/**
+ * @brief The idle outputs of the process, the most recently returned first.
+*/
+typedef struct {
+    pthread_mutex_t lock;  /* Protects the entries, the limits and isReaping */
+    pthread_cond_t changed;  /* Signalled when the limits change, waits on CLOCK_MONOTONIC */
+    pthread_once_t changedOnce;  /* Initializes changed */
+    PoolEntry *entries;  /* The idle outputs */
+    uint32_t entryCount;  /* The amount of idle outputs */
+    uint32_t maxOutputs;  /* How many idle outputs are kept */
+    uint64_t idleNanoseconds;  /* How long an idle output is kept */
+    bool isReaping;  /* Whether a thread closes the idle outputs when they expire */
+} OutputPool;
+
+static OutputPool outputPool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .changedOnce = PTHREAD_ONCE_INIT
+};
+
+uint64_t _poolGetTime(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * NANOSECONDS_PER_SECOND + time.tv_nsec;
+}
+
+void _poolCloseEntries(PoolEntry *entry) {
+    while (entry != NULL) {
+        PoolEntry *next = entry->next;
+        backendClose(entry->backend);
+        free(entry->deviceName);
+        free(entry);
+        entry = next;
+    }
+}
+
+bool _poolMatches(
+    const PoolEntry *entry, const char *deviceName,
+    const BackendParameters *parameters
+) {
+    const BackendParameters *pooled = &entry->parameters;
+    return pooled->format == parameters->format
+        && pooled->sampleRate == parameters->sampleRate
+        && pooled->bufferSize == parameters->bufferSize
+        && pooled->channelAmount == parameters->channelAmount
+        && pooled->channelMap->channels == parameters->channelMap->channels
+        && !memcmp(
+            pooled->channelMap->pos, parameters->channelMap->pos,
+            parameters->channelMap->channels * sizeof(unsigned int)
+        )
+        && !strcmp(entry->deviceName, deviceName);
+}
+
+PoolEntry * _poolTrim(uint64_t now) {
+    // Called with the lock held. Entries are sorted by their return time,
+    // so everything behind the first expired or surplus one goes. The
+    // caller closes the returned entries after unlocking.
+    PoolEntry **link = &outputPool.entries;
+    uint32_t count = 0;
+    while (
+        *link != NULL && count < outputPool.maxOutputs
+        && now - (*link)->returnTime < outputPool.idleNanoseconds
+    ) {
+        link = &(*link)->next;
+        ++count;
+    }
+    PoolEntry *expired = *link;
+    *link = NULL;
+    outputPool.entryCount = count;
+    return expired;
+}
+
+void _poolInitChanged(void) {
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&outputPool.changed, &attributes);
+    pthread_condattr_destroy(&attributes);
+}
+
+void * _poolReapLoop(void *unused) {
+    // Sleeps until the oldest entry expires or the limits change and
+    // closes what expired, so idle outputs do not block their devices
+    // in a process that stopped using the pool. It ends with the last
+    // entry and is started again by the next one.
+    pthread_mutex_lock(&outputPool.lock);
+    while (true) {
+        PoolEntry *expired = _poolTrim(_poolGetTime());
+        if (expired != NULL) {
+            pthread_mutex_unlock(&outputPool.lock);
+            _poolCloseEntries(expired);
+            pthread_mutex_lock(&outputPool.lock);
+            continue;
+        }
+        if (outputPool.entries == NULL) break;
+        PoolEntry *oldest = outputPool.entries;
+        while (oldest->next != NULL) oldest = oldest->next;
+        uint64_t deadline = oldest->returnTime + outputPool.idleNanoseconds;
+        struct timespec time = {
+            .tv_sec = deadline / NANOSECONDS_PER_SECOND,
+            .tv_nsec = deadline % NANOSECONDS_PER_SECOND
+        };
+        pthread_cond_timedwait(&outputPool.changed, &outputPool.lock, &time);
+    }
+    outputPool.isReaping = false;
+    pthread_mutex_unlock(&outputPool.lock);
+    return NULL;
+}
+
+void _poolStartReaper(void) {
+    // Called with the lock held. Without the thread expired outputs are
+    // still closed whenever the pool is used.
+    if (outputPool.isReaping || outputPool.entries == NULL) return;
+    pthread_once(&outputPool.changedOnce, _poolInitChanged);
+    pthread_attr_t attributes;
+    pthread_t thread;
+    if (pthread_attr_init(&attributes)) return;
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    outputPool.isReaping = !pthread_create(&thread, &attributes, _poolReapLoop, NULL);
+    pthread_attr_destroy(&attributes);
+}
+
+void poolSetLimits(uint32_t maxOutputs, uint32_t idleMilliseconds) {
+    pthread_mutex_lock(&outputPool.lock);
+    outputPool.maxOutputs = maxOutputs;
+    outputPool.idleNanoseconds = idleMilliseconds * NANOSECONDS_PER_MILLISECOND;
+    PoolEntry *expired = _poolTrim(_poolGetTime());
+    if (outputPool.isReaping) pthread_cond_signal(&outputPool.changed);
+    pthread_mutex_unlock(&outputPool.lock);
+    _poolCloseEntries(expired);
+}
+
+uint32_t poolGetIdleCount(void) {
+    pthread_mutex_lock(&outputPool.lock);
+    PoolEntry *expired = _poolTrim(_poolGetTime());
+    uint32_t count = outputPool.entryCount;
+    pthread_mutex_unlock(&outputPool.lock);
+    _poolCloseEntries(expired);
+    return count;
+}
+
+Backend * poolCheckOut(const char *deviceName, const BackendParameters *parameters) {
+    // Only ALSA pcms are pooled, so there is nothing to look for otherwise.
+    if (backendGetType(deviceName) != BACKEND_TYPE_ALSA) return NULL;
+    pthread_mutex_lock(&outputPool.lock);
+    PoolEntry *expired = _poolTrim(_poolGetTime());
+    PoolEntry **link = &outputPool.entries;
+    while (*link != NULL && !_poolMatches(*link, deviceName, parameters)) {
+        link = &(*link)->next;
+    }
+    PoolEntry *entry = *link;
+    if (entry != NULL) {
+        *link = entry->next;
+        --outputPool.entryCount;
+    }
+    pthread_mutex_unlock(&outputPool.lock);
+    _poolCloseEntries(expired);
+    if (entry == NULL) return NULL;
+
+    Backend *backend = entry->backend;
+    free(entry->deviceName);
+    free(entry);
+    return backend;
+}
+
+bool poolCheckIn(
+    Backend *backend, const char *deviceName, const BackendParameters *parameters
+) {
+    if (backend->type != BACKEND_TYPE_ALSA) return false;
+    pthread_mutex_lock(&outputPool.lock);
+    bool isEnabled = outputPool.maxOutputs > 0;
+    pthread_mutex_unlock(&outputPool.lock);
+    if (!isEnabled) return false;
+
+    // The output is stopped and prepared, so the next owner writes at once.
+    size_t channelMapSize = sizeof(snd_pcm_chmap_t)
+        + parameters->channelMap->channels * sizeof(unsigned int);
+    PoolEntry *entry = (PoolEntry*)malloc(sizeof(PoolEntry) + channelMapSize);
+    if (entry == NULL) return false;
+    entry->deviceName = strdup(deviceName);
+    if (
+        entry->deviceName == NULL
+        || backendDrop(backend) < 0 || backendPrepare(backend) < 0
+    ) {
+        free(entry->deviceName);
+        free(entry);
+        return false;
+    }
+    snd_pcm_chmap_t *channelMap = (snd_pcm_chmap_t*)(entry + 1);
+    memcpy(channelMap, parameters->channelMap, channelMapSize);
+    entry->backend = backend;
+    entry->parameters = *parameters;
+    entry->parameters.channelMap = channelMap;
+
+    pthread_mutex_lock(&outputPool.lock);
+    entry->returnTime = _poolGetTime();
+    entry->next = outputPool.entries;
+    outputPool.entries = entry;
+    ++outputPool.entryCount;
+    PoolEntry *expired = _poolTrim(entry->returnTime);
+    _poolStartReaper();
+    pthread_mutex_unlock(&outputPool.lock);
+    _poolCloseEntries(expired);
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include "backend.h"
+
+/**
+ * Sets the limits of the pool of configured ALSA outputs.
+ *
+ * Outputs returned to the pool stay open and configured, so the next
+ * output with the same device name and parameters is checked out without
+ * opening and configuring it again. Any thread may call this. Outputs
+ * beyond the new limits are closed. While outputs are idle a thread closes
+ * each one when its idle time runs out.
+ *
+ * @param maxOutputs How many idle outputs are kept, 0 to close all and
+ * keep none.
+ * @param idleMilliseconds How long an idle output is kept, 0 closes every
+ * output as soon as it is returned, which keeps none like maxOutputs 0.
+*/
+void poolSetLimits(uint32_t maxOutputs, uint32_t idleMilliseconds);
+/**
+ * Returns the amount of idle outputs after closing the expired ones.
+*/
+uint32_t poolGetIdleCount(void);
+/**
+ * Takes an idle output of the pool that was configured with the same
+ * parameters for the same device.
+ *
+ * @param deviceName The name of the sound device.
+ * @param parameters The parameters the output must be configured with.
+ * @return The output or NULL if there is none.
+*/
+Backend * poolCheckOut(const char *deviceName, const BackendParameters *parameters);
+/**
+ * Stops an output and keeps it in the pool if it is an ALSA pcm and
+ * there is room.
+ *
+ * @param backend The output, which must not be linked or started manually.
+ * @param deviceName The name of the sound device.
+ * @param parameters The parameters the output was configured with.
+ * @return Whether the pool took the output, otherwise the caller closes it.
+*/
+bool poolCheckIn(
+    Backend *backend, const char *deviceName, const BackendParameters *parameters
+);
+
+#endif // __POOL_H__
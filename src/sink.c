@@ -0,0 +1,645 @@
+#include "sink.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MEMORY_DEVICE_NAME ("memory")
+#define MEMORY_DEVICE_NAME_SIZE (6)
+#define RENDER_DEVICE_NAME ("render:")
+#define RENDER_DEVICE_NAME_SIZE (7)
+#define NANOSECONDS_PER_SECOND (1000000000ull)
+#define NANOSECONDS_PER_MICROSECOND (1000ull)
+#define BITS_PER_BYTE (8)
+#define CAPTURE_BUFFER_FRAMES (65536)
+#define WAVE_FORMAT_PCM (0x0001)
+#define WAVE_FORMAT_IEEE_FLOAT (0x0003)
+#define WAVE_FORMAT_ALAW (0x0006)
+#define WAVE_FORMAT_MULAW (0x0007)
+#define FMT_SIZE_PCM (16)
+#define FMT_SIZE_NON_PCM (18)
+#define FACT_SIZE (4)
+#define CHUNK_HEADER_SIZE (8)
+#define WAVE_MAGIC_SIZE (4)
+
+/**
+ * @brief The virtual clock shared by the sinks of one audio object.
+ *
+ * A stepped clock runs as fast as the CPU allows but never beyond its
+ * limit. The thread that advances it beyond the limit is parked until the
+ * limit is raised or it is woken.
+*/
+typedef struct {
+    _Atomic uint64_t nanoseconds;  /* The virtual time */
+    _Atomic uint32_t references;  /* The sinks that use the clock */
+    bool isStepped;  /* Whether it only advances up to the limit */
+    bool isParked;  /* Whether a thread waits for the limit */
+    bool isWoken;  /* Whether the next advance may go beyond the limit */
+    uint8_t __align[1];
+    double speed;  /* How much faster than real time the clock runs */
+    uint64_t limit;  /* How far a stepped clock may advance */
+    uint64_t parkedTarget;  /* Where the parked thread wants to advance to */
+    pthread_mutex_t lock;  /* Guards the limit and the parked thread */
+    pthread_cond_t changed;  /* Signals that the limit or the parked thread changed */
+} SinkClock;
+
+/**
+ * @brief The WAV file the played frames of a render sink go to.
+*/
+typedef struct {
+    int fileDescriptor;  /* The file, -1 if nothing is captured */
+    int error;  /* The first error writing the file, 0 if none */
+    uint8_t *buffer;  /* Frames waiting to be written */
+    size_t bufferUsed;  /* The bytes waiting in the buffer */
+    size_t headerSize;  /* The size of the header in front of the frames */
+    uint64_t dataSize;  /* The bytes of frames in the file */
+    uint64_t position;  /* The frames in the file */
+    uint64_t capturedFrames;  /* The played frames in the file since the sink was prepared */
+} SinkCapture;
+
+/**
+ * @brief A memory sink.
+ *
+ * The frames go into a ring buffer like the buffer of a sound card.
+ * Played frames are derived from the virtual time since the sink started.
+*/
+typedef struct {
+    Backend backend;  /* The operations */
+    SinkClock *clock;  /* The clock that plays the frames */
+    uint8_t *buffer;  /* The ring buffer */
+    size_t frameSize;  /* The size of one frame in bytes */
+    uint32_t sampleRate;  /* The frames played per virtual second */
+    snd_pcm_state_t state;  /* Whether it is prepared, running or ran out of frames */
+    snd_pcm_uframes_t bufferSize;  /* The size of the ring buffer in frames */
+    uint64_t writtenFrames;  /* The frames written since it was prepared */
+    uint64_t playedFrames;  /* The frames played since it was prepared */
+    uint64_t startFrames;  /* The frames played when it started */
+    uint64_t startNanoseconds;  /* The virtual time it started at */
+    uint64_t startThreshold;  /* The written frames it starts with by itself */
+    _Atomic uint32_t writeDelay;  /* How long every write takes in microseconds */
+    snd_pcm_format_t format;  /* The sample format */
+    uint16_t channelAmount;  /* The amount of interleaved channels */
+    uint8_t __align[6];
+    SinkCapture capture;  /* Where the played frames go */
+} MemorySink;
+
+void _advanceSteppedClock(SinkClock *clock, uint64_t nanoseconds) {
+    // An advance beyond the limit waits for the limit to be raised or for
+    // a wakeup, which lets exactly this advance through.
+    pthread_mutex_lock(&clock->lock);
+    uint64_t target = atomic_load_explicit(&clock->nanoseconds, memory_order_relaxed)
+        + nanoseconds;
+    if (target > clock->limit) {
+        while (target > clock->limit && !clock->isWoken) {
+            clock->isParked = true;
+            clock->parkedTarget = target;
+            pthread_cond_broadcast(&clock->changed);
+            pthread_cond_wait(&clock->changed, &clock->lock);
+        }
+        clock->isParked = false;
+        clock->isWoken = false;
+    }
+    atomic_store_explicit(&clock->nanoseconds, target, memory_order_relaxed);
+    pthread_mutex_unlock(&clock->lock);
+}
+
+void _advanceClock(SinkClock *clock, uint64_t nanoseconds) {
+    // The real time passes speed times faster.
+    if (clock->isStepped) {
+        _advanceSteppedClock(clock, nanoseconds);
+        return;
+    }
+    atomic_fetch_add_explicit(&clock->nanoseconds, nanoseconds, memory_order_relaxed);
+    uint64_t realNanoseconds = nanoseconds / clock->speed;
+    struct timespec time = {
+        .tv_sec = realNanoseconds / NANOSECONDS_PER_SECOND,
+        .tv_nsec = realNanoseconds % NANOSECONDS_PER_SECOND
+    };
+    while (nanosleep(&time, &time) == -1 && errno == EINTR);
+}
+
+uint64_t _getFramesUntil(uint64_t nanoseconds, uint32_t sampleRate) {
+    return (unsigned __int128)nanoseconds * sampleRate / NANOSECONDS_PER_SECOND;
+}
+
+void _flushCapture(SinkCapture *capture) {
+    // The first error stops the capture.
+    size_t written = 0;
+    while (written < capture->bufferUsed) {
+        ssize_t result = write(
+            capture->fileDescriptor, capture->buffer + written,
+            capture->bufferUsed - written
+        );
+        if (result < 0 && errno == EINTR) continue;
+        if (result <= 0) {
+            capture->error = result < 0 ? -errno : -EIO;
+            close(capture->fileDescriptor);
+            capture->fileDescriptor = -1;
+            break;
+        }
+        written += result;
+    }
+    capture->bufferUsed = 0;
+}
+
+void _captureBytes(MemorySink *sink, const uint8_t *bytes, uint64_t size) {
+    SinkCapture *capture = &sink->capture;
+    size_t bufferSize = CAPTURE_BUFFER_FRAMES * sink->frameSize;
+    while (size > 0 && capture->fileDescriptor != -1) {
+        size_t count = bufferSize - capture->bufferUsed < size
+            ? bufferSize - capture->bufferUsed
+            : size;
+        if (bytes != NULL) {
+            memcpy(capture->buffer + capture->bufferUsed, bytes, count);
+            bytes += count;
+        } else {
+            snd_pcm_format_set_silence(
+                sink->format, capture->buffer + capture->bufferUsed,
+                count / sink->frameSize * sink->channelAmount
+            );
+        }
+        capture->bufferUsed += count;
+        capture->dataSize += count;
+        size -= count;
+        if (capture->bufferUsed == bufferSize) _flushCapture(capture);
+    }
+}
+
+void _captureSilence(MemorySink *sink, uint64_t position) {
+    // The device plays silence while it does not run.
+    SinkCapture *capture = &sink->capture;
+    if (capture->fileDescriptor == -1 || position <= capture->position) return;
+    _captureBytes(sink, NULL, (position - capture->position) * sink->frameSize);
+    capture->position = position;
+}
+
+void _capturePlayedFrames(MemorySink *sink) {
+    // Played frames stay in the ring buffer until the next write.
+    SinkCapture *capture = &sink->capture;
+    if (capture->fileDescriptor == -1) return;
+    while (capture->capturedFrames < sink->playedFrames) {
+        snd_pcm_uframes_t start = capture->capturedFrames % sink->bufferSize;
+        uint64_t count = sink->playedFrames - capture->capturedFrames;
+        if (count > sink->bufferSize - start) count = sink->bufferSize - start;
+        _captureBytes(sink, sink->buffer + start * sink->frameSize, count * sink->frameSize);
+        capture->capturedFrames += count;
+        capture->position += count;
+    }
+}
+
+void _updateSink(MemorySink *sink) {
+    // The sink runs out of frames when it played everything written.
+    if (sink->state != SND_PCM_STATE_RUNNING) return;
+    uint64_t elapsed = atomic_load_explicit(&sink->clock->nanoseconds, memory_order_relaxed)
+        - sink->startNanoseconds;
+    sink->playedFrames = sink->startFrames + _getFramesUntil(elapsed, sink->sampleRate);
+    if (sink->playedFrames >= sink->writtenFrames) {
+        sink->playedFrames = sink->writtenFrames;
+        sink->state = SND_PCM_STATE_XRUN;
+    }
+    _capturePlayedFrames(sink);
+}
+
+void _startSink(MemorySink *sink) {
+    sink->state = SND_PCM_STATE_RUNNING;
+    sink->startFrames = sink->playedFrames;
+    sink->startNanoseconds = atomic_load_explicit(
+        &sink->clock->nanoseconds, memory_order_relaxed
+    );
+    _captureSilence(sink, _getFramesUntil(sink->startNanoseconds, sink->sampleRate));
+}
+
+void _resetSink(MemorySink *sink, snd_pcm_state_t state) {
+    sink->state = state;
+    sink->writtenFrames = 0;
+    sink->playedFrames = 0;
+    sink->capture.capturedFrames = 0;
+}
+
+void _putField(uint8_t **field, const void *value, size_t size) {
+    memcpy(*field, value, size);
+    *field += size;
+}
+
+void _writeCaptureHeader(MemorySink *sink, uint8_t *header) {
+    // Formats other than integer PCM have a longer fmt chunk and a fact
+    // chunk. The sizes are those of the frames captured so far.
+    uint16_t audioFormat = WAVE_FORMAT_PCM;
+    switch (sink->format) {
+        case SND_PCM_FORMAT_FLOAT_LE:
+        case SND_PCM_FORMAT_FLOAT64_LE: audioFormat = WAVE_FORMAT_IEEE_FLOAT; break;
+        case SND_PCM_FORMAT_A_LAW: audioFormat = WAVE_FORMAT_ALAW; break;
+        case SND_PCM_FORMAT_MU_LAW: audioFormat = WAVE_FORMAT_MULAW; break;
+        default: break;
+    }
+    SinkCapture *capture = &sink->capture;
+    uint32_t fmtSize = audioFormat == WAVE_FORMAT_PCM ? FMT_SIZE_PCM : FMT_SIZE_NON_PCM;
+    uint32_t dataSize = capture->dataSize > UINT32_MAX - capture->headerSize
+        ? UINT32_MAX - capture->headerSize
+        : capture->dataSize;
+    uint32_t riffSize = capture->headerSize - CHUNK_HEADER_SIZE + dataSize;
+    uint32_t samplesPerChannel = dataSize / sink->frameSize;
+    uint16_t bitsPerSample = snd_pcm_format_physical_width(sink->format);
+    uint32_t byteRate = sink->sampleRate * sink->frameSize;
+    uint16_t blockAlign = sink->frameSize;
+    uint16_t extraSize = 0;
+    uint32_t factSize = FACT_SIZE;
+
+    uint8_t *field = header;
+    _putField(&field, "RIFF", WAVE_MAGIC_SIZE);
+    _putField(&field, &riffSize, sizeof(riffSize));
+    _putField(&field, "WAVE", WAVE_MAGIC_SIZE);
+    _putField(&field, "fmt ", WAVE_MAGIC_SIZE);
+    _putField(&field, &fmtSize, sizeof(fmtSize));
+    _putField(&field, &audioFormat, sizeof(audioFormat));
+    _putField(&field, &sink->channelAmount, sizeof(sink->channelAmount));
+    _putField(&field, &sink->sampleRate, sizeof(sink->sampleRate));
+    _putField(&field, &byteRate, sizeof(byteRate));
+    _putField(&field, &blockAlign, sizeof(blockAlign));
+    _putField(&field, &bitsPerSample, sizeof(bitsPerSample));
+    if (audioFormat != WAVE_FORMAT_PCM) {
+        _putField(&field, &extraSize, sizeof(extraSize));
+        _putField(&field, "fact", WAVE_MAGIC_SIZE);
+        _putField(&field, &factSize, sizeof(factSize));
+        _putField(&field, &samplesPerChannel, sizeof(samplesPerChannel));
+    }
+    _putField(&field, "data", WAVE_MAGIC_SIZE);
+    _putField(&field, &dataSize, sizeof(dataSize));
+}
+
+size_t _getCaptureHeaderSize(snd_pcm_format_t format) {
+    bool isPcm = format != SND_PCM_FORMAT_FLOAT_LE && format != SND_PCM_FORMAT_FLOAT64_LE
+        && format != SND_PCM_FORMAT_A_LAW && format != SND_PCM_FORMAT_MU_LAW;
+    return CHUNK_HEADER_SIZE + WAVE_MAGIC_SIZE + CHUNK_HEADER_SIZE
+        + (isPcm ? FMT_SIZE_PCM : FMT_SIZE_NON_PCM + CHUNK_HEADER_SIZE + FACT_SIZE)
+        + CHUNK_HEADER_SIZE;
+}
+
+int _sinkConfigure(Backend *backend, const BackendParameters *parameters) {
+    MemorySink *sink = (MemorySink*)backend;
+    size_t frameSize = (size_t)parameters->channelAmount
+        * snd_pcm_format_physical_width(parameters->format) / BITS_PER_BYTE;
+    if (frameSize == 0 || parameters->sampleRate == 0 || parameters->bufferSize < 2) {
+        return -EINVAL;
+    }
+    uint8_t *buffer = (uint8_t*)realloc(sink->buffer, parameters->bufferSize * frameSize);
+    if (buffer == NULL) return -ENOMEM;
+    sink->buffer = buffer;
+    sink->frameSize = frameSize;
+    sink->sampleRate = parameters->sampleRate;
+    sink->bufferSize = parameters->bufferSize;
+    sink->format = parameters->format;
+    sink->channelAmount = parameters->channelAmount;
+    sink->startThreshold = 1;
+    _resetSink(sink, SND_PCM_STATE_PREPARED);
+
+    // The header is written again with the sizes when the capture ends.
+    // Writing it first keeps the buffered frames whole.
+    SinkCapture *capture = &sink->capture;
+    if (capture->fileDescriptor != -1 && capture->buffer == NULL) {
+        capture->buffer = (uint8_t*)malloc(CAPTURE_BUFFER_FRAMES * frameSize);
+        if (capture->buffer == NULL) return -ENOMEM;
+        capture->headerSize = _getCaptureHeaderSize(sink->format);
+        capture->bufferUsed = capture->headerSize;
+        _writeCaptureHeader(sink, capture->buffer);
+        _flushCapture(capture);
+    }
+    return 0;
+}
+
+int _sinkSetManualStart(Backend *backend) {
+    ((MemorySink*)backend)->startThreshold = UINT64_MAX;
+    return 0;
+}
+
+int _sinkGetCard(Backend *backend) {
+    return -1;
+}
+
+int _sinkLink(Backend *backend, Backend *other) {
+    return -ENOSYS;
+}
+
+int _sinkStatus(Backend *backend, BackendStatus *status) {
+    MemorySink *sink = (MemorySink*)backend;
+    _updateSink(sink);
+    status->delay = sink->writtenFrames - sink->playedFrames;
+    status->avail = sink->bufferSize - status->delay;
+    status->state = sink->state;
+    return 0;
+}
+
+snd_pcm_sframes_t _sinkAvail(Backend *backend) {
+    MemorySink *sink = (MemorySink*)backend;
+    _updateSink(sink);
+    if (sink->state == SND_PCM_STATE_XRUN) return -EPIPE;
+    return sink->bufferSize - (sink->writtenFrames - sink->playedFrames);
+}
+
+int _sinkDelay(Backend *backend, snd_pcm_sframes_t *delay) {
+    MemorySink *sink = (MemorySink*)backend;
+    _updateSink(sink);
+    if (sink->state == SND_PCM_STATE_XRUN) return -EPIPE;
+    *delay = sink->writtenFrames - sink->playedFrames;
+    return 0;
+}
+
+snd_pcm_state_t _sinkState(Backend *backend) {
+    MemorySink *sink = (MemorySink*)backend;
+    _updateSink(sink);
+    return sink->state;
+}
+
+snd_pcm_sframes_t _sinkWrite(
+    Backend *backend, const void *frames, snd_pcm_uframes_t frameCount
+) {
+    // A slow device takes the delay before the frames land.
+    MemorySink *sink = (MemorySink*)backend;
+    uint32_t writeDelay = atomic_load_explicit(&sink->writeDelay, memory_order_relaxed);
+    if (writeDelay > 0) {
+        _advanceClock(sink->clock, writeDelay * NANOSECONDS_PER_MICROSECOND);
+    }
+    _updateSink(sink);
+    if (sink->state == SND_PCM_STATE_XRUN) return -EPIPE;
+    if (sink->state != SND_PCM_STATE_PREPARED && sink->state != SND_PCM_STATE_RUNNING) {
+        return -EBADFD;
+    }
+
+    const uint8_t *bytes = (const uint8_t*)frames;
+    snd_pcm_uframes_t framesWritten = 0;
+    while (framesWritten < frameCount) {
+        snd_pcm_uframes_t framesAvailable = sink->bufferSize
+            - (sink->writtenFrames - sink->playedFrames);
+        if (framesAvailable == 0) {
+            // A sink that waits for its start never frees room. A running
+            // one blocks until half of the buffer is free.
+            if (sink->state != SND_PCM_STATE_RUNNING) break;
+            uint64_t nanoseconds = ((uint64_t)(sink->bufferSize / 2) * NANOSECONDS_PER_SECOND
+                + sink->sampleRate - 1) / sink->sampleRate;
+            _advanceClock(sink->clock, nanoseconds);
+            _updateSink(sink);
+            continue;
+        }
+        snd_pcm_uframes_t count = frameCount - framesWritten < framesAvailable
+            ? frameCount - framesWritten
+            : framesAvailable;
+        snd_pcm_uframes_t start = sink->writtenFrames % sink->bufferSize;
+        snd_pcm_uframes_t tailCount = sink->bufferSize - start < count
+            ? sink->bufferSize - start
+            : count;
+        memcpy(
+            sink->buffer + start * sink->frameSize,
+            bytes + framesWritten * sink->frameSize, tailCount * sink->frameSize
+        );
+        memcpy(
+            sink->buffer, bytes + (framesWritten + tailCount) * sink->frameSize,
+            (count - tailCount) * sink->frameSize
+        );
+        sink->writtenFrames += count;
+        framesWritten += count;
+        if (
+            sink->state == SND_PCM_STATE_PREPARED
+            && sink->writtenFrames >= sink->startThreshold
+        ) {
+            _startSink(sink);
+        }
+    }
+    return framesWritten;
+}
+
+int _sinkStart(Backend *backend) {
+    MemorySink *sink = (MemorySink*)backend;
+    if (sink->state != SND_PCM_STATE_PREPARED) return -EBADFD;
+    _startSink(sink);
+    return 0;
+}
+
+int _sinkDrop(Backend *backend) {
+    // The frames played until now were heard.
+    MemorySink *sink = (MemorySink*)backend;
+    _updateSink(sink);
+    _resetSink(sink, SND_PCM_STATE_SETUP);
+    return 0;
+}
+
+int _sinkPrepare(Backend *backend) {
+    _resetSink((MemorySink*)backend, SND_PCM_STATE_PREPARED);
+    return 0;
+}
+
+void _sinkGetTime(Backend *backend, struct timespec *time) {
+    uint64_t nanoseconds = atomic_load_explicit(
+        &((MemorySink*)backend)->clock->nanoseconds, memory_order_relaxed
+    );
+    time->tv_sec = nanoseconds / NANOSECONDS_PER_SECOND;
+    time->tv_nsec = nanoseconds % NANOSECONDS_PER_SECOND;
+}
+
+void _sinkSleep(Backend *backend, uint32_t microseconds) {
+    _advanceClock(
+        ((MemorySink*)backend)->clock, microseconds * NANOSECONDS_PER_MICROSECOND
+    );
+}
+
+void _sinkWake(Backend *backend) {
+    SinkClock *clock = ((MemorySink*)backend)->clock;
+    if (!clock->isStepped) return;
+    pthread_mutex_lock(&clock->lock);
+    clock->isWoken = true;
+    pthread_cond_broadcast(&clock->changed);
+    pthread_mutex_unlock(&clock->lock);
+}
+
+int _finishCapture(MemorySink *sink) {
+    // The sizes go into the header in front of the frames.
+    SinkCapture *capture = &sink->capture;
+    if (capture->fileDescriptor != -1 && capture->buffer != NULL) {
+        _flushCapture(capture);
+    }
+    if (capture->fileDescriptor != -1 && capture->buffer != NULL) {
+        uint8_t header[_getCaptureHeaderSize(sink->format)];
+        _writeCaptureHeader(sink, header);
+        if (pwrite(capture->fileDescriptor, header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+            capture->error = -EIO;
+        }
+    }
+    if (capture->fileDescriptor != -1) {
+        if (close(capture->fileDescriptor) != 0 && capture->error == 0) {
+            capture->error = -errno;
+        }
+        capture->fileDescriptor = -1;
+    }
+    free(capture->buffer);
+    capture->buffer = NULL;
+    return capture->error;
+}
+
+void _sinkClose(Backend *backend) {
+    MemorySink *sink = (MemorySink*)backend;
+    _finishCapture(sink);
+    if (atomic_fetch_sub(&sink->clock->references, 1) == 1) {
+        pthread_mutex_destroy(&sink->clock->lock);
+        pthread_cond_destroy(&sink->clock->changed);
+        free(sink->clock);
+    }
+    free(sink->buffer);
+    free(sink);
+}
+
+static const BackendOperations sinkOperations = {
+    .configure = _sinkConfigure,
+    .setManualStart = _sinkSetManualStart,
+    .getCard = _sinkGetCard,
+    .link = _sinkLink,
+    .status = _sinkStatus,
+    .avail = _sinkAvail,
+    .delay = _sinkDelay,
+    .state = _sinkState,
+    .write = _sinkWrite,
+    .start = _sinkStart,
+    .drop = _sinkDrop,
+    .prepare = _sinkPrepare,
+    .getTime = _sinkGetTime,
+    .sleep = _sinkSleep,
+    .wake = _sinkWake,
+    .close = _sinkClose
+};
+
+bool sinkMatchesName(const char *deviceName) {
+    return strncmp(deviceName, RENDER_DEVICE_NAME, RENDER_DEVICE_NAME_SIZE) == 0
+        || (strncmp(deviceName, MEMORY_DEVICE_NAME, MEMORY_DEVICE_NAME_SIZE) == 0
+            && (deviceName[MEMORY_DEVICE_NAME_SIZE] == '\0'
+                || deviceName[MEMORY_DEVICE_NAME_SIZE] == ':'));
+}
+
+SinkClock * _allocClock(double speed, bool isStepped) {
+    SinkClock *clock = (SinkClock*)calloc(1, sizeof(SinkClock));
+    if (clock == NULL) return NULL;
+    if (pthread_mutex_init(&clock->lock, NULL) != 0) {
+        free(clock);
+        return NULL;
+    }
+    if (pthread_cond_init(&clock->changed, NULL) != 0) {
+        pthread_mutex_destroy(&clock->lock);
+        free(clock);
+        return NULL;
+    }
+    atomic_init(&clock->nanoseconds, 0);
+    atomic_init(&clock->references, 1);
+    clock->speed = speed;
+    clock->isStepped = isStepped;
+    // A stepped clock stands still until it is advanced.
+    clock->limit = isStepped ? 0 : UINT64_MAX;
+    return clock;
+}
+
+int sinkOpen(Backend **backend, const char *deviceName, Backend *clockSource) {
+    // "memory:SPEED" plays SPEED times faster than real time, "render:PATH"
+    // as fast as it is stepped and captures to PATH.
+    *backend = NULL;
+    double speed = 1.0;
+    const char *capturePath = NULL;
+    if (strncmp(deviceName, RENDER_DEVICE_NAME, RENDER_DEVICE_NAME_SIZE) == 0) {
+        capturePath = deviceName + RENDER_DEVICE_NAME_SIZE;
+        if (*capturePath == '\0') return -EINVAL;
+    } else if (deviceName[MEMORY_DEVICE_NAME_SIZE] == ':') {
+        const char *arguments = deviceName + MEMORY_DEVICE_NAME_SIZE + 1;
+        char *end;
+        speed = strtod(arguments, &end);
+        if (end == arguments || *end != '\0' || !(speed > 0.0)) return -EINVAL;
+    }
+    if (clockSource != NULL && clockSource->type != BACKEND_TYPE_MEMORY) {
+        return -EINVAL;
+    }
+
+    MemorySink *sink = (MemorySink*)calloc(1, sizeof(MemorySink));
+    if (sink == NULL) return -ENOMEM;
+    sink->capture.fileDescriptor = -1;
+    if (capturePath != NULL) {
+        sink->capture.fileDescriptor = open(
+            capturePath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644
+        );
+        if (sink->capture.fileDescriptor == -1) {
+            int error = -errno;
+            free(sink);
+            return error;
+        }
+    }
+    if (clockSource != NULL) {
+        sink->clock = ((MemorySink*)clockSource)->clock;
+        atomic_fetch_add(&sink->clock->references, 1);
+    } else {
+        sink->clock = _allocClock(speed, capturePath != NULL);
+        if (sink->clock == NULL) {
+            if (sink->capture.fileDescriptor != -1) close(sink->capture.fileDescriptor);
+            free(sink);
+            return -ENOMEM;
+        }
+    }
+    sink->backend.operations = &sinkOperations;
+    sink->backend.type = BACKEND_TYPE_MEMORY;
+    sink->state = SND_PCM_STATE_OPEN;
+    atomic_init(&sink->writeDelay, 0);
+    *backend = &sink->backend;
+    return 0;
+}
+
+void sinkSetWriteDelay(Backend *backend, uint32_t microseconds) {
+    atomic_store_explicit(
+        &((MemorySink*)backend)->writeDelay, microseconds, memory_order_relaxed
+    );
+}
+
+bool sinkIsStepped(Backend *backend) {
+    return backend->type == BACKEND_TYPE_MEMORY && ((MemorySink*)backend)->clock->isStepped;
+}
+
+uint64_t sinkWaitUntilParked(Backend *backend) {
+    SinkClock *clock = ((MemorySink*)backend)->clock;
+    pthread_mutex_lock(&clock->lock);
+    while (!clock->isParked || clock->parkedTarget <= clock->limit) {
+        pthread_cond_wait(&clock->changed, &clock->lock);
+    }
+    uint64_t nanoseconds = atomic_load_explicit(&clock->nanoseconds, memory_order_relaxed);
+    pthread_mutex_unlock(&clock->lock);
+    return nanoseconds;
+}
+
+void sinkAdvanceTo(Backend *backend, uint64_t nanoseconds) {
+    // The parked thread wants to go beyond the new limit, so the clock
+    // stands exactly at it.
+    SinkClock *clock = ((MemorySink*)backend)->clock;
+    pthread_mutex_lock(&clock->lock);
+    if (nanoseconds > clock->limit) {
+        clock->limit = nanoseconds;
+        pthread_cond_broadcast(&clock->changed);
+    }
+    while (!clock->isParked || clock->parkedTarget <= clock->limit) {
+        pthread_cond_wait(&clock->changed, &clock->lock);
+    }
+    if (atomic_load_explicit(&clock->nanoseconds, memory_order_relaxed) < clock->limit) {
+        atomic_store_explicit(&clock->nanoseconds, clock->limit, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&clock->lock);
+}
+
+int sinkFinishCapture(Backend *backend) {
+    // Only called while the thread that plays the sink is parked.
+    MemorySink *sink = (MemorySink*)backend;
+    SinkClock *clock = sink->clock;
+    pthread_mutex_lock(&clock->lock);
+    _updateSink(sink);
+    if (sink->state != SND_PCM_STATE_RUNNING) {
+        _captureSilence(sink, _getFramesUntil(
+            atomic_load_explicit(&clock->nanoseconds, memory_order_relaxed),
+            sink->sampleRate
+        ));
+    }
+    int error = _finishCapture(sink);
+    pthread_mutex_unlock(&clock->lock);
+    return error;
+}
@@ -0,0 +1,78 @@
+#ifndef __SINK_H__
+#define __SINK_H__
+
+#include "backend.h"
+
+/**
+ * Returns whether a sound device name is one of a memory sink.
+ *
+ * @param deviceName "memory", "memory:SPEED" or "render:PATH" for a sink.
+*/
+bool sinkMatchesName(const char *deviceName);
+/**
+ * Opens a memory sink.
+ *
+ * A memory sink behaves like a blocking ALSA pcm whose frames are played
+ * by a virtual clock. The clock only advances when the sink sleeps or
+ * writes. It sleeps speed times shorter in real time, so a whole playback
+ * can run faster than real time with the same wakeups, refills and
+ * actions. A sink whose buffer runs empty reports an xrun like ALSA does.
+ *
+ * A render sink has a stepped clock that does not sleep at all and stands
+ * still until it is advanced with sinkAdvanceTo() or woken. It writes the
+ * frames it plays to a WAV file, with silence while it does not run.
+ *
+ * @param backend The sink, NULL if it could not be opened.
+ * @param deviceName "memory" for real time, "memory:SPEED" or
+ * "render:PATH".
+ * @param clockSource A memory sink whose clock is shared, or NULL. Its
+ * speed is used then.
+ * @return 0 or a negative error number.
+*/
+int sinkOpen(Backend **backend, const char *deviceName, Backend *clockSource);
+/**
+ * Makes every write of a sink take time on its clock, like a slow device.
+ *
+ * If the delay is longer than the frames in the buffer last, the write
+ * fails with -EPIPE. Any thread may call this.
+ *
+ * @param backend The sink.
+ * @param microseconds How long every write takes, 0 for no delay.
+*/
+void sinkSetWriteDelay(Backend *backend, uint32_t microseconds);
+/**
+ * Returns whether an output is a render sink with a stepped clock.
+ *
+ * @param backend The output.
+*/
+bool sinkIsStepped(Backend *backend);
+/**
+ * Waits until the thread that plays a render sink waits for its clock.
+ *
+ * @param backend The sink.
+ * @return The time of the clock.
+*/
+uint64_t sinkWaitUntilParked(Backend *backend);
+/**
+ * Lets the clock of a render sink advance to a time and waits until the
+ * thread that plays it waits for the clock again.
+ *
+ * The clock then stands exactly at the time, unless it was beyond it.
+ *
+ * @param backend The sink.
+ * @param nanoseconds The time.
+*/
+void sinkAdvanceTo(Backend *backend, uint64_t nanoseconds);
+/**
+ * Writes the frames played until now and the sizes of the WAV file of a
+ * render sink and closes it.
+ *
+ * Call it only while the thread that plays the sink waits for the clock.
+ * Later frames are not captured.
+ *
+ * @param backend The sink.
+ * @return 0 or the negative error number of the first failed write.
+*/
+int sinkFinishCapture(Backend *backend);
+
+#endif // __SINK_H__
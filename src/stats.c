@@ -0,0 +1,44 @@
+#include "stats.h"
+
+void statsAdd(_Atomic uint64_t *counter, uint64_t value) {
+    uint64_t current = atomic_load_explicit(counter, memory_order_relaxed);
+    atomic_store_explicit(counter, current + value, memory_order_relaxed);
+}
+
+void statsRaise(_Atomic uint64_t *counter, uint64_t value) {
+    if (value > atomic_load_explicit(counter, memory_order_relaxed)) {
+        atomic_store_explicit(counter, value, memory_order_relaxed);
+    }
+}
+
+void statsLower(_Atomic uint64_t *counter, uint64_t value) {
+    if (value < atomic_load_explicit(counter, memory_order_relaxed)) {
+        atomic_store_explicit(counter, value, memory_order_relaxed);
+    }
+}
+
+void statsRecord(StatsRecorder *recorder, uint64_t value) {
+    statsAdd(&recorder->count, 1);
+    statsAdd(&recorder->sum, value);
+    statsRaise(&recorder->max, value);
+    statsAdd(&recorder->buckets[statsGetBucket(value)], 1);
+}
+
+uint32_t statsGetBucket(uint64_t value) {
+    // The highest bit selects the power of two, the bits below it the
+    // bucket within.
+    if (value < STATS_SUB_BUCKETS) return value;
+    uint32_t exponent = 63 - __builtin_clzll(value);
+    uint32_t subBucket = (value >> (exponent - STATS_SUB_BUCKET_BITS))
+        & (STATS_SUB_BUCKETS - 1);
+    uint64_t bucket = (uint64_t)(exponent - STATS_SUB_BUCKET_BITS + 1)
+        * STATS_SUB_BUCKETS + subBucket;
+    return bucket < STATS_BUCKET_COUNT ? bucket : STATS_BUCKET_COUNT - 1;
+}
+
+uint64_t statsGetBucketStart(uint32_t bucket) {
+    if (bucket < STATS_SUB_BUCKETS) return bucket;
+    uint32_t exponent = bucket / STATS_SUB_BUCKETS + STATS_SUB_BUCKET_BITS - 1;
+    uint64_t subBucket = bucket % STATS_SUB_BUCKETS;
+    return (STATS_SUB_BUCKETS + subBucket) << (exponent - STATS_SUB_BUCKET_BITS);
+}
@@ -0,0 +1,73 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define STATS_SUB_BUCKET_BITS (3)
+#define STATS_SUB_BUCKETS (1 << STATS_SUB_BUCKET_BITS)
+#define STATS_BUCKET_COUNT (200)
+
+/**
+ * @brief Values recorded by one thread and read by any other.
+ *
+ * The histogram is log-linear like an HdrHistogram. Values below
+ * STATS_SUB_BUCKETS get a bucket each, larger values get
+ * STATS_SUB_BUCKETS buckets per power of two, so a bucket is at most
+ * 1 / STATS_SUB_BUCKETS of its values wide. Values beyond the last bucket
+ * are counted in it.
+ *
+ * Only one thread may record, so every counter is updated with a relaxed
+ * load and store instead of a locked read-modify-write. Readers may see
+ * the counters of a value that is still being recorded.
+*/
+typedef struct {
+    _Atomic uint64_t count;  /* The amount of values */
+    _Atomic uint64_t sum;  /* The sum of the values */
+    _Atomic uint64_t max;  /* The largest value */
+    _Atomic uint64_t buckets[STATS_BUCKET_COUNT];  /* How many values fell into each bucket */
+} StatsRecorder;
+
+/**
+ * Adds to a counter that only the calling thread changes.
+ *
+ * @param counter The counter.
+ * @param value The amount to add.
+*/
+void statsAdd(_Atomic uint64_t *counter, uint64_t value);
+/**
+ * Raises a counter that only the calling thread changes to a value.
+ *
+ * @param counter The counter.
+ * @param value The value it is raised to if it is below.
+*/
+void statsRaise(_Atomic uint64_t *counter, uint64_t value);
+/**
+ * Lowers a counter that only the calling thread changes to a value.
+ *
+ * @param counter The counter.
+ * @param value The value it is lowered to if it is above.
+*/
+void statsLower(_Atomic uint64_t *counter, uint64_t value);
+/**
+ * Records a value.
+ *
+ * @param recorder The recorder only the calling thread records into.
+ * @param value The value.
+*/
+void statsRecord(StatsRecorder *recorder, uint64_t value);
+/**
+ * Returns the bucket a value is counted in.
+ *
+ * @param value The value.
+*/
+uint32_t statsGetBucket(uint64_t value);
+/**
+ * Returns the smallest value counted in a bucket.
+ *
+ * @param bucket The bucket, at most STATS_BUCKET_COUNT.
+*/
+uint64_t statsGetBucketStart(uint32_t bucket);
+
+#endif // __STATS_H__
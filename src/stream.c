@@ -0,0 +1,757 @@
+#define _GNU_SOURCE
+
+#include "stream.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#include <errno.h>
+
+#define RING_ENTRIES (256)
+#define MAX_REGISTERED_BUFFERS (256)
+#define NO_REGISTERED_BUFFER (UINT32_MAX)
+
+#define USER_DATA_WAKEUP (0)
+#define USER_DATA_CANCEL (1)
+
+/**
+ * @brief The states of a slot.
+ *
+ * Only the reader thread moves a slot from EMPTY to PENDING and from
+ * PENDING to READY or EMPTY. Only the audio thread moves it from READY
+ * back to EMPTY.
+*/
+enum StreamSlotState {
+    STREAM_SLOT_EMPTY,  /* The slot can be filled. */
+    STREAM_SLOT_PENDING,  /* A read into the slot is in flight. */
+    STREAM_SLOT_READY  /* The slot contains the block. */
+};
+
+/**
+ * @brief A buffer for one block.
+*/
+typedef struct StreamSlot StreamSlot;
+struct StreamSlot {
+    AudioStream *stream;  /* The stream the slot belongs to */
+    uint8_t *buffer;  /* The block data */
+    uint64_t block;  /* The block the slot contains or is read into */
+    uint32_t length;  /* The amount of bytes requested or read */
+    _Atomic uint32_t state;  /* One of StreamSlotState */
+    bool cancelRequested;  /* Whether the read was cancelled already */
+    StreamSlot *nextRead;  /* The next slot read without io_uring */
+};
+
+struct AudioStream {
+    StreamSlot *slots;  /* The queueDepth slots */
+    uint8_t *buffers;  /* The memory of all slots */
+    AudioStream *next;  /* The next stream serviced by the reader thread */
+    size_t buffersSize;  /* The size of the slot memory */
+    size_t dataOffset;  /* The offset of the audio data in the file */
+    size_t dataSize;  /* The size of the audio data */
+    uint64_t blockCount;  /* The amount of blocks in the audio data */
+    _Atomic uint64_t base;  /* The first block of the window */
+    _Atomic uint64_t starvations;  /* How often a frame was requested too early */
+    uint32_t blockFrames;  /* The amount of frames in one block */
+    uint32_t blockSize;  /* The size of one block in bytes */
+    uint32_t frameSize;  /* The size of one frame in bytes */
+    uint32_t queueDepth;  /* The amount of slots */
+    uint32_t pendingCount;  /* The amount of reads in flight */
+    uint32_t bufferIndex;  /* The registered buffer index or NO_REGISTERED_BUFFER */
+    int fileDescriptor;  /* The file to read from */
+    bool closing;  /* Whether streamClose() waits for the stream */
+    bool closed;  /* Whether the reader thread released the stream */
+    _Atomic int error;  /* The negative error number of a read that failed permanently, else 0 */
+};
+
+/**
+ * @brief The memory shared with the kernel for one io_uring instance.
+*/
+typedef struct {
+    struct io_uring_sqe *sqes;  /* The submission queue entries */
+    struct io_uring_cqe *cqes;  /* The completion queue entries */
+    _Atomic uint32_t *sqHead;  /* Advanced by the kernel */
+    _Atomic uint32_t *sqTail;  /* Advanced by us */
+    uint32_t *sqArray;  /* Indices into sqes */
+    _Atomic uint32_t *cqHead;  /* Advanced by us */
+    _Atomic uint32_t *cqTail;  /* Advanced by the kernel */
+    void *sqRing;  /* The mapped submission ring */
+    void *cqRing;  /* The mapped completion ring */
+    size_t sqRingSize;  /* The size of the submission ring mapping */
+    size_t cqRingSize;  /* The size of the completion ring mapping */
+    size_t sqesSize;  /* The size of the sqes mapping */
+    uint32_t sqMask;  /* Mask for submission ring indices */
+    uint32_t cqMask;  /* Mask for completion ring indices */
+    uint32_t sqEntries;  /* The size of the submission ring */
+    uint32_t cqEntries;  /* The size of the completion ring */
+    uint32_t toSubmit;  /* Entries queued since the last io_uring_enter */
+    uint32_t inFlight;  /* Submitted requests without completion */
+    int fileDescriptor;  /* The io_uring file descriptor */
+} StreamRing;
+
+/**
+ * @brief The process wide reader thread and the streams it services.
+*/
+typedef struct {
+    pthread_mutex_t lifecycleLock;  /* Serializes starting and stopping the thread */
+    pthread_mutex_t lock;  /* Protects the stream list */
+    pthread_cond_t streamClosed;  /* Signaled when a stream was released */
+    pthread_t thread;  /* The reader thread */
+    AudioStream *streams;  /* The serviced streams */
+    StreamSlot *reads;  /* The slots to read without io_uring */
+    StreamRing ring;  /* The io_uring instance if used */
+    uint64_t wakeupValue;  /* The target of the eventfd read */
+    int eventFileDescriptor;  /* Written to wake the reader thread up */
+    bool useIoUring;  /* Whether the ring is used */
+    bool ioUringEnabled;  /* Whether the ring may be used */
+    bool hasRegisteredBuffers;  /* Whether the sparse buffer table exists */
+    bool bufferIndexUsed[MAX_REGISTERED_BUFFERS];  /* Which table entries are taken */
+    bool running;  /* Whether the reader thread runs */
+    bool haltFlag;  /* Whether the reader thread should stop */
+} StreamEngine;
+
+static StreamEngine engine = {
+    .lifecycleLock = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .streamClosed = PTHREAD_COND_INITIALIZER,
+    .eventFileDescriptor = -1,
+    .ioUringEnabled = true
+};
+
+// io_uring without liburing
+
+bool _ringSetup(StreamRing *ring) {
+    struct io_uring_params parameters;
+    memset(&parameters, 0, sizeof(parameters));
+    ring->fileDescriptor = syscall(
+        __NR_io_uring_setup, RING_ENTRIES, &parameters
+    );
+    if (ring->fileDescriptor < 0) return false;
+
+    // Older kernels need two mappings for the rings.
+    if (!(parameters.features & IORING_FEAT_SINGLE_MMAP)) {
+        close(ring->fileDescriptor);
+        return false;
+    }
+
+    ring->sqRingSize = parameters.sq_off.array
+        + parameters.sq_entries * sizeof(uint32_t);
+    ring->cqRingSize = parameters.cq_off.cqes
+        + parameters.cq_entries * sizeof(struct io_uring_cqe);
+    if (ring->cqRingSize > ring->sqRingSize) {
+        ring->sqRingSize = ring->cqRingSize;
+    }
+    ring->cqRingSize = ring->sqRingSize;
+    ring->sqRing = mmap(
+        NULL, ring->sqRingSize, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring->fileDescriptor, IORING_OFF_SQ_RING
+    );
+    if (ring->sqRing == MAP_FAILED) {
+        close(ring->fileDescriptor);
+        return false;
+    }
+    ring->cqRing = ring->sqRing;
+
+    ring->sqesSize = parameters.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(
+        NULL, ring->sqesSize, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring->fileDescriptor, IORING_OFF_SQES
+    );
+    if (ring->sqes == MAP_FAILED) {
+        munmap(ring->sqRing, ring->sqRingSize);
+        close(ring->fileDescriptor);
+        return false;
+    }
+
+    uint8_t *sqRing = (uint8_t*)ring->sqRing;
+    uint8_t *cqRing = (uint8_t*)ring->cqRing;
+    ring->sqHead = (_Atomic uint32_t*)(sqRing + parameters.sq_off.head);
+    ring->sqTail = (_Atomic uint32_t*)(sqRing + parameters.sq_off.tail);
+    ring->sqMask = *(uint32_t*)(sqRing + parameters.sq_off.ring_mask);
+    ring->sqArray = (uint32_t*)(sqRing + parameters.sq_off.array);
+    ring->cqHead = (_Atomic uint32_t*)(cqRing + parameters.cq_off.head);
+    ring->cqTail = (_Atomic uint32_t*)(cqRing + parameters.cq_off.tail);
+    ring->cqMask = *(uint32_t*)(cqRing + parameters.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cqRing + parameters.cq_off.cqes);
+    ring->sqEntries = parameters.sq_entries;
+    ring->cqEntries = parameters.cq_entries;
+    ring->toSubmit = 0;
+    ring->inFlight = 0;
+    return true;
+}
+
+void _ringDestroy(StreamRing *ring) {
+    munmap(ring->sqes, ring->sqesSize);
+    munmap(ring->sqRing, ring->sqRingSize);
+    close(ring->fileDescriptor);
+}
+
+int _ringEnter(StreamRing *ring, uint32_t minComplete) {
+    // Submit everything queued and optionally wait for completions.
+    int result;
+    do {
+        result = syscall(
+            __NR_io_uring_enter, ring->fileDescriptor, ring->toSubmit,
+            minComplete, minComplete ? IORING_ENTER_GETEVENTS : 0, NULL, 0
+        );
+    } while (result < 0 && errno == EINTR);
+    if (result >= 0) {
+        ring->inFlight += result;
+        ring->toSubmit -= result;
+    }
+    return result;
+}
+
+struct io_uring_sqe * _ringGetSqe(StreamRing *ring) {
+    // Never have more requests in flight than completions fit into the
+    // completion ring.
+    if (ring->inFlight + ring->toSubmit >= ring->cqEntries) return NULL;
+
+    uint32_t tail = atomic_load_explicit(ring->sqTail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(ring->sqHead, memory_order_acquire);
+    if (tail - head >= ring->sqEntries) {
+        if (_ringEnter(ring, 0) < 0) return NULL;
+        head = atomic_load_explicit(ring->sqHead, memory_order_acquire);
+        if (tail - head >= ring->sqEntries) return NULL;
+    }
+    uint32_t index = tail & ring->sqMask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sqArray[index] = index;
+    return sqe;
+}
+
+void _ringQueueSqe(StreamRing *ring) {
+    uint32_t tail = atomic_load_explicit(ring->sqTail, memory_order_relaxed);
+    atomic_store_explicit(ring->sqTail, tail + 1, memory_order_release);
+    ring->toSubmit++;
+}
+
+bool _ringRegisterSparseBuffers(StreamRing *ring) {
+    struct io_uring_rsrc_register registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.nr = MAX_REGISTERED_BUFFERS;
+    registration.flags = IORING_RSRC_REGISTER_SPARSE;
+    return syscall(
+        __NR_io_uring_register, ring->fileDescriptor,
+        IORING_REGISTER_BUFFERS2, &registration, sizeof(registration)
+    ) == 0;
+}
+
+bool _ringUpdateBuffer(
+    StreamRing *ring, uint32_t index, void *buffer, size_t size
+) {
+    // A NULL buffer removes the entry again.
+    struct iovec vector = { .iov_base = buffer, .iov_len = size };
+    struct io_uring_rsrc_update2 update;
+    memset(&update, 0, sizeof(update));
+    update.offset = index;
+    update.data = (uint64_t)(uintptr_t)&vector;
+    update.nr = 1;
+    return syscall(
+        __NR_io_uring_register, ring->fileDescriptor,
+        IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)
+    ) == 1;
+}
+
+// Reader thread
+
+uint64_t _windowBlock(AudioStream *stream, uint64_t base, uint32_t slotIndex) {
+    // The block in [base, base + queueDepth) that lives in the slot.
+    uint32_t baseSlot = base % stream->queueDepth;
+    return base
+        + (slotIndex + stream->queueDepth - baseSlot) % stream->queueDepth;
+}
+
+bool _isInWindow(AudioStream *stream, uint64_t block) {
+    uint64_t base = atomic_load_explicit(&stream->base, memory_order_acquire);
+    return block >= base && block < base + stream->queueDepth;
+}
+
+void _prepareSlot(StreamSlot *slot, uint64_t block) {
+    AudioStream *stream = slot->stream;
+    slot->block = block;
+    size_t offset = block * stream->blockSize;
+    slot->length = stream->dataSize - offset < stream->blockSize
+        ? stream->dataSize - offset
+        : stream->blockSize;
+    slot->cancelRequested = false;
+}
+
+void _completeSlot(StreamSlot *slot, ssize_t result) {
+    AudioStream *stream = slot->stream;
+    if (result == (ssize_t)slot->length && _isInWindow(stream, slot->block)) {
+        atomic_store_explicit(
+            &slot->state, STREAM_SLOT_READY, memory_order_release
+        );
+        return;
+    }
+    // Reading nothing means the file ended early, like for pread. Errors
+    // other than cancellation and short reads are not retried, the audio
+    // thread finds them with streamGetError().
+    if (result == 0) result = -EIO;
+    if (
+        result < 0 && result != -ECANCELED && result != -EINTR 
+        && result != -EAGAIN
+    ) {
+        int noError = 0;
+        atomic_compare_exchange_strong(&stream->error, &noError, (int)result);
+    }
+    atomic_store_explicit(&slot->state, STREAM_SLOT_EMPTY, memory_order_release);
+}
+
+bool _submitRead(StreamSlot *slot) {
+    AudioStream *stream = slot->stream;
+    struct io_uring_sqe *sqe = _ringGetSqe(&engine.ring);
+    if (sqe == NULL) return false;
+    if (stream->bufferIndex != NO_REGISTERED_BUFFER) {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->buf_index = stream->bufferIndex;
+    } else {
+        sqe->opcode = IORING_OP_READ;
+    }
+    sqe->fd = stream->fileDescriptor;
+    sqe->addr = (uint64_t)(uintptr_t)slot->buffer;
+    sqe->len = slot->length;
+    sqe->off = stream->dataOffset + slot->block * stream->blockSize;
+    sqe->user_data = (uint64_t)(uintptr_t)slot;
+    _ringQueueSqe(&engine.ring);
+    return true;
+}
+
+bool _submitCancel(StreamSlot *slot) {
+    struct io_uring_sqe *sqe = _ringGetSqe(&engine.ring);
+    if (sqe == NULL) return false;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = (uint64_t)(uintptr_t)slot;
+    sqe->user_data = USER_DATA_CANCEL;
+    _ringQueueSqe(&engine.ring);
+    return true;
+}
+
+void _submitWakeupRead() {
+    struct io_uring_sqe *sqe = _ringGetSqe(&engine.ring);
+    if (sqe == NULL) return;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = engine.eventFileDescriptor;
+    sqe->addr = (uint64_t)(uintptr_t)&engine.wakeupValue;
+    sqe->len = sizeof(engine.wakeupValue);
+    sqe->user_data = USER_DATA_WAKEUP;
+    _ringQueueSqe(&engine.ring);
+}
+
+void _queueRead(StreamSlot *slot) {
+    // Called with the lock held. The slot is read after unlocking.
+    slot->nextRead = engine.reads;
+    engine.reads = slot;
+}
+
+ssize_t _readSlot(StreamSlot *slot) {
+    // The fallback without io_uring: a blocking read on this thread without
+    // the lock. The slot is pending and counted, so neither the slot nor
+    // the stream change meanwhile.
+    AudioStream *stream = slot->stream;
+    size_t offset = stream->dataOffset + slot->block * stream->blockSize;
+    size_t bytesRead = 0;
+    while (bytesRead < slot->length) {
+        ssize_t result = pread(
+            stream->fileDescriptor, slot->buffer + bytesRead,
+            slot->length - bytesRead, offset + bytesRead
+        );
+        if (result == -1 && errno == EINTR) continue;
+        if (result <= 0) return result < 0 ? -errno : -EIO;
+        bytesRead += result;
+    }
+    return bytesRead;
+}
+
+void _releaseStream(AudioStream *stream) {
+    // Called with the lock held once no read is in flight anymore.
+    AudioStream **link = &engine.streams;
+    while (*link != stream) link = &(*link)->next;
+    *link = stream->next;
+    if (stream->bufferIndex != NO_REGISTERED_BUFFER) {
+        _ringUpdateBuffer(&engine.ring, stream->bufferIndex, NULL, 0);
+        engine.bufferIndexUsed[stream->bufferIndex] = false;
+    }
+    stream->closed = true;
+    pthread_cond_broadcast(&engine.streamClosed);
+}
+
+bool _scheduleStream(AudioStream *stream) {
+    // Issue reads for empty slots in the window and cancel reads that left
+    // it. Returns whether any work was done.
+    bool didWork = false;
+    uint64_t base = atomic_load_explicit(&stream->base, memory_order_acquire);
+    for (uint32_t i = 0; i < stream->queueDepth; ++i) {
+        StreamSlot *slot = &stream->slots[i];
+        uint32_t state = atomic_load_explicit(
+            &slot->state, memory_order_acquire
+        );
+
+        if (state == STREAM_SLOT_PENDING) {
+            bool isStale = stream->closing
+                || slot->block < base
+                || slot->block >= base + stream->queueDepth;
+            if (
+                engine.useIoUring && isStale && !slot->cancelRequested 
+                && _submitCancel(slot)
+            ) {
+                slot->cancelRequested = true;
+                didWork = true;
+            }
+            continue;
+        }
+        if (
+            state != STREAM_SLOT_EMPTY || stream->closing 
+            || atomic_load_explicit(&stream->error, memory_order_relaxed)
+        ) {
+            continue;
+        }
+
+        uint64_t block = _windowBlock(stream, base, i);
+        if (block >= stream->blockCount) continue;
+        _prepareSlot(slot, block);
+        atomic_store_explicit(
+            &slot->state, STREAM_SLOT_PENDING, memory_order_relaxed
+        );
+        if (engine.useIoUring && !_submitRead(slot)) {
+            atomic_store_explicit(
+                &slot->state, STREAM_SLOT_EMPTY, memory_order_relaxed
+            );
+            break;
+        }
+        if (!engine.useIoUring) _queueRead(slot);
+        stream->pendingCount++;
+        didWork = true;
+    }
+
+    if (stream->closing && stream->pendingCount == 0) {
+        _releaseStream(stream);
+        didWork = true;
+    }
+    return didWork;
+}
+
+bool _scheduleStreams() {
+    bool didWork = false;
+    AudioStream *stream = engine.streams;
+    while (stream != NULL) {
+        // The stream might be released while it is scheduled.
+        AudioStream *next = stream->next;
+        if (_scheduleStream(stream)) didWork = true;
+        stream = next;
+    }
+    return didWork;
+}
+
+void _reapCompletions() {
+    StreamRing *ring = &engine.ring;
+    uint32_t head = atomic_load_explicit(ring->cqHead, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(ring->cqTail, memory_order_acquire);
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & ring->cqMask];
+        ring->inFlight--;
+        if (cqe->user_data == USER_DATA_WAKEUP) {
+            _submitWakeupRead();
+        } else if (cqe->user_data != USER_DATA_CANCEL) {
+            StreamSlot *slot = (StreamSlot*)(uintptr_t)cqe->user_data;
+            slot->stream->pendingCount--;
+            _completeSlot(slot, cqe->res);
+        }
+        head++;
+    }
+    atomic_store_explicit(ring->cqHead, head, memory_order_release);
+}
+
+void * _ringReaderLoop(void *unused) {
+    _submitWakeupRead();
+    while (true) {
+        pthread_mutex_lock(&engine.lock);
+        if (engine.haltFlag && engine.streams == NULL) {
+            pthread_mutex_unlock(&engine.lock);
+            break;
+        }
+        _scheduleStreams();
+        pthread_mutex_unlock(&engine.lock);
+
+        // Submit the whole batch and sleep until something completes. Writing
+        // to the eventfd completes the wakeup read. Errors like EAGAIN are
+        // transient so just try again a bit later.
+        if (_ringEnter(&engine.ring, 1) < 0) usleep(1000);
+
+        pthread_mutex_lock(&engine.lock);
+        _reapCompletions();
+        pthread_mutex_unlock(&engine.lock);
+    }
+    return NULL;
+}
+
+void * _threadReaderLoop(void *unused) {
+    while (true) {
+        pthread_mutex_lock(&engine.lock);
+        if (engine.haltFlag && engine.streams == NULL) {
+            pthread_mutex_unlock(&engine.lock);
+            break;
+        }
+        bool didWork = _scheduleStreams();
+        StreamSlot *reads = engine.reads;
+        engine.reads = NULL;
+        pthread_mutex_unlock(&engine.lock);
+
+        // Read without the lock, so opening and closing streams does not
+        // wait for the disk. Every block is handed over when it is read.
+        while (reads != NULL) {
+            StreamSlot *slot = reads;
+            reads = slot->nextRead;
+            ssize_t result = _readSlot(slot);
+            pthread_mutex_lock(&engine.lock);
+            slot->stream->pendingCount--;
+            _completeSlot(slot, result);
+            pthread_mutex_unlock(&engine.lock);
+        }
+
+        // Sleep until a stream needs a block. If the eventfd cannot be
+        // read the streams are polled instead, like the ring does.
+        if (!didWork) {
+            uint64_t value;
+            if (read(engine.eventFileDescriptor, &value, sizeof(value)) < 0
+                && errno != EINTR) usleep(1000);
+        }
+    }
+    return NULL;
+}
+
+void _wakeReader() {
+    uint64_t value = 1;
+    ssize_t result = write(engine.eventFileDescriptor, &value, sizeof(value));
+    (void)result;
+}
+
+bool _startEngine() {
+    engine.eventFileDescriptor = eventfd(0, EFD_CLOEXEC);
+    if (engine.eventFileDescriptor == -1) return false;
+
+    engine.useIoUring = engine.ioUringEnabled && _ringSetup(&engine.ring);
+    engine.hasRegisteredBuffers = engine.useIoUring
+        && _ringRegisterSparseBuffers(&engine.ring);
+    memset(engine.bufferIndexUsed, 0, sizeof(engine.bufferIndexUsed));
+    engine.haltFlag = false;
+
+    if (pthread_create(
+        &engine.thread, NULL,
+        engine.useIoUring ? _ringReaderLoop : _threadReaderLoop, NULL
+    )) {
+        if (engine.useIoUring) _ringDestroy(&engine.ring);
+        close(engine.eventFileDescriptor);
+        return false;
+    }
+    engine.running = true;
+    return true;
+}
+
+void _stopEngine() {
+    pthread_mutex_lock(&engine.lock);
+    engine.haltFlag = true;
+    pthread_mutex_unlock(&engine.lock);
+    _wakeReader();
+    pthread_join(engine.thread, NULL);
+
+    if (engine.useIoUring) _ringDestroy(&engine.ring);
+    close(engine.eventFileDescriptor);
+    engine.eventFileDescriptor = -1;
+    engine.running = false;
+}
+
+// Public functions
+
+AudioStream * streamOpen(
+    int fileDescriptor, size_t dataOffset, size_t dataSize,
+    uint32_t frameSize, uint32_t blockSize, uint32_t queueDepth
+) {
+    if (frameSize == 0 || blockSize < frameSize || queueDepth == 0) {
+        return NULL;
+    }
+    AudioStream *stream = (AudioStream*)calloc(1, sizeof(AudioStream));
+    if (stream == NULL) return NULL;
+
+    stream->fileDescriptor = fileDescriptor;
+    stream->dataOffset = dataOffset;
+    stream->dataSize = dataSize;
+    stream->frameSize = frameSize;
+    stream->blockFrames = blockSize / frameSize;
+    stream->blockSize = stream->blockFrames * frameSize;
+    stream->blockCount = (dataSize + stream->blockSize - 1) / stream->blockSize;
+    stream->queueDepth = queueDepth;
+    stream->bufferIndex = NO_REGISTERED_BUFFER;
+
+    // All slots share one page aligned allocation so it can be registered
+    // as a single fixed buffer.
+    stream->buffersSize = (size_t)stream->blockSize * queueDepth;
+    stream->buffers = mmap(
+        NULL, stream->buffersSize, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+    );
+    stream->slots = (StreamSlot*)calloc(queueDepth, sizeof(StreamSlot));
+    if (stream->buffers == MAP_FAILED || stream->slots == NULL) {
+        if (stream->buffers != MAP_FAILED) {
+            munmap(stream->buffers, stream->buffersSize);
+        }
+        free(stream->slots);
+        free(stream);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < queueDepth; ++i) {
+        stream->slots[i].stream = stream;
+        stream->slots[i].buffer = stream->buffers
+            + (size_t)i * stream->blockSize;
+        atomic_init(&stream->slots[i].state, STREAM_SLOT_EMPTY);
+    }
+    atomic_init(&stream->base, 0);
+    atomic_init(&stream->starvations, 0);
+    atomic_init(&stream->error, 0);
+
+    pthread_mutex_lock(&engine.lifecycleLock);
+    if (!engine.running && !_startEngine()) {
+        pthread_mutex_unlock(&engine.lifecycleLock);
+        munmap(stream->buffers, stream->buffersSize);
+        free(stream->slots);
+        free(stream);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&engine.lock);
+    // Register the slot memory if there is room in the table. Otherwise
+    // plain reads are used for this stream.
+    if (engine.hasRegisteredBuffers) {
+        for (uint32_t i = 0; i < MAX_REGISTERED_BUFFERS; ++i) {
+            if (engine.bufferIndexUsed[i]) continue;
+            if (_ringUpdateBuffer(
+                &engine.ring, i, stream->buffers, stream->buffersSize
+            )) {
+                engine.bufferIndexUsed[i] = true;
+                stream->bufferIndex = i;
+            }
+            break;
+        }
+    }
+    stream->next = engine.streams;
+    engine.streams = stream;
+    pthread_mutex_unlock(&engine.lock);
+    pthread_mutex_unlock(&engine.lifecycleLock);
+
+    _wakeReader();
+    return stream;
+}
+
+void streamClose(AudioStream *stream) {
+    pthread_mutex_lock(&engine.lifecycleLock);
+
+    // The reader thread cancels outstanding reads and releases the stream.
+    pthread_mutex_lock(&engine.lock);
+    stream->closing = true;
+    _wakeReader();
+    while (!stream->closed) {
+        pthread_cond_wait(&engine.streamClosed, &engine.lock);
+    }
+    bool isLastStream = engine.streams == NULL;
+    pthread_mutex_unlock(&engine.lock);
+
+    if (isLastStream) _stopEngine();
+    pthread_mutex_unlock(&engine.lifecycleLock);
+
+    munmap(stream->buffers, stream->buffersSize);
+    free(stream->slots);
+    free(stream);
+}
+
+const uint8_t * streamGetFrames(
+    AudioStream *stream, uint64_t frame, uint32_t *frameCount
+) {
+    uint64_t block = frame / stream->blockFrames;
+    StreamSlot *slot = &stream->slots[block % stream->queueDepth];
+    uint32_t state = atomic_load_explicit(&slot->state, memory_order_acquire);
+
+    if (state != STREAM_SLOT_READY || slot->block != block) {
+        // A ready slot with another block is left over from before a jump.
+        // Hand it back so the reader thread can fill it.
+        if (state == STREAM_SLOT_READY) {
+            atomic_store_explicit(
+                &slot->state, STREAM_SLOT_EMPTY, memory_order_release
+            );
+            _wakeReader();
+        }
+        atomic_fetch_add_explicit(
+            &stream->starvations, 1, memory_order_relaxed
+        );
+        *frameCount = 0;
+        return NULL;
+    }
+
+    uint32_t frameInBlock = frame % stream->blockFrames;
+    uint32_t framesInSlot = slot->length / stream->frameSize - frameInBlock;
+    if (*frameCount > framesInSlot) *frameCount = framesInSlot;
+    return slot->buffer + (size_t)frameInBlock * stream->frameSize;
+}
+
+void streamSetPlayhead(
+    AudioStream *stream, uint64_t frame, uint32_t keepBehindFrames
+) {
+    // At least half of the window must be ahead of the playhead.
+    uint32_t maxKeepBehindFrames = stream->blockFrames * (stream->queueDepth / 2);
+    if (keepBehindFrames > maxKeepBehindFrames) {
+        keepBehindFrames = maxKeepBehindFrames;
+    }
+    uint64_t keptFrame = frame > keepBehindFrames ? frame - keepBehindFrames : 0;
+    uint64_t base = keptFrame / stream->blockFrames;
+    if (base == atomic_load_explicit(&stream->base, memory_order_relaxed)) {
+        return;
+    }
+    atomic_store_explicit(&stream->base, base, memory_order_release);
+
+    // Hand all ready slots outside the new window back to the reader thread.
+    for (uint32_t i = 0; i < stream->queueDepth; ++i) {
+        StreamSlot *slot = &stream->slots[i];
+        if (atomic_load_explicit(&slot->state, memory_order_acquire)
+            != STREAM_SLOT_READY) continue;
+        if (slot->block >= base && slot->block < base + stream->queueDepth) {
+            continue;
+        }
+        atomic_store_explicit(&slot->state, STREAM_SLOT_EMPTY, memory_order_release);
+    }
+    _wakeReader();
+}
+
+size_t streamLockBuffers(AudioStream *stream, bool lock) {
+    if (!lock) {
+        munlock(stream->buffers, stream->buffersSize);
+        return 0;
+    }
+    if (mlock(stream->buffers, stream->buffersSize) == -1) return 0;
+    return stream->buffersSize;
+}
+
+int streamGetError(AudioStream *stream) {
+    return atomic_load_explicit(&stream->error, memory_order_relaxed);
+}
+
+uint64_t streamGetStarvationCount(AudioStream *stream) {
+    return atomic_load_explicit(&stream->starvations, memory_order_relaxed);
+}
+
+bool streamGetUsesIoUring() {
+    return engine.running && engine.useIoUring;
+}
+
+void streamSetIoUringEnabled(bool enabled) {
+    pthread_mutex_lock(&engine.lifecycleLock);
+    engine.ioUringEnabled = enabled;
+    pthread_mutex_unlock(&engine.lifecycleLock);
+}
@@ -0,0 +1,121 @@
+#ifndef __STREAM_H__
+#define __STREAM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief This represents the audio data of a file that is read in blocks
+ * ahead of the playhead.
+ *
+ * Each stream owns queueDepth blocks. The block containing frame f is
+ * f / blockFrames and lives in slot (f / blockFrames) % queueDepth. All
+ * streams are serviced by one process wide reader thread. It uses io_uring
+ * if the kernel supports it and falls back to pread otherwise.
+ *
+ * streamGetFrames() and streamSetPlayhead() are meant to be called by the
+ * audio thread. They never block.
+*/
+typedef struct AudioStream AudioStream;
+
+/**
+ * Opens a stream for the given part of a file.
+ *
+ * The file descriptor must stay open until streamClose() returned.
+ *
+ * @param fileDescriptor The file to read from.
+ * @param dataOffset The offset of the audio data in the file.
+ * @param dataSize The size of the audio data in bytes.
+ * @param frameSize The size of one frame in bytes.
+ * @param blockSize The size of one block in bytes. Rounded down to whole frames.
+ * @param queueDepth The amount of blocks read ahead.
+ * @return The stream or NULL if it could not be created.
+*/
+AudioStream * streamOpen(
+    int fileDescriptor, size_t dataOffset, size_t dataSize,
+    uint32_t frameSize, uint32_t blockSize, uint32_t queueDepth
+);
+/**
+ * Cancels all outstanding reads of the stream and frees it.
+ *
+ * @param stream The stream.
+*/
+void streamClose(AudioStream *stream);
+
+/**
+ * Returns a pointer to the given frame if it was read already.
+ *
+ * On return frameCount holds the amount of consecutive frames that can be
+ * read from the pointer. It is never larger than on input. If the frame is
+ * not available yet frameCount is 0.
+ *
+ * @param stream The stream.
+ * @param frame The first frame.
+ * @param frameCount The maximum amount of frames.
+ * @return The pointer to the frame.
+*/
+const uint8_t * streamGetFrames(
+    AudioStream *stream, uint64_t frame, uint32_t *frameCount
+);
+/**
+ * Tells the reader thread where the playhead is.
+ *
+ * Blocks starting with the one that contains frame - keepBehindFrames are
+ * kept or read. Reads of blocks outside this window are cancelled. Call it
+ * after every write and after jumps. keepBehindFrames is limited to half of
+ * the window.
+ *
+ * @param stream The stream.
+ * @param frame The frame at the playhead.
+ * @param keepBehindFrames How many frames behind the playhead are kept.
+*/
+void streamSetPlayhead(
+    AudioStream *stream, uint64_t frame, uint32_t keepBehindFrames
+);
+
+/**
+ * Locks or unlocks the memory of all blocks of the stream.
+ *
+ * Locked blocks cannot be swapped out, so the audio thread never faults
+ * when it copies from them.
+ *
+ * @param stream The stream.
+ * @param lock Whether to lock or unlock the memory.
+ * @return The amount of locked bytes. 0 if unlocked or locking failed.
+*/
+size_t streamLockBuffers(AudioStream *stream, bool lock);
+/**
+ * Returns why the stream stopped reading blocks.
+ *
+ * A read that fails with anything but a transient error, or that finds the
+ * file shorter than the audio data, is not retried. streamGetFrames() then
+ * finds no more frames.
+ *
+ * @param stream The stream.
+ * @return 0 or the negative error number of the failed read.
+*/
+int streamGetError(AudioStream *stream);
+/**
+ * Returns how often streamGetFrames() did not find the requested frame.
+ *
+ * @param stream The stream.
+*/
+uint64_t streamGetStarvationCount(AudioStream *stream);
+/**
+ * Returns whether the reader thread uses io_uring.
+ *
+ * This is only meaningful while at least one stream is open.
+*/
+bool streamGetUsesIoUring(void);
+/**
+ * Enables or disables the use of io_uring for streams opened afterwards.
+ *
+ * It is enabled by default. This only takes effect when the reader thread
+ * is started, i.e. when no stream is open.
+ *
+ * @param enabled Whether io_uring may be used.
+*/
+void streamSetIoUringEnabled(bool enabled);
+
+#endif // __STREAM_H__
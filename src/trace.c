@@ -0,0 +1,197 @@
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NANOSECONDS_PER_SECOND (1000000000ull)
+#define NANOSECONDS_PER_MICROSECOND (1000.0)
+#define AUDIO_THREAD_ID (1)
+#define ACTION_THREAD_ID (2)
+
+enum TraceSnapshotState {
+    TRACE_SNAPSHOT_EMPTY,
+    TRACE_SNAPSHOT_READY,
+    TRACE_SNAPSHOT_BUSY
+};
+
+static const char *actionNames[] = {
+    "play", "pause", "stop", "jump", "cue preload", "gain", "add device",
+    "markers", "tracing", "loop", "segments", "replace"
+};
+
+TraceRing * traceInit(uint32_t size) {
+    TraceRing *ring = (TraceRing*)calloc(1, sizeof(TraceRing));
+    if (ring == NULL) return NULL;
+    ring->events = (TraceEvent*)calloc(size, sizeof(TraceEvent));
+    ring->snapshot = (TraceEvent*)calloc(size, sizeof(TraceEvent));
+    if (ring->events == NULL || ring->snapshot == NULL) {
+        traceFree(ring);
+        return NULL;
+    }
+    ring->size = size;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->snapshotState, TRACE_SNAPSHOT_EMPTY);
+    return ring;
+}
+
+void traceFree(TraceRing *ring) {
+    free(ring->events);
+    free(ring->snapshot);
+    free(ring);
+}
+
+void traceRecordAt(
+    TraceRing *ring, const struct timespec *time, uint16_t type, uint16_t device,
+    int64_t value
+) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    ring->events[head % ring->size] = (TraceEvent){
+        .nanoseconds = time->tv_sec * NANOSECONDS_PER_SECOND + time->tv_nsec,
+        .value = value,
+        .type = type,
+        .device = device
+    };
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+uint32_t _copyEvents(const TraceRing *ring, uint64_t first, uint64_t end, TraceEvent *events) {
+    // The events wrap around the end of the ring at most once.
+    uint32_t eventCount = end - first;
+    uint32_t start = first % ring->size;
+    uint32_t tailCount = ring->size - start < eventCount ? ring->size - start : eventCount;
+    memcpy(events, ring->events + start, tailCount * sizeof(TraceEvent));
+    memcpy(events + tailCount, ring->events, (eventCount - tailCount) * sizeof(TraceEvent));
+    return eventCount;
+}
+
+void traceTakeSnapshot(TraceRing *ring) {
+    // An older snapshot is replaced, one being read is kept.
+    uint32_t state = TRACE_SNAPSHOT_EMPTY;
+    if (
+        !atomic_compare_exchange_strong(&ring->snapshotState, &state, TRACE_SNAPSHOT_BUSY)
+        && (state != TRACE_SNAPSHOT_READY || !atomic_compare_exchange_strong(
+            &ring->snapshotState, &state, TRACE_SNAPSHOT_BUSY
+        ))
+    ) {
+        return;
+    }
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t first = head > ring->size ? head - ring->size : 0;
+    ring->snapshotCount = _copyEvents(ring, first, head, ring->snapshot);
+    atomic_store_explicit(&ring->snapshotState, TRACE_SNAPSHOT_READY, memory_order_release);
+}
+
+uint32_t traceCopy(TraceRing *ring, TraceEvent *events) {
+    // The slot behind the head may be written while it is copied, so only
+    // the events after it are kept.
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t first = head > ring->size ? head - ring->size : 0;
+    _copyEvents(ring, first, head, events);
+    uint64_t laterHead = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t validFirst = laterHead >= ring->size ? laterHead - ring->size + 1 : 0;
+    if (validFirst <= first) return head - first;
+    if (validFirst >= head) return 0;
+    uint32_t eventCount = head - validFirst;
+    memmove(events, events + (validFirst - first), eventCount * sizeof(TraceEvent));
+    return eventCount;
+}
+
+bool traceCopySnapshot(TraceRing *ring, TraceEvent *events, uint32_t *eventCount) {
+    uint32_t state = TRACE_SNAPSHOT_READY;
+    if (!atomic_compare_exchange_strong(&ring->snapshotState, &state, TRACE_SNAPSHOT_BUSY)) {
+        *eventCount = 0;
+        return false;
+    }
+    *eventCount = ring->snapshotCount;
+    memcpy(events, ring->snapshot, ring->snapshotCount * sizeof(TraceEvent));
+    atomic_store_explicit(&ring->snapshotState, TRACE_SNAPSHOT_READY, memory_order_release);
+    return true;
+}
+
+bool traceWriteChrome(FILE *file, const TraceEvent *events, uint32_t eventCount) {
+    fprintf(
+        file,
+        "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"audio thread\"}},\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"actions\"}}",
+        AUDIO_THREAD_ID, ACTION_THREAD_ID
+    );
+    for (uint32_t i = 0; i < eventCount; ++i) {
+        const TraceEvent *event = &events[i];
+        double microseconds = event->nanoseconds / NANOSECONDS_PER_MICROSECOND;
+        const char *actionName = event->value >= 0
+            && event->value < (int64_t)(sizeof(actionNames) / sizeof(actionNames[0]))
+            ? actionNames[event->value]
+            : "action";
+        fprintf(file, ",\n{\"pid\":1,\"ts\":%.3f,", microseconds);
+        switch (event->type) {
+            case TRACE_WAKEUP:
+                fprintf(file, "\"tid\":%d,\"name\":\"wakeup\",\"ph\":\"i\",\"s\":\"t\"}", AUDIO_THREAD_ID);
+                break;
+
+            case TRACE_AVAIL:
+            case TRACE_DELAY:
+                fprintf(
+                    file, "\"name\":\"%s\",\"ph\":\"C\",\"args\":{\"frames\":%ld}}",
+                    event->type == TRACE_AVAIL ? "avail" : "delay", event->value
+                );
+                break;
+
+            case TRACE_WRITE_BEGIN:
+                fprintf(
+                    file,
+                    "\"tid\":%d,\"name\":\"write\",\"ph\":\"B\",\"args\":{\"device\":%u,\"frames\":%ld}}",
+                    AUDIO_THREAD_ID, event->device, event->value
+                );
+                break;
+
+            case TRACE_WRITE_END:
+                fprintf(
+                    file, "\"tid\":%d,\"name\":\"write\",\"ph\":\"E\",\"args\":{\"result\":%ld}}",
+                    AUDIO_THREAD_ID, event->value
+                );
+                break;
+
+            case TRACE_DROP:
+            case TRACE_PREPARE:
+            case TRACE_START:
+                fprintf(
+                    file, "\"tid\":%d,\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"device\":%u}}",
+                    AUDIO_THREAD_ID,
+                    event->type == TRACE_DROP ? "drop"
+                        : event->type == TRACE_PREPARE ? "prepare" : "start",
+                    event->device
+                );
+                break;
+
+            case TRACE_XRUN:
+                fprintf(
+                    file, "\"tid\":%d,\"name\":\"xrun\",\"ph\":\"i\",\"s\":\"g\",\"args\":{\"frame\":%ld}}",
+                    AUDIO_THREAD_ID, event->value
+                );
+                break;
+
+            case TRACE_ACTION_SUBMITTED:
+            case TRACE_BARRIER_RELEASED:
+                fprintf(
+                    file, "\"tid\":%d,\"name\":\"%s\",\"ph\":\"%s\"}",
+                    ACTION_THREAD_ID, actionName,
+                    event->type == TRACE_ACTION_SUBMITTED ? "B" : "E"
+                );
+                break;
+
+            case TRACE_ACTION_APPLIED:
+                fprintf(
+                    file, "\"tid\":%d,\"name\":\"apply %s\",\"ph\":\"i\",\"s\":\"t\"}",
+                    AUDIO_THREAD_ID, actionName
+                );
+                break;
+
+            default:
+                fprintf(file, "\"tid\":%d,\"name\":\"unknown\",\"ph\":\"i\",\"s\":\"t\"}", AUDIO_THREAD_ID);
+                break;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    return !ferror(file);
+}
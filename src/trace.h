@@ -0,0 +1,139 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * @brief What a trace event records.
+*/
+enum TraceEventType {
+    TRACE_WAKEUP,  /* The audio thread woke up */
+    TRACE_AVAIL,  /* The room in the ALSA buffer in frames */
+    TRACE_DELAY,  /* The frames queued ahead of the playhead */
+    TRACE_WRITE_BEGIN,  /* The frames handed to snd_pcm_writei() */
+    TRACE_WRITE_END,  /* What snd_pcm_writei() returned */
+    TRACE_DROP,  /* The buffers were dropped and prepared */
+    TRACE_PREPARE,  /* A device was prepared after running out of frames */
+    TRACE_START,  /* A device was started */
+    TRACE_XRUN,  /* A device ran out of frames */
+    TRACE_ACTION_SUBMITTED,  /* A user thread handed over the action in value */
+    TRACE_ACTION_APPLIED,  /* The audio thread applied the action in value */
+    TRACE_BARRIER_RELEASED  /* The user thread was released after the action in value */
+};
+
+/**
+ * @brief The actions the audio thread applies for the user threads.
+*/
+enum TraceAction {
+    TRACE_ACTION_PLAY,
+    TRACE_ACTION_PAUSE,
+    TRACE_ACTION_STOP,
+    TRACE_ACTION_JUMP,
+    TRACE_ACTION_CUE_PRELOAD,
+    TRACE_ACTION_GAIN,
+    TRACE_ACTION_ADD_DEVICE,
+    TRACE_ACTION_MARKERS,
+    TRACE_ACTION_TRACING,
+    TRACE_ACTION_LOOP,
+    TRACE_ACTION_SEGMENTS,
+    TRACE_ACTION_REPLACE
+};
+
+/**
+ * @brief One timestamped event.
+*/
+typedef struct {
+    uint64_t nanoseconds;  /* When it happened on the clock of the output */
+    int64_t value;  /* The frames, the result or the action */
+    uint16_t type;  /* One of TraceEventType */
+    uint16_t device;  /* The sound device, 0 for the first one */
+    uint8_t __align[4];
+} TraceEvent;
+
+/**
+ * @brief The last events of one thread.
+ *
+ * Only one thread records, it overwrites the oldest events and never
+ * blocks. Readers copy the ring and drop the events that were overwritten
+ * while copying. The recording thread can also copy the ring into the
+ * snapshot, e.g. when a device ran out of frames, unless a reader holds
+ * the snapshot at that moment.
+*/
+typedef struct {
+    TraceEvent *events;  /* The ring */
+    TraceEvent *snapshot;  /* The events of the ring in order when the snapshot was taken */
+    uint32_t size;  /* The amount of events the ring and the snapshot hold */
+    uint32_t snapshotCount;  /* The amount of events in the snapshot */
+    _Atomic uint64_t head;  /* The amount of events ever recorded */
+    _Atomic uint32_t snapshotState;  /* Whether the snapshot is empty, ready or busy */
+    uint8_t __align[4];
+} TraceRing;
+
+/**
+ * Allocates a ring.
+ *
+ * @param size The amount of events it holds.
+ * @return The ring or NULL if it could not be allocated.
+*/
+TraceRing * traceInit(uint32_t size);
+/**
+ * Frees a ring.
+ *
+ * @param ring The ring.
+*/
+void traceFree(TraceRing *ring);
+/**
+ * Records an event that happened at some time.
+ *
+ * @param ring The ring only the calling thread records into.
+ * @param time When it happened on the clock of the output.
+ * @param type One of TraceEventType.
+ * @param device The sound device.
+ * @param value The frames, the result or the action.
+*/
+void traceRecordAt(
+    TraceRing *ring, const struct timespec *time, uint16_t type, uint16_t device,
+    int64_t value
+);
+/**
+ * Copies the ring into the snapshot unless a reader holds it.
+ *
+ * @param ring The ring only the calling thread records into.
+*/
+void traceTakeSnapshot(TraceRing *ring);
+/**
+ * Copies the events of the ring in order.
+ *
+ * @param ring The ring.
+ * @param events Room for the size of the ring.
+ * @return The amount of events copied.
+*/
+uint32_t traceCopy(TraceRing *ring, TraceEvent *events);
+/**
+ * Copies the events of the snapshot.
+ *
+ * @param ring The ring.
+ * @param events Room for the size of the ring.
+ * @param eventCount The amount of events copied.
+ * @return Whether a snapshot was taken.
+*/
+bool traceCopySnapshot(TraceRing *ring, TraceEvent *events, uint32_t *eventCount);
+/**
+ * Writes events in the Chrome trace event format.
+ *
+ * The audio thread is shown as thread 1 and the user threads waiting for
+ * actions as thread 2. Writes are slices, the ALSA buffer levels counters
+ * and everything else instant events.
+ *
+ * @param file The file.
+ * @param events The events.
+ * @param eventCount The amount of events.
+ * @return Whether the file was written.
+*/
+bool traceWriteChrome(FILE *file, const TraceEvent *events, uint32_t eventCount);
+
+#endif // __TRACE_H__
@@ -1,9 +1,18 @@
+import array
 import ctypes
+import errno
+import fcntl
+import json
+import math
 import os
 import pytest
+import select
+import struct
 import subprocess
 import tempfile
+import threading
 import time
+import wave
 
 from itertools import product
 from typing import Dict, List
@@ -19,6 +28,27 @@ class AudioConfiguration(ctypes.Structure):
     ]
 
 
+class AudioLoaderConfiguration(ctypes.Structure):
+    _fields_ = [
+        ("readaheadMilliseconds", ctypes.c_uint32),
+        ("keepBehindMilliseconds", ctypes.c_uint32),
+        ("populateThreshold", ctypes.c_size_t),
+        ("dropBehind", ctypes.c_bool),
+        ("useHugePages", ctypes.c_bool),
+        ("useStreaming", ctypes.c_bool),
+        ("streamBlockSize", ctypes.c_uint32),
+        ("streamQueueDepth", ctypes.c_uint32),
+    ]
+
+
+AUDIO_RESIDENCY_LOSSLESS = 1
+AUDIO_RESIDENCY_16_BIT = 2
+AUDIO_RESIDENCY_ADPCM = 3
+
+AUDIO_BUFFER_COPY = 1
+AUDIO_BUFFER_DEDUPLICATE = 2
+
+
 class AudioError(ctypes.Structure):
     _fields_ = [
         ("type", ctypes.c_int),
@@ -26,6 +56,159 @@ class AudioError(ctypes.Structure):
         ("alsaErrorNumber", ctypes.c_int)
     ]
 
+class AudioPeak(ctypes.Structure):
+    _fields_ = [
+        ("min", ctypes.c_int16),
+        ("max", ctypes.c_int16),
+        ("rms", ctypes.c_uint16)
+    ]
+
+
+AUDIO_PEAK_LEVEL_64 = 0
+AUDIO_PEAK_LEVEL_4096 = 2
+
+
+class AudioLoudness(ctypes.Structure):
+    _fields_ = [
+        ("integratedLoudness", ctypes.c_float),
+        ("loudnessRange", ctypes.c_float),
+        ("truePeak", ctypes.c_float)
+    ]
+
+
+AUDIO_PROBE_MAX_CHUNKS = 16
+
+
+class AudioChunk(ctypes.Structure):
+    _fields_ = [
+        ("id", ctypes.c_char * 4),
+        ("size", ctypes.c_uint32),
+        ("offset", ctypes.c_uint64)
+    ]
+
+
+class AudioProbe(ctypes.Structure):
+    _fields_ = [
+        ("error", AudioError),
+        ("fileSize", ctypes.c_uint64),
+        ("frameCount", ctypes.c_uint64),
+        ("durationMilliseconds", ctypes.c_uint32),
+        ("sampleRate", ctypes.c_uint32),
+        ("dataSize", ctypes.c_uint32),
+        ("cueCount", ctypes.c_uint32),
+        ("format", ctypes.c_uint16),
+        ("channelAmount", ctypes.c_uint16),
+        ("bitsPerSample", ctypes.c_uint16),
+        ("chunkCount", ctypes.c_uint16),
+        ("chunks", AudioChunk * AUDIO_PROBE_MAX_CHUNKS)
+    ]
+
+
+AUDIO_MAX_DEVICES = 8
+
+
+class AudioDeviceSync(ctypes.Structure):
+    _fields_ = [
+        ("offsetMicroseconds", ctypes.c_float),
+        ("driftPpm", ctypes.c_float),
+        ("correctionPpm", ctypes.c_float),
+        ("isLinked", ctypes.c_bool)
+    ]
+
+
+AUDIO_EVENT_END_REACHED = 0
+AUDIO_EVENT_STATE_CHANGED = 1
+AUDIO_EVENT_MARKER = 2
+AUDIO_EVENT_XRUN = 3
+AUDIO_EVENT_ERROR = 4
+AUDIO_STATE_STOPPED = 0
+AUDIO_STATE_PLAYING = 1
+AUDIO_STATE_PAUSED = 2
+
+
+AUDIO_RENDER_PLAY = 0
+AUDIO_RENDER_PAUSE = 1
+AUDIO_RENDER_JUMP = 3
+
+
+class AudioRenderCommand(ctypes.Structure):
+    _fields_ = [
+        ("milliseconds", ctypes.c_uint64),
+        ("object", ctypes.c_uint32),
+        ("action", ctypes.c_int),
+        ("value", ctypes.c_double)
+    ]
+
+
+class AudioEvent(ctypes.Structure):
+    _fields_ = [
+        ("type", ctypes.c_int),
+        ("state", ctypes.c_int),
+        ("frame", ctypes.c_uint32),
+        ("markerId", ctypes.c_uint32),
+        ("droppedEvents", ctypes.c_uint32),
+        ("nanoseconds", ctypes.c_uint64),
+        ("error", AudioError)
+    ]
+
+
+AUDIO_HISTOGRAM_BUCKETS = 200
+
+
+class AudioHistogram(ctypes.Structure):
+    _fields_ = [
+        ("count", ctypes.c_uint64),
+        ("averageMicroseconds", ctypes.c_float),
+        ("maxMicroseconds", ctypes.c_float),
+        ("buckets", ctypes.c_uint64 * AUDIO_HISTOGRAM_BUCKETS)
+    ]
+
+
+class AudioStats(ctypes.Structure):
+    _fields_ = [
+        ("wakeups", ctypes.c_uint64),
+        ("refills", ctypes.c_uint64),
+        ("framesWritten", ctypes.c_uint64),
+        ("xruns", ctypes.c_uint64),
+        ("commands", ctypes.c_uint64),
+        ("minorFaults", ctypes.c_uint64),
+        ("majorFaults", ctypes.c_uint64),
+        ("bufferFrames", ctypes.c_uint32),
+        ("maxAvailFrames", ctypes.c_uint32),
+        ("minDelayFrames", ctypes.c_uint32),
+        ("averageAvailFrames", ctypes.c_float),
+        ("averageDelayFrames", ctypes.c_float),
+        ("refill", AudioHistogram),
+        ("command", AudioHistogram),
+        ("headroom", AudioHistogram)
+    ]
+
+
+class AudioCue(ctypes.Structure):
+    _fields_ = [
+        ("id", ctypes.c_uint32),
+        ("frame", ctypes.c_uint32),
+        ("milliseconds", ctypes.c_uint32),
+        ("label", ctypes.c_char_p)
+    ]
+
+
+class AudioLoop(ctypes.Structure):
+    _fields_ = [
+        ("startFrame", ctypes.c_uint32),
+        ("endFrame", ctypes.c_uint32),
+        ("count", ctypes.c_uint32),
+        ("crossfadeMilliseconds", ctypes.c_uint32)
+    ]
+
+
+class AudioClock(ctypes.Structure):
+    _fields_ = [
+        ("frame", ctypes.c_uint32),
+        ("milliseconds", ctypes.c_uint32),
+        ("loopCount", ctypes.c_uint32)
+    ]
+
 sample_rates: List[int] = [8000, 44100]  # Hz
 number_of_channels: List[int] = [1, 2, 3, 5]
 bit_depths: List[int] = [8, 16, 24, 32]
@@ -48,6 +231,7 @@ def synth_audio(filename: str, configuration: Dict[str, int]):
         "sox", "-n", "-R",
         "-r", str(configuration["sample_rate"]),
         "-b", str(configuration["bit_depth"]),
+        *(["-e", configuration["encoding"]] if "encoding" in configuration else []),
         "-c", str(configuration["number_of_channels"]),
         filename,
         "synth",
@@ -65,6 +249,9 @@ def synth_audio(filename: str, configuration: Dict[str, int]):
     assert process.returncode == 0, f"Failed to generate audio: {stderr}"
 
 
+AudioBatchCallback = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_uint32, ctypes.c_void_p)
+
+
 def bind_libaudio() -> ctypes.CDLL:
     libaudio = ctypes.CDLL("build/libaudio.so")
 
@@ -72,6 +259,108 @@ def bind_libaudio() -> ctypes.CDLL:
 
     libaudio.audioInit.argtypes = [ctypes.POINTER(AudioConfiguration)]
     libaudio.audioInit.restype = ctypes.POINTER(ctypes.c_void_p)
+    libaudio.audioInitCompact.argtypes = [
+        ctypes.POINTER(AudioConfiguration), ctypes.c_int
+    ]
+    libaudio.audioInitCompact.restype = ctypes.POINTER(ctypes.c_void_p)
+    libaudio.audioInitFromPath.argtypes = [
+        ctypes.POINTER(AudioConfiguration), 
+        ctypes.c_char_p, 
+        ctypes.POINTER(AudioLoaderConfiguration)
+    ]
+    libaudio.audioInitFromPath.restype = ctypes.POINTER(ctypes.c_void_p)
+    libaudio.audioSetPcmPool.argtypes = [ctypes.c_uint32, ctypes.c_uint32]
+    libaudio.audioSetPcmPool.restype = None
+    libaudio.audioGetPcmPoolSize.argtypes = []
+    libaudio.audioGetPcmPoolSize.restype = ctypes.c_uint32
+    libaudio.audioInitBatch.argtypes = [
+        ctypes.POINTER(AudioConfiguration), ctypes.c_uint32, ctypes.c_uint32, 
+        AudioBatchCallback, ctypes.c_void_p
+    ]
+    libaudio.audioInitBatch.restype = ctypes.c_void_p
+    libaudio.audioBatchGetFd.argtypes = [ctypes.c_void_p]
+    libaudio.audioBatchGetFd.restype = ctypes.c_int
+    libaudio.audioBatchReadObjects.argtypes = [
+        ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint32), ctypes.c_uint32
+    ]
+    libaudio.audioBatchReadObjects.restype = ctypes.c_uint32
+    libaudio.audioBatchGetObject.argtypes = [
+        ctypes.c_void_p, ctypes.c_uint32, ctypes.POINTER(ctypes.c_void_p)
+    ]
+    libaudio.audioBatchGetObject.restype = ctypes.c_bool
+    libaudio.audioBatchWait.argtypes = [ctypes.c_void_p]
+    libaudio.audioBatchWait.restype = ctypes.c_uint32
+    libaudio.audioBatchDestroy.argtypes = [ctypes.c_void_p]
+    libaudio.audioBatchDestroy.restype = None
+    libaudio.audioBufferInit.argtypes = [
+        ctypes.c_void_p, ctypes.c_size_t, ctypes.c_uint32
+    ]
+    libaudio.audioBufferInit.restype = ctypes.POINTER(ctypes.c_void_p)
+    libaudio.audioBufferInitFromPath.argtypes = [ctypes.c_char_p, ctypes.c_uint32]
+    libaudio.audioBufferInitFromPath.restype = ctypes.POINTER(ctypes.c_void_p)
+    libaudio.audioBufferRetain.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
+    libaudio.audioBufferRetain.restype = None
+    libaudio.audioBufferRelease.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
+    libaudio.audioBufferRelease.restype = None
+    libaudio.audioBufferGetError.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
+    libaudio.audioBufferGetError.restype = ctypes.POINTER(AudioError)
+    libaudio.audioInitFromBuffer.argtypes = [
+        ctypes.POINTER(AudioConfiguration), ctypes.POINTER(ctypes.c_void_p)
+    ]
+    libaudio.audioInitFromBuffer.restype = ctypes.POINTER(ctypes.c_void_p)
+    libaudio.audioBankPack.argtypes = [
+        ctypes.c_char_p, ctypes.POINTER(ctypes.c_char_p), 
+        ctypes.POINTER(ctypes.c_char_p), ctypes.c_uint32, 
+        ctypes.POINTER(AudioError)
+    ]
+    libaudio.audioBankPack.restype = ctypes.c_bool
+    libaudio.audioBankOpen.argtypes = [ctypes.c_char_p]
+    libaudio.audioBankOpen.restype = ctypes.POINTER(ctypes.c_void_p)
+    libaudio.audioBankClose.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
+    libaudio.audioBankClose.restype = None
+    libaudio.audioBankGetError.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
+    libaudio.audioBankGetError.restype = ctypes.POINTER(AudioError)
+    libaudio.audioBankGetClipCount.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
+    libaudio.audioBankGetClipCount.restype = ctypes.c_uint32
+    libaudio.audioBankFindClip.argtypes = [
+        ctypes.POINTER(ctypes.c_void_p), ctypes.c_char_p, 
+        ctypes.POINTER(ctypes.c_uint32)
+    ]
+    libaudio.audioBankFindClip.restype = ctypes.c_bool
+    libaudio.audioBankGetClipDuration.argtypes = [
+        ctypes.POINTER(ctypes.c_void_p), ctypes.c_uint32
+    ]
+    libaudio.audioBankGetClipDuration.restype = ctypes.c_uint32
+    libaudio.audioInitFromBank.argtypes = [
+        ctypes.POINTER(AudioConfiguration), ctypes.POINTER(ctypes.c_void_p), 
+        ctypes.c_uint32
+    ]
+    libaudio.audioInitFromBank.restype = ctypes.POINTER(ctypes.c_void_p)
+    libaudio.audioPeaksInit.argtypes = [ctypes.c_char_p, ctypes.c_uint32]
+    libaudio.audioPeaksInit.restype = ctypes.POINTER(ctypes.c_void_p)
+    libaudio.audioPeaksDestroy.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
+    libaudio.audioPeaksDestroy.restype = None
+    libaudio.audioPeaksGetError.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
+    libaudio.audioPeaksGetError.restype = ctypes.POINTER(AudioError)
+    libaudio.audioPeaksGetChannelAmount.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
+    libaudio.audioPeaksGetChannelAmount.restype = ctypes.c_uint16
+    libaudio.audioPeaksGet.argtypes = [
+        ctypes.POINTER(ctypes.c_void_p), ctypes.c_int, ctypes.c_uint32, 
+        ctypes.c_uint32, ctypes.POINTER(AudioPeak), ctypes.c_uint32
+    ]
+    libaudio.audioPeaksGet.restype = ctypes.c_uint32
+    libaudio.audioProbe.argtypes = [ctypes.c_char_p, ctypes.POINTER(AudioProbe)]
+    libaudio.audioProbe.restype = ctypes.c_bool
+    libaudio.audioProbeFiles.argtypes = [
+        ctypes.POINTER(ctypes.c_char_p), ctypes.c_uint32, ctypes.c_uint32, 
+        ctypes.POINTER(AudioProbe)
+    ]
+    libaudio.audioProbeFiles.restype = None
+    libaudio.audioAnalyzeLoudness.argtypes = [
+        ctypes.c_char_p, ctypes.c_uint32, ctypes.POINTER(AudioLoudness), 
+        ctypes.POINTER(AudioError)
+    ]
+    libaudio.audioAnalyzeLoudness.restype = ctypes.c_bool
     libaudio.audioDestroy.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
     libaudio.audioDestroy.restype = None
 
@@ -95,6 +384,34 @@ def bind_libaudio() -> ctypes.CDLL:
         ctypes.POINTER(ctypes.c_void_p), ctypes.c_uint64
     ]
     libaudio.audioJump.restype = ctypes.c_bool
+    libaudio.audioGetCues.argtypes = [
+        ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_uint32)
+    ]
+    libaudio.audioGetCues.restype = ctypes.POINTER(AudioCue)
+    libaudio.audioJumpToCue.argtypes = [
+        ctypes.POINTER(ctypes.c_void_p), 
+        ctypes.POINTER(ctypes.c_void_p), ctypes.c_uint32
+    ]
+    libaudio.audioJumpToCue.restype = ctypes.c_bool
+    libaudio.audioSetCuePreload.argtypes = [
+        ctypes.POINTER(ctypes.c_void_p), ctypes.c_uint32
+    ]
+    libaudio.audioSetCuePreload.restype = ctypes.c_bool
+    libaudio.audioGetFileLoop.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(AudioLoop)]
+    libaudio.audioGetFileLoop.restype = ctypes.c_bool
+    libaudio.audioSetLoop.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(AudioLoop)]
+    libaudio.audioSetLoop.restype = ctypes.c_bool
+    libaudio.audioGetClock.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(AudioClock)]
+    libaudio.audioGetClock.restype = None
+    libaudio.audioAppendSegment.argtypes = [
+        ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_void_p),
+        ctypes.c_uint32, ctypes.c_uint32, ctypes.POINTER(ctypes.c_uint32)
+    ]
+    libaudio.audioAppendSegment.restype = ctypes.c_bool
+    libaudio.audioReplaceData.argtypes = [
+        ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_void_p), ctypes.c_uint32
+    ]
+    libaudio.audioReplaceData.restype = ctypes.c_bool
 
     libaudio.audioGetIsPlaying.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
     libaudio.audioGetIsPlaying.restype = ctypes.c_bool
@@ -104,6 +421,21 @@ def bind_libaudio() -> ctypes.CDLL:
     libaudio.audioGetCurrentTime.restype = ctypes.c_uint64
     libaudio.audioGetTotalDuration.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
     libaudio.audioGetTotalDuration.restype = ctypes.c_uint64
+    libaudio.audioGetMajorFaultsPerMinute.argtypes = [
+        ctypes.POINTER(ctypes.c_void_p)
+    ]
+    libaudio.audioGetMajorFaultsPerMinute.restype = ctypes.c_float
+    libaudio.audioGetDecoderLoad.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
+    libaudio.audioGetDecoderLoad.restype = ctypes.c_float
+    libaudio.audioGetCompressionRatio.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
+    libaudio.audioGetCompressionRatio.restype = ctypes.c_float
+    libaudio.audioSetLockedWindow.argtypes = [
+        ctypes.POINTER(ctypes.c_void_p), 
+        ctypes.c_uint32, ctypes.c_uint32, ctypes.c_size_t
+    ]
+    libaudio.audioSetLockedWindow.restype = ctypes.c_bool
+    libaudio.audioGetLockedBytes.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
+    libaudio.audioGetLockedBytes.restype = ctypes.c_size_t
 
     libaudio.audioSetVolume.argtypes = [
         ctypes.POINTER(ctypes.c_void_p), ctypes.c_uint8
@@ -111,7 +443,56 @@ def bind_libaudio() -> ctypes.CDLL:
     libaudio.audioSetVolume.restype = ctypes.c_bool
     libaudio.audioGetVolume.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
     libaudio.audioGetVolume.restype = ctypes.c_uint8
+    libaudio.audioSetGain.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.c_float]
+    libaudio.audioSetGain.restype = ctypes.c_bool
+    libaudio.audioNormalizeLoudness.argtypes = [
+        ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(AudioLoudness), ctypes.c_float
+    ]
+    libaudio.audioNormalizeLoudness.restype = ctypes.c_bool
 
+    libaudio.audioAddDevice.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.c_char_p]
+    libaudio.audioAddDevice.restype = ctypes.c_bool
+    libaudio.audioGetDeviceCount.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
+    libaudio.audioGetDeviceCount.restype = ctypes.c_uint32
+    libaudio.audioGetDeviceSync.argtypes = [
+        ctypes.POINTER(ctypes.c_void_p), ctypes.c_uint32, ctypes.POINTER(AudioDeviceSync)
+    ]
+    libaudio.audioGetDeviceSync.restype = ctypes.c_bool
+    libaudio.audioSetSinkWriteDelay.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.c_uint32, ctypes.c_uint32]
+    libaudio.audioSetSinkWriteDelay.restype = ctypes.c_bool
+    libaudio.audioGetPipeBacklog.argtypes = [
+        ctypes.POINTER(ctypes.c_void_p), ctypes.c_uint32, ctypes.POINTER(ctypes.c_uint32)
+    ]
+    libaudio.audioGetPipeBacklog.restype = ctypes.c_bool
+    libaudio.audioGetEventFd.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
+    libaudio.audioGetEventFd.restype = ctypes.c_int
+    libaudio.audioReadEvents.argtypes = [
+        ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(AudioEvent), ctypes.c_uint32
+    ]
+    libaudio.audioReadEvents.restype = ctypes.c_uint32
+    libaudio.audioAddMarker.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.c_uint32, ctypes.c_uint32]
+    libaudio.audioAddMarker.restype = ctypes.c_bool
+    libaudio.audioRemoveMarker.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.c_uint32]
+    libaudio.audioRemoveMarker.restype = ctypes.c_bool
+    libaudio.audioGetStats.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(AudioStats)]
+    libaudio.audioGetStats.restype = None
+    libaudio.audioGetHistogramBucketStart.argtypes = [ctypes.c_uint32]
+    libaudio.audioGetHistogramBucketStart.restype = ctypes.c_uint64
+    libaudio.audioGetHistogramPercentile.argtypes = [ctypes.POINTER(AudioHistogram), ctypes.c_float]
+    libaudio.audioGetHistogramPercentile.restype = ctypes.c_float
+    libaudio.audioFormatStats.argtypes = [
+        ctypes.POINTER(AudioStats), ctypes.c_bool, ctypes.c_char_p, ctypes.c_size_t
+    ]
+    libaudio.audioFormatStats.restype = ctypes.c_size_t
+    libaudio.audioSetTracing.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.c_uint32]
+    libaudio.audioSetTracing.restype = ctypes.c_bool
+    libaudio.audioWriteTrace.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.c_char_p, ctypes.c_bool]
+    libaudio.audioWriteTrace.restype = ctypes.c_bool
+    libaudio.audioRender.argtypes = [
+        ctypes.POINTER(ctypes.c_void_p), ctypes.c_uint32,
+        ctypes.POINTER(AudioRenderCommand), ctypes.c_uint32, ctypes.c_uint64
+    ]
+    libaudio.audioRender.restype = ctypes.c_bool
     libaudio.audioGetError.argtypes = [ctypes.POINTER(ctypes.c_void_p)]
     libaudio.audioGetError.restype = ctypes.POINTER(AudioError)
     libaudio.audioGetErrorString.argtypes = [ctypes.POINTER(AudioError)]
@@ -227,3 +608,1971 @@ def test_audio(configuration: Dict[str, int]):
 
     if os.path.exists(file.name):
         os.remove(file.name)
+
+
+loader_configurations: List[Dict[str, int]] = [
+    {"populate_threshold": 0, "drop_behind": False, "use_huge_pages": False, "use_streaming": False},
+    {"populate_threshold": 0, "drop_behind": False, "use_huge_pages": True, "use_streaming": False},
+    {"populate_threshold": 1, "drop_behind": True, "use_huge_pages": False, "use_streaming": False},
+    {"populate_threshold": 0, "drop_behind": False, "use_huge_pages": False, "use_streaming": True},
+]
+
+
+@pytest.mark.parametrize(
+    "loader_configuration", loader_configurations,
+    ids=["populate", "huge_pages", "windowed", "streaming"]
+)
+def test_audio_from_path(loader_configuration: Dict[str, int]):
+    configuration = {
+        "sample_rate": 44100, 
+        "number_of_channels": 2, 
+        "bit_depth": 16, 
+        "duration": 1
+    }
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+
+    audio_configuration = AudioConfiguration(
+        rawData=None,
+        rawDataSize=0,
+        soundDeviceName=str.encode("default"),
+        soundDeviceNameSize=7,
+        timeResolution=50  # ms
+    )
+    audio_loader_configuration = AudioLoaderConfiguration(
+        readaheadMilliseconds=200,
+        keepBehindMilliseconds=100,
+        populateThreshold=loader_configuration["populate_threshold"],
+        dropBehind=loader_configuration["drop_behind"],
+        useHugePages=loader_configuration["use_huge_pages"],
+        useStreaming=loader_configuration["use_streaming"],
+        streamBlockSize=4096,
+        streamQueueDepth=4
+    )
+
+    # initialize
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), 
+        str.encode(file.name), 
+        ctypes.byref(audio_loader_configuration)
+    )
+    assert audio_object is not None, "Failed to initialize"
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+    assert (
+        libaudio.audioGetTotalDuration(audio_object)
+    ) == configuration['duration'] * 1000, "Failed to get total duration"
+    assert libaudio.audioSetLockedWindow(audio_object, 200, 100, 0), "Failed to lock window"
+
+    # play, jump back and play until the end
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(configuration['duration'] / 2)
+    assert libaudio.audioJump(audio_object, None, 100), "Failed to jump"
+    time.sleep(configuration['duration'])
+    assert not libaudio.audioGetIsPlaying(audio_object), "Failed to reach end"
+    assert libaudio.audioGetMajorFaultsPerMinute(audio_object) >= 0, "Failed to get major faults"
+
+    libaudio.audioDestroy(audio_object)
+
+    if os.path.exists(file.name):
+        os.remove(file.name)
+
+
+def test_audio_stream_read_error():
+    configuration = {"sample_rate": 44100, "number_of_channels": 2, "bit_depth": 16, "duration": 2}
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+    audio_configuration = AudioConfiguration(
+        rawData=None,
+        rawDataSize=0,
+        soundDeviceName=str.encode("default"),
+        soundDeviceNameSize=7,
+        timeResolution=10  # ms
+    )
+    audio_loader_configuration = AudioLoaderConfiguration(
+        useStreaming=True, streamBlockSize=4096, streamQueueDepth=4
+    )
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), str.encode(file.name), 
+        ctypes.byref(audio_loader_configuration)
+    )
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+
+    # the file ends early, so the stream fails and the playback stops
+    os.truncate(file.name, 65536)
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    events = wait_for_events(libaudio, audio_object, AUDIO_STATE_STOPPED, 3)
+    errors = [event.error for event in events if event.type == AUDIO_EVENT_ERROR]
+    assert errors and errors[0].level == 2 and errors[0].alsaErrorNumber == -errno.EIO, "Failed to report the failed read"
+    assert not any(event.type == AUDIO_EVENT_END_REACHED for event in events), "Failed to stop at the failed read"
+    assert not libaudio.audioGetIsPlaying(audio_object), "Failed to stop at the failed read"
+    libaudio.audioDestroy(audio_object)
+    os.remove(file.name)
+
+
+def test_audio_from_missing_path():
+    libaudio = bind_libaudio()
+    audio_configuration = AudioConfiguration(
+        rawData=None,
+        rawDataSize=0,
+        soundDeviceName=str.encode("default"),
+        soundDeviceNameSize=7,
+        timeResolution=50  # ms
+    )
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), b"/nonexistent.wav", None
+    )
+    assert audio_object is not None, "Failed to initialize"
+    assert libaudio.audioGetError(audio_object).contents.level == 2, "Failed to report missing file"
+    libaudio.audioDestroy(audio_object)
+
+
+def test_audio_locked_window():
+    configuration = {
+        "sample_rate": 48000, 
+        "number_of_channels": 2, 
+        "bit_depth": 16, 
+        "duration": 1
+    }
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+
+    with open(file.name, "rb") as file:
+        buffer = bytearray(file.read())
+        file_size = os.path.getsize(file.name)
+
+    audio_configuration = create_audio_configuration(buffer, file_size)
+    audio_object = libaudio.audioInit(ctypes.byref(audio_configuration))
+    assert audio_object is not None, "Failed to initialize"
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+
+    # lock 200 ms ahead and 100 ms behind the playhead
+    assert libaudio.audioSetLockedWindow(audio_object, 200, 100, 0), "Failed to lock window"
+    assert libaudio.audioGetLockedBytes(audio_object) >= 48000 * 4 // 5, "Failed to lock 200 ms"
+
+    # the window follows the playhead and jumps
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(configuration['duration'] / 2)
+    assert libaudio.audioJump(audio_object, None, 100), "Failed to jump"
+    time.sleep(configuration['duration'])
+    assert not libaudio.audioGetIsPlaying(audio_object), "Failed to reach end"
+    assert libaudio.audioGetLockedBytes(audio_object) > 0, "Failed to keep window locked"
+
+    # a small budget reduces the window
+    assert libaudio.audioSetLockedWindow(audio_object, 200, 100, 16384), "Failed to lock reduced window"
+    assert libaudio.audioGetError(audio_object).contents.level == 1, "Failed to warn about reduced window"
+    assert libaudio.audioGetLockedBytes(audio_object) <= 16384, "Failed to respect budget"
+
+    # unlock
+    assert not libaudio.audioSetLockedWindow(audio_object, 0, 0, 0), "Failed to unlock"
+    assert libaudio.audioGetLockedBytes(audio_object) == 0, "Failed to unlock everything"
+
+    libaudio.audioDestroy(audio_object)
+
+    if os.path.exists(file.name):
+        os.remove(file.name)
+
+
+def append_cues(buffer: bytearray, cues: Dict[int, int], labels: Dict[int, str]):
+    """Appends a cue chunk and a LIST/adtl chunk and fixes the RIFF size."""
+    cue_chunk = len(cues).to_bytes(4, "little")
+    for position, (cue_id, frame) in enumerate(cues.items()):
+        cue_chunk += b"".join(
+            value.to_bytes(4, "little") for value in (cue_id, position)
+        ) + b"data" + bytes(8) + frame.to_bytes(4, "little")
+    buffer += b"cue " + len(cue_chunk).to_bytes(4, "little") + cue_chunk
+    list_chunk = b"adtl"
+    for cue_id, label in labels.items():
+        text = label.encode() + b"\0"
+        list_chunk += b"labl" + (len(text) + 4).to_bytes(4, "little")
+        list_chunk += cue_id.to_bytes(4, "little") + text + bytes(len(text) % 2)
+    buffer += b"LIST" + len(list_chunk).to_bytes(4, "little") + list_chunk
+    buffer[4:8] = (len(buffer) - 8).to_bytes(4, "little")
+
+
+@pytest.mark.parametrize("source", ["pcm", "adpcm", "compact"])
+def test_audio_cues(source: str):
+    configuration = {
+        "sample_rate": 22050, 
+        "number_of_channels": 2, 
+        "bit_depth": 4 if source == "adpcm" else 16, 
+        **({"encoding": "ima-adpcm"} if source == "adpcm" else {}),
+        "duration": 1
+    }
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+
+    with open(file.name, "rb") as file:
+        buffer = bytearray(file.read())
+    # the cue point past the end is dropped
+    append_cues(buffer, {7: 11025, 1: 2205, 9: 10 ** 6}, {7: "chorus"})
+
+    audio_configuration = create_audio_configuration(buffer, len(buffer))
+    if source == "compact":
+        audio_object = libaudio.audioInitCompact(
+            ctypes.byref(audio_configuration), AUDIO_RESIDENCY_LOSSLESS
+        )
+    else:
+        audio_object = libaudio.audioInit(ctypes.byref(audio_configuration))
+    assert audio_object is not None, "Failed to initialize"
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+
+    # the cue points are sorted by position and carry their labels
+    cue_count = ctypes.c_uint32()
+    cues = libaudio.audioGetCues(audio_object, ctypes.byref(cue_count))
+    assert cue_count.value == 2, "Failed to read cue points"
+    assert [cues[i].id for i in range(2)] == [1, 7], "Failed to sort cue points"
+    assert [cues[i].milliseconds for i in range(2)] == [100, 500], "Failed to convert cue points"
+    assert [cues[i].label for i in range(2)] == [b"", b"chorus"], "Failed to read labels"
+
+    # jump to the preloaded frames and play until the end
+    assert libaudio.audioSetCuePreload(audio_object, 300), "Failed to preload cue points"
+    assert libaudio.audioGetError(audio_object).contents.level < 2, "Failed to preload cue points"
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    assert libaudio.audioJumpToCue(audio_object, None, 7), "Failed to jump to cue point"
+    assert libaudio.audioGetCurrentTime(audio_object) >= 500, "Failed to jump to cue point"
+    assert not libaudio.audioJumpToCue(audio_object, None, 2), "Failed to reject unknown cue point"
+    assert libaudio.audioGetError(audio_object).contents.level == 1, "Failed to warn about unknown cue point"
+    time.sleep(configuration['duration'])
+    assert not libaudio.audioGetIsPlaying(audio_object), "Failed to reach end"
+    assert not libaudio.audioSetCuePreload(audio_object, 0), "Failed to free preloaded frames"
+
+    libaudio.audioDestroy(audio_object)
+
+    if os.path.exists(file.name):
+        os.remove(file.name)
+
+
+adpcm_configurations: List[Dict[str, int]] = [
+    {"encoding": encoding, "number_of_channels": number_of_channels, "use_streaming": use_streaming}
+    for encoding, number_of_channels, use_streaming
+    in product(["ima-adpcm", "ms-adpcm"], [1, 2], [False, True])
+]
+
+
+@pytest.mark.parametrize(
+    "adpcm_configuration", adpcm_configurations,
+    ids=[f"{config['encoding']}_{config['number_of_channels']}ch{'_streaming' if config['use_streaming'] else ''}" for config in adpcm_configurations]
+)
+def test_audio_adpcm(adpcm_configuration: Dict[str, int]):
+    configuration = {
+        "sample_rate": 22050, 
+        "number_of_channels": adpcm_configuration["number_of_channels"], 
+        "bit_depth": 4, 
+        "encoding": adpcm_configuration["encoding"],
+        "duration": 1
+    }
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+
+    audio_configuration = AudioConfiguration(
+        rawData=None,
+        rawDataSize=0,
+        soundDeviceName=str.encode("default"),
+        soundDeviceNameSize=7,
+        timeResolution=50  # ms
+    )
+    audio_loader_configuration = AudioLoaderConfiguration(
+        useStreaming=adpcm_configuration["use_streaming"],
+        streamBlockSize=4096,
+        streamQueueDepth=4
+    )
+
+    # initialize
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), 
+        str.encode(file.name), 
+        ctypes.byref(audio_loader_configuration)
+    )
+    assert audio_object is not None, "Failed to initialize"
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+    assert (
+        libaudio.audioGetTotalDuration(audio_object)
+    ) == configuration['duration'] * 1000, "Failed to get total duration"
+
+    # play, jump into the middle of a block and play until the end
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(configuration['duration'] / 2)
+    assert libaudio.audioJump(audio_object, None, 100), "Failed to jump"
+    assert libaudio.audioGetCurrentTime(audio_object) >= 100, "Failed to jump to block"
+    time.sleep(configuration['duration'])
+    assert not libaudio.audioGetIsPlaying(audio_object), "Failed to reach end"
+
+    libaudio.audioDestroy(audio_object)
+
+    if os.path.exists(file.name):
+        os.remove(file.name)
+
+
+def test_audio_adpcm_invalid_fmt():
+    libaudio = bind_libaudio()
+
+    def ms_adpcm_file(fmt_size: int, extension: bytes) -> bytearray:
+        fmt_chunk = struct.pack("<4sIHHIIHH", b"fmt ", fmt_size, 2, 1, 22050, 11155, 256, 4) + extension
+        return bytearray(b"RIFF" + struct.pack("<I", 4 + len(fmt_chunk)) + b"WAVE" + fmt_chunk)
+
+    # the coefficient count lies behind the extension, the coefficient
+    # table is longer than the extension or the sizes disagree
+    buffers = [
+        ms_adpcm_file(20, struct.pack("<HH", 2, 500)),
+        ms_adpcm_file(38, struct.pack("<HHH", 20, 500, 32) + bytes(16)),
+        ms_adpcm_file(50, struct.pack("<HHH", 32, 500, 7) + bytes(28)),
+    ]
+    for buffer in buffers:
+        audio_configuration = create_audio_configuration(buffer, len(buffer))
+        audio_object = libaudio.audioInit(ctypes.byref(audio_configuration))
+        assert audio_object is not None, "Failed to initialize"
+        assert libaudio.audioGetError(audio_object).contents.level == 2, "Failed to report invalid ADPCM fmt chunk"
+        libaudio.audioDestroy(audio_object)
+
+
+flac_configurations: List[Dict[str, int]] = [
+    {"source": source, "bit_depth": bit_depth}
+    for source, bit_depth in product(["memory", "path", "streaming"], [16, 24])
+]
+
+
+@pytest.mark.parametrize(
+    "flac_configuration", flac_configurations,
+    ids=[f"{config['source']}_{config['bit_depth']}bit" for config in flac_configurations]
+)
+def test_audio_flac(flac_configuration: Dict[str, int]):
+    configuration = {
+        "sample_rate": 44100, 
+        "number_of_channels": 2, 
+        "bit_depth": flac_configuration["bit_depth"], 
+        "duration": 1
+    }
+    file = tempfile.NamedTemporaryFile(suffix=".flac", delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+
+    # initialize
+    if flac_configuration["source"] == "memory":
+        with open(file.name, "rb") as file:
+            buffer = bytearray(file.read())
+            file_size = os.path.getsize(file.name)
+        audio_configuration = create_audio_configuration(buffer, file_size)
+        audio_object = libaudio.audioInit(ctypes.byref(audio_configuration))
+    else:
+        audio_configuration = AudioConfiguration(
+            rawData=None,
+            rawDataSize=0,
+            soundDeviceName=str.encode("default"),
+            soundDeviceNameSize=7,
+            timeResolution=50  # ms
+        )
+        audio_loader_configuration = AudioLoaderConfiguration(
+            populateThreshold=1,
+            useStreaming=flac_configuration["source"] == "streaming"
+        )
+        audio_object = libaudio.audioInitFromPath(
+            ctypes.byref(audio_configuration), 
+            str.encode(file.name), 
+            ctypes.byref(audio_loader_configuration)
+        )
+    assert audio_object is not None, "Failed to initialize"
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+    assert (
+        libaudio.audioGetTotalDuration(audio_object)
+    ) == configuration['duration'] * 1000, "Failed to get total duration"
+
+    # play, jump back into the middle of a frame and play until the end
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(configuration['duration'] / 2)
+    assert libaudio.audioJump(audio_object, None, 100), "Failed to jump"
+    assert libaudio.audioGetCurrentTime(audio_object) >= 100, "Failed to jump to frame"
+    time.sleep(configuration['duration'])
+    assert not libaudio.audioGetIsPlaying(audio_object), "Failed to reach end"
+    assert libaudio.audioGetDecoderLoad(audio_object) > 0, "Failed to report decoder load"
+
+    libaudio.audioDestroy(audio_object)
+
+    if os.path.exists(file.name):
+        os.remove(file.name)
+
+
+def test_audio_invalid_flac():
+    libaudio = bind_libaudio()
+    buffer = bytearray(b"fLaC" + bytes(64))
+    audio_configuration = create_audio_configuration(buffer, len(buffer))
+    audio_object = libaudio.audioInit(ctypes.byref(audio_configuration))
+    assert audio_object is not None, "Failed to initialize"
+    assert libaudio.audioGetError(audio_object).contents.level == 2, "Failed to report invalid FLAC stream"
+    libaudio.audioDestroy(audio_object)
+
+
+compact_configurations: List[Dict[str, int]] = [
+    {"residency": residency, "bit_depth": bit_depth}
+    for residency, bit_depth in product(
+        [AUDIO_RESIDENCY_LOSSLESS, AUDIO_RESIDENCY_16_BIT, AUDIO_RESIDENCY_ADPCM], 
+        [8, 16, 24]
+    )
+]
+residency_names: Dict[int, str] = {
+    AUDIO_RESIDENCY_LOSSLESS: "lossless",
+    AUDIO_RESIDENCY_16_BIT: "16bit",
+    AUDIO_RESIDENCY_ADPCM: "adpcm"
+}
+
+
+@pytest.mark.parametrize(
+    "compact_configuration", compact_configurations,
+    ids=[f"{residency_names[config['residency']]}_{config['bit_depth']}bit" for config in compact_configurations]
+)
+def test_audio_compact(compact_configuration: Dict[str, int]):
+    configuration = {
+        "sample_rate": 44100, 
+        "number_of_channels": 2, 
+        "bit_depth": compact_configuration["bit_depth"], 
+        "duration": 1
+    }
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+
+    with open(file.name, "rb") as file:
+        buffer = bytearray(file.read())
+        file_size = os.path.getsize(file.name)
+    audio_configuration = create_audio_configuration(buffer, file_size)
+
+    # initialize, afterwards the raw data is not needed anymore
+    audio_object = libaudio.audioInitCompact(
+        ctypes.byref(audio_configuration), compact_configuration["residency"]
+    )
+    assert audio_object is not None, "Failed to initialize"
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+    buffer[:] = bytes(len(buffer))
+    assert (
+        libaudio.audioGetTotalDuration(audio_object)
+    ) == configuration['duration'] * 1000, "Failed to get total duration"
+
+    # white noise hardly compresses losslessly
+    ratio = libaudio.audioGetCompressionRatio(audio_object)
+    bit_depth = configuration["bit_depth"]
+    if compact_configuration["residency"] == AUDIO_RESIDENCY_LOSSLESS:
+        assert ratio > 0.95, "Lossless data grew too much"
+    elif compact_configuration["residency"] == AUDIO_RESIDENCY_16_BIT:
+        assert ratio == pytest.approx(max(bit_depth, 16) / 16, rel=0.01), "Failed to reduce to 16 bit"
+    else:
+        assert ratio > bit_depth / 4 * 0.95, "Failed to encode ADPCM"
+
+    # play, jump back and play until the end
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(configuration['duration'] / 2)
+    assert libaudio.audioJump(audio_object, None, 100), "Failed to jump"
+    assert libaudio.audioGetCurrentTime(audio_object) >= 100, "Failed to jump to block"
+    time.sleep(configuration['duration'])
+    assert not libaudio.audioGetIsPlaying(audio_object), "Failed to reach end"
+    if compact_configuration["residency"] != AUDIO_RESIDENCY_16_BIT:
+        assert libaudio.audioGetDecoderLoad(audio_object) > 0, "Failed to report decoder load"
+
+    libaudio.audioDestroy(audio_object)
+
+    if os.path.exists(file.name):
+        os.remove(file.name)
+
+
+def test_audio_compact_unsupported():
+    configuration = {
+        "sample_rate": 22050, 
+        "number_of_channels": 1, 
+        "bit_depth": 4, 
+        "encoding": "ima-adpcm",
+        "duration": 1
+    }
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+
+    with open(file.name, "rb") as file:
+        buffer = bytearray(file.read())
+        file_size = os.path.getsize(file.name)
+    audio_configuration = create_audio_configuration(buffer, file_size)
+    audio_object = libaudio.audioInitCompact(
+        ctypes.byref(audio_configuration), AUDIO_RESIDENCY_LOSSLESS
+    )
+    assert audio_object is not None, "Failed to initialize"
+    assert libaudio.audioGetError(audio_object).contents.level == 1, "Failed to warn about unsupported residency"
+    assert libaudio.audioGetCompressionRatio(audio_object) == 1.0, "Failed to keep the data as given"
+    libaudio.audioDestroy(audio_object)
+
+    if os.path.exists(file.name):
+        os.remove(file.name)
+
+
+@pytest.mark.parametrize("suffix", [".wav", ".flac"])
+def test_audio_buffer(suffix: str):
+    configuration = {
+        "sample_rate": 44100, 
+        "number_of_channels": 2, 
+        "bit_depth": 16, 
+        "duration": 1
+    }
+    file = tempfile.NamedTemporaryFile(suffix=suffix, delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+
+    # parse a copy once, afterwards the bytes are not needed anymore
+    with open(file.name, "rb") as file:
+        buffer = bytearray(file.read())
+        file_size = os.path.getsize(file.name)
+    char_array = (ctypes.c_char * len(buffer)).from_buffer(buffer)
+    audio_buffer = libaudio.audioBufferInit(
+        ctypes.addressof(char_array), file_size, 
+        AUDIO_BUFFER_COPY | AUDIO_BUFFER_DEDUPLICATE
+    )
+    assert audio_buffer is not None, "Failed to create buffer"
+    assert libaudio.audioBufferGetError(audio_buffer).contents.level == 0, "Failed to parse buffer"
+
+    # the same bytes and the same file give the same buffer
+    same_buffer = libaudio.audioBufferInit(
+        ctypes.addressof(char_array), file_size, AUDIO_BUFFER_DEDUPLICATE
+    )
+    assert ctypes.addressof(same_buffer.contents) == ctypes.addressof(audio_buffer.contents), "Failed to deduplicate bytes"
+    path_buffer = libaudio.audioBufferInitFromPath(
+        file.name.encode(), AUDIO_BUFFER_DEDUPLICATE
+    )
+    assert ctypes.addressof(path_buffer.contents) == ctypes.addressof(audio_buffer.contents), "Failed to deduplicate file"
+    libaudio.audioBufferRelease(same_buffer)
+    libaudio.audioBufferRelease(path_buffer)
+    del char_array
+    buffer[:] = bytes(len(buffer))
+
+    # two voices of one buffer outlive the caller's reference
+    audio_configuration = create_audio_configuration(bytearray(1), 0)
+    audio_objects = [
+        libaudio.audioInitFromBuffer(ctypes.byref(audio_configuration), audio_buffer)
+        for _ in range(2)
+    ]
+    libaudio.audioBufferRelease(audio_buffer)
+    for audio_object in audio_objects:
+        assert audio_object is not None, "Failed to initialize"
+        assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+        assert (
+            libaudio.audioGetTotalDuration(audio_object)
+        ) == configuration['duration'] * 1000, "Failed to get total duration"
+        assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(configuration['duration'] / 2)
+    assert libaudio.audioJump(audio_objects[1], None, 100), "Failed to jump"
+    time.sleep(configuration['duration'])
+    for audio_object in audio_objects:
+        assert not libaudio.audioGetIsPlaying(audio_object), "Failed to reach end"
+        libaudio.audioDestroy(audio_object)
+
+    if os.path.exists(file.name):
+        os.remove(file.name)
+
+
+def test_audio_buffer_invalid():
+    libaudio = bind_libaudio()
+    buffer = bytearray(b"RIFF" + bytes(64))
+    char_array = (ctypes.c_char * len(buffer)).from_buffer(buffer)
+    audio_buffer = libaudio.audioBufferInit(
+        ctypes.addressof(char_array), len(buffer), AUDIO_BUFFER_DEDUPLICATE
+    )
+    assert audio_buffer is not None, "Failed to create buffer"
+    assert libaudio.audioBufferGetError(audio_buffer).contents.level == 2, "Failed to report invalid data"
+
+    # the audio object reports the error of its buffer
+    audio_configuration = create_audio_configuration(buffer, 0)
+    audio_object = libaudio.audioInitFromBuffer(
+        ctypes.byref(audio_configuration), audio_buffer
+    )
+    assert audio_object is not None, "Failed to initialize"
+    assert libaudio.audioGetError(audio_object).contents.level == 2, "Failed to take over the error"
+    libaudio.audioDestroy(audio_object)
+    libaudio.audioBufferRelease(audio_buffer)
+
+    missing_buffer = libaudio.audioBufferInitFromPath(b"/nonexistent.wav", 0)
+    assert missing_buffer is not None, "Failed to create buffer"
+    assert libaudio.audioBufferGetError(missing_buffer).contents.level == 2, "Failed to report missing file"
+    libaudio.audioBufferRelease(missing_buffer)
+
+
+def get_peaks(libaudio: ctypes.CDLL, peaks, level: int, start: int, end: int) -> List[tuple]:
+    bucket_count = libaudio.audioPeaksGet(peaks, level, start, end, None, 0)
+    channel_amount = libaudio.audioPeaksGetChannelAmount(peaks)
+    buffer = (AudioPeak * (bucket_count * channel_amount))()
+    assert libaudio.audioPeaksGet(peaks, level, start, end, buffer, bucket_count) == bucket_count
+    return [(peak.min, peak.max, peak.rms) for peak in buffer]
+
+
+peaks_configurations: List[Dict[str, int]] = [
+    {"bit_depth": 16},
+    {"bit_depth": 24},
+    {"bit_depth": 32, "encoding": "floating-point"},
+    {"bit_depth": 8, "encoding": "a-law"},
+    {"bit_depth": 4, "encoding": "ima-adpcm"},
+    {"bit_depth": 16, "suffix": ".flac"},
+]
+
+
+@pytest.mark.parametrize(
+    "peaks_configuration", peaks_configurations,
+    ids=[f"{config.get('encoding', 'pcm')}_{config['bit_depth']}bit{config.get('suffix', '')}" for config in peaks_configurations]
+)
+def test_audio_peaks(peaks_configuration: Dict[str, int]):
+    configuration = {
+        "sample_rate": 44100, 
+        "number_of_channels": 2, 
+        "bit_depth": peaks_configuration["bit_depth"], 
+        **({"encoding": peaks_configuration["encoding"]} if "encoding" in peaks_configuration else {}),
+        "duration": 1
+    }
+    directory = tempfile.TemporaryDirectory()
+    path = os.path.join(directory.name, "audio" + peaks_configuration.get("suffix", ".wav"))
+    synth_audio(path, configuration)
+    libaudio = bind_libaudio()
+
+    # compute the peaks on several threads and cache them
+    peaks = libaudio.audioPeaksInit(path.encode(), 4)
+    assert peaks is not None, "Failed to compute peaks"
+    assert (error := libaudio.audioPeaksGetError(peaks)).contents.level == 0, f"ERROR while computing peaks:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+    assert libaudio.audioPeaksGetChannelAmount(peaks) == 2, "Failed to get channels"
+    fine = get_peaks(libaudio, peaks, AUDIO_PEAK_LEVEL_64, 0, 1000)
+    coarse = get_peaks(libaudio, peaks, AUDIO_PEAK_LEVEL_4096, 0, 1000)
+    assert len(fine) == 2 * ((44100 + 63) // 64), "Failed to get every bucket"
+    assert len(coarse) == 2 * ((44100 + 4095) // 4096), "Failed to get every coarse bucket"
+    assert all(low <= high and rms <= max(-low, high) + 1 for low, high, rms in fine), "Failed to compute peaks"
+    assert max(high for _, high, _ in fine) > 8192, "Failed to scale samples"
+    assert min(low for low, _, _ in coarse) == min(low for low, _, _ in fine), "Failed to merge buckets"
+    assert len(get_peaks(libaudio, peaks, AUDIO_PEAK_LEVEL_64, 500, 600)) == 2 * 70, "Failed to get time range"
+    libaudio.audioPeaksDestroy(peaks)
+
+    if peaks_configuration["bit_depth"] == 16 and "suffix" not in peaks_configuration:
+        # the finest buckets match the samples exactly
+        with open(path, "rb") as file:
+            data = file.read()
+        samples = array.array("h", data[data.index(b"data") + 8:])
+        for bucket in (0, 100, 689):
+            for channel in range(2):
+                values = samples[bucket * 128 + channel:(bucket + 1) * 128:2]
+                rms = int(math.sqrt(sum(value * value for value in values) // len(values)))
+                assert fine[2 * bucket + channel] == (min(values), max(values), rms), "Failed to compute exact peaks"
+
+    # the sidecar file is used until the audio file changes
+    sidecar = os.stat(path + ".peaks")
+    sidecar_time = sidecar.st_mtime_ns
+    peaks = libaudio.audioPeaksInit(path.encode(), 1)
+    assert libaudio.audioPeaksGetError(peaks).contents.level == 0, "Failed to read sidecar file"
+    assert get_peaks(libaudio, peaks, AUDIO_PEAK_LEVEL_64, 0, 1000) == fine, "Failed to cache peaks"
+    libaudio.audioPeaksDestroy(peaks)
+    assert os.stat(path + ".peaks").st_ino == sidecar.st_ino, "Failed to reuse sidecar file"
+    os.utime(path, ns=(sidecar_time, sidecar_time + 10 ** 9))
+    peaks = libaudio.audioPeaksInit(path.encode(), 1)
+    assert get_peaks(libaudio, peaks, AUDIO_PEAK_LEVEL_64, 0, 1000) == fine, "Failed to compute peaks on one thread"
+    libaudio.audioPeaksDestroy(peaks)
+    assert os.stat(path + ".peaks").st_ino != sidecar.st_ino, "Failed to invalidate sidecar file"
+
+    directory.cleanup()
+
+
+def test_audio_peaks_invalid():
+    libaudio = bind_libaudio()
+    directory = tempfile.TemporaryDirectory()
+    path = os.path.join(directory.name, "invalid.wav")
+    peaks = libaudio.audioPeaksInit(path.encode(), 0)
+    assert libaudio.audioPeaksGetError(peaks).contents.level == 2, "Failed to report missing file"
+    assert libaudio.audioPeaksGet(peaks, AUDIO_PEAK_LEVEL_64, 0, 1000, None, 0) == 0, "Failed to hide missing peaks"
+    libaudio.audioPeaksDestroy(peaks)
+
+    # a corrupt sidecar file is replaced
+    synth_audio(path, {"sample_rate": 8000, "number_of_channels": 1, "bit_depth": 16, "duration": 1})
+    with open(path + ".peaks", "wb") as file:
+        file.write(b"WAVPEAKS" + bytes(100))
+    peaks = libaudio.audioPeaksInit(path.encode(), 0)
+    assert libaudio.audioPeaksGetError(peaks).contents.level == 0, "Failed to replace sidecar file"
+    assert libaudio.audioPeaksGet(peaks, AUDIO_PEAK_LEVEL_64, 0, 1000, None, 0) == 125, "Failed to compute peaks"
+    libaudio.audioPeaksDestroy(peaks)
+    directory.cleanup()
+
+
+def synth_sine(filename: str, sample_rate: int, levels: List[tuple]):
+    """Writes a stereo 16 bit 997 Hz sine, levels are (seconds, dBFS) pairs."""
+    samples = array.array("h")
+    frame = 0
+    for seconds, level in levels:
+        amplitude = 32767 * 10 ** (level / 20)
+        for _ in range(int(seconds * sample_rate)):
+            value = round(amplitude * math.sin(2 * math.pi * 997 * frame / sample_rate))
+            samples.extend((value, value))
+            frame += 1
+    data = samples.tobytes()
+    fmt_chunk = b"".join(
+        value.to_bytes(size, "little") for value, size in 
+        ((1, 2), (2, 2), (sample_rate, 4), (sample_rate * 4, 4), (4, 2), (16, 2))
+    )
+    with open(filename, "wb") as file:
+        file.write(
+            b"RIFF" + (36 + len(data)).to_bytes(4, "little") + b"WAVE" 
+            + b"fmt " + len(fmt_chunk).to_bytes(4, "little") + fmt_chunk 
+            + b"data" + len(data).to_bytes(4, "little") + data
+        )
+
+
+def analyze_loudness(libaudio: ctypes.CDLL, path: str, thread_count: int) -> tuple:
+    loudness = AudioLoudness()
+    error = AudioError()
+    assert libaudio.audioAnalyzeLoudness(
+        path.encode(), thread_count, ctypes.byref(loudness), ctypes.byref(error)
+    ), f"ERROR while measuring loudness:{libaudio.audioGetErrorString(ctypes.byref(error)).decode('utf-8')}"
+    assert error.level == 0, "Failed to cache loudness"
+    return loudness.integratedLoudness, loudness.loudnessRange, loudness.truePeak
+
+
+def test_audio_loudness():
+    libaudio = bind_libaudio()
+    directory = tempfile.TemporaryDirectory()
+    path = os.path.join(directory.name, "audio.wav")
+    synth_sine(path, 48000, [(10, -20), (10, -30)])
+
+    # the ranges of several threads are measured like one pass
+    integrated, loudness_range, true_peak = analyze_loudness(libaudio, path, 1)
+    assert abs(integrated - (-20 + 10 * math.log10(0.55))) < 0.1, "Failed to measure integrated loudness"
+    assert abs(loudness_range - 10) < 0.2, "Failed to measure loudness range"
+    assert abs(true_peak - (-20)) < 0.1, "Failed to measure true peak"
+    os.remove(path + ".loudness")
+    threaded = analyze_loudness(libaudio, path, 4)
+    assert all(
+        abs(a - b) < 1e-3 for a, b in zip(threaded, (integrated, loudness_range, true_peak))
+    ), "Failed to merge threads"
+
+    # the sidecar file is used until the audio file changes
+    sidecar = os.stat(path + ".loudness")
+    assert analyze_loudness(libaudio, path, 0) == threaded, "Failed to cache loudness"
+    assert os.stat(path + ".loudness").st_ino == sidecar.st_ino, "Failed to reuse sidecar file"
+    os.utime(path, ns=(sidecar.st_mtime_ns, sidecar.st_mtime_ns + 10 ** 9))
+    analyze_loudness(libaudio, path, 0)
+    assert os.stat(path + ".loudness").st_ino != sidecar.st_ino, "Failed to invalidate sidecar file"
+
+    # silence is gated entirely
+    silence_path = os.path.join(directory.name, "silence.wav")
+    synth_sine(silence_path, 8000, [(1, -math.inf)])
+    integrated, loudness_range, true_peak = analyze_loudness(libaudio, silence_path, 0)
+    assert integrated == -math.inf and true_peak == -math.inf, "Failed to gate silence"
+    assert loudness_range == 0, "Failed to measure range of silence"
+
+    loudness = AudioLoudness()
+    error = AudioError()
+    assert not libaudio.audioAnalyzeLoudness(
+        os.path.join(directory.name, "missing.wav").encode(), 0, 
+        ctypes.byref(loudness), ctypes.byref(error)
+    ), "Failed to report missing file"
+    assert error.level == 2, "Failed to report missing file"
+    directory.cleanup()
+
+
+def test_audio_gain():
+    libaudio = bind_libaudio()
+    directory = tempfile.TemporaryDirectory()
+    path = os.path.join(directory.name, "audio.wav")
+    synth_sine(path, 22050, [(1, -6)])
+    loudness = AudioLoudness()
+    error = AudioError()
+    assert libaudio.audioAnalyzeLoudness(path.encode(), 0, ctypes.byref(loudness), ctypes.byref(error))
+
+    with open(path, "rb") as file:
+        buffer = bytearray(file.read())
+    audio_configuration = create_audio_configuration(buffer, len(buffer))
+    audio_object = libaudio.audioInit(ctypes.byref(audio_configuration))
+    assert audio_object is not None, "Failed to initialize"
+    assert libaudio.audioGetError(audio_object).contents.level == 0, "Failed to initialize"
+
+    # the gain changes while playing
+    assert libaudio.audioNormalizeLoudness(audio_object, ctypes.byref(loudness), -23), "Failed to normalize loudness"
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(0.3)
+    assert libaudio.audioSetGain(audio_object, 12), "Failed to set gain"
+    time.sleep(0.3)
+    assert libaudio.audioSetGain(audio_object, 0), "Failed to reset gain"
+    libaudio.audioDestroy(audio_object)
+
+    # companded samples are played without gain
+    alaw_path = os.path.join(directory.name, "alaw.wav")
+    synth_audio(alaw_path, {"sample_rate": 8000, "number_of_channels": 1, "bit_depth": 8, "encoding": "a-law", "duration": 1})
+    with open(alaw_path, "rb") as file:
+        buffer = bytearray(file.read())
+    audio_configuration = create_audio_configuration(buffer, len(buffer))
+    audio_object = libaudio.audioInit(ctypes.byref(audio_configuration))
+    assert not libaudio.audioSetGain(audio_object, -6), "Failed to reject companded samples"
+    assert libaudio.audioGetError(audio_object).contents.level == 1, "Failed to warn about companded samples"
+    libaudio.audioDestroy(audio_object)
+    directory.cleanup()
+
+
+def pack_bank(libaudio: ctypes.CDLL, bank_path: str, paths: List[str], names: List[str]) -> AudioError:
+    error = AudioError()
+    libaudio.audioBankPack(
+        bank_path.encode(), 
+        (ctypes.c_char_p * len(paths))(*[path.encode() for path in paths]), 
+        (ctypes.c_char_p * len(names))(*[name.encode() for name in names]), 
+        len(paths), ctypes.byref(error)
+    )
+    return error
+
+
+def test_audio_bank():
+    clip_configurations: Dict[str, Dict[str, int]] = {
+        "mono_8bit.wav": {"number_of_channels": 1, "bit_depth": 8},
+        "stereo_16bit.wav": {"number_of_channels": 2, "bit_depth": 16},
+        "stereo_24bit.wav": {"number_of_channels": 2, "bit_depth": 24},
+        "stereo_float.wav": {"number_of_channels": 2, "bit_depth": 32, "encoding": "floating-point"},
+        "mono_ima.wav": {"number_of_channels": 1, "bit_depth": 4, "encoding": "ima-adpcm"},
+        "stereo_16bit.flac": {"number_of_channels": 2, "bit_depth": 16},
+    }
+    directory = tempfile.TemporaryDirectory()
+    paths = []
+    for duration, (name, clip_configuration) in enumerate(clip_configurations.items(), 1):
+        paths.append(os.path.join(directory.name, name))
+        synth_audio(paths[-1], {"sample_rate": 22050, "duration": duration / 10, **clip_configuration})
+    libaudio = bind_libaudio()
+
+    # pack once, afterwards the clips are not needed anymore
+    bank_path = os.path.join(directory.name, "clips.bank")
+    error = pack_bank(libaudio, bank_path, paths, list(clip_configurations))
+    assert error.level == 0, f"Failed to pack:{libaudio.audioGetErrorString(ctypes.byref(error)).decode('utf-8')}"
+    for path in paths:
+        os.remove(path)
+
+    bank = libaudio.audioBankOpen(bank_path.encode())
+    assert bank is not None, "Failed to open bank"
+    assert libaudio.audioBankGetError(bank).contents.level == 0, "Failed to read bank"
+    assert libaudio.audioBankGetClipCount(bank) == len(clip_configurations), "Failed to count clips"
+    clip = ctypes.c_uint32()
+    assert not libaudio.audioBankFindClip(bank, b"missing.wav", ctypes.byref(clip)), "Failed to miss clip"
+
+    audio_configuration = create_audio_configuration(bytearray(1), 0)
+    audio_objects = []
+    for duration, name in enumerate(clip_configurations, 1):
+        assert libaudio.audioBankFindClip(bank, name.encode(), ctypes.byref(clip)), f"Failed to find {name}"
+        assert libaudio.audioBankGetClipDuration(bank, clip) == duration * 100, f"Failed to index duration of {name}"
+        audio_object = libaudio.audioInitFromBank(ctypes.byref(audio_configuration), bank, clip)
+        assert audio_object is not None, "Failed to initialize"
+        assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize {name}:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+        assert libaudio.audioGetTotalDuration(audio_object) == duration * 100, f"Failed to get total duration of {name}"
+        audio_objects.append(audio_object)
+
+    # the audio objects keep the bank mapped
+    missing_object = libaudio.audioInitFromBank(ctypes.byref(audio_configuration), bank, len(clip_configurations))
+    assert libaudio.audioGetError(missing_object).contents.level == 2, "Failed to report missing clip"
+    libaudio.audioDestroy(missing_object)
+    libaudio.audioBankClose(bank)
+    for audio_object in audio_objects:
+        assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(len(clip_configurations) / 10 + 0.3)
+    for audio_object in audio_objects:
+        assert not libaudio.audioGetIsPlaying(audio_object), "Failed to reach end"
+        libaudio.audioDestroy(audio_object)
+    directory.cleanup()
+
+
+def test_audio_bank_many_clips():
+    directory = tempfile.TemporaryDirectory()
+    path = os.path.join(directory.name, "click.wav")
+    synth_audio(path, {"sample_rate": 8000, "number_of_channels": 1, "bit_depth": 8, "duration": 0.1})
+    libaudio = bind_libaudio()
+
+    # a clip can be packed under several names
+    clip_count = 10000
+    bank_path = os.path.join(directory.name, "clips.bank")
+    names = [f"click_{i}" for i in range(clip_count)]
+    error = pack_bank(libaudio, bank_path, [path] * clip_count, names)
+    assert error.level == 0, "Failed to pack"
+
+    bank = libaudio.audioBankOpen(bank_path.encode())
+    assert libaudio.audioBankGetError(bank).contents.level == 0, "Failed to read bank"
+    assert libaudio.audioBankGetClipCount(bank) == clip_count, "Failed to count clips"
+    clips = set()
+    clip = ctypes.c_uint32()
+    for name in names:
+        assert libaudio.audioBankFindClip(bank, name.encode(), ctypes.byref(clip)), f"Failed to find {name}"
+        clips.add(clip.value)
+    assert len(clips) == clip_count, "Failed to tell clips apart"
+    libaudio.audioBankClose(bank)
+
+    # names have to be unique
+    error = pack_bank(libaudio, bank_path, [path] * 2, ["click", "click"])
+    assert error.level == 2, "Failed to reject duplicate names"
+    assert not os.path.exists(bank_path), "Failed to remove incomplete bank"
+    directory.cleanup()
+
+
+def test_audio_bank_invalid():
+    libaudio = bind_libaudio()
+    file = tempfile.NamedTemporaryFile(suffix=".bank", delete=False)
+    file.write(b"SNDBANK\0" + bytes(64))
+    file.close()
+    bank = libaudio.audioBankOpen(file.name.encode())
+    assert bank is not None, "Failed to open bank"
+    assert libaudio.audioBankGetError(bank).contents.level == 2, "Failed to report invalid bank"
+    assert libaudio.audioBankGetClipCount(bank) == 0, "Failed to hide invalid index"
+    libaudio.audioBankClose(bank)
+
+    # invalid clips are rejected when packing
+    error = pack_bank(libaudio, file.name + ".packed", [file.name], ["invalid"])
+    assert error.level == 2, "Failed to reject invalid clip"
+    os.remove(file.name)
+
+
+def probe(libaudio: ctypes.CDLL, path: str) -> AudioProbe:
+    audio_probe = AudioProbe()
+    is_valid = libaudio.audioProbe(path.encode(), ctypes.byref(audio_probe))
+    assert is_valid == (audio_probe.error.level < 2), "Failed to return validity"
+    return audio_probe
+
+
+def test_audio_probe():
+    libaudio = bind_libaudio()
+    directory = tempfile.TemporaryDirectory()
+
+    # the header is described without decoding anything
+    path = os.path.join(directory.name, "pcm.wav")
+    synth_audio(path, {"sample_rate": 44100, "number_of_channels": 2, "bit_depth": 24, "duration": 1})
+    audio_probe = probe(libaudio, path)
+    assert audio_probe.error.level == 0, f"ERROR while probing:{libaudio.audioGetErrorString(ctypes.byref(audio_probe.error)).decode('utf-8')}"
+    assert audio_probe.fileSize == os.path.getsize(path), "Failed to get file size"
+    assert (audio_probe.sampleRate, audio_probe.channelAmount, audio_probe.bitsPerSample) == (44100, 2, 24), "Failed to read format"
+    assert audio_probe.frameCount == 44100, "Failed to count frames"
+    assert audio_probe.durationMilliseconds == 1000, "Failed to get duration"
+    chunks = [(bytes(chunk.id), chunk.offset, chunk.size) for chunk in audio_probe.chunks[:audio_probe.chunkCount]]
+    assert chunks[0][:2] == (b"fmt ", 12), "Failed to list fmt chunk"
+    assert chunks[-1] == (b"data", os.path.getsize(path) - audio_probe.dataSize - 8, audio_probe.dataSize), "Failed to list data chunk"
+
+    # a large chunk in front of the data is skipped without reading it
+    with open(path, "rb") as file:
+        data = bytearray(file.read())
+    list_chunk = b"LIST" + (128 * 1024).to_bytes(4, "little") + bytes(128 * 1024)
+    data[36:36] = list_chunk
+    data[4:8] = (len(data) - 8).to_bytes(4, "little")
+    with open(path, "wb") as file:
+        file.write(data)
+    audio_probe = probe(libaudio, path)
+    assert audio_probe.error.level == 0, "Failed to skip large chunk"
+    assert bytes(audio_probe.chunks[1].id) == b"LIST", "Failed to list large chunk"
+    assert audio_probe.frameCount == 44100, "Failed to find data behind large chunk"
+
+    # compressed files
+    path = os.path.join(directory.name, "adpcm.wav")
+    synth_audio(path, {"sample_rate": 22050, "number_of_channels": 1, "bit_depth": 4, "encoding": "ima-adpcm", "duration": 1})
+    audio_probe = probe(libaudio, path)
+    assert audio_probe.error.level == 0, "Failed to probe ADPCM file"
+    assert audio_probe.bitsPerSample == 4, "Failed to read ADPCM format"
+    assert abs(audio_probe.durationMilliseconds - 1000) <= 1, "Failed to get ADPCM duration"
+    path = os.path.join(directory.name, "audio.flac")
+    synth_audio(path, {"sample_rate": 44100, "number_of_channels": 2, "bit_depth": 16, "duration": 1})
+    audio_probe = probe(libaudio, path)
+    assert audio_probe.error.level == 0, "Failed to probe FLAC file"
+    assert audio_probe.format == 0xF1AC and audio_probe.chunkCount == 0, "Failed to report FLAC format"
+    assert audio_probe.frameCount == 44100, "Failed to read FLAC stream info"
+
+    # invalid files
+    path = os.path.join(directory.name, "junk.wav")
+    with open(path, "wb") as file:
+        file.write(b"RIFF" + bytes(64))
+    assert probe(libaudio, path).error.level == 2, "Failed to report invalid file"
+    assert probe(libaudio, "/nonexistent.wav").error.level == 2, "Failed to report missing file"
+    directory.cleanup()
+
+
+def test_audio_probe_files():
+    libaudio = bind_libaudio()
+    directory = tempfile.TemporaryDirectory()
+    paths = []
+    for index, configuration in enumerate(configurations):
+        paths.append(os.path.join(directory.name, f"{index}.wav"))
+        synth_audio(paths[-1], configuration)
+    paths.append("/nonexistent.wav")
+
+    # every thread count gives the probes of single files in order
+    expected = [bytes(probe(libaudio, path)) for path in paths]
+    path_array = (ctypes.c_char_p * len(paths))(*(path.encode() for path in paths))
+    for thread_count in [1, 3, 0]:
+        probes = (AudioProbe * len(paths))()
+        libaudio.audioProbeFiles(path_array, len(paths), thread_count, probes)
+        assert [bytes(audio_probe) for audio_probe in probes] == expected, "Failed to probe files in parallel"
+    directory.cleanup()
+
+
+@pytest.mark.parametrize("bit_depth", [8, 16, 24, 32], ids=[f"{bit_depth}bit" for bit_depth in [8, 16, 24, 32]])
+def test_audio_devices(bit_depth: int):
+    configuration = {"sample_rate": 44100, "number_of_channels": 2, "bit_depth": bit_depth, "duration": 1}
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+    audio_configuration = AudioConfiguration(
+        rawData=None,
+        rawDataSize=0,
+        soundDeviceName=str.encode("default"),
+        soundDeviceNameSize=7,
+        timeResolution=50  # ms
+    )
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), file.name.encode(), None
+    )
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+
+    # devices are added before and while playing
+    assert libaudio.audioAddDevice(audio_object, b"default"), f"ERROR while adding device:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(configuration["duration"] / 2)
+    assert libaudio.audioAddDevice(audio_object, b"default"), "Failed to add device while playing"
+    assert libaudio.audioGetDeviceCount(audio_object) == 3, "Failed to count devices"
+    time.sleep(configuration["duration"])
+    assert not libaudio.audioGetIsPlaying(audio_object), "Failed to reach end"
+
+    # devices sharing a clock stay aligned without correction beyond the limit
+    sync = AudioDeviceSync()
+    for device in range(3):
+        assert libaudio.audioGetDeviceSync(audio_object, device, ctypes.byref(sync)), "Failed to get device sync"
+        assert abs(sync.offsetMicroseconds) < 10000, "Failed to align device"
+        assert abs(sync.correctionPpm) <= 1000.5, "Failed to limit correction"
+    assert not libaudio.audioGetDeviceSync(audio_object, 3, ctypes.byref(sync)), "Failed to reject missing device"
+    assert error.contents.level == 1, "Failed to report missing device"
+
+    # at most AUDIO_MAX_DEVICES devices are fed
+    while libaudio.audioGetDeviceCount(audio_object) < AUDIO_MAX_DEVICES:
+        assert libaudio.audioAddDevice(audio_object, b"default"), "Failed to add device"
+    assert not libaudio.audioAddDevice(audio_object, b"default"), "Failed to limit devices"
+    assert error.contents.level == 1, "Failed to report too many devices"
+
+    libaudio.audioDestroy(audio_object)
+    os.remove(file.name)
+
+
+def wait_for_events(libaudio: ctypes.CDLL, audio_object, until_state: int, timeout: float) -> List[AudioEvent]:
+    # Polls the event file descriptor like an event loop would until the
+    # state changes to until_state.
+    events = []
+    poller = select.poll()
+    poller.register(libaudio.audioGetEventFd(audio_object), select.POLLIN)
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline and not any(
+        event.type == AUDIO_EVENT_STATE_CHANGED and event.state == until_state for event in events
+    ):
+        if not poller.poll(int((deadline - time.monotonic()) * 1000)):
+            break
+        buffer = (AudioEvent * 8)()
+        count = libaudio.audioReadEvents(audio_object, buffer, len(buffer))
+        events.extend(AudioEvent.from_buffer_copy(event) for event in buffer[:count])
+    return events
+
+
+def test_audio_events():
+    configuration = {"sample_rate": 44100, "number_of_channels": 2, "bit_depth": 16, "duration": 1}
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+    audio_configuration = AudioConfiguration(
+        rawData=None,
+        rawDataSize=0,
+        soundDeviceName=str.encode("default"),
+        soundDeviceNameSize=7,
+        timeResolution=50  # ms
+    )
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), file.name.encode(), None
+    )
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+    assert libaudio.audioGetEventFd(audio_object) >= 0, "Failed to create event file descriptor"
+
+    # markers are reported in frame order and once per pass
+    assert libaudio.audioAddMarker(audio_object, 2, 22050), "Failed to add marker"
+    assert libaudio.audioAddMarker(audio_object, 1, 0), "Failed to add marker"
+    assert libaudio.audioAddMarker(audio_object, 3, 44100), "Failed to add marker at last frame"
+    assert libaudio.audioAddMarker(audio_object, 4, 33075), "Failed to add marker"
+    assert not libaudio.audioAddMarker(audio_object, 5, 44101), "Failed to reject marker beyond end"
+    assert error.contents.level == 1, "Failed to report marker beyond end"
+    assert libaudio.audioRemoveMarker(audio_object, 4), "Failed to remove marker"
+    assert not libaudio.audioRemoveMarker(audio_object, 4), "Failed to reject missing marker"
+    assert error.contents.level == 1, "Failed to report missing marker"
+
+    start = time.monotonic_ns()
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    events = wait_for_events(libaudio, audio_object, AUDIO_STATE_STOPPED, 3)
+    assert [(event.type, event.state) for event in events] == [
+        (AUDIO_EVENT_STATE_CHANGED, AUDIO_STATE_PLAYING),
+        (AUDIO_EVENT_MARKER, AUDIO_STATE_PLAYING),
+        (AUDIO_EVENT_MARKER, AUDIO_STATE_PLAYING),
+        (AUDIO_EVENT_MARKER, AUDIO_STATE_PLAYING),
+        (AUDIO_EVENT_END_REACHED, AUDIO_STATE_PLAYING),
+        (AUDIO_EVENT_STATE_CHANGED, AUDIO_STATE_STOPPED)
+    ], "Failed to report events in order"
+    assert [event.markerId for event in events[1:4]] == [1, 2, 3], "Failed to report markers"
+    assert [event.frame for event in events[1:4]] == [0, 22050, 44100], "Failed to report marker frames"
+    assert all(event.droppedEvents == 0 for event in events), "Failed to queue events"
+    # the middle marker is reported once it is heard
+    marker_seconds = (events[2].nanoseconds - start) / 1e9
+    assert 0.4 < marker_seconds < 0.9, "Failed to report marker when played"
+    assert libaudio.audioReadEvents(audio_object, (AudioEvent * 1)(), 1) == 0, "Failed to empty queue"
+    assert not select.select([libaudio.audioGetEventFd(audio_object)], [], [], 0)[0], "Failed to clear event file descriptor"
+
+    # pausing reports the state, resuming does not repeat heard markers
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(0.3)
+    assert libaudio.audioPause(audio_object, None), "Failed to pause"
+    assert libaudio.audioPlay(audio_object, None), "Failed to resume"
+    events = wait_for_events(libaudio, audio_object, AUDIO_STATE_STOPPED, 3)
+    marker_ids = [event.markerId for event in events if event.type == AUDIO_EVENT_MARKER]
+    assert marker_ids == [1, 2, 3], "Failed to report markers once"
+    states = [event.state for event in events if event.type == AUDIO_EVENT_STATE_CHANGED]
+    assert states == [AUDIO_STATE_PLAYING, AUDIO_STATE_PAUSED, AUDIO_STATE_PLAYING, AUDIO_STATE_STOPPED], "Failed to report state changes"
+
+    # a full queue counts the events it dropped
+    for marker in range(70):
+        assert libaudio.audioAddMarker(audio_object, 100 + marker, 1000 + marker), "Failed to add marker"
+    time.sleep(0.1)
+    libaudio.audioReadEvents(audio_object, (AudioEvent * 64)(), 64)
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(configuration["duration"])
+    events = (AudioEvent * 256)()
+    count = libaudio.audioReadEvents(audio_object, events, len(events))
+    assert count == 64, "Failed to fill queue"
+    assert libaudio.audioReadEvents(audio_object, events, len(events)) == 0, "Failed to drop events"
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    events = wait_for_events(libaudio, audio_object, AUDIO_STATE_PLAYING, 1)
+    assert events[0].droppedEvents == 1 + 73 + 2 - count, "Failed to count dropped events"
+
+    libaudio.audioDestroy(audio_object)
+    os.remove(file.name)
+
+
+def format_stats(libaudio: ctypes.CDLL, stats: AudioStats, as_json: bool) -> str:
+    size = libaudio.audioFormatStats(ctypes.byref(stats), as_json, None, 0)
+    text = ctypes.create_string_buffer(size + 1)
+    assert libaudio.audioFormatStats(ctypes.byref(stats), as_json, text, len(text)) == size, "Failed to format stats"
+    return text.value.decode()
+
+
+def test_audio_stats():
+    configuration = {"sample_rate": 44100, "number_of_channels": 2, "bit_depth": 16, "duration": 1}
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+    audio_configuration = AudioConfiguration(
+        rawData=None,
+        rawDataSize=0,
+        soundDeviceName=str.encode("default"),
+        soundDeviceNameSize=7,
+        timeResolution=50  # ms
+    )
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), file.name.encode(), None
+    )
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+
+    # the buckets grow by at most an eighth
+    starts = [libaudio.audioGetHistogramBucketStart(bucket) for bucket in range(AUDIO_HISTOGRAM_BUCKETS + 1)]
+    assert starts[:10] == list(range(10)), "Failed to give small durations a bucket each"
+    assert starts[16] == 16 and starts[24] == 32, "Failed to split powers of two"
+    assert all(0 < (end - start) * 8 <= start or start < 8 for start, end in zip(starts, starts[1:])), "Failed to bound bucket width"
+
+    stats = AudioStats()
+    libaudio.audioGetStats(audio_object, ctypes.byref(stats))
+    assert stats.refills == 0 and stats.commands == 0, "Failed to start empty"
+    assert stats.bufferFrames == 44100 * 8 * 50 // 1000, "Failed to report buffer size"
+    assert libaudio.audioGetHistogramPercentile(ctypes.byref(stats.refill), 99.0) == 0, "Failed to handle empty histogram"
+
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(configuration["duration"] / 2)
+    assert libaudio.audioPause(audio_object, None), "Failed to pause"
+    libaudio.audioGetStats(audio_object, ctypes.byref(stats))
+    assert stats.wakeups >= 5 and stats.refills >= 2, "Failed to count wakeups"
+    assert 0 < stats.framesWritten <= 44100, "Failed to count frames"
+    assert stats.commands == 2 and stats.command.count == 2, "Failed to count commands"
+    assert stats.xruns == 0, "Failed to count xruns"
+    assert 0 < stats.maxAvailFrames <= stats.bufferFrames, "Failed to sample room"
+    assert stats.minDelayFrames <= stats.averageDelayFrames <= stats.bufferFrames, "Failed to sample delay"
+    for histogram in [stats.refill, stats.command, stats.headroom]:
+        assert histogram.count > 0 and sum(histogram.buckets) == histogram.count, "Failed to fill histogram"
+        p50 = libaudio.audioGetHistogramPercentile(ctypes.byref(histogram), 50.0)
+        p99 = libaudio.audioGetHistogramPercentile(ctypes.byref(histogram), 99.0)
+        assert p50 <= p99 <= histogram.maxMicroseconds, "Failed to compute percentiles"
+    # the headroom stays within the buffer
+    assert stats.headroom.maxMicroseconds <= stats.bufferFrames * 1e6 / 44100, "Failed to measure headroom"
+
+    # the text has a line per number, the JSON the same numbers nested
+    text = dict(line.split(" ") for line in format_stats(libaudio, stats, False).splitlines())
+    assert int(text["refills"]) == stats.refills and int(text["command_count"]) == 2, "Failed to format text"
+    assert float(text["headroom_max_us"]) == round(stats.headroom.maxMicroseconds), "Failed to format histogram"
+    values = json.loads(format_stats(libaudio, stats, True))
+    assert values["wakeups"] == stats.wakeups and values["xruns"] == 0, "Failed to format JSON"
+    assert sum(count for _, count in values["refill"]["buckets"]) == stats.refill.count, "Failed to list buckets"
+    assert values["headroom"]["p99_us"] == float(text["headroom_p99_us"]), "Failed to match text"
+    short = ctypes.create_string_buffer(8)
+    assert libaudio.audioFormatStats(ctypes.byref(stats), False, short, len(short)) > len(short), "Failed to report length"
+    assert short.value == b"wakeups", "Failed to cut off text"
+
+    libaudio.audioDestroy(audio_object)
+    os.remove(file.name)
+
+
+def test_audio_trace():
+    configuration = {"sample_rate": 44100, "number_of_channels": 2, "bit_depth": 16, "duration": 1}
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    trace = tempfile.NamedTemporaryFile(suffix=".json", delete=False)
+    libaudio = bind_libaudio()
+    audio_configuration = AudioConfiguration(
+        rawData=None,
+        rawDataSize=0,
+        soundDeviceName=str.encode("default"),
+        soundDeviceNameSize=7,
+        timeResolution=50  # ms
+    )
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), file.name.encode(), None
+    )
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+
+    assert not libaudio.audioWriteTrace(audio_object, trace.name.encode(), False), "Failed to refuse without tracing"
+    assert libaudio.audioGetError(audio_object).contents.level == 1, "Failed to warn without tracing"
+
+    assert libaudio.audioSetTracing(audio_object, 4096), "Failed to enable tracing"
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(0.3)
+    assert libaudio.audioPause(audio_object, None), "Failed to pause"
+    assert libaudio.audioWriteTrace(audio_object, trace.name.encode(), False), "Failed to write trace"
+    with open(trace.name) as f:
+        events = json.load(f)["traceEvents"]
+    names = [event["name"] for event in events]
+    assert "wakeup" in names and "avail" in names and "delay" in names, "Failed to trace refills"
+    writes = [event["ph"] for event in events if event["name"] == "write"]
+    assert writes and writes.count("B") == writes.count("E"), "Failed to pair writes"
+    assert all(event["args"]["result"] > 0 for event in events if event["name"] == "write" and event["ph"] == "E"), "Failed to trace results"
+    actions = [(event["name"], event["ph"]) for event in events if event.get("tid") == 2 and event["ph"] != "M"]
+    assert actions == [
+        ("tracing", "B"), ("tracing", "E"), ("play", "B"), ("play", "E"), ("pause", "B"), ("pause", "E")
+    ], "Failed to trace actions"
+    assert "apply play" in names and "apply pause" in names, "Failed to trace applied actions"
+
+    # no device ran out of frames
+    assert not libaudio.audioWriteTrace(audio_object, trace.name.encode(), True), "Failed to refuse without xrun"
+    assert libaudio.audioGetError(audio_object).contents.level == 1, "Failed to warn without xrun"
+    assert not libaudio.audioWriteTrace(audio_object, b"/nonexistent/trace.json", False), "Failed to report unwritable path"
+    assert libaudio.audioGetError(audio_object).contents.level == 2, "Failed to fail on unwritable path"
+
+    assert libaudio.audioSetTracing(audio_object, 0), "Failed to disable tracing"
+    assert not libaudio.audioWriteTrace(audio_object, trace.name.encode(), False), "Failed to stop tracing"
+
+    libaudio.audioDestroy(audio_object)
+    os.remove(file.name)
+    os.remove(trace.name)
+
+
+def test_audio_long_duration():
+    # more than 2^32 / 1000 frames and bytes of audio
+    configuration = {"sample_rate": 44100, "number_of_channels": 1, "bit_depth": 8, "duration": 100}
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+    audio_configuration = AudioConfiguration(
+        rawData=None,
+        rawDataSize=0,
+        soundDeviceName=str.encode("default"),
+        soundDeviceNameSize=7,
+        timeResolution=50  # ms
+    )
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), file.name.encode(), None
+    )
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+
+    assert libaudio.audioGetTotalDuration(audio_object) == 100000, "Failed to compute duration"
+    assert libaudio.audioJump(audio_object, None, 99000), "Failed to jump"
+    assert libaudio.audioGetCurrentTime(audio_object) == 99000, "Failed to report position"
+
+    libaudio.audioDestroy(audio_object)
+    os.remove(file.name)
+
+
+def test_audio_memory_sink():
+    configuration = {"sample_rate": 44100, "number_of_channels": 2, "bit_depth": 16, "duration": 1}
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+    audio_configuration = AudioConfiguration(
+        rawData=None,
+        rawDataSize=0,
+        soundDeviceName=str.encode("memory:100"),
+        soundDeviceNameSize=10,
+        timeResolution=50  # ms
+    )
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), file.name.encode(), None
+    )
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+
+    # a second of audio plays in a hundredth of the time on the virtual clock
+    start = time.monotonic()
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    events = wait_for_events(libaudio, audio_object, AUDIO_STATE_STOPPED, 3)
+    assert [event.type for event in events] == [
+        AUDIO_EVENT_STATE_CHANGED, AUDIO_EVENT_END_REACHED, AUDIO_EVENT_STATE_CHANGED
+    ], "Failed to play to the end"
+    assert time.monotonic() - start < 0.5, "Failed to play faster than real time"
+    # the end is reached when the last frame was written, less than the
+    # 400 ms of the buffer before it is heard
+    played_seconds = (events[1].nanoseconds - events[0].nanoseconds) / 1e9
+    assert 0.6 <= played_seconds <= 1.0, "Failed to play on the virtual clock"
+    stats = AudioStats()
+    libaudio.audioGetStats(audio_object, ctypes.byref(stats))
+    assert stats.xruns == 0 and stats.command.maxMicroseconds <= 60000, "Failed to measure on the virtual clock"
+
+    # writes slower than the buffer lasts run the sink out of frames
+    assert libaudio.audioSetSinkWriteDelay(audio_object, 0, 500000), "Failed to set write delay"
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    events = wait_for_events(libaudio, audio_object, AUDIO_STATE_STOPPED, 3)
+    assert AUDIO_EVENT_XRUN in [event.type for event in events], "Failed to report xrun"
+    libaudio.audioGetStats(audio_object, ctypes.byref(stats))
+    assert stats.xruns >= 1, "Failed to count xrun"
+    assert libaudio.audioSetSinkWriteDelay(audio_object, 0, 0), "Failed to reset write delay"
+    assert not libaudio.audioSetSinkWriteDelay(audio_object, 1, 0), "Failed to reject missing device"
+    assert error.contents.level == 1, "Failed to report missing device"
+
+    # added devices use the same backend and clock
+    assert not libaudio.audioAddDevice(audio_object, b"default"), "Failed to reject ALSA device"
+    assert error.contents.level == 1, "Failed to report backend mismatch"
+    assert libaudio.audioAddDevice(audio_object, b"memory"), "Failed to add memory sink"
+    assert libaudio.audioGetDeviceCount(audio_object) == 2, "Failed to count devices"
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    events = wait_for_events(libaudio, audio_object, AUDIO_STATE_STOPPED, 3)
+    assert AUDIO_EVENT_END_REACHED in [event.type for event in events], "Failed to play to both sinks"
+    libaudio.audioDestroy(audio_object)
+
+    # ALSA devices have no write delay
+    audio_configuration.soundDeviceName = str.encode("default")
+    audio_configuration.soundDeviceNameSize = 7
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), file.name.encode(), None
+    )
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+    assert not libaudio.audioSetSinkWriteDelay(audio_object, 0, 1000), "Failed to reject ALSA device"
+    assert error.contents.level == 1, "Failed to report ALSA device"
+    libaudio.audioDestroy(audio_object)
+    os.remove(file.name)
+
+
+def render(libaudio: ctypes.CDLL, audio_objects: list, commands: List[tuple], end_milliseconds: int) -> bool:
+    objects = (ctypes.c_void_p * len(audio_objects))(
+        *[ctypes.cast(audio_object, ctypes.c_void_p).value for audio_object in audio_objects]
+    )
+    script = (AudioRenderCommand * max(len(commands), 1))(
+        *[AudioRenderCommand(*command) for command in commands]
+    )
+    return libaudio.audioRender(objects, len(audio_objects), script, len(commands), end_milliseconds)
+
+
+def test_audio_render():
+    configuration = {"sample_rate": 44100, "number_of_channels": 2, "bit_depth": 16, "duration": 1}
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    with wave.open(file.name) as source:
+        source_frames = source.readframes(source.getnframes())
+    frame_size = 4
+    libaudio = bind_libaudio()
+    outputs = [tempfile.NamedTemporaryFile(suffix=".wav", delete=False).name for _ in range(2)]
+    audio_objects = []
+    for output in outputs:
+        device_name = f"render:{output}".encode()
+        audio_configuration = AudioConfiguration(
+            rawData=None,
+            rawDataSize=0,
+            soundDeviceName=device_name,
+            soundDeviceNameSize=len(device_name) + 1,
+            timeResolution=10  # ms
+        )
+        audio_objects.append(libaudio.audioInitFromPath(
+            ctypes.byref(audio_configuration), file.name.encode(), None
+        ))
+        assert (error := libaudio.audioGetError(audio_objects[-1])).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+
+    # the script is checked before anything plays
+    error = libaudio.audioGetError(audio_objects[0])
+    assert not render(libaudio, audio_objects, [(500, 0, AUDIO_RENDER_PLAY, 0), (0, 1, AUDIO_RENDER_PLAY, 0)], 1500), "Failed to reject unsorted script"
+    assert error.contents.level == 1, "Failed to report unsorted script"
+    assert not render(libaudio, audio_objects, [(0, 2, AUDIO_RENDER_PLAY, 0)], 1500), "Failed to reject missing object"
+
+    # the second object jumps back to the start after half a second
+    start = time.monotonic()
+    assert render(libaudio, audio_objects, [
+        (0, 0, AUDIO_RENDER_PLAY, 0),
+        (0, 1, AUDIO_RENDER_PLAY, 0),
+        (500, 1, AUDIO_RENDER_JUMP, 0)
+    ], 1500), "Failed to render"
+    assert time.monotonic() - start < 1, "Failed to render faster than real time"
+    rendered = []
+    for output in outputs:
+        with wave.open(output) as result:
+            assert (result.getnchannels(), result.getsampwidth(), result.getframerate()) == (2, 2, 44100), "Failed to write format"
+            assert result.getnframes() == 1500 * 441 // 10, "Failed to render until the end"
+            rendered.append(result.readframes(result.getnframes()))
+
+    # play is applied at the first wakeup and heard after the first refill
+    played = 20 * 441 // 10 * frame_size
+    assert rendered[0][:played] == bytes(played), "Failed to render silence before playing"
+    heard = len(rendered[0][played:].rstrip(b"\0"))
+    assert 0.5 * len(source_frames) < heard <= len(source_frames), "Failed to render until the end of the audio"
+    assert rendered[0][played:played + heard] == source_frames[:heard], "Failed to render the frames sent to the device"
+
+    # the jump is applied at the wakeup after 500 ms, which drops the buffer
+    jumped = 510 * 441 // 10 * frame_size
+    restarted = 520 * 441 // 10 * frame_size
+    assert rendered[1][played:jumped] == source_frames[:jumped - played], "Failed to render before the jump"
+    assert rendered[1][jumped:restarted] == bytes(restarted - jumped), "Failed to drop the buffer"
+    assert rendered[1][restarted:restarted + 44100] == source_frames[:44100], "Failed to render after the jump"
+    for audio_object in audio_objects:
+        libaudio.audioDestroy(audio_object)
+
+    # other devices cannot be rendered
+    audio_configuration = AudioConfiguration(
+        rawData=None,
+        rawDataSize=0,
+        soundDeviceName=str.encode("memory"),
+        soundDeviceNameSize=7,
+        timeResolution=10  # ms
+    )
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), file.name.encode(), None
+    )
+    assert not render(libaudio, [audio_object], [], 1000), "Failed to reject memory sink"
+    assert libaudio.audioGetError(audio_object).contents.level == 1, "Failed to report memory sink"
+    libaudio.audioDestroy(audio_object)
+    for output in outputs:
+        os.remove(output)
+    os.remove(file.name)
+
+
+def start_pipe_reader(read_fd: int) -> tuple:
+    # Reads the pipe until its end on a thread, like a consumer process.
+    received = bytearray()
+    def read():
+        while chunk := os.read(read_fd, 65536):
+            received.extend(chunk)
+    reader = threading.Thread(target=read)
+    reader.start()
+    return reader, received
+
+
+def test_audio_pipe():
+    configuration = {"sample_rate": 44100, "number_of_channels": 2, "bit_depth": 16, "duration": 1}
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    with wave.open(file.name) as source:
+        source_frames = source.readframes(source.getnframes())
+    libaudio = bind_libaudio()
+
+    def init(device_name: str):
+        audio_configuration = AudioConfiguration(
+            rawData=None,
+            rawDataSize=0,
+            soundDeviceName=device_name.encode(),
+            soundDeviceNameSize=len(device_name) + 1,
+            timeResolution=10  # ms
+        )
+        audio_object = libaudio.audioInitFromPath(
+            ctypes.byref(audio_configuration), file.name.encode(), None
+        )
+        assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+        return audio_object
+
+    # a pipe that holds the whole stream gets every frame, spliced from the
+    # mapped file. A paced one gets them in real time and the frames still
+    # queued at the end are dropped like on a sound card.
+    for device_prefix, min_seconds, max_seconds in (("pipe-free", 0.0, 0.5), ("pipe", 0.6, 1.2)):
+        read_fd, write_fd = os.pipe()
+        fcntl.fcntl(write_fd, fcntl.F_SETPIPE_SZ, 1 << 20)
+        audio_object = init(f"{device_prefix}:{write_fd}")
+        os.close(write_fd)
+        reader, received = start_pipe_reader(read_fd)
+        assert libaudio.audioPlay(audio_object, None), "Failed to play"
+        events = wait_for_events(libaudio, audio_object, AUDIO_STATE_STOPPED, 3)
+        assert [event.type for event in events] == [
+            AUDIO_EVENT_STATE_CHANGED, AUDIO_EVENT_END_REACHED, AUDIO_EVENT_STATE_CHANGED
+        ], f"Failed to play {device_prefix} to the end"
+        played_seconds = (events[1].nanoseconds - events[0].nanoseconds) / 1e9
+        assert min_seconds <= played_seconds <= max_seconds, f"Failed to pace {device_prefix}"
+        libaudio.audioDestroy(audio_object)
+        reader.join()
+        os.close(read_fd)
+        if device_prefix == "pipe-free":
+            assert bytes(received) == source_frames, f"Failed to stream {device_prefix}"
+        else:
+            assert len(received) >= len(source_frames) // 2 and bytes(received) == source_frames[:len(received)], f"Failed to stream {device_prefix}"
+
+    # frames with gain are copied
+    read_fd, write_fd = os.pipe()
+    fcntl.fcntl(write_fd, fcntl.F_SETPIPE_SZ, 1 << 20)
+    audio_object = init(f"pipe-free:{write_fd}")
+    os.close(write_fd)
+    reader, received = start_pipe_reader(read_fd)
+    assert libaudio.audioSetGain(audio_object, -200), "Failed to set gain"
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    wait_for_events(libaudio, audio_object, AUDIO_STATE_STOPPED, 3)
+    libaudio.audioDestroy(audio_object)
+    reader.join()
+    os.close(read_fd)
+    assert bytes(received) == bytes(len(source_frames)), "Failed to stream copied frames"
+
+    # a reader that does not read holds the playback back
+    fifo_directory = tempfile.TemporaryDirectory()
+    fifo_path = os.path.join(fifo_directory.name, "stream")
+    os.mkfifo(fifo_path)
+    read_fd = os.open(fifo_path, os.O_RDONLY | os.O_NONBLOCK)
+    audio_object = init(f"pipe-free:{fifo_path}")
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(0.5)
+    backlog = ctypes.c_uint32()
+    assert libaudio.audioGetPipeBacklog(audio_object, 0, ctypes.byref(backlog)), "Failed to read backlog"
+    assert backlog.value >= 300000, "Failed to report backlog"
+    events = wait_for_events(libaudio, audio_object, AUDIO_STATE_STOPPED, 0.1)
+    assert AUDIO_EVENT_END_REACHED not in [event.type for event in events], "Failed to apply backpressure"
+    os.set_blocking(read_fd, True)
+    reader, received = start_pipe_reader(read_fd)
+    events = wait_for_events(libaudio, audio_object, AUDIO_STATE_STOPPED, 3)
+    assert AUDIO_EVENT_END_REACHED in [event.type for event in events], "Failed to continue after backpressure"
+    deadline = time.monotonic() + 1
+    while libaudio.audioGetPipeBacklog(audio_object, 0, ctypes.byref(backlog)) and backlog.value > 0 and time.monotonic() < deadline:
+        time.sleep(0.01)
+    assert backlog.value == 0, "Failed to clear backlog"
+    assert not libaudio.audioGetPipeBacklog(audio_object, 1, ctypes.byref(backlog)), "Failed to reject missing device"
+    assert libaudio.audioGetError(audio_object).contents.level == 1, "Failed to report missing device"
+    libaudio.audioDestroy(audio_object)
+    reader.join()
+    os.close(read_fd)
+    # frames queued when the end is reached are dropped like on a sound card
+    assert len(received) % 4 == 0 and bytes(received) == source_frames[:len(received)], "Failed to keep the stream intact"
+    fifo_directory.cleanup()
+
+    # a pipe whose reader is gone pauses the playback at the frames written
+    read_fd, write_fd = os.pipe()
+    audio_object = init(f"pipe:{write_fd}")
+    os.close(write_fd)
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(0.2)
+    os.close(read_fd)
+    events = wait_for_events(libaudio, audio_object, AUDIO_STATE_PAUSED, 3)
+    assert AUDIO_EVENT_ERROR in [event.type for event in events], "Failed to report closed pipe"
+    assert AUDIO_EVENT_END_REACHED not in [event.type for event in events], "Failed to pause on closed pipe"
+    assert 0 < libaudio.audioGetCurrentTime(audio_object) < 1000, "Failed to keep the written frames"
+    libaudio.audioDestroy(audio_object)
+
+    # a pipe can be fed along with a sound device, but not with a memory sink
+    read_fd, write_fd = os.pipe()
+    audio_object = init("default")
+    assert not libaudio.audioGetPipeBacklog(audio_object, 0, ctypes.byref(backlog)), "Failed to reject ALSA device"
+    assert libaudio.audioGetError(audio_object).contents.level == 1, "Failed to report ALSA device"
+    assert libaudio.audioAddDevice(audio_object, f"pipe-free:{write_fd}".encode()), "Failed to add pipe"
+    libaudio.audioDestroy(audio_object)
+    audio_object = init("memory")
+    assert not libaudio.audioAddDevice(audio_object, f"pipe-free:{write_fd}".encode()), "Failed to reject pipe"
+    libaudio.audioDestroy(audio_object)
+    os.close(read_fd)
+    os.close(write_fd)
+    os.remove(file.name)
+
+
+def write_ramp(filename: str, frame_count: int, loops: List[tuple]):
+    """Writes a mono 16-bit ramp, whose sample is the frame number modulo
+    30000, with a smpl chunk holding the (type, start, end, play count)
+    loops."""
+    samples = array.array("h", (frame % 30000 for frame in range(frame_count)))
+    with wave.open(filename, "wb") as output:
+        output.setnchannels(1)
+        output.setsampwidth(2)
+        output.setframerate(44100)
+        output.writeframes(samples.tobytes())
+    smpl_chunk = bytes(28) + len(loops).to_bytes(4, "little") + bytes(4)
+    for loop_id, (loop_type, start, end, play_count) in enumerate(loops):
+        smpl_chunk += b"".join(
+            value.to_bytes(4, "little") for value in (loop_id, loop_type, start, end, 0, play_count)
+        )
+    with open(filename, "r+b") as output:
+        buffer = bytearray(output.read())
+        buffer += b"smpl" + len(smpl_chunk).to_bytes(4, "little") + smpl_chunk
+        buffer[4:8] = (len(buffer) - 8).to_bytes(4, "little")
+        output.seek(0)
+        output.write(buffer)
+
+
+def test_audio_loop():
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    write_ramp(file.name, 30000, [(1, 0, 29999, 0), (0, 10000, 19999, 3)])
+    libaudio = bind_libaudio()
+    output = tempfile.NamedTemporaryFile(suffix=".wav", delete=False).name
+    device_name = f"render:{output}".encode()
+    audio_configuration = AudioConfiguration(
+        rawData=None,
+        rawDataSize=0,
+        soundDeviceName=device_name,
+        soundDeviceNameSize=len(device_name) + 1,
+        timeResolution=10  # ms
+    )
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), file.name.encode(), None
+    )
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+
+    # the first forward loop of the smpl chunk is read
+    loop = AudioLoop()
+    assert libaudio.audioGetFileLoop(audio_object, ctypes.byref(loop)), "Failed to read loop"
+    assert (loop.startFrame, loop.endFrame, loop.count, loop.crossfadeMilliseconds) == (10000, 19999, 3, 0), "Failed to read loop points"
+    assert not libaudio.audioSetLoop(audio_object, ctypes.byref(AudioLoop(10000, 30000, 0, 0))), "Failed to reject loop beyond end"
+    assert error.contents.level == 1, "Failed to report invalid loop"
+
+    # the loop is played three times without a gap, then the audio goes on
+    assert libaudio.audioSetLoop(audio_object, ctypes.byref(loop)), "Failed to set loop"
+    assert render(libaudio, [audio_object], [(0, 0, AUDIO_RENDER_PLAY, 0)], 1500), "Failed to render"
+    with wave.open(output) as result:
+        rendered = array.array("h", result.readframes(result.getnframes()))
+    expected = array.array("h", [*range(20000), *range(10000, 20000), *range(10000, 20000), *range(20000, 30000)])
+    # the ramp starts with a silent frame
+    played = rendered.index(1) - 1
+    heard = len(rendered[played:].tobytes().rstrip(b"\0")) // 2
+    assert heard > 40000, "Failed to render the passes of the loop"
+    assert rendered[played:played + heard] == expected[:heard], "Failed to loop seamlessly"
+
+    # the crossfade fades the end of the loop into the frames before its start
+    libaudio.audioDestroy(audio_object)
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), file.name.encode(), None
+    )
+    assert libaudio.audioSetLoop(audio_object, ctypes.byref(AudioLoop(10000, 19999, 2, 10))), "Failed to set crossfade"
+    assert render(libaudio, [audio_object], [(0, 0, AUDIO_RENDER_PLAY, 0)], 1000), "Failed to render"
+    with wave.open(output) as result:
+        rendered = array.array("h", result.readframes(result.getnframes()))
+    played = rendered.index(1) - 1
+    seam = [
+        round(frame * (1 - (i + 1) / 442) + (frame - 10000) * (i + 1) / 442)
+        for i, frame in enumerate(range(19559, 20000))
+    ]
+    assert list(rendered[played + 19559:played + 20000]) == seam, "Failed to crossfade the end of the loop"
+    assert list(rendered[played + 20000:played + 20010]) == list(range(10000, 10010)), "Failed to continue at the start"
+    assert list(rendered[played + 29559:played + 29570]) == list(range(19559, 19570)), "Failed to play the last pass without crossfade"
+    libaudio.audioDestroy(audio_object)
+
+    # the clock counts the passes and reports markers inside the loop on every pass
+    audio_configuration.soundDeviceName = str.encode("memory:20")
+    audio_configuration.soundDeviceNameSize = 10
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), file.name.encode(), None
+    )
+    assert libaudio.audioAddMarker(audio_object, 1, 15000), "Failed to add marker"
+    assert libaudio.audioSetLoop(audio_object, ctypes.byref(AudioLoop(10000, 19999, 0, 0))), "Failed to set endless loop"
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(0.1)
+    clock = AudioClock()
+    libaudio.audioGetClock(audio_object, ctypes.byref(clock))
+    assert clock.loopCount >= 3, "Failed to count passes"
+    assert 10000 <= clock.frame < 20000, "Failed to report the frame in the loop"
+    assert clock.milliseconds == clock.frame * 1000 // 44100, "Failed to report the time"
+    loop_count = clock.loopCount
+    assert libaudio.audioSetLoop(audio_object, None), "Failed to stop looping"
+    events = wait_for_events(libaudio, audio_object, AUDIO_STATE_STOPPED, 3)
+    markers = [event.markerId for event in events if event.type == AUDIO_EVENT_MARKER]
+    assert len(markers) > loop_count, "Failed to report the marker on every pass"
+    libaudio.audioGetClock(audio_object, ctypes.byref(clock))
+    assert (clock.frame, clock.loopCount) == (0, 0), "Failed to reset the clock"
+    libaudio.audioDestroy(audio_object)
+
+    # files without a forward loop have none
+    write_ramp(file.name, 30000, [(1, 0, 29999, 0)])
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), file.name.encode(), None
+    )
+    error = libaudio.audioGetError(audio_object)
+    assert not libaudio.audioGetFileLoop(audio_object, ctypes.byref(loop)), "Failed to skip backward loop"
+    assert error.contents.level == 1, "Failed to report missing loop"
+    libaudio.audioDestroy(audio_object)
+    os.remove(output)
+    os.remove(file.name)
+
+
+def test_audio_segments():
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    write_ramp(file.name, 20000, [])
+    source = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    write_ramp(source.name, 30000, [])
+    stereo = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(stereo.name, {"sample_rate": 44100, "number_of_channels": 2, "bit_depth": 16, "duration": 1})
+    libaudio = bind_libaudio()
+    output = tempfile.NamedTemporaryFile(suffix=".wav", delete=False).name
+    device_name = f"render:{output}".encode()
+    audio_configuration = AudioConfiguration(
+        rawData=None,
+        rawDataSize=0,
+        soundDeviceName=device_name,
+        soundDeviceNameSize=len(device_name) + 1,
+        timeResolution=10  # ms
+    )
+    source_buffer = libaudio.audioBufferInitFromPath(source.name.encode(), 0)
+    stereo_buffer = libaudio.audioBufferInitFromPath(stereo.name.encode(), 0)
+
+    def init_timeline():
+        audio_object = libaudio.audioInitFromPath(
+            ctypes.byref(audio_configuration), file.name.encode(), None
+        )
+        assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+        timeline_frame = ctypes.c_uint32()
+        assert libaudio.audioAppendSegment(audio_object, source_buffer, 25000, 0, ctypes.byref(timeline_frame)), "Failed to append the rest of the buffer"
+        assert timeline_frame.value == 20000, "Failed to append behind the audio data"
+        assert libaudio.audioAppendSegment(audio_object, source_buffer, 100, 900, ctypes.byref(timeline_frame)), "Failed to append a segment"
+        assert timeline_frame.value == 25000, "Failed to append behind the last segment"
+        assert libaudio.audioAppendSegment(audio_object, source_buffer, 0, 5000, None), "Failed to append a tail"
+        return audio_object
+
+    # segments of other formats or beyond the end of the buffer are rejected
+    audio_object = init_timeline()
+    error = libaudio.audioGetError(audio_object)
+    assert libaudio.audioGetTotalDuration(audio_object) == 30900 * 1000 // 44100, "Failed to count the segments"
+    assert not libaudio.audioAppendSegment(audio_object, stereo_buffer, 0, 0, None), "Failed to reject other format"
+    assert error.contents.level == 1, "Failed to report other format"
+    assert not libaudio.audioAppendSegment(audio_object, source_buffer, 30000, 0, None), "Failed to reject segment beyond end"
+    assert not libaudio.audioAppendSegment(audio_object, source_buffer, 29000, 2000, None), "Failed to reject segment across end"
+    assert error.contents.level == 1, "Failed to report invalid segment"
+    assert not libaudio.audioSetLoop(audio_object, ctypes.byref(AudioLoop(19000, 21000, 0, 0))), "Failed to reject loop into segment"
+
+    # the audio data and the segments play without a gap
+    assert render(libaudio, [audio_object], [(0, 0, AUDIO_RENDER_PLAY, 0)], 1000), "Failed to render"
+    with wave.open(output) as result:
+        rendered = array.array("h", result.readframes(result.getnframes()))
+    expected = array.array("h", [*range(20000), *range(25000, 30000), *range(100, 1000), *range(5000)])
+    # the ramp starts with a silent frame
+    played = rendered.index(1) - 1
+    heard = len(rendered[played:].tobytes().rstrip(b"\0")) // 2
+    assert 25900 < heard <= len(expected), "Failed to render the segments"
+    assert rendered[played:played + heard] == expected[:heard], "Failed to stitch the segments"
+    libaudio.audioDestroy(audio_object)
+
+    # a jump addresses the timeline
+    audio_object = init_timeline()
+    assert render(libaudio, [audio_object], [(0, 0, AUDIO_RENDER_JUMP, 500), (0, 0, AUDIO_RENDER_PLAY, 0)], 1000), "Failed to render"
+    with wave.open(output) as result:
+        rendered = array.array("h", result.readframes(result.getnframes()))
+    played = rendered.index(27050)
+    expected = array.array("h", [*range(27050, 30000), *range(100, 1000), *range(100)])
+    assert rendered[played:played + len(expected)] == expected, "Failed to jump into a segment"
+    libaudio.audioDestroy(audio_object)
+
+    libaudio.audioBufferRelease(source_buffer)
+    libaudio.audioBufferRelease(stereo_buffer)
+    os.remove(output)
+    os.remove(file.name)
+    os.remove(source.name)
+    os.remove(stereo.name)
+
+
+def test_audio_replace_data():
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    write_ramp(file.name, 20000, [])
+    # the new render counts down, so both are told apart
+    update = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    with wave.open(update.name, "wb") as output:
+        output.setnchannels(1)
+        output.setsampwidth(2)
+        output.setframerate(44100)
+        output.writeframes(array.array("h", (-frame for frame in range(25000))).tobytes())
+    stereo = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(stereo.name, {"sample_rate": 44100, "number_of_channels": 2, "bit_depth": 16, "duration": 1})
+    libaudio = bind_libaudio()
+    output = tempfile.NamedTemporaryFile(suffix=".wav", delete=False).name
+    device_name = f"render:{output}".encode()
+    audio_configuration = AudioConfiguration(
+        rawData=None,
+        rawDataSize=0,
+        soundDeviceName=device_name,
+        soundDeviceNameSize=len(device_name) + 1,
+        timeResolution=10  # ms
+    )
+    update_buffer = libaudio.audioBufferInitFromPath(update.name.encode(), 0)
+    stereo_buffer = libaudio.audioBufferInitFromPath(stereo.name.encode(), 0)
+
+    # buffers of another format are rejected
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), file.name.encode(), None
+    )
+    assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+    assert not libaudio.audioReplaceData(audio_object, stereo_buffer, 0), "Failed to reject other format"
+    assert error.contents.level == 1, "Failed to report other format"
+
+    # the new data plays from the same position and segments move behind it
+    assert libaudio.audioAppendSegment(audio_object, update_buffer, 0, 5000, None), "Failed to append segment"
+    assert libaudio.audioJump(audio_object, None, 200), "Failed to jump"
+    assert libaudio.audioReplaceData(audio_object, update_buffer, 0), "Failed to replace data"
+    assert libaudio.audioGetTotalDuration(audio_object) == 30000 * 1000 // 44100, "Failed to move the segments"
+    assert render(libaudio, [audio_object], [(0, 0, AUDIO_RENDER_PLAY, 0)], 1000), "Failed to render"
+    with wave.open(output) as result:
+        rendered = array.array("h", result.readframes(result.getnframes()))
+    played = rendered.index(-8820)
+    heard = len(rendered[played:].tobytes().rstrip(b"\0")) // 2
+    expected = array.array("h", [*(-frame for frame in range(8820, 25000)), *(-frame for frame in range(5000))])
+    assert heard > 16180, "Failed to render the new data"
+    assert rendered[played:played + heard] == expected[:heard], "Failed to keep the position"
+    libaudio.audioDestroy(audio_object)
+
+    # the crossfade fades the old into the new data behind the position
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), file.name.encode(), None
+    )
+    assert libaudio.audioJump(audio_object, None, 200), "Failed to jump"
+    assert libaudio.audioReplaceData(audio_object, update_buffer, 10), "Failed to replace data with crossfade"
+    assert render(libaudio, [audio_object], [(0, 0, AUDIO_RENDER_PLAY, 0)], 1000), "Failed to render"
+    with wave.open(output) as result:
+        rendered = array.array("h", result.readframes(result.getnframes()))
+    played = next(i for i, sample in enumerate(rendered) if sample)
+    fade = [
+        round(frame * (1 - (i + 1) / 442) - frame * (i + 1) / 442)
+        for i, frame in enumerate(range(8820, 9261))
+    ]
+    assert list(rendered[played:played + 441]) == fade, "Failed to crossfade into the new data"
+    assert list(rendered[played + 441:played + 451]) == [-frame for frame in range(9261, 9271)], "Failed to continue with the new data"
+    libaudio.audioDestroy(audio_object)
+
+    # the data can be replaced again while it plays
+    audio_configuration.soundDeviceName = str.encode("memory")
+    audio_configuration.soundDeviceNameSize = 7
+    audio_object = libaudio.audioInitFromPath(
+        ctypes.byref(audio_configuration), file.name.encode(), None
+    )
+    assert libaudio.audioPlay(audio_object, None), "Failed to play"
+    time.sleep(0.05)
+    assert libaudio.audioReplaceData(audio_object, update_buffer, 5), "Failed to replace playing data"
+    time.sleep(0.05)
+    assert libaudio.audioReplaceData(audio_object, update_buffer, 5), "Failed to replace the replacement"
+    assert libaudio.audioGetIsPlaying(audio_object), "Failed to keep playing"
+    events = wait_for_events(libaudio, audio_object, AUDIO_STATE_STOPPED, 3)
+    assert any(event.type == AUDIO_EVENT_END_REACHED for event in events), "Failed to play to the new end"
+    libaudio.audioDestroy(audio_object)
+
+    libaudio.audioBufferRelease(update_buffer)
+    libaudio.audioBufferRelease(stereo_buffer)
+    os.remove(output)
+    os.remove(file.name)
+    os.remove(update.name)
+    os.remove(stereo.name)
+
+
+def test_audio_pcm_pool():
+    configuration = {"sample_rate": 44100, "number_of_channels": 2, "bit_depth": 16, "duration": 1}
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+
+    def init(device_name: str, time_resolution: int):
+        audio_configuration = AudioConfiguration(
+            rawData=None,
+            rawDataSize=0,
+            soundDeviceName=device_name.encode(),
+            soundDeviceNameSize=len(device_name) + 1,
+            timeResolution=time_resolution  # ms
+        )
+        audio_object = libaudio.audioInitFromPath(
+            ctypes.byref(audio_configuration), file.name.encode(), None
+        )
+        assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+        return audio_object
+
+    # without the pool nothing is kept
+    libaudio.audioDestroy(init("default", 10))
+    assert libaudio.audioGetPcmPoolSize() == 0, "Failed to disable the pool by default"
+
+    # a destroyed object leaves its pcm to the next one with the same setup
+    libaudio.audioSetPcmPool(2, 10000)
+    libaudio.audioDestroy(init("default", 10))
+    assert libaudio.audioGetPcmPoolSize() == 1, "Failed to keep the pcm"
+    audio_object = init("default", 10)
+    assert libaudio.audioGetPcmPoolSize() == 0, "Failed to take the kept pcm"
+    assert libaudio.audioPlay(audio_object, None), "Failed to play on the kept pcm"
+    time.sleep(0.05)
+    assert libaudio.audioGetCurrentTime(audio_object) > 0, "Failed to play on the kept pcm"
+    libaudio.audioDestroy(audio_object)
+    assert libaudio.audioGetPcmPoolSize() == 1, "Failed to return the played pcm"
+
+    # other setups open their own pcm and the pool keeps up to its limit
+    audio_objects = [init("default", time_resolution) for time_resolution in (20, 30, 40)]
+    assert libaudio.audioGetPcmPoolSize() == 1, "Failed to tell the setups apart"
+    for audio_object in audio_objects:
+        libaudio.audioDestroy(audio_object)
+    assert libaudio.audioGetPcmPoolSize() == 2, "Failed to limit the pool"
+    libaudio.audioDestroy(init("memory", 10))
+    assert libaudio.audioGetPcmPoolSize() == 2, "Failed to skip memory sinks"
+
+    # idle pcms expire, the thread closing them ends with the last one
+    libaudio.audioSetPcmPool(2, 50)
+    time.sleep(0.1)
+    assert libaudio.audioGetPcmPoolSize() == 0, "Failed to close idle pcms"
+    def wait_for_threads(count: int, timeout: float) -> bool:
+        deadline = time.monotonic() + timeout
+        while len(os.listdir("/proc/self/task")) != count:
+            if time.monotonic() > deadline:
+                return False
+            time.sleep(0.01)
+        return True
+
+    thread_count = len(os.listdir("/proc/self/task"))
+    libaudio.audioSetPcmPool(2, 500)
+    libaudio.audioDestroy(init("default", 10))
+    assert wait_for_threads(thread_count + 1, 0.3), "Failed to start closing idle pcms"
+    assert wait_for_threads(thread_count, 2), "Failed to close idle pcms without using the pool"
+    assert libaudio.audioGetPcmPoolSize() == 0, "Failed to close idle pcms without using the pool"
+
+    # an idle time of 0 keeps nothing
+    libaudio.audioSetPcmPool(2, 0)
+    libaudio.audioDestroy(init("default", 10))
+    assert libaudio.audioGetPcmPoolSize() == 0, "Failed to close pcms without idle time"
+    libaudio.audioSetPcmPool(0, 0)
+    os.remove(file.name)
+
+
+def test_audio_init_batch():
+    configuration = {"sample_rate": 44100, "number_of_channels": 2, "bit_depth": 16, "duration": 1}
+    file = tempfile.NamedTemporaryFile(suffix=".wav", delete=False)
+    synth_audio(file.name, configuration)
+    libaudio = bind_libaudio()
+    with open(file.name, "rb") as wav_file:
+        buffer = bytearray(wav_file.read())
+    invalid_buffer = bytearray(b"RIFF" + bytes(40))
+
+    # the last configuration is invalid, its object reports the error
+    object_count = 12
+    audio_configurations = (AudioConfiguration * (object_count + 1))()
+    for index in range(object_count):
+        audio_configurations[index] = create_audio_configuration(buffer, len(buffer))
+    audio_configurations[object_count] = create_audio_configuration(invalid_buffer, len(invalid_buffer))
+
+    for thread_count in [1, 4, 0]:
+        ready = []
+        callback = AudioBatchCallback(lambda user_data, index, audio_object: ready.append(index))
+        batch = libaudio.audioInitBatch(audio_configurations, object_count + 1, thread_count, callback, None)
+        assert batch is not None, "Failed to create the batch"
+        assert (file_descriptor := libaudio.audioBatchGetFd(batch)) >= 0, "Failed to create the file descriptor"
+
+        # objects are handed over one at a time through the file descriptor
+        read = []
+        indices = (ctypes.c_uint32 * 4)()
+        while len(read) < object_count + 1:
+            assert select.select([file_descriptor], [], [], 5)[0], "Failed to signal ready objects"
+            read += indices[:libaudio.audioBatchReadObjects(batch, indices, len(indices))]
+        assert not select.select([file_descriptor], [], [], 0)[0], "Failed to clear the file descriptor"
+        assert libaudio.audioBatchWait(batch) == object_count + 1, "Failed to wait for the batch"
+        assert sorted(read) == list(range(object_count + 1)), "Failed to read every object once"
+        assert sorted(ready) == sorted(read), "Failed to call back for every object"
+
+        audio_objects = []
+        for index in range(object_count + 1):
+            audio_object = ctypes.c_void_p()
+            assert libaudio.audioBatchGetObject(batch, index, ctypes.byref(audio_object)), "Failed to get a ready object"
+            audio_objects.append(ctypes.cast(audio_object, ctypes.POINTER(ctypes.c_void_p)))
+        libaudio.audioBatchDestroy(batch)
+        for audio_object in audio_objects[:object_count]:
+            assert (error := libaudio.audioGetError(audio_object)).contents.level == 0, f"ERROR while initialize:{libaudio.audioGetErrorString(error).decode('utf-8')}"
+            assert libaudio.audioGetTotalDuration(audio_object) == 1000, "Failed to initialize in the batch"
+        assert libaudio.audioGetError(audio_objects[object_count]).contents.level == 2, "Failed to report the invalid data"
+        assert libaudio.audioPlay(audio_objects[0], None), "Failed to play an object of the batch"
+        for audio_object in audio_objects:
+            libaudio.audioDestroy(audio_object)
+    os.remove(file.name)
@@ -0,0 +1,152 @@
+#define _GNU_SOURCE
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "audio.h"
+
+/*
+ * Probes every WAV and FLAC file below a directory and prints one JSON
+ * object per file, sorted by path. Only the headers are read, on one
+ * thread per processor unless a thread count is given. A summary goes to
+ * stderr.
+*/
+
+#define MAX_OPEN_DIRECTORIES (64)
+
+char **paths = NULL;  /* The collected paths */
+uint32_t pathCount = 0;  /* The amount of collected paths */
+uint32_t pathCapacity = 0;  /* The room in paths */
+
+int collectPath(
+    const char *path, const struct stat *stats, int type, struct FTW *ftw
+) {
+    if (type != FTW_F) return 0;
+    const char *extension = strrchr(path, '.');
+    if (
+        extension == NULL 
+        || (strcasecmp(extension, ".wav") && strcasecmp(extension, ".flac"))
+    ) {
+        return 0;
+    }
+    if (pathCount == pathCapacity) {
+        pathCapacity = pathCapacity ? pathCapacity * 2 : 1024;
+        char **grown = realloc(paths, pathCapacity * sizeof(char*));
+        if (grown == NULL) return -1;
+        paths = grown;
+    }
+    if ((paths[pathCount] = strdup(path)) == NULL) return -1;
+    ++pathCount;
+    return 0;
+}
+
+int comparePaths(const void *a, const void *b) {
+    return strcmp(*(const char**)a, *(const char**)b);
+}
+
+void printString(const char *string) {
+    putchar('"');
+    for (const unsigned char *c = (const unsigned char*)string; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            printf("\\%c", *c);
+        } else if (*c < 0x20) {
+            printf("\\u%04x", *c);
+        } else {
+            putchar(*c);
+        }
+    }
+    putchar('"');
+}
+
+const char * getFormatName(uint16_t format) {
+    switch (format) {
+        case 0x0001: return "pcm";
+        case 0x0002: return "ms-adpcm";
+        case 0x0003: return "float";
+        case 0x0006: return "a-law";
+        case 0x0007: return "mu-law";
+        case 0x0011: return "ima-adpcm";
+        case 0xF1AC: return "flac";
+        default: return "unknown";
+    }
+}
+
+void printProbe(const char *path, AudioProbe *probe) {
+    printf("{\"path\":");
+    printString(path);
+    bool isValid = probe->error.level != AUDIO_ERROR_LEVEL_ERROR;
+    printf(",\"valid\":%s", isValid ? "true" : "false");
+    if (probe->error.level != AUDIO_ERROR_LEVEL_INFO) {
+        printf(",\"error\":");
+        printString(audioGetErrorString(&probe->error));
+    }
+    printf(",\"size\":%lu", (unsigned long)probe->fileSize);
+    if (isValid) {
+        printf(
+            ",\"format\":\"%s\",\"channels\":%u,\"sampleRate\":%u"
+            ",\"bitsPerSample\":%u,\"frames\":%lu,\"durationMs\":%u,\"cues\":%u",
+            getFormatName(probe->format), probe->channelAmount, 
+            probe->sampleRate, probe->bitsPerSample, 
+            (unsigned long)probe->frameCount, probe->durationMilliseconds, 
+            probe->cueCount
+        );
+    }
+    printf(",\"chunks\":[");
+    for (uint16_t i = 0; i < probe->chunkCount; ++i) {
+        char id[5] = { 0 };
+        memcpy(id, probe->chunks[i].id, 4);
+        printf("%s{\"id\":", i ? "," : "");
+        printString(id);
+        printf(
+            ",\"offset\":%lu,\"size\":%u}", 
+            (unsigned long)probe->chunks[i].offset, probe->chunks[i].size
+        );
+    }
+    printf("]}\n");
+}
+
+double now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s DIRECTORY [THREADS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    uint32_t threadCount = argc == 3 ? (uint32_t)strtoul(argv[2], NULL, 10) : 0;
+
+    double start = now();
+    if (nftw(argv[1], collectPath, MAX_OPEN_DIRECTORIES, FTW_PHYS) != 0) {
+        perror("nftw");
+        return EXIT_FAILURE;
+    }
+    qsort(paths, pathCount, sizeof(char*), comparePaths);
+    AudioProbe *probes = calloc(pathCount ? pathCount : 1, sizeof(AudioProbe));
+    if (probes == NULL) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    audioProbeFiles((const char**)paths, pathCount, threadCount, probes);
+    double seconds = now() - start;
+
+    uint32_t invalidCount = 0;
+    for (uint32_t i = 0; i < pathCount; ++i) {
+        printProbe(paths[i], &probes[i]);
+        invalidCount += probes[i].error.level == AUDIO_ERROR_LEVEL_ERROR;
+        free(paths[i]);
+    }
+    fprintf(
+        stderr, "Indexed %u files (%u invalid) in %.3f s\n", 
+        pathCount, invalidCount, seconds
+    );
+    free(paths);
+    free(probes);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio.h"
+
+/*
+ * Packs WAV or FLAC files into a sound bank. Every clip is named after its
+ * file name without the directory, which is what audioBankFindClip() is
+ * called with later on.
+*/
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s BANK_FILE WAV_OR_FLAC_FILE...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint32_t clipCount = argc - 2;
+    const char **clipPaths = (const char**)&argv[2];
+    const char **clipNames = calloc(clipCount, sizeof(char*));
+    if (clipNames == NULL) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    for (uint32_t i = 0; i < clipCount; ++i) {
+        const char *separator = strrchr(clipPaths[i], '/');
+        clipNames[i] = separator ? separator + 1 : clipPaths[i];
+    }
+
+    AudioError error;
+    if (!audioBankPack(argv[1], clipPaths, clipNames, clipCount, &error)) {
+        fprintf(stderr, "Error: %s\n", audioGetErrorString(&error));
+        free(clipNames);
+        return EXIT_FAILURE;
+    }
+    printf("Packed %u clips into %s\n", clipCount, argv[1]);
+    free(clipNames);
+    return EXIT_SUCCESS;
+}
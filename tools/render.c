@@ -0,0 +1,167 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio.h"
+
+/*
+ * Renders WAV or FLAC files through a timed script as fast as the CPU
+ * allows and writes what would have been played to WAV files. Every line
+ * of the script is one of
+ *
+ *   load INPUT OUTPUT     adds an audio object that plays INPUT into OUTPUT
+ *   MS OBJECT ACTION [V]  gives ACTION to the OBJECT-th loaded file at MS
+ *   MS end                ends the render at MS
+ *
+ * where ACTION is play, pause, stop, jump, cue, volume or gain. Empty
+ * lines and lines starting with '#' are skipped.
+*/
+
+#define MAX_OBJECTS (64)
+#define DEFAULT_TIME_RESOLUTION (10)
+#define RENDER_DEVICE_PREFIX ("render:")
+
+static const char *actionNames[] = {
+    "play", "pause", "stop", "jump", "cue", "volume", "gain"
+};
+
+AudioObject objects[MAX_OBJECTS];  /* The loaded audio objects */
+uint32_t objectCount = 0;  /* The amount of loaded audio objects */
+AudioRenderCommand *commands = NULL;  /* The parsed commands */
+uint32_t commandCount = 0;  /* The amount of parsed commands */
+uint32_t commandCapacity = 0;  /* The room in commands */
+
+bool loadObject(const char *input, const char *output, uint32_t timeResolution) {
+    if (objectCount == MAX_OBJECTS) {
+        fprintf(stderr, "Error: more than %d files\n", MAX_OBJECTS);
+        return false;
+    }
+    char *deviceName;
+    if (asprintf(&deviceName, "%s%s", RENDER_DEVICE_PREFIX, output) < 0) {
+        perror("malloc");
+        return false;
+    }
+    AudioConfiguration configuration = {
+        .soundDeviceName = deviceName,
+        .soundDeviceNameSize = strlen(deviceName) + 1,
+        .timeResolution = timeResolution
+    };
+    AudioObject audio = audioInitFromPath(&configuration, input, NULL);
+    free(deviceName);
+    if (audio == NULL) {
+        perror("malloc");
+        return false;
+    }
+    AudioError *error = audioGetError(audio);
+    if (error->level == AUDIO_ERROR_LEVEL_ERROR) {
+        fprintf(stderr, "Error loading %s: %s\n", input, audioGetErrorString(error));
+        audioDestroy(audio);
+        return false;
+    }
+    objects[objectCount++] = audio;
+    return true;
+}
+
+bool addCommand(uint64_t milliseconds, uint32_t object, const char *action, double value) {
+    uint32_t actionCount = sizeof(actionNames) / sizeof(actionNames[0]);
+    uint32_t i = 0;
+    while (i < actionCount && strcmp(action, actionNames[i])) ++i;
+    if (i == actionCount) return false;
+    if (commandCount == commandCapacity) {
+        commandCapacity = commandCapacity ? commandCapacity * 2 : 64;
+        AudioRenderCommand *grown = realloc(
+            commands, commandCapacity * sizeof(AudioRenderCommand)
+        );
+        if (grown == NULL) return false;
+        commands = grown;
+    }
+    commands[commandCount++] = (AudioRenderCommand){
+        .milliseconds = milliseconds,
+        .object = object,
+        .action = (enum AudioRenderAction)i,
+        .value = value
+    };
+    return true;
+}
+
+bool readScript(FILE *script, uint32_t timeResolution, uint64_t *endMilliseconds) {
+    char line[4096];
+    uint32_t lineNumber = 0;
+    bool hasEnd = false;
+    while (fgets(line, sizeof(line), script) != NULL) {
+        ++lineNumber;
+        char input[2048], output[2048], action[16];
+        unsigned long long milliseconds;
+        uint32_t object;
+        double value = 0.0;
+        if (line[0] == '#' || strspn(line, " \t\r\n") == strlen(line)) continue;
+        if (sscanf(line, "load %2047s %2047s", input, output) == 2) {
+            if (!loadObject(input, output, timeResolution)) return false;
+        } else if (
+            sscanf(line, "%llu %15s", &milliseconds, action) == 2 && !strcmp(action, "end")
+        ) {
+            *endMilliseconds = milliseconds;
+            hasEnd = true;
+        } else if (
+            sscanf(line, "%llu %u %15s %lf", &milliseconds, &object, action, &value) < 3
+            || !addCommand(milliseconds, object, action, value)
+        ) {
+            fprintf(stderr, "Error: invalid line %u: %s", lineNumber, line);
+            return false;
+        }
+    }
+    if (!hasEnd) {
+        fprintf(stderr, "Error: the script has no end\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s SCRIPT [TIME_RESOLUTION_MS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    uint32_t timeResolution = argc == 3 ? atoi(argv[2]) : DEFAULT_TIME_RESOLUTION;
+    FILE *script = fopen(argv[1], "r");
+    if (script == NULL) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+    uint64_t endMilliseconds = 0;
+    bool success = readScript(script, timeResolution, &endMilliseconds);
+    fclose(script);
+
+    if (success && objectCount == 0) {
+        fprintf(stderr, "Error: the script loads no file\n");
+        success = false;
+    }
+    if (success) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        success = audioRender(
+            objects, objectCount, commands, commandCount, endMilliseconds
+        );
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        for (uint32_t i = 0; i < objectCount; ++i) {
+            AudioError *error = audioGetError(objects[i]);
+            if (error->level != AUDIO_ERROR_LEVEL_INFO) {
+                fprintf(stderr, "File %u: %s\n", i, audioGetErrorString(error));
+            }
+        }
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        if (success) {
+            fprintf(
+                stderr, "Rendered %.1f s of audio in %.2f s\n",
+                endMilliseconds / 1000.0, seconds
+            );
+        }
+    }
+
+    for (uint32_t i = 0; i < objectCount; ++i) audioDestroy(objects[i]);
+    free(commands);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}